@@ -8,24 +8,32 @@
 #import <CHDataStructures/CHAVLTree.h>
 #import "CHAbstractBinarySearchTree_Internal.h"
 
-// Two-way single rotation
+// Two-way single rotation; the node returned takes the place of node under its
+// parent, and so gets its parent link.
 static CHBinaryTreeNode * singleRotation(CHBinaryTreeNode *node, u_int32_t dir) {
 	CHBinaryTreeNode *save = node->link[!dir];
-	node->link[!dir] = save->link[dir];
-	save->link[dir] = node;
+	save->parent = node->parent;
+	CHBinaryTreeLinkChild(node, !dir, save->link[dir]);
+	CHBinaryTreeLinkChild(save, dir, node);
+	CHBinaryTreeNode_UPDATE_SIZE(node);
+	CHBinaryTreeNode_UPDATE_SIZE(save);
 	return save;
 }
 
 // Two-way double rotation
 static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, u_int32_t dir) {
 	CHBinaryTreeNode *save = node->link[!dir]->link[dir];
-	node->link[!dir]->link[dir] = save->link[!dir];
-	save->link[!dir] = node->link[!dir];
-	node->link[!dir] = save;
+	CHBinaryTreeLinkChild(node->link[!dir], dir, save->link[!dir]);
+	CHBinaryTreeLinkChild(save, !dir, node->link[!dir]);
+	CHBinaryTreeLinkChild(node, !dir, save);
 	
 	save = node->link[!dir];
-	node->link[!dir] = save->link[dir];
-	save->link[dir] = node;
+	save->parent = node->parent;
+	CHBinaryTreeLinkChild(node, !dir, save->link[dir]);
+	CHBinaryTreeLinkChild(save, dir, node);
+	CHBinaryTreeNode_UPDATE_SIZE(node);
+	CHBinaryTreeNode_UPDATE_SIZE(save->link[!dir]);
+	CHBinaryTreeNode_UPDATE_SIZE(save);
 	return save;
 }
 
@@ -51,14 +59,17 @@ static void adjustBalance(CHBinaryTreeNode *root, u_int32_t dir, int32_t bal) {
 - (void)addObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeFinger_DECLARE(aKey);
 	
 	CHBinaryTreeNode *parent = nil, *save = nil, *current = header;
 	CHBinaryTreeStack_DECLARE();
 	CHBinaryTreeStack_INIT();
 	
-	sentinel->object = anObject; // Assure that we find a spot to insert
+	sentinel->key = aKey; // Assure that we find a spot to insert
 	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
+	while ((comparison = CHBinaryTreeFingerCompare(current, aKey))) {
 		CHBinaryTreeStack_PUSH(current);
 		if (current == header) {
 			save = current->right;
@@ -73,17 +84,21 @@ static void adjustBalance(CHBinaryTreeNode *root, u_int32_t dir, int32_t bal) {
 	if (current != sentinel) {
 		// Replace the existing object with the new object.
 		[current->object release];
-		current->object = anObject;
+		CHBinaryTreeNodeSetObject(current, anObject, aKey);
 		// No need to rebalance up the path since we didn't modify the structure
 		goto done;
 	} else {
-		current = [self _createNodeWithObject:anObject];
+		current = [self _createNodeWithObject:anObject key:aKey];
 		++count;
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeStack_ADJUST_SIZES(+1);
+		}
 		// Link from parent as the proper child, based on last comparison
 		parent = CHBinaryTreeStack_POP();
 		NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
-		comparison = [parent->object compare:anObject];
-		parent->link[comparison == NSOrderedAscending] = current; // R if YES
+		comparison = CHBinaryTreeCompare(parent, aKey);
+		CHBinaryTreeLinkChild(parent, comparison == NSOrderedAscending, current); // R if YES
+		CHBinaryTreeFinger_NOTE_LEAF(current);
 	}
 	
 	// Trace back up the path, rebalancing as we go
@@ -98,6 +113,7 @@ static void adjustBalance(CHBinaryTreeNode *root, u_int32_t dir, int32_t bal) {
 		} else {
 			parent->balance--;
 		}
+		CHBinaryTreeNode *subtree = parent; // Its parent still links to it.
 		if (parent == save) {
 			// Rebalance if the balance factor is out of whack, then terminate
 			if (abs(parent->balance) > 1) {
@@ -117,9 +133,8 @@ static void adjustBalance(CHBinaryTreeNode *root, u_int32_t dir, int32_t bal) {
 		current = parent;
 		parent = CHBinaryTreeStack_POP();
 		NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
-		// Link from parent as the proper child, based on last comparison
-		comparison = [parent->object compare:current->object];
-		parent->link[comparison == NSOrderedAscending] = current; // R if YES
+		// Link from parent in place of the subtree, which a rotation may have replaced
+		CHBinaryTreeLinkChild(parent, parent->right == subtree, current);
 	}
 done:
 	CHBinaryTreeStack_FREE(stack);
@@ -127,25 +142,48 @@ done:
 
 - (void)removeObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self _removeObject:anObject orObjectAtEnd:0];
+}
+
+- (void)_removeObjectAtEnd:(NSUInteger)direction {
+	[self _removeObject:nil orObjectAtEnd:direction];
+}
+
+// Removes anObject or, if it is nil, the first (0) or last (1) object. The end
+// of the tree is reached by following links, so no comparisons are needed, and
+// rebalancing compares nodes by identity rather than by object.
+- (void)_removeObject:(id)anObject orObjectAtEnd:(NSUInteger)direction {
 	if (count == 0) {
 		return;
 	}
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
 
 	CHBinaryTreeNode *parent, *current = header;
 	CHBinaryTreeStack_DECLARE();
 	CHBinaryTreeStack_INIT();
 
-	sentinel->object = anObject; // Assure that we stop at a leaf if not found.
-	NSComparisonResult comparison;
-	// Search down the node for the tree and save the path
-	while ((comparison = [current->object compare:anObject])) {
-		CHBinaryTreeStack_PUSH(current);
-		current = current->link[comparison == NSOrderedAscending]; // R on YES
-	}
-	// Exit if the specified node was not found in the tree.
-	if (current == sentinel) {
-		goto done;
+	if (anObject == nil) {
+		// The node at the end has no child in that direction.
+		CHBinaryTreeStack_PUSH(header);
+		current = header->right;
+		while (current->link[direction] != sentinel) {
+			CHBinaryTreeStack_PUSH(current);
+			current = current->link[direction];
+		}
+	} else {
+		CHBinaryTreeKey_DECLARE(anObject);
+		sentinel->key = aKey; // Assure that we stop at a leaf if not found.
+		NSComparisonResult comparison;
+		// Search down the node for the tree and save the path
+		while ((comparison = CHBinaryTreeCompare(current, aKey))) {
+			CHBinaryTreeStack_PUSH(current);
+			current = current->link[comparison == NSOrderedAscending]; // R on YES
+		}
+		// Exit if the specified node was not found in the tree.
+		if (current == sentinel) {
+			goto done;
+		}
 	}
 	
 	[current->object release]; // Object must be released in any case
@@ -155,11 +193,14 @@ done:
 	if (current->left == sentinel || current->right == sentinel) {
 		// Single/zero child case -- replace node with non-nil child (if exists)
 		replacement = current->link[current->left == sentinel];
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeStack_ADJUST_SIZES(-1);
+		}
 		parent = CHBinaryTreeStack_POP();
 		NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
 		isRightChild = (parent->right == current);
-		parent->link[isRightChild] = replacement;
-		free(current);
+		CHBinaryTreeLinkChild(parent, isRightChild, replacement);
+		CHBinaryTreeNode_FREE(current);
 	} else {
 		// Two child case -- replace with minimum object in right subtree
 		CHBinaryTreeStack_PUSH(current); // Need to start here when rebalancing
@@ -169,11 +210,14 @@ done:
 			replacement = replacement->left;
 		}
 		// Grab object from replacement node, steal its right child, deallocate
-		current->object = replacement->object;
+		CHBinaryTreeNode_TAKE_OBJECT(current, replacement);
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeStack_ADJUST_SIZES(-1);
+		}
 		parent = CHBinaryTreeStack_POP();
 		isRightChild = (parent->right == replacement);
-		parent->link[isRightChild] = replacement->right;
-		free(replacement);
+		CHBinaryTreeLinkChild(parent, isRightChild, replacement->right);
+		CHBinaryTreeNode_FREE(replacement);
 	}
 	
 	// Trace back up the search path, rebalancing as we go until we're done
@@ -188,6 +232,7 @@ done:
 		// If the subtree heights differ by more than 1, rebalance them
 		if (parent->balance > 1 || parent->balance < -1) {
 			CHBinaryTreeNode *node = parent->link[!isRightChild];
+			BOOL wasRightChild = (CHBinaryTreeStack_TOP->right == parent);
 			int32_t bal = (isRightChild) ? +1 : -1;
 			if (node->balance == -bal) {
 				parent->balance = node->balance = 0;
@@ -201,8 +246,7 @@ done:
 				parent = singleRotation(parent, isRightChild);
 				done = YES;
 			}
-			comparison = [CHBinaryTreeStack_TOP->object compare:parent->object];
-			CHBinaryTreeStack_TOP->link[comparison == NSOrderedAscending] = parent;
+			CHBinaryTreeLinkChild(CHBinaryTreeStack_TOP, wasRightChild, parent);
 		} else if (parent->balance != 0) {
 			break;
 		}
@@ -214,6 +258,13 @@ done:
 	CHBinaryTreeStack_FREE(stack);
 }
 
+- (void)_balanceBuiltNode:(CHBinaryTreeNode *)node count:(NSUInteger)subtreeCount depth:(NSUInteger)depth height:(NSUInteger)height {
+	// The right subtree has either the same number of nodes as the left or one more.
+	NSUInteger leftCount = (subtreeCount - 1) / 2;
+	node->balance = (int32_t) (CHBinaryTreeHeightForCount(subtreeCount - 1 - leftCount)
+	                           - CHBinaryTreeHeightForCount(leftCount));
+}
+
 - (NSString *)debugDescriptionForNode:(CHBinaryTreeNode *)node {
 	return [NSString stringWithFormat:@"[%2d]\t\"%@\"",
 			node->balance, node->object];
@@ -20,6 +20,7 @@ NS_ASSUME_NONNULL_BEGIN
  <pre>
     typedef struct CHBinaryTreeNode {
         id object;
+        id key;
         union {
             struct {
                 __strong struct CHBinaryTreeNode *left;
@@ -27,12 +28,14 @@ NS_ASSUME_NONNULL_BEGIN
             };
             __strong struct CHBinaryTreeNode *link[2];
         };
+        struct CHBinaryTreeNode *parent;
         union {
               int32_t balance;   // Used by CHAVLTree
             u_int32_t color;     // Used by CHRedBlackTree
             u_int32_t level;     // Used by CHAnderssonTree
             u_int32_t priority;  // Used by CHTreap
         };
+        u_int32_t size;
     } CHBinaryTreeNode;</pre>
  
  The nested anonymous union and structs are to provide flexibility for dealing with various types of trees and access. (For those not familiar, a <a href="http://en.wikipedia.org/wiki/Union_(computer_science)">union</a> is a data structure in which all members are stored at the same memory location, and can take on the value of any of its fields. A union occupies only as much space as the largest member, whereas a struct requires space equal to at least the sum of the size of its members.)
@@ -40,10 +43,16 @@ NS_ASSUME_NONNULL_BEGIN
  - The first union provides two equivalent ways to access child nodes, based on what is most convenient and efficient. Because of the order in which the fields are declared, <code>left === link[0]</code> and <code>right === link[1]</code>, meaning these respective pairs point to the same memory address. (This technique is an adaptation of the idiom used in the BST tutorials on <a href="http://eternallyconfuzzled.com/tuts/datastructures/jsw_tut_bst1.aspx">EternallyConfuzzled.com</a>.)
  - The second union allows balanced trees to store extra data at each node, while using the field name and type that makes sense for its algorithms. This allows for generic reuse while promoting meaningful semantics and preserving space. These fields use 32-bit-only types since we don't need extra space in 64-bit mode.
  
+ - The @a size field holds the number of nodes in the subtree rooted at the node (including itself), but is only kept current once a tree has been asked a positional question, such as \link CHAbstractBinarySearchTree#objectAtIndex: -objectAtIndex:\endlink. It occupies what would otherwise be padding after the second union in 64-bit mode, so it doesn't make nodes any larger; the 32-bit type limits positional queries to trees with fewer than 2<sup>32</sup> objects.
+ - The @a key field holds the value by which the node is ordered. For most trees this is simply the node's object, but a tree created with a key path or sort descriptor stores the object's value for that key path here when the object is added, so that searches compare keys directly instead of evaluating the key path of both objects for every comparison. A key that isn't the object itself is retained by the node.
+ - A tree that caches key prefixes (see \link CHAbstractBinarySearchTree#setCachesKeyPrefixes: -setCachesKeyPrefixes:\endlink) stores a 64-bit prefix of each node's key immediately after the node, making each node 56 bytes rather than 48 in 64-bit mode. Other trees' nodes have no room for one, so they are not affected.
+ - The @a parent field links each node to the node above it (the header node, for the root). Subclasses change child links only with a function that also sets the child's parent, so parent links are always current, and the cost is a single store per link plus one pointer per node. The sentinel's parent is overwritten freely, and is never read.
+ 
  Since CHUnbalancedTree doesn't store any extra data, the second union is essentially 4 bytes of pure overhead per node. However, since unbalanced trees are generally not a good choice for sorting large data sets anyway, this is largely a moot point.
  */
 typedef struct CHBinaryTreeNode {
 	__unsafe_unretained _Nullable id object;                        ///< The object stored in the node.
+	__unsafe_unretained _Nullable id key;                           ///< The key by which the node is ordered.
 	union {
 		struct {
 			struct CHBinaryTreeNode *left;  ///< Link to left child.
@@ -51,17 +60,35 @@ typedef struct CHBinaryTreeNode {
 		};
 		struct CHBinaryTreeNode * _Nullable link[2];   ///< Links to both childen.
 	};
+	struct CHBinaryTreeNode *parent; ///< Link to parent node (the header, for the root).
 	union {
 		  int32_t balance;   // Used by CHAVLTree
 		u_int32_t color;     // Used by CHRedBlackTree
 		u_int32_t level;     // Used by CHAnderssonTree
 		u_int32_t priority;  // Used by CHTreap
 	};
+	u_int32_t size; ///< The number of nodes in this subtree, if tracked.
 } CHBinaryTreeNode;
 // NOTE: If the compiler issues "Declaration does not declare anthing" warnings for this struct, change the C Language Dialect in your Xcode build settings to GNU99; anonymous structs and unions are not properly supported by the C99 standard.
 
+struct CHBinaryTreeNodeSlab; // Defined in CHAbstractBinarySearchTree_Internal.h
+
 /**
  An abstract CHSearchTree with many default method implementations. Methods for search, size, and enumeration are implemented in this class, as are methods for NSCoding, NSCopying, and NSFastEnumeration. (This works since all child classes use the CHBinaryTreeNode struct.) Any subclass @b must implement \link #addObject: -addObject:\endlink and \link #removeObject: -removeObject:\endlink according to the inner workings of that specific tree.
+
+ Nodes are not allocated individually. Each tree carves its nodes out of larger slabs and keeps removed nodes on a free list for reuse, which avoids a @c malloc() and @c free() per insertion and removal and keeps nodes close together in memory. Slabs are only released by \link #removeAllObjects -removeAllObjects\endlink or when the tree is deallocated, so a tree that shrinks dramatically continues to hold the memory for its peak size until then.
+ 
+ Nodes link to their parents as well as their children, so a traversal in any order but level order can find the next node from the current one, and enumerators (including fast enumeration and subset views) don't need to allocate a stack of the nodes above it. A short range scan costs only the O(log n) search for its first object, plus amortized O(1) for each object after that.
+ 
+ Copying a tree duplicates its nodes directly, including any balancing data, so the copy has exactly the same shape and takes O(n) time without comparing any objects. Archives record the shape as well, so unarchiving a tree is also linear and needs no comparisons. (Archives of subset views, and those made by older versions, contain only the objects, which are sorted and built into a balanced tree.)
+ 
+ Positional queries (such as \link #objectAtIndex: -objectAtIndex:\endlink) take O(log n) time in a tree that keeps a count of the nodes in each subtree. Maintaining those counts adds a little work to each insertion and removal, so a tree only does so once it is asked to with \link #setTracksSubtreeSizes: -setTracksSubtreeSizes:\endlink; otherwise, positional queries walk the tree in O(n) time. Either way, they never modify the tree, so they are as safe to call from several threads at once as any other search.
+ 
+ Objects often arrive in nearly ascending order, such as timestamps or sequence numbers that are only occasionally late. Once an insertion adds a new greatest object, the insertions after it start at the greatest node rather than the root: they climb the right spine (the path from the root to the greatest node) until reaching an object less than the one being inserted, and the subclass's usual search goes down the spine to that point without comparing anything. Appending an object then takes a constant number of comparisons rather than O(log n), and an object that belongs a short distance from the end takes a few more. A tree returns to searching from the root as soon as an insertion climbs more than halfway up the spine. (CHSplayTree doesn't do this, since the object it inserted last is already at the root.)
+ 
+ Objects are ordered by their @c -compare: method, unless the tree is created with a comparator block or comparison function instead. Objects can also be ordered by the value of a key path (such as a property of model objects), using a key path or an NSSortDescriptor. Such a tree evaluates the key path once for each object as it is added and keeps the result in the object's node, so a search evaluates it only for the object being searched for, rather than for two objects at every level of the tree, and \link #memberForKey: -memberForKey:\endlink needs no object at all. Rather than sending @c -compare: for every comparison, each operation looks up the method once and calls it directly, looking it up again only if it encounters an object of a different class.
+ 
+ Combining a tree with another sorted set (as in \link #unionWithSortedSet: -unionWithSortedSet:\endlink) is done in one of two ways. If the other set is small enough that searching the tree for each of its objects costs less than visiting every node, its objects are added, removed, or searched for individually, which takes O(m log n) time. Otherwise, the two sets of sorted objects are merged and the tree is rebuilt from the result, which takes O(n + m) time. Merges of more than about 65,000 objects are split into independent chunks that are processed concurrently using Grand Central Dispatch, so the objects' @c -compare: methods (or the tree's comparator or comparison function) must be safe to call from multiple threads at once, which is true of immutable objects such as NSString and NSNumber.
  
  Rather than enforcing that this class be abstract, the contract is implied. If this class were actually instantiated, it would be of little use since there is attempts to insert or remove will result in runtime exceptions being raised.
  
@@ -73,10 +100,362 @@ typedef struct CHBinaryTreeNode {
 	CHBinaryTreeNode *sentinel; // Dummy leaf; no more checks for NULL.
 	NSUInteger count; // The number of objects currently in the tree.
 	unsigned long mutations; // Tracks mutations for NSFastEnumeration.
+	struct CHBinaryTreeNodeSlab *nodeSlabs; // Blocks from which nodes are allocated.
+	CHBinaryTreeNode *freeNodes; // Unused nodes in nodeSlabs, linked by right child.
+	BOOL tracksSubtreeSizes; // Whether the size of each node is kept current.
+	BOOL insertsNearEnd; // Whether insertions search from the greatest node.
+	CHComparison ordering; // How objects are compared; its cache is never used.
+	NSComparator comparator; // The block used by ordering, if any.
+	CHComparison keyOrdering; // How the keys in nodes are compared (as ordering, unless keyed).
+	NSComparator keyComparator; // The block used by keyOrdering, if any.
+	NSSortDescriptor *sortDescriptor; // Orders objects by a key path, if not nil.
+	NSString *keyPath; // The key path of the key in each node, or nil for the object.
+	size_t nodeSize; // The size of each node, including any key prefix.
+	BOOL cachesKeyPrefixes; // Whether each node holds a prefix of its key.
 }
 
+/**
+ Initialize a search tree with the contents of an array.
+ 
+ Rather than adding each object in turn, the array is sorted (unless it is already in ascending order) and the tree is built directly in a perfectly balanced shape in linear time. If several objects in the array compare as equal, only the one occurring last in @a anArray is kept, just as if each had been added with \link #addObject: -addObject:\endlink. The same applies when \link #addObjectsFromArray: -addObjectsFromArray:\endlink is sent to an empty tree.
+ 
+ @param anArray An array containing objects with which to populate a new search tree.
+ @return An initialized search tree that contains the objects in @a anArray in sorted order.
+ */
 - (instancetype)initWithArray:(NSArray<ObjectType> *)anArray NS_DESIGNATED_INITIALIZER;
 
+/**
+ Initialize an empty search tree that orders objects using a given comparator, rather than their @c -compare: method.
+ 
+ @param cmptr A comparator block that defines a total ordering of the objects to be added. The block is copied.
+ @return An initialized search tree that contains no objects and orders them using @a cmptr.
+ 
+ @throw NSInvalidArgumentException if @a cmptr is @c nil.
+ 
+ @attention A tree created this way can't be archived, since blocks can't be encoded. Copies and subsets of the tree use the same comparator.
+ 
+ @see comparator
+ @see initWithComparisonFunction:context:
+ */
+- (instancetype)initWithComparator:(NSComparator)cmptr;
+
+/**
+ Initialize an empty search tree that orders objects using a given C function, rather than their @c -compare: method. Calling a function avoids the overhead of sending a message for each comparison.
+ 
+ @param function A function that defines a total ordering of the objects to be added.
+ @param context A pointer that is passed to @a function with each pair of objects to be compared. It is not retained.
+ @return An initialized search tree that contains no objects and orders them using @a function.
+ 
+ @throw NSInvalidArgumentException if @a function is @c NULL.
+ 
+ @attention A tree created this way can't be archived, since functions can't be encoded. Copies and subsets of the tree use the same function and context.
+ 
+ @see initWithComparator:
+ */
+- (instancetype)initWithComparisonFunction:(CHComparisonFunction)function context:(nullable void *)context;
+
+/**
+ Initialize an empty search tree that orders objects by their values for a given key path, which are compared using their @c -compare: method. This is equivalent to using a sort descriptor with the key path, in ascending order, using @c -compare:.
+ 
+ @param aKeyPath The key path whose value for each object determines its place in the tree. Every object added must have a non-nil value for it, which must not change while the object is in the tree.
+ @return An initialized search tree that contains no objects and orders them by their values for @a aKeyPath.
+ 
+ @throw NSInvalidArgumentException if @a aKeyPath is @c nil.
+ 
+ @see initWithSortDescriptor:
+ @see memberForKey:
+ */
+- (instancetype)initWithKeyPath:(NSString *)aKeyPath;
+
+/**
+ Initialize an empty search tree that orders objects as a given sort descriptor would.
+ 
+ Each object's value for the descriptor's key path (its @a key) is found once, when the object is added, and is kept in the object's node. Searches find the value for the object being searched for, then compare it with the values in the nodes they pass, using the descriptor's selector or comparator. If the descriptor uses @c -compare: in ascending order, the method is called directly, as for a tree without a key path, which is the fastest way to compare keys such as NSNumber and NSString objects.
+ 
+ @param descriptor A sort descriptor that defines a total ordering of the objects to be added. If its key is @c nil, the objects themselves are compared.
+ @return An initialized search tree that contains no objects and orders them using @a descriptor.
+ 
+ @throw NSInvalidArgumentException if @a descriptor is @c nil, or if an object added to the tree has no value for the key path.
+ 
+ @attention The value of each object for the key path must not change while the object is in the tree. A tree created this way can be archived only if @a descriptor uses a selector rather than a comparator block. Copies and subsets of the tree use the same sort descriptor.
+ 
+ @see initWithKeyPath:
+ @see sortDescriptor
+ */
+- (instancetype)initWithSortDescriptor:(NSSortDescriptor *)descriptor;
+
+/**
+ Returns the comparator used to order the objects in the receiver.
+ 
+ @return The comparator with which the receiver was initialized, or @c nil if the receiver uses a comparison function or the @c -compare: method.
+ 
+ @see initWithComparator:
+ */
+- (nullable NSComparator)comparator;
+
+/**
+ Returns the sort descriptor used to order the objects in the receiver.
+ 
+ @return The sort descriptor with which the receiver was initialized (or one equivalent to the key path it was initialized with), or @c nil if the receiver doesn't order objects by a key path.
+ 
+ @see initWithSortDescriptor:
+ */
+- (nullable NSSortDescriptor *)sortDescriptor;
+
+/**
+ Returns the object in the receiver whose key is equal to a given key, for a receiver that orders its objects by a key path. This is like \link CHSortedSet#member: -member:\endlink, but without needing an object with the key to search for.
+ 
+ @param aKey The key to search for, as it would be found by evaluating the receiver's key path for an object.
+ @return The object in the receiver whose value for the key path compares as equal to @a aKey, or @c nil if there is none.
+ 
+ @throw NSInvalidArgumentException if @a aKey is @c nil.
+ 
+ @attention For a receiver that doesn't order its objects by a key path, the keys are the objects themselves, so this is the same as \link CHSortedSet#member: -member:\endlink.
+ 
+ @see initWithKeyPath:
+ */
+- (nullable ObjectType)memberForKey:(id)aKey;
+
+/**
+ Returns whether each node in the receiver holds a prefix of its key.
+ 
+ @return @c YES if the receiver caches key prefixes, otherwise @c NO (the default).
+ 
+ @see setCachesKeyPrefixes:
+ */
+- (BOOL)cachesKeyPrefixes;
+
+/**
+ Sets whether each node in the receiver holds a prefix of its key, an unsigned 64-bit number whose order matches that of the keys. Comparing a node's prefix to that of the key being searched for takes a single instruction and doesn't touch the key, which may be elsewhere in memory; only when the prefixes are equal are the keys themselves compared. This speeds up searches of large trees whose keys are strings or numbers, at a cost of 8 bytes per node.
+ 
+ The prefix of an NSString is its first 8 characters, but only if they are all ASCII characters; a string with any other character among its first 8 has no prefix, and is always compared in full. The prefix of an NSNumber is its value as a @c double. Keys of any other class have no prefix.
+ 
+ @param flag @c YES to cache key prefixes in each node, or @c NO to stop doing so.
+ 
+ @throw NSInvalidArgumentException if @a flag is @c YES and the receiver orders its keys with a comparator or comparison function (or a sort descriptor with a selector other than @c -compare: or a descending order), since prefixes follow only the order of @c -compare:.
+ 
+ @attention Changing this setting for a non-empty receiver moves every object to a new node, which takes O(n) time. Copies and archives of the receiver keep the setting, but subset views don't use prefixes.
+ */
+- (void)setCachesKeyPrefixes:(BOOL)flag;
+
+#pragma mark Querying Contents by Position
+/** @name Querying Contents by Position */
+// @{
+
+/**
+ Returns whether the receiver keeps a count of the nodes in each subtree, for positional queries.
+ 
+ @return @c YES if the receiver tracks subtree sizes, otherwise @c NO (the default).
+ 
+ @see setTracksSubtreeSizes:
+ */
+- (BOOL)tracksSubtreeSizes;
+
+/**
+ Sets whether the receiver keeps a count of the nodes in each subtree, which makes positional queries such as #objectAtIndex: take O(log n) time rather than O(n), at the cost of a little extra work for each insertion and removal.
+ 
+ @param flag @c YES to start tracking subtree sizes, or @c NO to stop.
+ 
+ @attention Starting to track sizes computes them for the whole tree in O(n) time. This modifies every node, so (like adding an object) it must not be done while another thread may be reading the receiver. Copies of the receiver keep the setting.
+ */
+- (void)setTracksSubtreeSizes:(BOOL)flag;
+
+/**
+ Returns the object at a given position in the receiver's sorted order.
+ 
+ @param index The zero-based position of the object to return. Must be less than the value returned by #count.
+ @return The object at @a index, where index 0 is the object returned by #firstObject.
+ 
+ @throw NSRangeException if @a index exceeds the bounds of the receiver.
+ 
+ @attention This method runs in O(log n) time if the receiver tracks subtree sizes (see #setTracksSubtreeSizes:), and O(n) time otherwise.
+ 
+ @see indexOfObject:
+ */
+- (ObjectType)objectAtIndex:(NSUInteger)index;
+
+/**
+ Returns the position of a given object in the receiver's sorted order.
+ 
+ @param anObject The object to search for in the receiver.
+ @return The zero-based position of the object which compares as equal to @a anObject, or @c NSNotFound if no such object exists in the receiver. This is also the number of objects that are less than @a anObject.
+ 
+ @throw NSInvalidArgumentException if @a anObject is @c nil.
+ 
+ @attention This method runs in O(log n) time if the receiver tracks subtree sizes (see #setTracksSubtreeSizes:), and O(n) time otherwise.
+ 
+ @see objectAtIndex:
+ */
+- (NSUInteger)indexOfObject:(ObjectType)anObject;
+
+/**
+ Returns the number of objects in the receiver that fall within a given range, without enumerating them. As with \link CHSortedSet#subsetFromObject:toObject:options: -subsetFromObject:toObject:options:\endlink, a range whose start follows its end wraps around the ends of the receiver.
+ 
+ @param start Low endpoint of the range, inclusive. If @c nil, the range starts at the first object.
+ @param end High endpoint of the range, inclusive. If @c nil, the range ends at the last object.
+ @return The number of objects that are greater than or equal to @a start and less than or equal to @a end. If @a start is greater than @a end, this is instead the number of objects that are @b not strictly between them.
+ 
+ @attention This method runs in O(log n) time if the receiver tracks subtree sizes (see #setTracksSubtreeSizes:), and O(n) time otherwise.
+ */
+- (NSUInteger)countOfObjectsFromObject:(nullable ObjectType)start toObject:(nullable ObjectType)end;
+
+// @}
+
+#pragma mark Searching for Many Objects
+/** @name Searching for Many Objects */
+// @{
+
+/**
+ Determines which of the objects in a given array are members of the receiver, as if by calling \link CHSortedSet#containsObject: -containsObject:\endlink on each in turn.
+ 
+ @param anArray An array of objects to search for in the receiver.
+ @return The indexes in @a anArray of the objects that are members of the receiver.
+ 
+ @throw NSInvalidArgumentException if @a anArray is @c nil.
+ 
+ @see membersOfObjects:
+ */
+- (NSIndexSet *)containsObjects:(NSArray<ObjectType> *)anArray;
+
+/**
+ Returns the members of the receiver equal to each of the objects in a given array, as if by calling \link CHSortedSet#member: -member:\endlink on each in turn.
+ 
+ @param anArray An array of objects to search for in the receiver.
+ @return An array with an object for each object in @a anArray, at the same index: the receiver's object that is equal to it, or @c NSNull if there is none.
+ 
+ @throw NSInvalidArgumentException if @a anArray is @c nil.
+ 
+ Rather than searching for one object after another, this searches for up to 16 at a time, which take turns descending the tree one level each. Each search prefetches the next node it will visit, so that fetching the nodes for the different searches from memory overlaps, rather than every search waiting for each of its nodes in turn. This pays off most for large trees whose nodes are not already cached. If @a anArray holds enough objects that the searches would make more comparisons than a pass through the entire receiver, the objects are sorted instead, and matched to the receiver's objects in a single pass in ascending order, which takes O(n + k log k) time for k objects.
+ 
+ Like \link CHSortedSet#member: -member:\endlink, this doesn't modify the receiver, so it can be called by several threads at once, as long as no other thread modifies the receiver.
+ 
+ @see containsObjects:
+ */
+- (NSArray *)membersOfObjects:(NSArray<ObjectType> *)anArray;
+
+// @}
+
+#pragma mark Removing Objects by Position
+/** @name Removing Objects by Position */
+// @{
+
+/**
+ Removes a given number of objects from the front of the receiver's sorted order, and returns them. Along with \link CHSortedSet#removeFirstObject -removeFirstObject\endlink and \link CHSortedSet#removeLastObject -removeLastObject\endlink, this makes a tree usable as a double-ended priority queue.
+ 
+ @param n The number of objects to remove. If this exceeds the count of the receiver, every object is removed.
+ @return An array of the objects that were removed, in ascending order. If the receiver is empty or @a n is 0, the array is empty.
+ 
+ CHAVLTree, CHRedBlackTree, CHAnderssonTree and CHTreap remove their first or last object without comparing any objects, by following links down one edge of the tree. Each object takes O(log n) time to remove, but if more than half the objects are to be removed, the tree is instead rebuilt from the rest, which takes O(n) time.
+ 
+ @see removeAllObjects
+ */
+- (NSArray<ObjectType> *)removeFirstObjects:(NSUInteger)n;
+
+// @}
+
+#pragma mark Combining Sorted Sets
+/** @name Combining Sorted Sets */
+// @{
+
+/**
+ Adds each object in another sorted set to the receiver, if it is not already a member. As with \link #addObject: -addObject:\endlink, an object from @a otherSortedSet replaces any equal object already in the receiver.
+ 
+ @param otherSortedSet The sorted set of objects to add to the receiver.
+ 
+ @throw NSInvalidArgumentException if @a otherSortedSet is @c nil.
+ 
+ @see intersectWithSortedSet:
+ @see minusSortedSet:
+ */
+- (void)unionWithSortedSet:(id<CHSortedSet>)otherSortedSet;
+
+/**
+ Removes from the receiver each object that is not also in another sorted set. The objects that remain are the receiver's own, not the equal objects in @a otherSortedSet.
+ 
+ @param otherSortedSet The sorted set of objects to retain in the receiver.
+ 
+ @throw NSInvalidArgumentException if @a otherSortedSet is @c nil.
+ 
+ @see minusSortedSet:
+ @see unionWithSortedSet:
+ */
+- (void)intersectWithSortedSet:(id<CHSortedSet>)otherSortedSet;
+
+/**
+ Removes from the receiver each object that is also in another sorted set.
+ 
+ @param otherSortedSet The sorted set of objects to remove from the receiver.
+ 
+ @throw NSInvalidArgumentException if @a otherSortedSet is @c nil.
+ 
+ @see intersectWithSortedSet:
+ @see unionWithSortedSet:
+ */
+- (void)minusSortedSet:(id<CHSortedSet>)otherSortedSet;
+
+// @}
+
+#pragma mark Memory Layout
+/** @name Memory Layout */
+// @{
+
+/**
+ Moves every node of the receiver into a single contiguous block of memory, arranged so that searches touch as few cache lines and pages as possible. This is worth doing once a tree has been built (especially by adding objects one at a time) and is about to be searched many times without being modified much, since a tree's nodes otherwise end up scattered across the blocks from which they were allocated as objects were added and removed.
+ 
+ The nodes are laid out in <a href="http://en.wikipedia.org/wiki/Van_Emde_Boas_tree">van Emde Boas</a> order: the top half of the tree's levels are placed first (recursively laid out the same way), followed by each of the subtrees hanging below them, one after another. Any path from the root then crosses about log<sub>B</sub>(n) blocks of B nodes, whatever the size of a cache line or page, rather than one block for nearly every level. The shape of the tree, and any balancing data, are unchanged, and no objects are compared. Compacting takes O(n log log n) time and allocates memory for the n nodes, then frees the memory the nodes were in before, including that held for objects which have been removed.
+ 
+ The receiver may still be modified afterward. Nodes for objects added later come from new blocks, so a tree that changes a great deal gradually loses the benefit, and can be compacted again.
+ 
+ @warning Any enumerators or subset views of the receiver become invalid, since the nodes they refer to have moved, and will raise a mutation exception if used afterward.
+ */
+- (void)compact;
+
+// @}
+
+/**
+ Returns a read-only sorted set of the objects in the receiver that fall within a given range, without copying them.
+ 
+ The range is interpreted in the same way as in \link CHSortedSet#subsetFromObject:toObject:options: -subsetFromObject:toObject:options:\endlink. However, rather than building a new tree, the returned set is a view of the receiver that descends directly to the start of the range when it is enumerated, so creating it takes constant time and enumerating k objects takes O(log n + k) time. Searching the view with @c -member: or @c -containsObject: takes O(log n) time, while @c -count must enumerate the view once.
+ 
+ Like an enumerator, the view becomes invalid if the receiver is modified, and will raise a mutation exception if it is used after that. Methods that would modify the view raise an exception. A copy of the view (or one that is archived and unarchived) is an independent tree of the same class as the receiver.
+ 
+ @param start Low endpoint of the range.
+ @param end High endpoint of the range.
+ @param options A combination of @c CHSubsetConstructionOptions values that specifies how to construct the range.
+ @return A read-only view of the objects in the receiver that fall within the specified range.
+ 
+ @see subsetFromObject:toObject:options:
+ */
+- (id<CHSortedSet>)subsetViewFromObject:(nullable ObjectType)start toObject:(nullable ObjectType)end options:(CHSubsetConstructionOptions)options;
+
+/**
+ Returns an enumerator that accesses the objects in the receiver in ascending order, starting at a given object. The enumerator descends directly to the least object not less than @a anObject (as found by \link CHSortedSet#ceilingObject: -ceilingObject:\endlink), so enumerating k objects takes O(log n + k) time.
+
+ @param anObject The object at which to start; need not be present in the receiver.
+ @return An enumerator that accesses each object in the receiver which is greater than or equal to @a anObject, in ascending order.
+
+ @throw NSInvalidArgumentException if @a anObject is @c nil.
+ @warning Modifying a collection while it is being enumerated is unsafe, and may cause a mutation exception to be raised.
+
+ @see reverseObjectEnumeratorFromObject:
+ @see subsetViewFromObject:toObject:options:
+ */
+- (NSEnumerator<ObjectType> *)objectEnumeratorFromObject:(ObjectType)anObject;
+
+/**
+ Returns an enumerator that accesses the objects in the receiver in descending order, starting at a given object. The enumerator descends directly to the greatest object not greater than @a anObject (as found by \link CHSortedSet#floorObject: -floorObject:\endlink), so enumerating k objects takes O(log n + k) time.
+
+ @param anObject The object at which to start; need not be present in the receiver.
+ @return An enumerator that accesses each object in the receiver which is less than or equal to @a anObject, in descending order.
+
+ @throw NSInvalidArgumentException if @a anObject is @c nil.
+ @warning Modifying a collection while it is being enumerated is unsafe, and may cause a mutation exception to be raised.
+
+ @see objectEnumeratorFromObject:
+ @see subsetViewFromObject:toObject:options:
+ */
+- (NSEnumerator<ObjectType> *)reverseObjectEnumeratorFromObject:(ObjectType)anObject;
+
 /**
  Produces a representation of the receiver that can be useful for debugging.
  
@@ -6,9 +6,267 @@
 //
 
 #import "CHAbstractBinarySearchTree_Internal.h"
+#import <objc/message.h>
 
 // Definitions of extern variables from CHAbstractBinarySearchTree_Internal.h
 size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
+size_t kCHBinaryTreePrefixedNodeSize = sizeof(CHBinaryTreeNode) + sizeof(u_int64_t);
+
+// Bounds on the number of nodes in a slab; each new slab doubles the last one.
+#define kCHBinaryTreeNodeSlabMinimumCapacity 16
+#define kCHBinaryTreeNodeSlabMaximumCapacity 4096
+
+// Releases the object (and any key retained apart from it) in every node of each
+// slab in a chain, then frees them.
+static void CHBinaryTreeNodeSlabsFree(CHBinaryTreeNodeSlab *slab) {
+	CHBinaryTreeNodeSlab *next;
+	while (slab != NULL) {
+		next = slab->next;
+		for (NSUInteger i = 0; i < slab->capacity; i++) {
+			CHBinaryTreeNode *node = CHBinaryTreeNodeSlabNode(slab, i);
+			if (node->key != node->object) {
+				[node->key release];
+			}
+			[node->object release]; // Nil for nodes on the free list
+		}
+		free(slab);
+		slab = next;
+	}
+}
+
+#pragma mark Merging sorted objects
+
+// Merges larger than two chunks are split up and done concurrently.
+#define kCHSortedMergeChunkSize 32768
+#define kCHSortedMergeMaximumChunkCount 64
+
+// Ways of combining two sets of sorted objects in a single merge pass.
+typedef NS_ENUM(NSUInteger, CHSortedMergeOperation) {
+	CHSortedMergeUnion,
+	CHSortedMergeIntersection,
+	CHSortedMergeDifference
+};
+
+// Merges two C arrays of objects in strictly ascending order, and returns the
+// number of objects written to merged (which needs room for aCount + bCount).
+// For equal objects, a union keeps the one from b (as -addObject: would) and an
+// intersection keeps the one from a. The ordering is passed by value, so each
+// merge has its own cache.
+static NSUInteger CHSortedMerge(__unsafe_unretained id *a, NSUInteger aCount,
+                                __unsafe_unretained id *b, NSUInteger bCount,
+                                __unsafe_unretained id *merged,
+                                CHSortedMergeOperation operation,
+                                CHComparison ordering)
+{
+	NSUInteger i = 0, j = 0, mergedCount = 0;
+	NSComparisonResult comparison;
+	while (i < aCount && j < bCount) {
+		comparison = CHComparisonCompare(&ordering, a[i], b[j]);
+		if (comparison == NSOrderedAscending) {
+			if (operation != CHSortedMergeIntersection) {
+				merged[mergedCount++] = a[i];
+			}
+			i++;
+		} else if (comparison == NSOrderedDescending) {
+			if (operation == CHSortedMergeUnion) {
+				merged[mergedCount++] = b[j];
+			}
+			j++;
+		} else {
+			if (operation == CHSortedMergeUnion) {
+				merged[mergedCount++] = b[j];
+			} else if (operation == CHSortedMergeIntersection) {
+				merged[mergedCount++] = a[i];
+			}
+			i++;
+			j++;
+		}
+	}
+	if (operation != CHSortedMergeIntersection) {
+		while (i < aCount) {
+			merged[mergedCount++] = a[i++];
+		}
+	}
+	if (operation == CHSortedMergeUnion) {
+		while (j < bCount) {
+			merged[mergedCount++] = b[j++];
+		}
+	}
+	return mergedCount;
+}
+
+// Returns the index of the first object in a sorted C array that is not less
+// than anObject, or count if there is none.
+static NSUInteger CHSortedLowerBound(__unsafe_unretained id *objects, NSUInteger count, id anObject, CHComparison *ordering) {
+	NSUInteger low = 0, high = count, middle;
+	while (low < high) {
+		middle = low + (high - low) / 2;
+		if (CHComparisonCompare(ordering, objects[middle], anObject) == NSOrderedAscending) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+// Like CHSortedMerge(), but large merges are split into chunks which are merged
+// concurrently, then packed together. Chunks start at even intervals in the
+// longer array, and at the matching place in the other, so objects equal to the
+// one that starts a chunk are always in the same chunk in both arrays.
+static NSUInteger CHSortedMergeConcurrently(__unsafe_unretained id *a, NSUInteger aCount,
+                                            __unsafe_unretained id *b, NSUInteger bCount,
+                                            __unsafe_unretained id *merged,
+                                            CHSortedMergeOperation operation,
+                                            CHComparison ordering)
+{
+	NSUInteger chunkCount = MIN((aCount + bCount) / kCHSortedMergeChunkSize,
+	                            kCHSortedMergeMaximumChunkCount);
+	if (chunkCount < 2) {
+		return CHSortedMerge(a, aCount, b, bCount, merged, operation, ordering);
+	}
+	NSUInteger *aStarts = malloc(sizeof(NSUInteger) * (chunkCount + 1));
+	NSUInteger *bStarts = malloc(sizeof(NSUInteger) * (chunkCount + 1));
+	NSUInteger *mergedCounts = malloc(sizeof(NSUInteger) * chunkCount);
+	aStarts[0] = bStarts[0] = 0;
+	for (NSUInteger chunk = 1; chunk < chunkCount; chunk++) {
+		if (aCount >= bCount) {
+			aStarts[chunk] = chunk * aCount / chunkCount;
+			bStarts[chunk] = CHSortedLowerBound(b, bCount, a[aStarts[chunk]], &ordering);
+		} else {
+			bStarts[chunk] = chunk * bCount / chunkCount;
+			aStarts[chunk] = CHSortedLowerBound(a, aCount, b[bStarts[chunk]], &ordering);
+		}
+	}
+	aStarts[chunkCount] = aCount;
+	bStarts[chunkCount] = bCount;
+	// Each chunk writes where it would start if nothing were left out.
+	dispatch_apply(chunkCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t chunk) {
+		mergedCounts[chunk] = CHSortedMerge(a + aStarts[chunk], aStarts[chunk+1] - aStarts[chunk],
+		                                    b + bStarts[chunk], bStarts[chunk+1] - bStarts[chunk],
+		                                    merged + aStarts[chunk] + bStarts[chunk], operation, ordering);
+	});
+	NSUInteger mergedCount = 0;
+	for (NSUInteger chunk = 0; chunk < chunkCount; chunk++) {
+		memmove(merged + mergedCount, merged + aStarts[chunk] + bStarts[chunk],
+		        kCHPointerSize * mergedCounts[chunk]);
+		mergedCount += mergedCounts[chunk];
+	}
+	free(aStarts);
+	free(bStarts);
+	free(mergedCounts);
+	return mergedCount;
+}
+
+#pragma mark Archiving tree shapes
+
+// Each node is archived in pre-order as a record of this many bytes: a byte of
+// CHBinaryTreeShapeFlags, then the node's balancing data as a big-endian value.
+#define kCHBinaryTreeShapeRecordSize 5
+
+typedef NS_OPTIONS(uint8_t, CHBinaryTreeShapeFlags) {
+	CHBinaryTreeShapeHasLeftChild  = 1 << 0,
+	CHBinaryTreeShapeHasRightChild = 1 << 1,
+};
+
+// Returns whether records for objectCount nodes in pre-order describe a single
+// binary tree. Every node fills one open child link and opens one per child, so
+// there must be an open link for each node, and none left over at the end.
+static BOOL CHBinaryTreeShapeIsValid(const uint8_t *shape, NSUInteger shapeLength, NSUInteger objectCount) {
+	if (shapeLength != objectCount * kCHBinaryTreeShapeRecordSize) {
+		return NO;
+	}
+	NSUInteger openLinks = 1;
+	for (NSUInteger index = 0; index < objectCount; index++) {
+		if (openLinks == 0) {
+			return NO;
+		}
+		CHBinaryTreeShapeFlags flags = shape[index * kCHBinaryTreeShapeRecordSize];
+		openLinks = openLinks - 1 + ((flags & CHBinaryTreeShapeHasLeftChild) ? 1 : 0)
+		                          + ((flags & CHBinaryTreeShapeHasRightChild) ? 1 : 0);
+	}
+	return (openLinks == 0);
+}
+
+#pragma mark Batched searches
+
+// The number of searches that descend a tree in lockstep. Each one has at most
+// one node being fetched at a time, so this bounds the cache misses in flight.
+#define kCHBinaryTreeBatchWidth 16
+
+// Stores in nodes[i] the node whose key is equal to keys[i], or the sentinel if
+// there is none, for each of keyCount keys. Rather than doing
+// one search after another, a batch of searches take turns descending the tree,
+// and each prefetches the child it moves to, so that its node has arrived by
+// its next turn. The cache misses of the whole batch overlap, instead of every
+// search stalling on one miss per level. As with CHBinaryTreeFindNode(), no
+// shared state is written. If usesPrefixes is YES, each search finds the prefix
+// of its key when it starts.
+static void CHBinaryTreeFindNodesInterleaved(CHBinaryTreeNode *root, __unsafe_unretained id *keys, NSUInteger keyCount, BOOL usesPrefixes, CHBinaryTreeNode *sentinel, CHComparison *comparison, CHBinaryTreeNode **nodes) {
+	CHBinaryTreeNode *current[kCHBinaryTreeBatchWidth];
+	NSUInteger searching[kCHBinaryTreeBatchWidth];
+	u_int64_t prefixes[kCHBinaryTreeBatchWidth];
+	NSUInteger active = 0, next = 0;
+	while (active < kCHBinaryTreeBatchWidth && next < keyCount) {
+		current[active] = root;
+		prefixes[active] = usesPrefixes ? CHBinaryTreePrefixForKey(keys[next]) : 0;
+		searching[active++] = next++;
+	}
+	while (active > 0) {
+		NSUInteger i = 0;
+		while (i < active) {
+			CHBinaryTreeNode *node = current[i];
+			NSComparisonResult result;
+			if (node != sentinel && (result = CHBinaryTreeCompareNodeToKey(comparison, node, keys[searching[i]], prefixes[i]))) {
+				node = node->link[result == NSOrderedAscending]; // R on YES
+				__builtin_prefetch(node);
+				current[i++] = node;
+				continue;
+			}
+			nodes[searching[i]] = node;
+			// Start the next search in its place, or close the gap with the last one.
+			if (next < keyCount) {
+				current[i] = root;
+				prefixes[i] = usesPrefixes ? CHBinaryTreePrefixForKey(keys[next]) : 0;
+				searching[i++] = next++;
+			} else {
+				--active;
+				current[i] = current[active];
+				prefixes[i] = prefixes[active];
+				searching[i] = searching[active];
+			}
+		}
+	}
+}
+
+// Stores the same nodes as CHBinaryTreeFindNodesInterleaved(), but by sorting the
+// keys and then stepping through the tree in ascending order alongside them,
+// which takes O(n + k log k) time for k keys instead of O(k log n). Each
+// comparison in the sweep either moves on to the next node or settles one of the
+// keys, and the nodes are visited in order, mostly from neighboring memory. The
+// keys' indexes are sorted in a C array, so no key is boxed or sent a message
+// other than to compare it.
+static void CHBinaryTreeFindNodesBySweep(CHBinaryTreeNode *header, __unsafe_unretained id *keys, NSUInteger keyCount, BOOL usesPrefixes, CHBinaryTreeNode *sentinel, CHComparison *comparison, CHBinaryTreeNode **nodes) {
+	NSUInteger *indexes = malloc(sizeof(NSUInteger) * keyCount);
+	for (NSUInteger i = 0; i < keyCount; i++) {
+		indexes[i] = i;
+	}
+	__block CHComparison sortOrdering = *comparison;
+	qsort_b(indexes, keyCount, sizeof(NSUInteger), ^int(const void *index1, const void *index2) {
+		return (int) CHComparisonCompare(&sortOrdering, keys[*(const NSUInteger *)index1], keys[*(const NSUInteger *)index2]);
+	});
+	CHBinaryTreeNode *node = CHBinaryTreeFirstNode(header->right, NO, sentinel);
+	NSComparisonResult result = NSOrderedAscending;
+	for (NSUInteger k = 0; k < keyCount; k++) {
+		NSUInteger i = indexes[k];
+		u_int64_t prefix = usesPrefixes ? CHBinaryTreePrefixForKey(keys[i]) : 0;
+		while (node != header && (result = CHBinaryTreeCompareNodeToKey(comparison, node, keys[i], prefix)) == NSOrderedAscending) {
+			node = CHBinaryTreeNextNode(node, NO, header, sentinel);
+		}
+		nodes[i] = (node != header && result == NSOrderedSame) ? node : sentinel;
+	}
+	free(indexes);
+}
 
 /**
  A dummy object that resides in the header node for a tree. Using a header node can simplify insertion logic by eliminating the need to check whether the root is null. The actual root of the tree is generally stored as the right child of the header node. In order to always proceed to the actual root node when traversing down the tree, instances of this class always return @c NSOrderedAscending when called as the receiver of the @c -compare: method.
@@ -70,6 +328,47 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 
 #pragma mark -
 
+// Returns the node after node in pre-order, or the header if there is none.
+// This is the first child of node if it has any, or else the right child of the
+// nearest ancestor whose left subtree contains node (if it has a right child).
+static CHBinaryTreeNode *CHBinaryTreePreOrderNextNode(CHBinaryTreeNode *node, CHBinaryTreeNode *header, CHBinaryTreeNode *sentinel) {
+	if (node->left != sentinel) {
+		return node->left;
+	}
+	if (node->right != sentinel) {
+		return node->right;
+	}
+	CHBinaryTreeNode *parent = node->parent;
+	while (parent != header) {
+		if (parent->left == node && parent->right != sentinel) {
+			return parent->right;
+		}
+		node = parent;
+		parent = parent->parent;
+	}
+	return header;
+}
+
+// Returns the first node in post-order of the subtree rooted at node, which is
+// the leaf reached by going left whenever possible, and right otherwise.
+static CHBinaryTreeNode *CHBinaryTreePostOrderFirstNode(CHBinaryTreeNode *node, CHBinaryTreeNode *sentinel) {
+	while (node->left != sentinel || node->right != sentinel) {
+		node = node->link[node->left == sentinel];
+	}
+	return node;
+}
+
+// Returns the node after node in post-order, or the header if there is none.
+// This is its parent, unless node is a left child with a right sibling, in which
+// case it is the first node in post-order of the sibling's subtree.
+static CHBinaryTreeNode *CHBinaryTreePostOrderNextNode(CHBinaryTreeNode *node, CHBinaryTreeNode *header, CHBinaryTreeNode *sentinel) {
+	CHBinaryTreeNode *parent = node->parent;
+	if (parent != header && parent->left == node && parent->right != sentinel) {
+		return CHBinaryTreePostOrderFirstNode(parent->right, sentinel);
+	}
+	return parent;
+}
+
 /**
  An NSEnumerator for traversing any CHAbstractBinarySearchTree subclass in a specified order.
  
@@ -79,7 +378,7 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
  <li>Iterative algorithms are usually faster since they reduce overhead from function calls.</li>
  </ol>
  
- Traversal state is stored in either a stack or queue using dynamically-allocated C structs and @c \#define pseudo-functions to increase performance and reduce the required memory footprint.
+ Since every node links to its parent, the next node in ascending, descending, pre-order, or post-order traversal can be found from the current node alone, which is the only state those traversals need. Each step takes amortized O(1) time, and no memory is allocated. Level-order traversal stores the nodes yet to be visited in a queue using dynamically-allocated C structs and @c \#define pseudo-functions to increase performance and reduce the required memory footprint.
  
  Enumerators encapsulate their own state, and more than one enumerator may be active at once. However, if a collection is modified, any existing enumerators for that collection become invalid and will raise a mutation exception if any further objects are requested from it.
  */
@@ -91,6 +390,7 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 {
 	__strong id<CHSearchTree> searchTree; // The tree being enumerated.
 	__strong CHBinaryTreeNode *current; // The next node to be enumerated.
+	__strong CHBinaryTreeNode *headerNode; // Header node in the tree.
 	__strong CHBinaryTreeNode *sentinelNode; // Sentinel node in the tree.
 	CHTraversalOrder traversalOrder; // Order in which to traverse the tree.
 	NSUInteger remainingCount; ///< Number of elements in @a searchTree remaining to be enumerated.
@@ -98,24 +398,23 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 	unsigned long *mutationPtr; // Pointer for checking changes in mutation.
 	
 @private
-	// Pointers and counters that are used for various tree traveral orderings.
-	CHBinaryTreeStack_DECLARE();
+	// Nodes yet to be visited in a level-order traversal.
 	CHBinaryTreeQueue_DECLARE();
-	// These macros are defined in CHAbstractBinarySearchTree_Internal.h
+	// This macro is defined in CHAbstractBinarySearchTree_Internal.h
 }
 
 /**
- Create an enumerator which traverses a given (sub)tree in the specified order.
+ Create an enumerator which traverses a given tree in the specified order.
  
  @param tree The tree collection that is being enumerated. This collection is to be retained while the enumerator has not exhausted all its objects.
- @param root The root node of the @a tree whose elements are to be enumerated.
+ @param header The header node of @a tree, whose right child is the root.
  @param sentinel The sentinel value used at the leaves of the specified @a tree.
  @param order The traversal order to use for enumerating the given @a tree.
  @param mutations A pointer to the collection's mutation count for invalidation.
  @return An initialized CHBinarySearchTreeEnumerator which will enumerate objects in @a tree in the order specified by @a order.
  */
 - (instancetype)initWithTree:(id<CHSearchTree>)tree
-						root:(CHBinaryTreeNode *)root
+					  header:(CHBinaryTreeNode *)header
 					sentinel:(CHBinaryTreeNode *)sentinel
 			  traversalOrder:(CHTraversalOrder)order
 			 mutationPointer:(unsigned long *)mutations
@@ -125,22 +424,31 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 	}
 	self = [super init];
 	if (self) {
+		CHBinaryTreeNode *root = header->right;
 		traversalOrder = order;
 		searchTree = (root != sentinel) ? [tree retain] : nil;
 		remainingCount = [searchTree count];
-		if (traversalOrder == CHTraversalOrderLevelOrder) {
-			CHBinaryTreeQueue_INIT();
-			CHBinaryTreeQueue_ENQUEUE(root);
-		} else {
-			CHBinaryTreeStack_INIT();
-			if (traversalOrder == CHTraversalOrderPreOrder) {
-				CHBinaryTreeStack_PUSH(root);
-			} else {
-				current = root;
+		headerNode = header;
+		sentinelNode = sentinel;
+		current = header;
+		if (searchTree != nil) {
+			switch (traversalOrder) {
+				case CHTraversalOrderAscending:
+				case CHTraversalOrderDescending:
+					current = CHBinaryTreeFirstNode(root, (traversalOrder == CHTraversalOrderDescending), sentinel);
+					break;
+				case CHTraversalOrderPreOrder:
+					current = root;
+					break;
+				case CHTraversalOrderPostOrder:
+					current = CHBinaryTreePostOrderFirstNode(root, sentinel);
+					break;
+				case CHTraversalOrderLevelOrder:
+					CHBinaryTreeQueue_INIT();
+					CHBinaryTreeQueue_ENQUEUE(root);
+					break;
 			}
 		}
-		sentinel->object = nil;
-		sentinelNode = sentinel;
 		mutationCount = *mutations;
 		mutationPtr = mutations;
 	}
@@ -157,8 +465,8 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 		[searchTree release];
 		searchTree = nil;
 		current = nil;
+		headerNode = nil;
 		sentinelNode = nil;
-		CHBinaryTreeStack_FREE(stack);
 		CHBinaryTreeQueue_FREE(queue);
 	}
 }
@@ -188,274 +496,1448 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 		return nil;
 	}
 	
+	CHBinaryTreeNode *node = current;
 	switch (traversalOrder) {
-		case CHTraversalOrderAscending: {
-			if (stackSize == 0 && current == sentinelNode) {
-				[self _collectionExhausted];
-				return nil;
-			} else {
-				remainingCount--;
-			}
-			while (current != sentinelNode) {
-				CHBinaryTreeStack_PUSH(current);
-				current = current->left;
-				// TODO: How to not push/pop leaf nodes unnecessarily?
+		case CHTraversalOrderAscending:
+		case CHTraversalOrderDescending:
+			if (node != headerNode) {
+				current = CHBinaryTreeNextNode(node, (traversalOrder == CHTraversalOrderDescending),
+				                               headerNode, sentinelNode);
 			}
-			current = CHBinaryTreeStack_POP(); // Save top node for return value
-			NSAssert(current != nil, @"Illegal state, current should never be nil!");
-			id tempObject = current->object;
-			current = current->right;
-			return tempObject;
-		}
+			break;
 			
-		case CHTraversalOrderDescending: {
-			if (stackSize == 0 && current == sentinelNode) {
-				[self _collectionExhausted];
-				return nil;
-			} else {
-				remainingCount--;
-			}
-			while (current != sentinelNode) {
-				CHBinaryTreeStack_PUSH(current);
-				current = current->right;
-				// TODO: How to not push/pop leaf nodes unnecessarily?
+		case CHTraversalOrderPreOrder:
+			if (node != headerNode) {
+				current = CHBinaryTreePreOrderNextNode(node, headerNode, sentinelNode);
 			}
-			current = CHBinaryTreeStack_POP(); // Save top node for return value
-			NSAssert(current != nil, @"Illegal state, current should never be nil!");
-			id tempObject = current->object;
-			current = current->left;
-			remainingCount--;
-			return tempObject;
-		}
+			break;
 			
-		case CHTraversalOrderPreOrder: {
-			current = CHBinaryTreeStack_POP();
-			if (current == NULL) {
-				[self _collectionExhausted];
-				return nil;
-			} else {
-				remainingCount--;
-			}
-			if (current->right != sentinelNode) {
-				CHBinaryTreeStack_PUSH(current->right);
-			}
-			if (current->left != sentinelNode) {
-				CHBinaryTreeStack_PUSH(current->left);
+		case CHTraversalOrderPostOrder:
+			if (node != headerNode) {
+				current = CHBinaryTreePostOrderNextNode(node, headerNode, sentinelNode);
 			}
-			return current->object;
-		}
+			break;
 			
-		case CHTraversalOrderPostOrder: {
-			// This algorithm from: http://www.johny.ca/blog/archives/05/03/04/
-			if (stackSize == 0 && current == sentinelNode) {
-				[self _collectionExhausted];
-				return nil;
+		case CHTraversalOrderLevelOrder:
+			node = CHBinaryTreeQueue_FRONT;
+			CHBinaryTreeQueue_DEQUEUE();
+			if (node == NULL) {
+				node = headerNode;
 			} else {
-				remainingCount--;
-			}
-			while (1) {
-				while (current != sentinelNode) {
-					CHBinaryTreeStack_PUSH(current);
-					current = current->left;
+				if (node->left != sentinelNode) {
+					CHBinaryTreeQueue_ENQUEUE(node->left);
 				}
-				NSAssert(stackSize > 0, @"Stack should never be empty!");
-				// A null entry indicates that we've traversed the left subtree
-				if (CHBinaryTreeStack_TOP != NULL) {
-					current = CHBinaryTreeStack_TOP->right;
-					CHBinaryTreeStack_PUSH(NULL);
-					// TODO: How to not push a null pad for leaf nodes?
-				} else {
-					(void)CHBinaryTreeStack_POP(); // ignore the null pad
-					CHBinaryTreeNode *temp = CHBinaryTreeStack_POP();
-					return temp ? temp->object : nil;
+				if (node->right != sentinelNode) {
+					CHBinaryTreeQueue_ENQUEUE(node->right);
 				}
 			}
-		}
-			
-		case CHTraversalOrderLevelOrder: {
-			current = CHBinaryTreeQueue_FRONT;
-			CHBinaryTreeQueue_DEQUEUE();
-			if (current == NULL) {
-				[self _collectionExhausted];
-				return nil;
-			} else {
-				remainingCount--;
-			}
-			if (current->left != sentinelNode) {
-				CHBinaryTreeQueue_ENQUEUE(current->left);
-			}
-			if (current->right != sentinelNode) {
-				CHBinaryTreeQueue_ENQUEUE(current->right);
-			}
-			return current->object;
-		}
+			break;
 	}
+	if (node == headerNode) {
+		[self _collectionExhausted];
+		return nil;
+	}
+	remainingCount--;
+	return node->object;
 }
 
 @end
 
 #pragma mark -
 
-@implementation CHAbstractBinarySearchTree
-
-- (void)dealloc {
-	[self removeAllObjects];
-	free(header);
-	free(sentinel);
-	[super dealloc];
+/**
+ One contiguous run of objects within a CHBinarySearchTreeRange. The bounds are keys, which are compared with the keys in the tree's nodes (for most trees, these are simply the objects). A @c nil bound means the run extends to that end of the tree. A range has two runs when it wraps around the ends of the tree.
+ */
+typedef struct CHBinarySearchTreeRangeRun {
+	__unsafe_unretained id low;  // Lowest permitted key, or nil if unbounded.
+	__unsafe_unretained id high; // Highest permitted key, or nil if unbounded.
+	BOOL includesLow;  // Whether an object equal to low is permitted.
+	BOOL includesHigh; // Whether an object equal to high is permitted.
+} CHBinarySearchTreeRangeRun;
+
+static inline BOOL CHObjectIsAboveLowBound(id aKey, CHBinarySearchTreeRangeRun *run, CHComparison *ordering) {
+	if (run->low == nil) {
+		return YES;
+	}
+	NSComparisonResult comparison = CHComparisonCompare(ordering, aKey, run->low);
+	return (comparison == NSOrderedDescending || (comparison == NSOrderedSame && run->includesLow));
 }
 
-- (instancetype)init {
-	return [self initWithArray:@[]];
+static inline BOOL CHObjectIsBelowHighBound(id aKey, CHBinarySearchTreeRangeRun *run, CHComparison *ordering) {
+	if (run->high == nil) {
+		return YES;
+	}
+	NSComparisonResult comparison = CHComparisonCompare(ordering, aKey, run->high);
+	return (comparison == NSOrderedAscending || (comparison == NSOrderedSame && run->includesHigh));
 }
 
-// This is the designated initializer for CHAbstractBinarySearchTree.
-- (instancetype)initWithArray:(NSArray *)anArray {
-	self = [super init];
-	if (self) {
-		count = 0;
-		mutations = 0;
-		sentinel = [self _createNodeWithObject:nil];
-		sentinel->right = sentinel;
-		sentinel->left = sentinel;
-		header = [self _createNodeWithObject:[CHSearchTreeHeaderObject object]];
-		[self _subclassSetup];
-		[self addObjectsFromArray:anArray];
+/**
+ A read-only CHSortedSet that presents the objects of a binary search tree that fall within a range, without copying them. Instances are created by \link CHAbstractBinarySearchTree#subsetViewFromObject:toObject:options: -[CHAbstractBinarySearchTree subsetViewFromObject:toObject:options:]\endlink.
+ 
+ A range retains its tree, and uses the tree's nodes directly. Like an enumerator, it becomes invalid if the tree is modified, and raises a mutation exception if it is used after that. Methods that would modify the range raise an exception, since its contents are determined by the tree.
+ */
+@interface CHBinarySearchTreeRange : NSObject <CHSortedSet>
+
+- (instancetype)initWithTree:(id<CHSearchTree>)tree
+                      header:(CHBinaryTreeNode *)header
+                    sentinel:(CHBinaryTreeNode *)sentinel
+                  fromObject:(nullable id)start
+                    toObject:(nullable id)end
+                     options:(CHSubsetConstructionOptions)options
+                    ordering:(CHComparison)ordering
+                     keyPath:(nullable NSString *)keyPath
+             mutationPointer:(unsigned long *)mutations;
+
+@end
+
+// Returns the first node within a run (or the last, if descending), or the
+// header if there is none. The node found may be beyond the far end of the run,
+// which must be checked separately.
+static CHBinaryTreeNode *CHBinarySearchTreeRangeRunFirstNode(CHBinarySearchTreeRangeRun *run, BOOL descending, CHBinaryTreeNode *header, CHBinaryTreeNode *sentinel, CHComparison *ordering) {
+	CHBinaryTreeNode *first = header, *current = header->right;
+	while (current != sentinel) {
+		BOOL isWithinNearEnd = descending
+			? CHObjectIsBelowHighBound(current->key, run, ordering)
+			: CHObjectIsAboveLowBound(current->key, run, ordering);
+		if (isWithinNearEnd) {
+			first = current;
+			current = current->link[descending];
+		} else {
+			current = current->link[!descending];
+		}
 	}
-	return self;
+	return first;
 }
 
-- (void)_subclassSetup {
-	// This allows child classes to initialize their specific state on init.
+// Returns whether a node found by CHBinarySearchTreeRangeRunFirstNode(), or by
+// stepping on from it, is within the far end of the run.
+static inline BOOL CHBinarySearchTreeRangeRunIncludesNode(CHBinarySearchTreeRangeRun *run, BOOL descending, CHBinaryTreeNode *node, CHBinaryTreeNode *header, CHComparison *ordering) {
+	return (node != header) && (descending
+		? CHObjectIsAboveLowBound(node->key, run, ordering)
+		: CHObjectIsBelowHighBound(node->key, run, ordering));
 }
 
-- (CHBinaryTreeNode *)_createNodeWithObject:(nullable id)object {
-	CHBinaryTreeNode *node = malloc(kCHBinaryTreeNodeSize);
-	node->object = object;
-	node->left = sentinel;
-	node->right = sentinel;
-	node->balance = 0; // Affects balancing info for any subclass (anonymous union)
-	return node;
-}
+/**
+ An NSEnumerator for traversing a CHBinarySearchTreeRange in ascending or descending order. Rather than starting at one end of the tree, it descends directly to the first object within each run of the range, then follows parent and child links to each object after it until it reaches one beyond the run, so enumerating k objects takes O(log n + k) time and allocates no memory.
+ */
+@interface CHBinarySearchTreeRangeEnumerator : NSEnumerator
 
-#pragma mark <NSCoding>
+- (instancetype)initWithRange:(CHBinarySearchTreeRange *)range
+                         runs:(CHBinarySearchTreeRangeRun *)runs
+                     runCount:(NSUInteger)runCount
+                       header:(CHBinaryTreeNode *)header
+                     sentinel:(CHBinaryTreeNode *)sentinel
+                   descending:(BOOL)descending
+                     ordering:(CHComparison)ordering
+              mutationPointer:(unsigned long *)mutations;
 
-- (instancetype)initWithCoder:(NSCoder *)decoder {
-	// Decode the array of objects and use it to initialize the tree's contents.
-	return [self initWithArray:[decoder decodeObjectForKey:@"objects"]];
-}
+@end
 
-- (void)encodeWithCoder:(NSCoder *)encoder {
-	[encoder encodeObject:[self allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder]
-	               forKey:@"objects"];
+@implementation CHBinarySearchTreeRangeEnumerator
+{
+	__strong CHBinarySearchTreeRange *range; // The range being enumerated.
+	CHBinarySearchTreeRangeRun *runs; // The runs of the range, owned by range.
+	NSUInteger runCount; // The number of runs in the range.
+	NSUInteger runIndex; // The run currently being enumerated.
+	__strong CHBinaryTreeNode *current; // The next node, if it is in the run.
+	__strong CHBinaryTreeNode *headerNode; // Header node in the tree.
+	__strong CHBinaryTreeNode *sentinelNode; // Sentinel node in the tree.
+	BOOL descending; // Whether to enumerate from the high end.
+	CHComparison ordering; // How the tree compares keys, with our own cache.
+	unsigned long mutationCount; // Stores the collection's initial mutation.
+	unsigned long *mutationPtr; // Pointer for checking changes in mutation.
 }
 
-#pragma mark <NSCopying> methods
-
-- (instancetype)copyWithZone:(NSZone *)zone {
-	id<CHSearchTree> newTree = [[[self class] allocWithZone:zone] init];
-	for (id anObject in [self objectEnumeratorWithTraversalOrder:CHTraversalOrderLevelOrder]) {
-		[newTree addObject:anObject];
+- (instancetype)initWithRange:(CHBinarySearchTreeRange *)aRange
+                         runs:(CHBinarySearchTreeRangeRun *)someRuns
+                     runCount:(NSUInteger)aRunCount
+                       header:(CHBinaryTreeNode *)header
+                     sentinel:(CHBinaryTreeNode *)sentinel
+                   descending:(BOOL)isDescending
+                     ordering:(CHComparison)anOrdering
+              mutationPointer:(unsigned long *)mutations
+{
+	self = [super init];
+	if (self) {
+		range = [aRange retain];
+		runs = someRuns;
+		runCount = aRunCount;
+		runIndex = 0;
+		headerNode = header;
+		sentinelNode = sentinel;
+		descending = isDescending;
+		ordering = anOrdering;
+		mutationCount = *mutations;
+		mutationPtr = mutations;
+		current = CHBinarySearchTreeRangeRunFirstNode([self _currentRun], descending, headerNode, sentinelNode, &ordering);
 	}
-	return newTree;
+	return self;
 }
 
-#pragma mark <NSFastEnumeration>
+- (void)dealloc {
+	[self _collectionExhausted];
+	[super dealloc];
+}
 
-- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
-	CHBinaryTreeNode *current;
-	CHBinaryTreeStack_DECLARE();
-	
-	// For the first call, start at leftmost node, otherwise the last saved node
-	if (state->state == 0) {
-		state->itemsPtr = stackbuf;
-		state->mutationsPtr = &mutations;
-		current = header->right;
-		CHBinaryTreeStack_INIT();
-	} else if (state->state == 1) {
-		return 0;
-	} else {
-		current = (CHBinaryTreeNode *) state->state;
-		stack = (CHBinaryTreeNode **) state->extra[0];
-		stackCapacity = (NSUInteger) state->extra[1];
-		stackSize = (NSUInteger) state->extra[2];
-	}
-	NSAssert(current != nil, @"Illegal state, current should never be nil!");
-	
-	// Accumulate objects from the tree until we reach all nodes or the maximum
-	NSUInteger batchCount = 0;
-	while ((current != sentinel || stackSize > 0) && batchCount < len) {
-		while (current != sentinel) {
-			CHBinaryTreeStack_PUSH(current);
-			current = current->left;
-		}
-		current = CHBinaryTreeStack_POP(); // Save top node for return value
-		NSAssert(current != nil, @"Illegal state, current should never be nil!");
-		stackbuf[batchCount] = current->object;
-		current = current->right;
-		batchCount++;
-	}
-	
-	if (current == sentinel && stackSize == 0) {
-		CHBinaryTreeStack_FREE(stack);
-		state->state = 1; // used as a termination flag
-	} else {
-		state->state    = (unsigned long) current;
-		state->extra[0] = (unsigned long) stack;
-		state->extra[1] = (unsigned long) stackCapacity;
-		state->extra[2] = (unsigned long) stackSize;
+- (void)_collectionExhausted {
+	if (range != nil) {
+		[range release];
+		range = nil;
+		current = NULL;
 	}
-	return batchCount;
 }
 
-#pragma mark Concrete Implementations
-
-- (void)addObjectsFromArray:(NSArray *)anArray {
-	for (id anObject in anArray) {
-		[self addObject:anObject];
-	}
+// Runs are visited in reverse when descending, so they're indexed from the end.
+- (CHBinarySearchTreeRangeRun *)_currentRun {
+	return &runs[descending ? (runCount - 1 - runIndex) : runIndex];
 }
 
 - (NSArray *)allObjects {
-	return [self allObjectsWithTraversalOrder:CHTraversalOrderAscending];
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	NSMutableArray *array = [NSMutableArray array];
+	id anObject;
+	while ((anObject = [self nextObject])) {
+		[array addObject:anObject];
+	}
+	return array;
 }
 
-- (NSArray *)allObjectsWithTraversalOrder:(CHTraversalOrder)order {
-	return [[self objectEnumeratorWithTraversalOrder:order] allObjects];
+- (id)nextObject {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	while (range != nil) {
+		CHBinarySearchTreeRangeRun *run = [self _currentRun];
+		if (CHBinarySearchTreeRangeRunIncludesNode(run, descending, current, headerNode, &ordering)) {
+			id anObject = current->object;
+			current = CHBinaryTreeNextNode(current, descending, headerNode, sentinelNode);
+			return anObject;
+		}
+		// Move on to the next run, if there is one.
+		if (++runIndex < runCount) {
+			current = CHBinarySearchTreeRangeRunFirstNode([self _currentRun], descending, headerNode, sentinelNode, &ordering);
+		} else {
+			[self _collectionExhausted];
+		}
+	}
+	return nil;
 }
 
-- (id)anyObject {
-	return (count > 0) ? header->right->object : nil;
-	// In an empty tree, sentinel's object may be nil, but let's not chance it.
-	// (Our -removeAllObjects nils the pointer, child's -removeObject: may not.)
+@end
+
+@implementation CHBinarySearchTreeRange
+{
+	__strong id<CHSearchTree> searchTree; // The tree that holds the objects.
+	__strong CHBinaryTreeNode *headerNode; // Header node in the tree.
+	__strong CHBinaryTreeNode *sentinelNode; // Sentinel node in the tree.
+	id startKey; // Retained, since runs refer to it.
+	id endKey; // Retained, since runs refer to it.
+	NSString *keyPath; // The tree's key path, for finding the keys of objects.
+	CHBinarySearchTreeRangeRun runs[2]; // Ranges that wrap around have two runs.
+	NSUInteger runCount; // The number of runs in use.
+	NSUInteger count; // Number of objects in the range, or NSNotFound if unknown.
+	CHComparison ordering; // How the tree compares keys.
+	unsigned long mutationCount; // Stores the collection's initial mutation.
+	unsigned long *mutationPtr; // Pointer for checking changes in mutation.
 }
 
-- (BOOL)containsObject:(id)anObject {
-	return ([self member:anObject] != nil);
+// Sets up a run; nil bounds are unbounded, so whether they are included is moot.
+static inline void CHBinarySearchTreeRangeRunSet(CHBinarySearchTreeRangeRun *run, id low, BOOL includesLow, id high, BOOL includesHigh) {
+	run->low = low;
+	run->includesLow = includesLow;
+	run->high = high;
+	run->includesHigh = includesHigh;
 }
 
-- (NSUInteger)count {
-	return count;
+- (instancetype)initWithTree:(id<CHSearchTree>)tree
+                      header:(CHBinaryTreeNode *)header
+                    sentinel:(CHBinaryTreeNode *)sentinel
+                  fromObject:(nullable id)start
+                    toObject:(nullable id)end
+                     options:(CHSubsetConstructionOptions)options
+                    ordering:(CHComparison)anOrdering
+                     keyPath:(NSString *)aKeyPath
+             mutationPointer:(unsigned long *)mutations
+{
+	self = [super init];
+	if (self) {
+		searchTree = [tree retain];
+		headerNode = header;
+		sentinelNode = sentinel;
+		keyPath = [aKeyPath copy];
+		// The runs are bounded by the keys of the endpoints.
+		start = (start != nil) ? CHBinaryTreeKeyForObject(keyPath, start) : nil;
+		end = (end != nil) ? CHBinaryTreeKeyForObject(keyPath, end) : nil;
+		startKey = [start retain];
+		endKey = [end retain];
+		count = NSNotFound;
+		ordering = anOrdering;
+		mutationCount = *mutations;
+		mutationPtr = mutations;
+		
+		// The runs follow the rules of -[CHSortedSet subsetFromObject:toObject:options:]
+		BOOL includesStart = !(options & CHSubsetConstructionExcludeLowEndpoint);
+		BOOL includesEnd = !(options & CHSubsetConstructionExcludeHighEndpoint);
+		runCount = 1;
+		if (start == nil || end == nil) {
+			// Options are ignored if both are nil, since the range is everything.
+			CHBinarySearchTreeRangeRunSet(&runs[0], start, includesStart, end, includesEnd);
+		} else {
+			NSComparisonResult comparison = CHComparisonCompare(&ordering, start, end);
+			if (comparison == NSOrderedAscending) {
+				CHBinarySearchTreeRangeRunSet(&runs[0], start, includesStart, end, includesEnd);
+			} else if (comparison == NSOrderedDescending) {
+				// Everything except what falls between end and start.
+				CHBinarySearchTreeRangeRunSet(&runs[0], nil, NO, end, includesEnd);
+				CHBinarySearchTreeRangeRunSet(&runs[1], start, includesStart, nil, NO);
+				runCount = 2;
+			} else if (includesStart && includesEnd) {
+				// Since nothing falls between them, everything is included.
+				CHBinarySearchTreeRangeRunSet(&runs[0], nil, NO, nil, NO);
+			} else {
+				// Everything except the endpoint itself.
+				CHBinarySearchTreeRangeRunSet(&runs[0], nil, NO, end, NO);
+				CHBinarySearchTreeRangeRunSet(&runs[1], start, NO, nil, NO);
+				runCount = 2;
+			}
+		}
+	}
+	return self;
 }
 
-- (NSString *)description {
-	return [[self allObjectsWithTraversalOrder:CHTraversalOrderAscending] description];
+- (void)dealloc {
+	[searchTree release];
+	[startKey release];
+	[endKey release];
+	[keyPath release];
+	[super dealloc];
 }
 
-- (id)firstObject {
-	sentinel->object = nil;
-	CHBinaryTreeNode *current = header->right;
-	while (current->left != sentinel) {
-		current = current->left;
+- (void)_checkForMutation {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
 	}
-	return current->object;
 }
 
-- (NSUInteger)hash {
-	return CHHashOfCountAndObjects(count, [self firstObject], [self lastObject]);
+- (BOOL)_rangeIncludesObject:(id)anObject {
+	CHComparison localOrdering = ordering;
+	id aKey = CHBinaryTreeKeyForObject(keyPath, anObject);
+	for (NSUInteger i = 0; i < runCount; i++) {
+		if (CHObjectIsAboveLowBound(aKey, &runs[i], &localOrdering) &&
+		    CHObjectIsBelowHighBound(aKey, &runs[i], &localOrdering)) {
+			return YES;
+		}
+	}
+	return NO;
 }
 
-- (BOOL)isEqual:(id)otherObject {
+// Since the runs are disjoint and in ascending order, the nearest object is in
+// the first run (searching them in the direction sought) that has one. Within a
+// run, the search starts from its near bound if anObject lies beyond it.
+- (id)_objectNearestToObject:(id)anObject direction:(NSUInteger)direction inclusive:(BOOL)inclusive {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self _checkForMutation];
+	CHComparison localOrdering = ordering;
+	id aKey = CHBinaryTreeKeyForObject(keyPath, anObject);
+	NSComparisonResult beyond = direction ? NSOrderedAscending : NSOrderedDescending;
+	for (NSUInteger i = 0; i < runCount; i++) {
+		CHBinarySearchTreeRangeRun *run = &runs[direction ? i : runCount - 1 - i];
+		id bound = direction ? run->low : run->high;
+		BOOL includesBound = direction ? run->includesLow : run->includesHigh;
+		id target = aKey;
+		BOOL includesTarget = inclusive;
+		if (bound != nil) {
+			NSComparisonResult comparison = CHComparisonCompare(&localOrdering, aKey, bound);
+			if (comparison == beyond) {
+				target = bound;
+				includesTarget = includesBound;
+			} else if (comparison == NSOrderedSame) {
+				includesTarget = inclusive && includesBound;
+			}
+		}
+		// Key prefixes are left to the tree's own searches.
+		CHBinaryTreeNode *nearest = CHBinaryTreeFindNearestNode(headerNode->right, target, 0, direction, includesTarget, sentinelNode, &localOrdering);
+		if (nearest == sentinelNode) {
+			break; // Nothing in the tree lies any further in this direction.
+		}
+		BOOL isWithinFarEnd = direction
+			? CHObjectIsBelowHighBound(nearest->key, run, &localOrdering)
+			: CHObjectIsAboveLowBound(nearest->key, run, &localOrdering);
+		if (isWithinFarEnd) {
+			return nearest->object;
+		}
+	}
+	return nil;
+}
+
+// A range can't be created except from a tree, so these raise an exception.
+- (instancetype)init {
+	return [self initWithArray:@[]];
+}
+
+- (instancetype)initWithArray:(NSArray *)anArray {
+	CHRaiseUnsupportedOperationException();
+	return nil;
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	CHRaiseUnsupportedOperationException();
+	return nil;
+}
+
+// A range is archived as a tree of the same class as the one it belongs to.
+- (Class)classForCoder {
+	return [searchTree class];
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[(CHAbstractBinarySearchTree *)searchTree _checkOrderingCanBeEncoded];
+	[encoder encodeObject:[self allObjects] forKey:@"objects"];
+	[encoder encodeObject:[(CHAbstractBinarySearchTree *)searchTree sortDescriptor] forKey:@"sortDescriptor"];
+	[encoder encodeBool:[(CHAbstractBinarySearchTree *)searchTree cachesKeyPrefixes] forKey:@"cachesKeyPrefixes"];
+}
+
+#pragma mark <NSCopying>
+
+// Copying a range produces a new tree with only the objects in the range.
+- (id)copyWithZone:(NSZone *)zone {
+	id<CHSortedSet> tree = [(CHAbstractBinarySearchTree *)searchTree _emptyCopyWithZone:zone];
+	[tree addObjectsFromArray:[self allObjects]];
+	return tree;
+}
+
+#pragma mark <NSFastEnumeration>
+
+// The index of the current run and the next node are kept in the state, so
+// nothing needs to be allocated (or released if enumeration stops early).
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	CHComparison localOrdering = ordering;
+	NSUInteger runIndex;
+	CHBinaryTreeNode *current;
+	if (state->state == 0) {
+		[self _checkForMutation];
+		state->state = 1;
+		state->mutationsPtr = mutationPtr;
+		runIndex = 0;
+		current = CHBinarySearchTreeRangeRunFirstNode(&runs[0], NO, headerNode, sentinelNode, &localOrdering);
+	} else {
+		runIndex = (NSUInteger) state->extra[0];
+		current = (CHBinaryTreeNode *) state->extra[1];
+	}
+	state->itemsPtr = stackbuf;
+	NSUInteger batchCount = 0;
+	while (batchCount < len && runIndex < runCount) {
+		if (CHBinarySearchTreeRangeRunIncludesNode(&runs[runIndex], NO, current, headerNode, &localOrdering)) {
+			stackbuf[batchCount++] = current->object;
+			current = CHBinaryTreeNextNode(current, NO, headerNode, sentinelNode);
+		} else if (++runIndex < runCount) {
+			current = CHBinarySearchTreeRangeRunFirstNode(&runs[runIndex], NO, headerNode, sentinelNode, &localOrdering);
+		}
+	}
+	state->extra[0] = (unsigned long) runIndex;
+	state->extra[1] = (unsigned long) current;
+	return batchCount;
+}
+
+#pragma mark Querying Contents
+
+- (NSArray *)allObjects {
+	return [[self objectEnumerator] allObjects];
+}
+
+- (id)anyObject {
+	return [self firstObject];
+}
+
+- (id)ceilingObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:YES];
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self member:anObject] != nil);
+}
+
+- (NSUInteger)count {
+	[self _checkForMutation];
+	if (count == NSNotFound) {
+		NSEnumerator *enumerator = [self objectEnumerator];
+		count = 0;
+		while ([enumerator nextObject]) {
+			count++;
+		}
+	}
+	return count;
+}
+
+- (NSString *)description {
+	return [[self allObjects] description];
+}
+
+- (id)firstObject {
+	return [[self objectEnumerator] nextObject];
+}
+
+- (id)floorObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:YES];
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects([self count], [self firstObject], [self lastObject]);
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
+		return [self isEqualToSortedSet:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+- (BOOL)isEqualToSortedSet:(id<CHSortedSet>)otherSortedSet {
+	return CHCollectionsAreEqual(self, otherSortedSet);
+}
+
+- (id)lastObject {
+	return [[self reverseObjectEnumerator] nextObject];
+}
+
+// The tree is searched directly rather than with -member:, which CHSplayTree
+// overrides to splay the node it finds, counting as a mutation of the tree.
+- (id)member:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self _checkForMutation];
+	if (![self _rangeIncludesObject:anObject]) {
+		return nil;
+	}
+	CHComparison localOrdering = ordering;
+	id aKey = CHBinaryTreeKeyForObject(keyPath, anObject);
+	CHBinaryTreeNode *node = CHBinaryTreeFindNode(headerNode->right, aKey, 0, sentinelNode, &localOrdering);
+	return (node != sentinelNode) ? node->object : nil;
+}
+
+- (id)objectAfter:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:NO];
+}
+
+- (id)objectBefore:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:NO];
+}
+
+- (NSEnumerator *)objectEnumerator {
+	[self _checkForMutation];
+	return [[[CHBinarySearchTreeRangeEnumerator alloc]
+	         initWithRange:self
+	                  runs:runs
+	              runCount:runCount
+	                header:headerNode
+	              sentinel:sentinelNode
+	            descending:NO
+	              ordering:ordering
+	       mutationPointer:mutationPtr] autorelease];
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	[self _checkForMutation];
+	return [[[CHBinarySearchTreeRangeEnumerator alloc]
+	         initWithRange:self
+	                  runs:runs
+	              runCount:runCount
+	                header:headerNode
+	              sentinel:sentinelNode
+	            descending:YES
+	              ordering:ordering
+	       mutationPointer:mutationPtr] autorelease];
+}
+
+- (NSSet *)set {
+	return [NSSet setWithArray:[self allObjects]];
+}
+
+- (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	return [[[self copy] autorelease] subsetFromObject:start toObject:end options:options];
+}
+
+#pragma mark Modifying Contents
+
+// A range reflects the contents of its tree, so it can't be modified directly.
+
+- (void)addObject:(id)anObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeAllObjects {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeFirstObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeLastObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeObject:(id)anObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+@end
+
+#pragma mark -
+
+@implementation CHAbstractBinarySearchTree
+
+// Compares two objects by their keys, for the ordering of a tree with a key path.
+// Searches compare keys with keyOrdering directly, so this is only used when
+// objects must be compared, as in sorting them. The context is the tree.
+static NSInteger CHAbstractBinarySearchTreeCompareKeys(id object1, id object2, void *context) {
+	CHAbstractBinarySearchTree *tree = (CHAbstractBinarySearchTree *)context;
+	CHComparison comparison = tree->keyOrdering;
+	return CHComparisonCompare(&comparison,
+	                           CHBinaryTreeKeyForObject(tree->keyPath, object1),
+	                           CHBinaryTreeKeyForObject(tree->keyPath, object2));
+}
+
+- (void)dealloc {
+	[self removeAllObjects];
+	free(header);
+	free(sentinel);
+	[comparator release];
+	[keyComparator release];
+	[sortDescriptor release];
+	[keyPath release];
+	[super dealloc];
+}
+
+- (instancetype)init {
+	return [self initWithArray:@[]];
+}
+
+// This is the designated initializer for CHAbstractBinarySearchTree.
+- (instancetype)initWithArray:(NSArray *)anArray {
+	self = [super init];
+	if (self) {
+		count = 0;
+		mutations = 0;
+		nodeSlabs = NULL;
+		freeNodes = NULL;
+		nodeSize = kCHBinaryTreeNodeSize;
+		// The header and sentinel outlive -removeAllObjects, so they don't
+		// come from the node slabs. They have room for a key prefix (which is
+		// always 0) in case the tree caches them.
+		sentinel = calloc(1, kCHBinaryTreePrefixedNodeSize);
+		sentinel->right = sentinel;
+		sentinel->left = sentinel;
+		header = calloc(1, kCHBinaryTreePrefixedNodeSize);
+		header->object = [CHSearchTreeHeaderObject object];
+		header->key = header->object;
+		header->right = sentinel;
+		header->left = sentinel;
+		[self _subclassSetup];
+		[self addObjectsFromArray:anArray];
+	}
+	return self;
+}
+
+- (instancetype)initWithComparator:(NSComparator)cmptr {
+	CHRaiseInvalidArgumentExceptionIfNil(cmptr);
+	self = [self initWithArray:@[]];
+	if (self) {
+		comparator = [cmptr copy];
+		ordering.function = CHCompareUsingComparator;
+		ordering.context = (void *)comparator;
+		keyOrdering = ordering;
+	}
+	return self;
+}
+
+- (instancetype)initWithComparisonFunction:(CHComparisonFunction)function context:(void *)context {
+	if (function == NULL) {
+		CHRaiseInvalidArgumentException(@"Invalid NULL comparison function");
+	}
+	self = [self initWithArray:@[]];
+	if (self) {
+		ordering.function = function;
+		ordering.context = context;
+		keyOrdering = ordering;
+	}
+	return self;
+}
+
+- (instancetype)initWithKeyPath:(NSString *)aKeyPath {
+	CHRaiseInvalidArgumentExceptionIfNil(aKeyPath);
+	return [self initWithSortDescriptor:[NSSortDescriptor sortDescriptorWithKey:aKeyPath
+	                                                                  ascending:YES
+	                                                                   selector:@selector(compare:)]];
+}
+
+- (instancetype)initWithSortDescriptor:(NSSortDescriptor *)descriptor {
+	CHRaiseInvalidArgumentExceptionIfNil(descriptor);
+	self = [self initWithArray:@[]];
+	if (self) {
+		[self _orderBySortDescriptor:descriptor];
+	}
+	return self;
+}
+
+// Sets up an empty tree to order objects as a sort descriptor would. Keys that
+// are compared in ascending order with -compare: use the same cached method as
+// a tree without a key path; any other selector is sent through a block.
+- (void)_orderBySortDescriptor:(NSSortDescriptor *)descriptor {
+	sortDescriptor = [descriptor retain];
+	keyPath = [[descriptor key] copy];
+	BOOL ascending = [descriptor ascending];
+	SEL selector = [descriptor selector];
+	if (selector == NULL) {
+		NSComparator descriptorComparator = [descriptor comparator];
+		keyComparator = ascending ? [descriptorComparator copy] : [^(id key1, id key2) {
+			return descriptorComparator(key2, key1);
+		} copy];
+	} else if (selector != @selector(compare:) || !ascending) {
+		NSComparisonResult (*send)(id, SEL, id) = (NSComparisonResult (*)(id, SEL, id))objc_msgSend;
+		keyComparator = ascending ? [^(id key1, id key2) {
+			return send(key1, selector, key2);
+		} copy] : [^(id key1, id key2) {
+			return send(key2, selector, key1);
+		} copy];
+	}
+	if (keyComparator != nil) {
+		keyOrdering.function = CHCompareUsingComparator;
+		keyOrdering.context = (void *)keyComparator;
+	}
+	if (keyPath != nil) {
+		ordering.function = CHAbstractBinarySearchTreeCompareKeys;
+		ordering.context = (void *)self;
+	} else {
+		ordering = keyOrdering;
+	}
+}
+
+- (void)_subclassSetup {
+	// This allows child classes to initialize their specific state on init.
+}
+
+- (instancetype)_emptyCopyWithZone:(NSZone *)zone {
+	CHAbstractBinarySearchTree *tree = [[[self class] allocWithZone:zone] init];
+	if (sortDescriptor != nil) {
+		// The ordering refers to the tree it belongs to, so it is set up anew.
+		[tree _orderBySortDescriptor:sortDescriptor];
+	} else {
+		tree->ordering = ordering;
+		if (comparator != nil) {
+			tree->comparator = [comparator copy];
+			tree->ordering.context = (void *)tree->comparator;
+		}
+		tree->keyOrdering = tree->ordering;
+	}
+	[tree setCachesKeyPrefixes:cachesKeyPrefixes];
+	return tree;
+}
+
+// A sort descriptor can be archived unless it uses a comparator block.
+- (void)_checkOrderingCanBeEncoded {
+	if ((sortDescriptor != nil) ? ([sortDescriptor selector] == NULL) : (ordering.function != NULL)) {
+		CHRaiseInvalidArgumentException(@"A tree with a comparator or comparison function can't be archived");
+	}
+}
+
+- (CHBinaryTreeNode *)_createNodeWithObject:(nullable id)object {
+	return [self _createNodeWithObject:object key:(object != nil) ? CHBinaryTreeKeyForObject(keyPath, object) : nil];
+}
+
+- (CHBinaryTreeNode *)_createNodeWithObject:(id)object key:(id)key {
+	if (freeNodes == NULL) {
+		[self _allocateNodeSlab];
+	}
+	CHBinaryTreeNode *node = freeNodes;
+	freeNodes = node->right;
+	node->object = object;
+	node->key = (key != object) ? [key retain] : key;
+	if (cachesKeyPrefixes) {
+		*CHBinaryTreeNodePrefix(node) = (key != nil) ? CHBinaryTreePrefixForKey(key) : 0;
+	}
+	node->left = sentinel;
+	node->right = sentinel;
+	node->balance = 0; // Affects balancing info for any subclass (anonymous union)
+	node->size = 1;
+	return node;
+}
+
+- (void)_allocateNodeSlab {
+	NSUInteger capacity = (nodeSlabs == NULL)
+		? kCHBinaryTreeNodeSlabMinimumCapacity
+		: MIN(nodeSlabs->capacity * 2, kCHBinaryTreeNodeSlabMaximumCapacity);
+	CHBinaryTreeNodeSlab *slab = malloc(sizeof(CHBinaryTreeNodeSlab) + nodeSize * capacity);
+	slab->next = nodeSlabs;
+	slab->capacity = capacity;
+	slab->nodeSize = nodeSize;
+	nodeSlabs = slab;
+	// Push nodes in reverse so they are handed out in ascending address order.
+	for (NSUInteger index = capacity; index-- > 0; ) {
+		CHBinaryTreeNode *node = CHBinaryTreeNodeSlabNode(slab, index);
+		node->object = nil; // So that the uninitialized key isn't released.
+		node->key = nil;
+		CHBinaryTreeNode_FREE(node);
+	}
+}
+
+#pragma mark <NSCoding>
+
+// Trees are archived with their objects in pre-order and the shape of the tree,
+// so they can be decoded in linear time without comparing any objects. If the
+// shape is missing (as in older archives and those of subset views) or doesn't
+// match the objects, the objects are sorted and added as usual. The shape isn't
+// checked against the tree's balancing rules, so archives should be trusted.
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	NSArray *objects = [decoder decodeObjectForKey:@"objects"];
+	NSData *shape = [decoder decodeObjectForKey:@"shape"];
+	NSString *shapeClass = [decoder decodeObjectForKey:@"shapeClass"];
+	NSSortDescriptor *descriptor = [decoder decodeObjectForKey:@"sortDescriptor"];
+	NSUInteger objectCount = [objects count];
+	self = (descriptor != nil) ? [self initWithSortDescriptor:descriptor] : [self initWithArray:@[]];
+	if (self) {
+		[self setCachesKeyPrefixes:[decoder decodeBoolForKey:@"cachesKeyPrefixes"]];
+		if (shape == nil || ![shapeClass isEqualToString:NSStringFromClass([self class])] ||
+		    !CHBinaryTreeShapeIsValid([shape bytes], [shape length], objectCount))
+		{
+			[self addObjectsFromArray:objects];
+		} else {
+			__unsafe_unretained id *buffer = (__unsafe_unretained id *) malloc(kCHPointerSize * objectCount);
+			[objects getObjects:buffer range:NSMakeRange(0, objectCount)];
+			[self _buildTreeWithPreOrderObjects:buffer shape:[shape bytes] count:objectCount];
+			free(buffer);
+		}
+	}
+	return self;
+}
+
+// Nodes with a right child still to be built are kept on a stack, since each
+// right subtree follows the entire left subtree in pre-order.
+- (void)_buildTreeWithPreOrderObjects:(__unsafe_unretained id *)objects shape:(const uint8_t *)shape count:(NSUInteger)objectCount {
+	CHBinaryTreeNode *parent = header, *node;
+	NSUInteger direction = 1;
+	CHBinaryTreeStack_DECLARE();
+	CHBinaryTreeStack_INIT();
+	for (NSUInteger index = 0; index < objectCount; index++) {
+		const uint8_t *record = shape + index * kCHBinaryTreeShapeRecordSize;
+		node = [self _createNodeWithObject:[objects[index] retain]];
+		uint32_t balance;
+		memcpy(&balance, record + 1, sizeof(balance));
+		node->balance = (int32_t) NSSwapBigIntToHost(balance);
+		CHBinaryTreeLinkChild(parent, direction, node);
+		if (record[0] & CHBinaryTreeShapeHasRightChild) {
+			CHBinaryTreeStack_PUSH(node);
+		}
+		if (record[0] & CHBinaryTreeShapeHasLeftChild) {
+			parent = node;
+			direction = 0;
+		} else {
+			parent = CHBinaryTreeStack_POP(); // NULL only after the last node
+			direction = 1;
+		}
+	}
+	CHBinaryTreeStack_FREE(stack);
+	count = objectCount;
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[self _checkOrderingCanBeEncoded];
+	NSMutableArray *objects = [NSMutableArray arrayWithCapacity:count];
+	NSMutableData *shape = [NSMutableData dataWithLength:count * kCHBinaryTreeShapeRecordSize];
+	uint8_t *record = [shape mutableBytes];
+	CHBinaryTreeNode *current = header->right;
+	while (current != sentinel && current != header) {
+		[objects addObject:current->object];
+		record[0] = ((current->left != sentinel) ? CHBinaryTreeShapeHasLeftChild : 0)
+		          | ((current->right != sentinel) ? CHBinaryTreeShapeHasRightChild : 0);
+		uint32_t balance = NSSwapHostIntToBig((uint32_t) current->balance);
+		memcpy(record + 1, &balance, sizeof(balance));
+		record += kCHBinaryTreeShapeRecordSize;
+		current = CHBinaryTreePreOrderNextNode(current, header, sentinel);
+	}
+	[encoder encodeObject:objects forKey:@"objects"];
+	[encoder encodeObject:sortDescriptor forKey:@"sortDescriptor"];
+	[encoder encodeBool:cachesKeyPrefixes forKey:@"cachesKeyPrefixes"];
+	[encoder encodeObject:shape forKey:@"shape"];
+	[encoder encodeObject:NSStringFromClass([self class]) forKey:@"shapeClass"];
+}
+
+#pragma mark <NSCopying> methods
+
+// The copy has the same shape and balancing data as the receiver, so it takes
+// linear time and no comparisons. Nodes are copied in pre-order, and each time
+// the traversal climbs the receiver, the copy's parent links are used to climb
+// the copy in step, so no stack is needed.
+- (instancetype)copyWithZone:(NSZone *)zone {
+	CHAbstractBinarySearchTree *newTree = [self _emptyCopyWithZone:zone];
+	CHBinaryTreeNode *current = header->right, *parentCopy = newTree->header, *nodeCopy;
+	NSUInteger direction = 1;
+	while (current != sentinel) {
+		nodeCopy = [newTree _createNodeWithObject:[current->object retain] key:current->key];
+		nodeCopy->balance = current->balance;
+		nodeCopy->size = current->size;
+		CHBinaryTreeLinkChild(parentCopy, direction, nodeCopy);
+		parentCopy = nodeCopy;
+		if (current->left != sentinel) {
+			current = current->left;
+			direction = 0;
+			continue;
+		}
+		direction = 1;
+		if (current->right != sentinel) {
+			current = current->right;
+			continue;
+		}
+		// Climb to the nearest ancestor with a right subtree not yet copied.
+		while (current->parent != header &&
+		       (current->parent->right == current || current->parent->right == sentinel))
+		{
+			current = current->parent;
+			parentCopy = parentCopy->parent;
+		}
+		parentCopy = parentCopy->parent;
+		current = (current->parent != header) ? current->parent->right : sentinel;
+	}
+	newTree->count = count;
+	newTree->tracksSubtreeSizes = tracksSubtreeSizes;
+	return newTree;
+}
+
+#pragma mark <NSFastEnumeration>
+
+// The next node is kept in the state and found by following parent links, so
+// nothing needs to be allocated (or freed if enumeration stops early).
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	CHBinaryTreeNode *current;
+	
+	// For the first call, start at leftmost node, otherwise the last saved node
+	if (state->state == 0) {
+		state->state = 1;
+		state->mutationsPtr = &mutations;
+		current = (header->right != sentinel) ? CHBinaryTreeFirstNode(header->right, NO, sentinel) : header;
+	} else {
+		current = (CHBinaryTreeNode *) state->extra[0];
+	}
+	state->itemsPtr = stackbuf;
+	
+	// Accumulate objects from the tree until we reach all nodes or the maximum
+	NSUInteger batchCount = 0;
+	while (current != header && batchCount < len) {
+		stackbuf[batchCount++] = current->object;
+		current = CHBinaryTreeNextNode(current, NO, header, sentinel);
+	}
+	state->extra[0] = (unsigned long) current;
+	return batchCount;
+}
+
+#pragma mark Concrete Implementations
+
+// An empty tree is built directly from the sorted objects in linear time. The
+// input is only sorted if it isn't already in ascending order.
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	NSUInteger arrayCount = [anArray count];
+	if (count > 0 || arrayCount < 2) {
+		for (id anObject in anArray) {
+			[self addObject:anObject];
+		}
+		return;
+	}
+	++mutations;
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * arrayCount);
+	arrayCount = [self _getSortedObjects:objects fromArray:anArray];
+	[self _buildTreeWithSortedObjects:objects count:arrayCount];
+	free(objects);
+}
+
+// Copies the objects in an array to a C array (which must have room for all of
+// them) in the receiver's order, leaving out any object that is equal to a later
+// one, and returns the number copied. The array is only sorted if necessary.
+- (NSUInteger)_getSortedObjects:(__unsafe_unretained id *)objects fromArray:(NSArray *)anArray {
+	NSUInteger arrayCount = [anArray count];
+	[anArray getObjects:objects range:NSMakeRange(0, arrayCount)];
+	CHComparison localOrdering = ordering;
+	NSUInteger index = 1;
+	while (index < arrayCount && CHComparisonCompare(&localOrdering, objects[index-1], objects[index]) == NSOrderedAscending) {
+		index++;
+	}
+	if (index < arrayCount) {
+		// A stable sort means the last of several equal objects is kept, just as
+		// if each one had been added by -addObject: in turn.
+		__block CHComparison sortOrdering = ordering;
+		NSArray *sorted = [anArray sortedArrayWithOptions:NSSortStable
+		                                  usingComparator:^(id object1, id object2) {
+			return CHComparisonCompare(&sortOrdering, object1, object2);
+		}];
+		[sorted getObjects:objects range:NSMakeRange(0, arrayCount)];
+		NSUInteger uniqueCount = 0;
+		for (index = 0; index < arrayCount; index++) {
+			if (index + 1 < arrayCount && CHComparisonCompare(&localOrdering, objects[index], objects[index+1]) == NSOrderedSame) {
+				continue;
+			}
+			objects[uniqueCount++] = objects[index];
+		}
+		arrayCount = uniqueCount;
+	}
+	return arrayCount;
+}
+
+- (void)_buildTreeWithSortedObjects:(__unsafe_unretained id *)objects count:(NSUInteger)objectCount {
+	NSAssert(count == 0, @"Illegal state, tree must be empty before building!");
+	CHBinaryTreeLinkChild(header, 1, [self _subtreeWithSortedObjects:objects
+	                                                           count:objectCount
+	                                                           depth:0
+	                                                          height:CHBinaryTreeHeightForCount(objectCount)]);
+	count = objectCount;
+}
+
+// Recursion depth is bounded by the height of a balanced tree (about log2 n).
+- (CHBinaryTreeNode *)_subtreeWithSortedObjects:(__unsafe_unretained id *)objects
+                                          count:(NSUInteger)subtreeCount
+                                          depth:(NSUInteger)depth
+                                         height:(NSUInteger)height
+{
+	if (subtreeCount == 0) {
+		return sentinel;
+	}
+	// When the count is even, the extra node goes in the right subtree.
+	NSUInteger leftCount = (subtreeCount - 1) / 2;
+	CHBinaryTreeNode *node = [self _createNodeWithObject:[objects[leftCount] retain]];
+	CHBinaryTreeLinkChild(node, 0, [self _subtreeWithSortedObjects:objects
+	                                                         count:leftCount
+	                                                         depth:depth + 1
+	                                                        height:height]);
+	CHBinaryTreeLinkChild(node, 1, [self _subtreeWithSortedObjects:objects + leftCount + 1
+	                                                         count:subtreeCount - leftCount - 1
+	                                                         depth:depth + 1
+	                                                        height:height]);
+	node->size = (u_int32_t) subtreeCount;
+	[self _balanceBuiltNode:node count:subtreeCount depth:depth height:height];
+	return node;
+}
+
+- (void)_balanceBuiltNode:(CHBinaryTreeNode *)node count:(NSUInteger)subtreeCount depth:(NSUInteger)depth height:(NSUInteger)height {
+	// Unbalanced trees don't store any extra data.
+}
+
+// The old nodes are released only after the new tree is built, since it may
+// contain the same objects.
+- (void)_replaceObjectsWithSortedObjects:(__unsafe_unretained id *)objects count:(NSUInteger)objectCount {
+	CHBinaryTreeNodeSlab *oldSlabs = nodeSlabs;
+	nodeSlabs = NULL;
+	freeNodes = NULL;
+	header->right = sentinel;
+	count = 0;
+	[self _buildTreeWithSortedObjects:objects count:objectCount];
+	CHBinaryTreeNodeSlabsFree(oldSlabs);
+}
+
+- (void)_combineWithSortedSet:(id<CHSortedSet>)otherSortedSet operation:(CHSortedMergeOperation)operation {
+	CHRaiseInvalidArgumentExceptionIfNil(otherSortedSet);
+	if (otherSortedSet == self) {
+		if (operation == CHSortedMergeDifference) {
+			[self removeAllObjects];
+		}
+		return;
+	}
+	NSArray *otherObjects = [otherSortedSet allObjects];
+	NSUInteger otherCount = [otherObjects count];
+	if (count == 0 || otherCount == 0) {
+		if (operation == CHSortedMergeUnion) {
+			[self addObjectsFromArray:otherObjects];
+		} else if (operation == CHSortedMergeIntersection) {
+			[self removeAllObjects];
+		}
+		return;
+	}
+	// If the other set is small, searching for each of its objects is cheaper
+	// than visiting every node.
+	BOOL searchIndividually = (otherCount * CHBinaryTreeHeightForCount(count) < count);
+	if (searchIndividually && operation == CHSortedMergeUnion) {
+		for (id anObject in otherObjects) {
+			[self addObject:anObject];
+		}
+		return;
+	}
+	if (searchIndividually && operation == CHSortedMergeDifference) {
+		for (id anObject in otherObjects) {
+			[self removeObject:anObject];
+		}
+		return;
+	}
+	
+	// One buffer holds the receiver's objects, the other set's objects, and the
+	// result of combining them.
+	NSUInteger mergedCapacity = count + otherCount;
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * mergedCapacity * 2);
+	__unsafe_unretained id *otherObjectsArray = objects + count;
+	__unsafe_unretained id *merged = objects + mergedCapacity;
+	NSUInteger mergedCount = 0;
+	if (searchIndividually) {
+		// Only intersections get here, and the result can't be larger than m.
+		// The members are found in the other set's order, which may not be the
+		// receiver's, and several objects may match the same member, so they
+		// are sorted and duplicates are left out, as for any other array.
+		NSMutableArray *members = [NSMutableArray arrayWithCapacity:otherCount];
+		id anObject;
+		for (id otherObject in otherObjects) {
+			if ((anObject = [self member:otherObject])) {
+				[members addObject:anObject];
+			}
+		}
+		mergedCount = [self _getSortedObjects:merged fromArray:members];
+	} else {
+		NSUInteger index = 0;
+		for (id anObject in self) {
+			objects[index++] = anObject;
+		}
+		// The other set may be ordered differently, in which case it is sorted.
+		otherCount = [self _getSortedObjects:otherObjectsArray fromArray:otherObjects];
+		mergedCount = CHSortedMergeConcurrently(objects, count, otherObjectsArray, otherCount,
+		                                        merged, operation, ordering);
+	}
+	++mutations;
+	[self _replaceObjectsWithSortedObjects:merged count:mergedCount];
+	free(objects);
+}
+
+// Sizes are computed in reverse pre-order, which visits children before parents,
+// so this doesn't require recursion even if the tree is badly unbalanced.
+- (void)_computeSubtreeSizes {
+	if (count == 0) {
+		return;
+	}
+	CHBinaryTreeNode **nodes = malloc(kCHPointerSize * count);
+	NSUInteger nodeCount = 0;
+	CHBinaryTreeNode *current;
+	CHBinaryTreeStack_DECLARE();
+	CHBinaryTreeStack_INIT();
+	CHBinaryTreeStack_PUSH(header->right);
+	while ((current = CHBinaryTreeStack_POP())) {
+		nodes[nodeCount++] = current;
+		if (current->right != sentinel) {
+			CHBinaryTreeStack_PUSH(current->right);
+		}
+		if (current->left != sentinel) {
+			CHBinaryTreeStack_PUSH(current->left);
+		}
+	}
+	CHBinaryTreeStack_FREE(stack);
+	while (nodeCount > 0) {
+		current = nodes[--nodeCount];
+		CHBinaryTreeNode_UPDATE_SIZE(current);
+	}
+	free(nodes);
+}
+
+// Without subtree sizes, a node's position is found by stepping back from it to
+// the first node, which takes O(n) time but writes nothing.
+static NSUInteger CHBinaryTreeCountNodesBeforeNode(CHBinaryTreeNode *node, NSUInteger count, CHBinaryTreeNode *header, CHBinaryTreeNode *sentinel) {
+	if (node == sentinel) {
+		return count;
+	}
+	NSUInteger rank = 0;
+	while ((node = CHBinaryTreeNextNode(node, YES, header, sentinel)) != header) {
+		rank++;
+	}
+	return rank;
+}
+
+// Returns the number of objects less than anObject (or equal to it, if desired).
+- (NSUInteger)_countOfObjectsBeforeObject:(id)anObject includingEqual:(BOOL)includeEqual {
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	if (!tracksSubtreeSizes) {
+		// Count the objects before the first one that isn't included.
+		CHBinaryTreeNode *node = CHBinaryTreeFindNearestNode(header->right, aKey, aPrefix, 1, !includeEqual, sentinel, &localComparison);
+		return CHBinaryTreeCountNodesBeforeNode(node, count, header, sentinel);
+	}
+	NSUInteger rank = 0;
+	CHBinaryTreeNode *current = header->right;
+	NSComparisonResult comparison;
+	while (current != sentinel) {
+		comparison = CHBinaryTreeCompare(current, aKey);
+		if (comparison == NSOrderedAscending) {
+			rank += current->left->size + 1;
+			current = current->right;
+		} else if (comparison == NSOrderedDescending) {
+			current = current->left;
+		} else {
+			return rank + current->left->size + (includeEqual ? 1 : 0);
+		}
+	}
+	return rank;
+}
+
+// Stores in nodes[i] the node containing an object equal to objects[i] (or the
+// sentinel), replacing each object in the buffer with its key. A batch large
+// enough that separate searches would compare more objects than there are in the
+// tree is found in a single sweep instead.
+- (void)_getNodes:(CHBinaryTreeNode **)nodes forObjects:(__unsafe_unretained id *)objects count:(NSUInteger)objectCount {
+	if (keyPath != nil) {
+		for (NSUInteger i = 0; i < objectCount; i++) {
+			objects[i] = CHBinaryTreeKeyForObject(keyPath, objects[i]);
+		}
+	}
+	CHComparison localComparison = keyOrdering;
+	if (objectCount * CHBinaryTreeHeightForCount(count) > count + objectCount) {
+		CHBinaryTreeFindNodesBySweep(header, objects, objectCount, cachesKeyPrefixes, sentinel, &localComparison, nodes);
+	} else {
+		CHBinaryTreeFindNodesInterleaved(header->right, objects, objectCount, cachesKeyPrefixes, sentinel, &localComparison, nodes);
+	}
+}
+
+// Returns the nearest object below anObject (if direction is 0) or above it (if
+// 1), or an object equal to it if inclusive is YES, or nil if there is none.
+- (id)_objectNearestToObject:(id)anObject direction:(NSUInteger)direction inclusive:(BOOL)inclusive {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison localComparison = keyOrdering;
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeNode *nearest = CHBinaryTreeFindNearestNode(header->right, aKey, aPrefix, direction, inclusive, sentinel, &localComparison);
+	return (nearest != sentinel) ? nearest->object : nil;
+}
+
+- (NSArray *)allObjects {
+	return [self allObjectsWithTraversalOrder:CHTraversalOrderAscending];
+}
+
+- (NSArray *)allObjectsWithTraversalOrder:(CHTraversalOrder)order {
+	return [[self objectEnumeratorWithTraversalOrder:order] allObjects];
+}
+
+- (id)anyObject {
+	return (count > 0) ? header->right->object : nil;
+	// In an empty tree, sentinel's object may be nil, but let's not chance it.
+	// (Our -removeAllObjects nils the pointer, child's -removeObject: may not.)
+}
+
+- (id)ceilingObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:YES];
+}
+
+- (NSComparator)comparator {
+	return comparator;
+}
+
+- (NSSortDescriptor *)sortDescriptor {
+	return sortDescriptor;
+}
+
+- (BOOL)cachesKeyPrefixes {
+	return cachesKeyPrefixes;
+}
+
+// Nodes with and without prefixes differ in size, so the tree is rebuilt from
+// new slabs, just as when it is combined with another set.
+- (void)setCachesKeyPrefixes:(BOOL)flag {
+	if (flag == cachesKeyPrefixes) {
+		return;
+	}
+	if (flag && keyOrdering.function != NULL) {
+		CHRaiseInvalidArgumentException(@"Key prefixes require keys to be compared with -compare: in ascending order");
+	}
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * count);
+	NSUInteger objectCount = 0;
+	for (id anObject in self) {
+		objects[objectCount++] = anObject;
+	}
+	++mutations;
+	cachesKeyPrefixes = flag;
+	nodeSize = flag ? kCHBinaryTreePrefixedNodeSize : kCHBinaryTreeNodeSize;
+	[self _replaceObjectsWithSortedObjects:objects count:objectCount];
+	free(objects);
+}
+
+- (BOOL)tracksSubtreeSizes {
+	return tracksSubtreeSizes;
+}
+
+- (void)setTracksSubtreeSizes:(BOOL)flag {
+	if (flag && !tracksSubtreeSizes) {
+		[self _computeSubtreeSizes];
+	}
+	tracksSubtreeSizes = flag;
+}
+
+// Returns the node after node in a pre-order traversal of the subtree at top
+// that goes no more than maxDepth levels below top, and updates *depth to the
+// level of the returned node. Returns NULL after the last node. Parent links are
+// used to climb back up, so no stack is needed.
+static CHBinaryTreeNode *CHBinaryTreeNextNodeWithinDepth(CHBinaryTreeNode *node, NSUInteger *depth, NSUInteger maxDepth, CHBinaryTreeNode *top, CHBinaryTreeNode *sentinel) {
+	if (*depth < maxDepth) {
+		for (NSUInteger direction = 0; direction < 2; direction++) {
+			if (node->link[direction] != sentinel) {
+				++*depth;
+				return node->link[direction];
+			}
+		}
+	}
+	while (node != top) {
+		CHBinaryTreeNode *parent = node->parent;
+		if (parent->left == node && parent->right != sentinel) {
+			return parent->right; // A sibling is at the same depth.
+		}
+		--*depth;
+		node = parent;
+	}
+	return NULL;
+}
+
+// Appends the nodes in the top height levels of the subtree at root to nodes, in
+// van Emde Boas order: the top half of those levels is laid out recursively,
+// followed by each subtree hanging below it, from left to right, so that any
+// search path crosses about log(n)/log(B) blocks of B nodes for every B. The
+// recursion only goes log2(height) deep, even for an unbalanced tree.
+static void CHBinaryTreeVanEmdeBoasLayout(CHBinaryTreeNode *root, NSUInteger height, CHBinaryTreeNode *sentinel, CHBinaryTreeNode **nodes, NSUInteger *nodeCount) {
+	if (height == 1) {
+		nodes[(*nodeCount)++] = root;
+		return;
+	}
+	NSUInteger bottomHeight = height / 2, topHeight = height - bottomHeight;
+	CHBinaryTreeVanEmdeBoasLayout(root, topHeight, sentinel, nodes, nodeCount);
+	NSUInteger depth = 0;
+	CHBinaryTreeNode *node = root;
+	while ((node = CHBinaryTreeNextNodeWithinDepth(node, &depth, topHeight, root, sentinel))) {
+		if (depth == topHeight) {
+			CHBinaryTreeVanEmdeBoasLayout(node, bottomHeight, sentinel, nodes, nodeCount);
+		}
+	}
+}
+
+// Each node is copied to its place in the new slab, and its old address is left
+// in the old node's parent link, so the children of each copy can be found there.
+- (void)compact {
+	if (count == 0) {
+		[self removeAllObjects]; // Frees any slabs left by -removeObject:
+		return;
+	}
+	++mutations; // Enumerators hold on to nodes, which are about to move.
+	NSUInteger height = 0, depth = 0;
+	CHBinaryTreeNode *node = header->right;
+	do {
+		height = MAX(height, depth + 1);
+	} while ((node = CHBinaryTreeNextNodeWithinDepth(node, &depth, NSUIntegerMax, header->right, sentinel)));
+	CHBinaryTreeNode **nodes = malloc(kCHPointerSize * count);
+	NSUInteger nodeCount = 0;
+	CHBinaryTreeVanEmdeBoasLayout(header->right, height, sentinel, nodes, &nodeCount);
+	NSAssert(nodeCount == count, @"Illegal state, layout should include every node!");
+	
+	CHBinaryTreeNodeSlab *slab = malloc(sizeof(CHBinaryTreeNodeSlab) + nodeSize * count);
+	slab->next = NULL;
+	slab->capacity = count;
+	slab->nodeSize = nodeSize;
+	for (NSUInteger i = 0; i < count; i++) {
+		memcpy(CHBinaryTreeNodeSlabNode(slab, i), nodes[i], nodeSize);
+		nodes[i]->object = nil; // The copy owns it (and its key) now.
+		nodes[i]->key = nil;
+		nodes[i]->parent = CHBinaryTreeNodeSlabNode(slab, i);
+	}
+	for (NSUInteger i = 0; i < count; i++) {
+		node = CHBinaryTreeNodeSlabNode(slab, i);
+		for (NSUInteger direction = 0; direction < 2; direction++) {
+			if (node->link[direction] != sentinel) {
+				CHBinaryTreeLinkChild(node, direction, node->link[direction]->parent);
+			}
+		}
+	}
+	CHBinaryTreeLinkChild(header, 1, header->right->parent);
+	free(nodes);
+	CHBinaryTreeNodeSlabsFree(nodeSlabs); // Every object in them is now nil.
+	nodeSlabs = slab;
+	freeNodes = NULL;
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self member:anObject] != nil);
+}
+
+- (NSIndexSet *)containsObjects:(NSArray *)anArray {
+	CHRaiseInvalidArgumentExceptionIfNil(anArray);
+	NSUInteger objectCount = [anArray count];
+	CHBinaryTreeNode **nodes = malloc(kCHPointerSize * objectCount * 2);
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) (nodes + objectCount);
+	[anArray getObjects:objects range:NSMakeRange(0, objectCount)];
+	[self _getNodes:nodes forObjects:objects count:objectCount];
+	NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+	for (NSUInteger i = 0; i < objectCount; i++) {
+		if (nodes[i] != sentinel) {
+			[indexes addIndex:i];
+		}
+	}
+	free(nodes);
+	return indexes;
+}
+
+- (NSUInteger)count {
+	return count;
+}
+
+- (NSUInteger)countOfObjectsFromObject:(id)start toObject:(id)end {
+	if (count == 0) {
+		return 0;
+	}
+	// Objects before start and after end are excluded.
+	NSUInteger before = (start != nil) ? [self _countOfObjectsBeforeObject:start includingEqual:NO] : 0;
+	NSUInteger through = (end != nil) ? [self _countOfObjectsBeforeObject:end includingEqual:YES] : count;
+	CHComparison localOrdering = ordering;
+	if (start != nil && end != nil && CHComparisonCompare(&localOrdering, start, end) == NSOrderedDescending) {
+		// Objects strictly between end and start are excluded instead.
+		return count - before + through;
+	}
+	return through - before;
+}
+
+- (NSString *)description {
+	return [[self allObjectsWithTraversalOrder:CHTraversalOrderAscending] description];
+}
+
+- (id)firstObject {
+	if (header->right == sentinel) {
+		return nil;
+	}
+	return CHBinaryTreeFirstNode(header->right, NO, sentinel)->object;
+}
+
+- (id)floorObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:YES];
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects(count, [self firstObject], [self lastObject]);
+}
+
+- (NSUInteger)indexOfObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	if (!tracksSubtreeSizes) {
+		CHBinaryTreeNode *node = CHBinaryTreeFindNode(header->right, aKey, aPrefix, sentinel, &localComparison);
+		return (node != sentinel) ? CHBinaryTreeCountNodesBeforeNode(node, count, header, sentinel) : NSNotFound;
+	}
+	NSUInteger rank = 0;
+	CHBinaryTreeNode *current = header->right;
+	NSComparisonResult comparison;
+	while (current != sentinel && (comparison = CHBinaryTreeCompare(current, aKey))) {
+		if (comparison == NSOrderedAscending) {
+			rank += current->left->size + 1;
+		}
+		current = current->link[comparison == NSOrderedAscending]; // R on YES
+	}
+	return (current != sentinel) ? rank + current->left->size : NSNotFound;
+}
+
+- (void)intersectWithSortedSet:(id<CHSortedSet>)otherSortedSet {
+	[self _combineWithSortedSet:otherSortedSet operation:CHSortedMergeIntersection];
+}
+
+- (BOOL)isEqual:(id)otherObject {
 	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
 		return [self isEqualToSortedSet:otherObject];
 	} else {
@@ -472,33 +1954,93 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 }
 
 - (id)lastObject {
-	sentinel->object = nil;
-	CHBinaryTreeNode *current = header->right;
-	while (current->right != sentinel) {
-		current = current->right;
+	if (header->right == sentinel) {
+		return nil;
 	}
-	return current->object;
+	return CHBinaryTreeFirstNode(header->right, YES, sentinel)->object;
 }
 
 - (id)member:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
-	sentinel->object = anObject; // Make sure the target value is always "found"
-	CHBinaryTreeNode *current = header->right;
-	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
-		current = current->link[comparison == NSOrderedAscending]; // R on YES
-	}
+	return [self memberForKey:CHBinaryTreeKeyForObject(keyPath, anObject)];
+}
+
+- (id)memberForKey:(id)aKey {
+	CHRaiseInvalidArgumentExceptionIfNil(aKey);
+	CHComparison localComparison = keyOrdering;
+	CHBinaryTreePrefix_DECLARE(aKey);
+	CHBinaryTreeNode *current = CHBinaryTreeFindNode(header->right, aKey, aPrefix, sentinel, &localComparison);
 	return (current != sentinel) ? current->object : nil;
 }
 
+// The members are gathered in the same buffer as the objects searched for.
+- (NSArray *)membersOfObjects:(NSArray *)anArray {
+	CHRaiseInvalidArgumentExceptionIfNil(anArray);
+	NSUInteger objectCount = [anArray count];
+	CHBinaryTreeNode **nodes = malloc(kCHPointerSize * objectCount * 2);
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) (nodes + objectCount);
+	[anArray getObjects:objects range:NSMakeRange(0, objectCount)];
+	[self _getNodes:nodes forObjects:objects count:objectCount];
+	NSNull *notFound = [NSNull null];
+	for (NSUInteger i = 0; i < objectCount; i++) {
+		objects[i] = (nodes[i] != sentinel) ? nodes[i]->object : notFound;
+	}
+	NSArray *members = [NSArray arrayWithObjects:objects count:objectCount];
+	free(nodes);
+	return members;
+}
+
+- (void)minusSortedSet:(id<CHSortedSet>)otherSortedSet {
+	[self _combineWithSortedSet:otherSortedSet operation:CHSortedMergeDifference];
+}
+
+- (id)objectAtIndex:(NSUInteger)index {
+	CHRaiseIndexOutOfRangeExceptionIf(index, >=, count);
+	CHBinaryTreeNode *current;
+	if (!tracksSubtreeSizes) {
+		// Step from whichever end of the tree is nearer.
+		BOOL descending = (index >= count / 2);
+		NSUInteger steps = descending ? count - 1 - index : index;
+		current = CHBinaryTreeFirstNode(header->right, descending, sentinel);
+		while (steps-- > 0) {
+			current = CHBinaryTreeNextNode(current, descending, header, sentinel);
+		}
+		return current->object;
+	}
+	current = header->right;
+	while (index != current->left->size) {
+		if (index < current->left->size) {
+			current = current->left;
+		} else {
+			index -= current->left->size + 1;
+			current = current->right;
+		}
+	}
+	return current->object;
+}
+
+- (id)objectAfter:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:NO];
+}
+
+- (id)objectBefore:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:NO];
+}
+
 - (NSEnumerator *)objectEnumerator {
 	return [self objectEnumeratorWithTraversalOrder:CHTraversalOrderAscending];
 }
 
+// A view of everything from anObject onward descends straight to its ceiling.
+- (NSEnumerator *)objectEnumeratorFromObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	return [[self subsetViewFromObject:anObject toObject:nil options:0] objectEnumerator];
+}
+
 - (NSEnumerator *)objectEnumeratorWithTraversalOrder:(CHTraversalOrder)order {
 	return [[[CHBinarySearchTreeEnumerator alloc]
 			 initWithTree:self
-	                 root:header->right
+	               header:header
 	             sentinel:sentinel
 	       traversalOrder:order
 	      mutationPointer:&mutations] autorelease];
@@ -506,45 +2048,56 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 
 // Doesn't call -[NSGarbageCollector collectIfNeeded] -- lets the sender choose.
 - (void)removeAllObjects {
-	if (count == 0) {
-		return;
-	}
-	++mutations;
-	count = 0;
-	
-	// Remove each node from the tree and release the object it points to.
-	// Use pre-order (depth-first) traversal for simplicity and performance.
-	CHBinaryTreeStack_DECLARE();
-	CHBinaryTreeStack_INIT();
-	CHBinaryTreeStack_PUSH(header->right);
-	
-	CHBinaryTreeNode *current;
-	while ((current = CHBinaryTreeStack_POP())) {
-		if (current->right != sentinel) {
-			CHBinaryTreeStack_PUSH(current->right);
-		}
-		if (current->left != sentinel) {
-			CHBinaryTreeStack_PUSH(current->left);
-		}
-		[current->object release];
-		free(current);
+	if (count > 0) {
+		++mutations;
+		count = 0;
+		header->right = sentinel; // With GC, this is sufficient to unroot the tree.
+		sentinel->object = nil; // Make sure we don't accidentally retain an object.
+		sentinel->key = nil;
 	}
-	CHBinaryTreeStack_FREE(stack);
-	header->right = sentinel; // With GC, this is sufficient to unroot the tree.
-	sentinel->object = nil; // Make sure we don't accidentally retain an object.
+	// Rather than traversing the tree, scan the slabs to release each object, and
+	// free the slabs wholesale. This also reclaims slabs left by -removeObject:.
+	CHBinaryTreeNodeSlabsFree(nodeSlabs);
+	nodeSlabs = NULL;
+	freeNodes = NULL;
 }
 
-// Incurs an extra search cost, but we don't know how the child class removes...
 - (void)removeFirstObject {
-	id object = [self firstObject];
-	if (object) { // Avoid removing nil
-		[self removeObject:object];
+	[self _removeObjectAtEnd:0];
+}
+
+// Once more than half the objects are to be removed, it's cheaper to rebuild the
+// tree from those that remain, in linear time, than to remove each one.
+- (NSArray *)removeFirstObjects:(NSUInteger)n {
+	n = MIN(n, count);
+	if (n == 0) {
+		return @[];
+	}
+	if (n > count / 2) {
+		NSArray *objects = [self allObjects];
+		NSUInteger remainingCount = count - n;
+		__unsafe_unretained id *remaining = (__unsafe_unretained id *) malloc(kCHPointerSize * remainingCount);
+		[objects getObjects:remaining range:NSMakeRange(n, remainingCount)];
+		[self removeAllObjects];
+		[self _buildTreeWithSortedObjects:remaining count:remainingCount];
+		free(remaining);
+		return [objects subarrayWithRange:NSMakeRange(0, n)];
 	}
+	NSMutableArray *objects = [NSMutableArray arrayWithCapacity:n];
+	while (n-- > 0) {
+		[objects addObject:CHBinaryTreeFirstNode(header->right, NO, sentinel)->object];
+		[self _removeObjectAtEnd:0];
+	}
+	return objects;
 }
 
-// Incurs an extra search cost, but we don't know how the child class removes...
 - (void)removeLastObject {
-	id object = [self lastObject];
+	[self _removeObjectAtEnd:1];
+}
+
+// Incurs an extra search cost, but we don't know how the child class removes...
+- (void)_removeObjectAtEnd:(NSUInteger)direction {
+	id object = direction ? [self lastObject] : [self firstObject];
 	if (object) { // Avoid removing nil
 		[self removeObject:object];
 	}
@@ -554,6 +2107,11 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 	return [self objectEnumeratorWithTraversalOrder:CHTraversalOrderDescending];
 }
 
+- (NSEnumerator *)reverseObjectEnumeratorFromObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	return [[self subsetViewFromObject:nil toObject:anObject options:0] reverseObjectEnumerator];
+}
+
 - (NSSet *)set {
 	NSMutableSet *set = [NSMutableSet new];
 	for (id anObject in [self objectEnumeratorWithTraversalOrder:CHTraversalOrderPreOrder]) {
@@ -569,67 +2127,36 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
  
  \link    CHSortedSet#subsetFromObject:toObject: \endlink
  
- \attention This implementation tests objects for membership in the subset according to their sorted order. This worst-case input causes more work for self-balancing trees, and subsets of unbalanced trees will always degenerate to linked lists.
+ \attention This implementation finds the objects in the subset using a range view (see #subsetViewFromObject:toObject:options:) in O(log n + k) time, then builds the subset from them directly in O(k) time, since they are already sorted.
  */
 - (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
 	// If both parameters are nil, return a copy containing all the objects.
 	if (start == nil && end == nil) {
 		return [[self copy] autorelease];
 	}
-	id<CHSortedSet> subset = [[[[self class] alloc] init] autorelease];
-	if (count == 0) {
-		return subset;
-	}
-	
-	NSEnumerator *e;
-	id anObject;
-	
-	if (start == nil) {
-		// Start from the first object and add until we pass the end parameter.
-		e = [self objectEnumeratorWithTraversalOrder:CHTraversalOrderAscending];
-		while ((anObject = [e nextObject]) && [anObject compare:end] != NSOrderedDescending) {
-			[subset addObject:anObject];
-		}
-	} else if (end == nil) {
-		// Start from the last object and add until we pass the start parameter.
-		e = [self objectEnumeratorWithTraversalOrder:CHTraversalOrderDescending];
-		while ((anObject = [e nextObject]) && [anObject compare:start] != NSOrderedAscending) {
-			[subset addObject:anObject];
-		}
-	} else {
-		if ([start compare:end] == NSOrderedAscending) {
-			// Include subset of objects between the range parameters.
-			e = [self objectEnumeratorWithTraversalOrder:CHTraversalOrderAscending];
-			while ((anObject = [e nextObject]) && [anObject compare:start] == NSOrderedAscending) {
-				;
-			}
-			if (anObject) {
-				do {
-					[subset addObject:anObject];
-				} while ((anObject = [e nextObject]) && [anObject compare:end] != NSOrderedDescending);
-			}
-		} else {
-			// Include subset of objects NOT between the range parameters.
-			e = [self objectEnumeratorWithTraversalOrder:CHTraversalOrderDescending];
-			while ((anObject = [e nextObject]) && [anObject compare:start] != NSOrderedAscending) {
-				[subset addObject:anObject];
-			}
-			e = [self objectEnumeratorWithTraversalOrder:CHTraversalOrderAscending];
-			while ((anObject = [e nextObject]) && [anObject compare:end] != NSOrderedDescending) {
-				[subset addObject:anObject];
-			}
-		}
-	}
-	// If the start and/or end value is to be excluded, remove before returning.
-	if (start && (options & CHSubsetConstructionExcludeLowEndpoint)) {
-		[subset removeObject:start];
-	}
-	if (end && (options & CHSubsetConstructionExcludeHighEndpoint)) {
-		[subset removeObject:end];
-	}
+	id<CHSortedSet> range = [self subsetViewFromObject:start toObject:end options:options];
+	id<CHSortedSet> subset = [[self _emptyCopyWithZone:nil] autorelease];
+	[subset addObjectsFromArray:[range allObjects]];
 	return subset;
 }
 
+- (id<CHSortedSet>)subsetViewFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	return [[[CHBinarySearchTreeRange alloc]
+	         initWithTree:self
+	               header:header
+	             sentinel:sentinel
+	           fromObject:start
+	             toObject:end
+	              options:options
+	             ordering:keyOrdering
+	              keyPath:keyPath
+	      mutationPointer:&mutations] autorelease];
+}
+
+- (void)unionWithSortedSet:(id<CHSortedSet>)otherSortedSet {
+	[self _combineWithSortedSet:otherSortedSet operation:CHSortedMergeUnion];
+}
+
 
 - (NSString *)debugDescription {
 	NSMutableString *description = [NSMutableString stringWithFormat:
@@ -638,7 +2165,6 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 	CHBinaryTreeStack_DECLARE();
 	CHBinaryTreeStack_INIT();
 	
-	sentinel->object = nil;
 	if (header->right != sentinel) {
 		CHBinaryTreeStack_PUSH(header->right);
 	}
@@ -652,7 +2178,8 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 		// Append entry for the current node, including children
 		[description appendFormat:@"\t%@ -> \"%@\" and \"%@\"\n",
 		 [self debugDescriptionForNode:current],
-		 current->left->object, current->right->object];
+		 (current->left != sentinel) ? current->left->object : nil,
+		 (current->right != sentinel) ? current->right->object : nil];
 	}
 	CHBinaryTreeStack_FREE(stack);
 	[description appendString:@"}"];
@@ -673,7 +2200,6 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 	} else {
 		NSString *leftChild, *rightChild;
 		NSUInteger sentinelCount = 0;
-		sentinel->object = nil;
 		
 		CHBinaryTreeNode *current;
 		CHBinaryTreeStack_DECLARE();
@@ -690,10 +2216,10 @@ size_t kCHBinaryTreeNodeSize = sizeof(CHBinaryTreeNode);
 			// Append entry for node with any subclass-specific customizations.
 			[graph appendString:[self dotGraphStringForNode:current]];
 			// Append entry for edges from current node to both its children.
-			leftChild = (current->left->object == nil)
+			leftChild = (current->left == sentinel)
 				? [NSString stringWithFormat:@"nil%lu", ++sentinelCount]
 				: [NSString stringWithFormat:@"\"%@\"", current->left->object];
-			rightChild = (current->right->object == nil)
+			rightChild = (current->right == sentinel)
 				? [NSString stringWithFormat:@"nil%lu", ++sentinelCount]
 				: [NSString stringWithFormat:@"\"%@\"", current->right->object];
 			[graph appendFormat:@"  \"%@\" -> {%@;%@};\n",
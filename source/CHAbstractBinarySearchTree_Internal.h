@@ -15,7 +15,7 @@ NS_ASSUME_NONNULL_BEGIN
  
  This file is a private header that is only used by internal implementations, and is not included in the the compiled framework. The macros and variables are to be considered private and unsupported.
  
- Memory for stacks and queues is (re)allocated using NSScannedOption, since (if garbage collection is enabled) the nodes which may be placed in a stack or queue are known to the garbage collector. (If garbage collection is @b not enabled, the macros explicitly free the allocated memory.) We assume that a stack or queue will not outlive the nodes it contains, since they are only used in connection with an active tree (usually during insertion, removal or iteration). An enumerator may contain a stack or queue, but also retains the underlying collection, so correct retain-release calls will not leak.
+ Stacks start out in a fixed-size buffer on the C stack, which is large enough for any path through a balanced tree, and only move to the heap if they outgrow it. Memory for queues (and stacks that outgrow their buffers) is (re)allocated using NSScannedOption, since (if garbage collection is enabled) the nodes which may be placed in a stack or queue are known to the garbage collector. (If garbage collection is @b not enabled, the macros explicitly free the allocated memory.) We assume that a stack or queue will not outlive the nodes it contains, since they are only used in connection with an active tree (usually during insertion, removal or iteration). An enumerator may contain a stack or queue, but also retains the underlying collection, so correct retain-release calls will not leak.
  */
 
 @interface CHAbstractBinarySearchTree ()
@@ -24,10 +24,80 @@ NS_ASSUME_NONNULL_BEGIN
  Convenience method for allocating a new CHBinaryTreeNode. This centralizes the allocation so all subclasses can be sure they're allocating nodes correctly. Explicitly sets the "extra" field used by self-balancing trees to zero. Also sets both @c left and @c right to the value of @c sentinel.
  
  @param object The value to be stored in the @a object field of the struct; may be @c nil.
- @return An struct allocated with @c malloc().
+ @return A node taken from the receiver's free list. (A new slab is allocated if the free list is empty.) The node must be returned with #CHBinaryTreeNode_FREE rather than @c free().
  */
 - (CHBinaryTreeNode *)_createNodeWithObject:(nullable id)object;
 
+/**
+ Allocates a new CHBinaryTreeNode as #_createNodeWithObject: does, for an object whose key has already been found (by a search for the place to insert it, for example), so that the key path isn't evaluated again.
+ 
+ @param object The value to be stored in the @a object field of the struct.
+ @param key The key of @a object, as returned by CHBinaryTreeKeyForObject(). It is retained if it isn't @a object itself.
+ @return A node taken from the receiver's free list.
+ */
+- (CHBinaryTreeNode *)_createNodeWithObject:(id)object key:(id)key;
+
+/**
+ Populates an empty tree with a perfectly balanced arrangement of objects in linear time, without any comparisons. Each object is retained. Nodes are created in pre-order, and #_balanceBuiltNode:count:depth:height: is called for each one so subclasses can initialize their balancing data.
+ 
+ @param objects A C array of objects in strictly ascending order.
+ @param objectCount The number of objects in @a objects.
+ 
+ @warning The receiver must be empty, and @a objects must be sorted with no duplicates, or the tree will be invalid.
+ */
+- (void)_buildTreeWithSortedObjects:(__unsafe_unretained id *)objects count:(NSUInteger)objectCount;
+
+/**
+ Builds a perfectly balanced subtree of objects in linear time, as #_buildTreeWithSortedObjects:count: does for a whole tree. Each object is retained, and the @a size of each node is set. The caller must link the returned node to its parent, and update the count if necessary.
+
+ @param objects A C array of objects in strictly ascending order.
+ @param subtreeCount The number of objects in @a objects.
+ @param depth The depth at which the subtree will be placed in the tree.
+ @param height The number of levels in the tree being built.
+ @return The root of the new subtree, or the sentinel if @a subtreeCount is 0.
+ */
+- (CHBinaryTreeNode *)_subtreeWithSortedObjects:(__unsafe_unretained id *)objects
+                                          count:(NSUInteger)subtreeCount
+                                          depth:(NSUInteger)depth
+                                         height:(NSUInteger)height;
+
+/**
+ Sets any subclass-specific balancing data for a node created by #_buildTreeWithSortedObjects:count:. The default implementation does nothing.
+ 
+ @param node A node whose children have already been linked.
+ @param subtreeCount The number of nodes in the subtree rooted at @a node.
+ @param depth The depth of @a node in the tree; the root has a depth of 0.
+ @param height The number of levels in the tree being built.
+ */
+- (void)_balanceBuiltNode:(CHBinaryTreeNode *)node count:(NSUInteger)subtreeCount depth:(NSUInteger)depth height:(NSUInteger)height;
+
+/**
+ Removes the first or last object in the receiver, if it isn't empty. The default implementation gets the object from #firstObject or #lastObject and passes it to #removeObject:, which must search for it all over again. Subclasses whose removal can start from a node found by following links down one edge of the tree, with no comparisons, should override this.
+
+ @param direction 0 to remove the first object, or 1 to remove the last.
+ */
+- (void)_removeObjectAtEnd:(NSUInteger)direction;
+
+/**
+ Computes the @a size field of every node in a single O(n) pass, as when the receiver starts tracking subtree sizes. From then on, subclasses keep them current as they add and remove nodes, so positional queries take O(log n) time.
+ */
+- (void)_computeSubtreeSizes;
+
+/**
+ Creates an empty tree of the same class as the receiver, which orders objects in the same way. This is used for copies and subsets of the receiver.
+ 
+ @param zone The zone from which to allocate the tree, or @c nil for the default zone.
+ @return A new (not autoreleased) tree that uses the receiver's comparator or comparison function, if any.
+ */
+- (instancetype)_emptyCopyWithZone:(nullable NSZone *)zone;
+
+/**
+ Raises an exception if the receiver uses a comparator or comparison function, since neither can be archived.
+ 
+ @throw NSInvalidArgumentException if the receiver doesn't order objects using @c -compare:.
+ */
+- (void)_checkOrderingCanBeEncoded;
+
 // NOTE: Subclasses should override the following methods to display any algorithm-specific information (such as the extra field used by self-balancing trees) in debugging output and generated DOT graphs.
 
 // This method determines the appearance of nodes in the graph produced by -debugDescription, and may be overriden by subclasses. The default implementation returns the -description for the object in the node, surrounded by quote marks.
@@ -42,30 +112,392 @@ NS_ASSUME_NONNULL_BEGIN
 
 // These are used by subclasses; marked as HIDDEN to reduce external visibility.
 HIDDEN FOUNDATION_EXTERN size_t kCHBinaryTreeNodeSize;
+HIDDEN FOUNDATION_EXTERN size_t kCHBinaryTreePrefixedNodeSize; // A node followed by a key prefix.
+
+// Returns the height of a tree with n nodes when every level except the lowest
+// is full, as is the case for trees built by -_buildTreeWithSortedObjects:count:
+static inline NSUInteger CHBinaryTreeHeightForCount(NSUInteger n) {
+	NSUInteger height = 0;
+	while (n > 0) {
+		n >>= 1;
+		height++;
+	}
+	return height;
+}
+
+// Returns a random treap priority for a node at the given depth of a tree built
+// all at once with the given height. Each level draws from a lower band than the
+// level above it, so every node outranks its children. (The top of the range is
+// left for CHTreapNotFound, the priority of the header.)
+static inline u_int32_t CHTreapPriorityForDepth(NSUInteger depth, NSUInteger height) {
+	u_int32_t bandWidth = (u_int32_t) (UINT32_MAX / height);
+	return (u_int32_t) (height - 1 - depth) * bandWidth + arc4random_uniform(bandWidth);
+}
+
+// Recomputes the size of a node's subtree from the sizes of its children. Since
+// a rotation doesn't change the size of the subtree it is applied to, this need
+// only be called for the rotated nodes, lowest first. (Rotations do this even if
+// sizes aren't being tracked; it's cheaper than checking, and harmless.)
+#define CHBinaryTreeNode_UPDATE_SIZE(node) \
+	((node)->size = (node)->left->size + (node)->right->size + 1)
+
+#pragma mark Parent links
+
+// Makes child the left (0) or right (1) child of node, and node its parent. All
+// changes to child links go through this, so parent links are always current.
+// (The sentinel may be passed as the child; its parent is never read.)
+static inline void CHBinaryTreeLinkChild(CHBinaryTreeNode *node, NSUInteger direction, CHBinaryTreeNode *child) {
+	node->link[direction] = child;
+	child->parent = node;
+}
+
+// Returns the first node in ascending order (or the last, if descending) of the
+// subtree rooted at node, which must not be the sentinel.
+static inline CHBinaryTreeNode *CHBinaryTreeFirstNode(CHBinaryTreeNode *node, BOOL descending, CHBinaryTreeNode *sentinel) {
+	while (node->link[descending] != sentinel) {
+		node = node->link[descending];
+	}
+	return node;
+}
+
+// Returns the node after node in ascending order (or before it, if descending),
+// or the header if there is none. Stepping through all n nodes this way visits
+// each link at most twice, so each step takes amortized O(1) time.
+static inline CHBinaryTreeNode *CHBinaryTreeNextNode(CHBinaryTreeNode *node, BOOL descending, CHBinaryTreeNode *header, CHBinaryTreeNode *sentinel) {
+	if (node->link[!descending] != sentinel) {
+		return CHBinaryTreeFirstNode(node->link[!descending], descending, sentinel);
+	}
+	// Climb until arriving from the near side; the root is the header's right
+	// child, so the header must be checked for explicitly.
+	CHBinaryTreeNode *parent = node->parent;
+	while (parent != header && parent->link[!descending] == node) {
+		node = parent;
+		parent = parent->parent;
+	}
+	return parent;
+}
+
+#pragma mark Comparison macros
+
+// Returns the key by which a tree orders anObject: its value for the tree's key
+// path, or the object itself if the tree has none. A nil value can't be ordered.
+static inline id CHBinaryTreeKeyForObject(NSString * _Nullable keyPath, id anObject) {
+	if (keyPath == nil) {
+		return anObject;
+	}
+	id key = [anObject valueForKeyPath:keyPath];
+	if (key == nil) {
+		CHRaiseInvalidArgumentException(([NSString stringWithFormat:@"Object has a nil value for key path \"%@\"", keyPath]));
+	}
+	return key;
+}
+
+// Returns a 64-bit number whose order matches the order in which -compare:
+// places aKey among other keys, or 0 if there is no such number. Prefixes are
+// only meaningful in trees whose keys are compared with -compare: (ascending).
+//
+// For an NSString, this is its first 8 characters, if they (or all of it, if it
+// is shorter) are ASCII characters other than NUL, in big-endian order and
+// padded with zeroes; ASCII strings are ordered by their character codes, and a
+// string that ends first is smaller. Any other character could be canonically
+// equivalent to a different sequence, so a string with one in its first 8
+// characters has no prefix. For an NSNumber, it is the bits of its double value,
+// rearranged so that they are ordered as unsigned integers; rounding to a double
+// may make different numbers equal, but never reverses their order.
+static inline u_int64_t CHBinaryTreePrefixForKey(id aKey) {
+	u_int64_t prefix = 0;
+	if ([aKey isKindOfClass:[NSString class]]) {
+		NSUInteger length = MIN([aKey length], sizeof(prefix));
+		uint8_t bytes[sizeof(prefix)];
+		NSUInteger usedLength = 0;
+		[aKey getBytes:bytes maxLength:length usedLength:&usedLength encoding:NSASCIIStringEncoding
+		       options:0 range:NSMakeRange(0, length) remainingRange:NULL];
+		if (usedLength < length) {
+			return 0;
+		}
+		for (NSUInteger i = 0; i < sizeof(prefix); i++) {
+			if (i < length && bytes[i] == 0) {
+				return 0;
+			}
+			prefix = (prefix << 8) | ((i < length) ? bytes[i] : 0);
+		}
+	} else if ([aKey isKindOfClass:[NSNumber class]]) {
+		double value = [aKey doubleValue];
+		if (value != value) {
+			return 0; // NaN isn't ordered.
+		}
+		if (value == 0) {
+			value = 0; // -0.0 is equal to 0.0
+		}
+		memcpy(&prefix, &value, sizeof(prefix));
+		prefix = (prefix >> 63) ? ~prefix : (prefix | (1ULL << 63));
+	}
+	return prefix;
+}
+
+// Declares aPrefix, the prefix of aKey, or 0 if the tree doesn't cache prefixes.
+#define CHBinaryTreePrefix_DECLARE(aKey) \
+	u_int64_t aPrefix = cachesKeyPrefixes ? CHBinaryTreePrefixForKey(aKey) : 0
+
+// Declares aKey, the key of anObject, for comparing to the keys in nodes, and
+// its prefix. Both are found once per operation, however many nodes are
+// compared to them.
+#define CHBinaryTreeKey_DECLARE(anObject) \
+	__unsafe_unretained id aKey = CHBinaryTreeKeyForObject(keyPath, (anObject)); \
+	CHBinaryTreePrefix_DECLARE(aKey)
+
+// Returns the key prefix that follows a node in a tree that caches key prefixes.
+// Other trees' nodes have no room for one, so it must not be used for them.
+static inline u_int64_t *CHBinaryTreeNodePrefix(CHBinaryTreeNode *node) {
+	return (u_int64_t *) (node + 1);
+}
+
+// Stores an object and its key in a node in place of the ones it holds. A key
+// that isn't the object itself is retained (and the old one released), but the
+// caller is responsible for retaining and releasing the objects.
+static inline void CHBinaryTreeNodeSetObject(CHBinaryTreeNode *node, id object, id key) {
+	if (key != object) {
+		[key retain];
+	}
+	if (node->key != node->object) {
+		[node->key release];
+	}
+	node->object = object;
+	node->key = key;
+}
+
+// Moves the object in donor (with its key and any key prefix) to node, as when
+// removing a node with two children. The donor must then be freed.
+#define CHBinaryTreeNode_TAKE_OBJECT(node, donor) { \
+	CHBinaryTreeNodeSetObject((node), (donor)->object, (donor)->key); \
+	if (cachesKeyPrefixes) { \
+		*CHBinaryTreeNodePrefix(node) = *CHBinaryTreeNodePrefix(donor); \
+	} \
+}
+
+// Compares the key in a node to aKey. If aPrefix isn't 0 (so the tree caches
+// prefixes) and the node has a different prefix, the prefixes decide, and the
+// keys aren't touched; otherwise the keys themselves are compared. The header
+// and sentinel have no prefix, so the search for a target stored in the
+// sentinel still stops there.
+static inline NSComparisonResult CHBinaryTreeCompareNodeToKey(CHComparison *comparison, CHBinaryTreeNode *node, id aKey, u_int64_t aPrefix) {
+	if (aPrefix != 0) {
+		u_int64_t prefix = *CHBinaryTreeNodePrefix(node);
+		if (prefix != 0 && prefix != aPrefix) {
+			return (prefix < aPrefix) ? NSOrderedAscending : NSOrderedDescending;
+		}
+	}
+	return CHComparisonCompare(comparison, node->key, aKey);
+}
+
+// Compares the key in a node to aKey in a tree's order. The header node is less
+// than everything, and its key is never passed to a comparator.
+static inline NSComparisonResult CHBinaryTreeCompareNode(CHComparison *comparison, id headerObject, CHBinaryTreeNode *node, id aKey, u_int64_t aPrefix) {
+	return (node->key == headerObject) ? NSOrderedAscending : CHBinaryTreeCompareNodeToKey(comparison, node, aKey, aPrefix);
+}
+
+// Makes local copies of the tree's key ordering and header object for use with
+// CHBinaryTreeCompare(), which compares the key in a node to aKey and aPrefix
+// (see CHBinaryTreeKey_DECLARE). Each operation declares its own, so that
+// -compare: is looked up once per operation and then called directly.
+#define CHBinaryTreeComparison_DECLARE() \
+	CHComparison localComparison = keyOrdering; \
+	__unsafe_unretained id headerObject = header->key
+
+#define CHBinaryTreeCompare(node, aKey) \
+	CHBinaryTreeCompareNode(&localComparison, headerObject, (node), (aKey), aPrefix)
+
+#pragma mark Insertion finger
+
+// Returns whether node is on the right spine (the path from the header to the
+// greatest node), which is the case for a new leaf that is the greatest node.
+static inline BOOL CHBinaryTreeNodeIsOnRightSpine(CHBinaryTreeNode *node, CHBinaryTreeNode *header) {
+	for (; node != header; node = node->parent) {
+		if (node->parent->right != node) {
+			return NO;
+		}
+	}
+	return YES;
+}
+
+// Returns how many nodes at the top of the right spine are less than aKey,
+// so that a search for the place to insert it can go right past them without
+// comparing. The spine is in ascending order from the root down, so these are
+// found by climbing it from the bottom, which takes one comparison to append an
+// object and a few more for one that belongs near the end. This is only done
+// while insertsNearEnd is YES; it is cleared if the climb covers more than half
+// the spine, since descending from the root would have cost fewer comparisons.
+static inline NSUInteger CHBinaryTreeFingerSteps(CHBinaryTreeNode *header, CHBinaryTreeNode *sentinel, id aKey, u_int64_t aPrefix, CHComparison *comparison, BOOL *insertsNearEnd) {
+	if (!*insertsNearEnd || header->right == sentinel) {
+		return 0;
+	}
+	NSUInteger spineLength = 0, climbed = 0;
+	CHBinaryTreeNode *node = header;
+	while (node->right != sentinel) {
+		node = node->right;
+		spineLength++;
+	}
+	while (node != header && CHBinaryTreeCompareNodeToKey(comparison, node, aKey, aPrefix) != NSOrderedAscending) {
+		node = node->parent;
+		climbed++;
+	}
+	if (climbed * 2 > spineLength) {
+		*insertsNearEnd = NO;
+	}
+	return spineLength - climbed;
+}
+
+// Declares fingerSteps for CHBinaryTreeFingerCompare(), once the comparison has
+// been declared with CHBinaryTreeComparison_DECLARE().
+#define CHBinaryTreeFinger_DECLARE(aKey) \
+	NSUInteger fingerSteps = CHBinaryTreeFingerSteps(header, sentinel, (aKey), aPrefix, &localComparison, &insertsNearEnd)
+
+// Compares like CHBinaryTreeCompare() in a search that goes down the right spine
+// from the header, except that the first fingerSteps nodes below the header are
+// taken to be less than aKey without comparing them. If a search restructures the
+// spine as it goes, it must revisit nodes rather than skip any, so that it runs
+// out of steps before passing the last of these nodes.
+#define CHBinaryTreeFingerCompare(node, aKey) \
+	((fingerSteps > 0 && (node)->key != headerObject) ? (fingerSteps--, NSOrderedAscending) : CHBinaryTreeCompare(node, aKey))
+
+// Sets insertsNearEnd once a new leaf is the greatest node, so the insertions
+// after it start at the end of the tree for as long as it keeps growing there.
+#define CHBinaryTreeFinger_NOTE_LEAF(node) { \
+	if (!insertsNearEnd) { \
+		insertsNearEnd = CHBinaryTreeNodeIsOnRightSpine((node), header); \
+	} \
+}
+
+// Returns the node whose key is equal to aKey, or the sentinel if there is none.
+// Methods that modify a tree store the target in the sentinel so the search loop
+// needn't check for it, but this one checks instead, so it writes no shared
+// state, and any number of threads can search a tree at once.
+static inline CHBinaryTreeNode *CHBinaryTreeFindNode(CHBinaryTreeNode *root, id aKey, u_int64_t aPrefix, CHBinaryTreeNode *sentinel, CHComparison *comparison) {
+	CHBinaryTreeNode *current = root;
+	NSComparisonResult result;
+	while (current != sentinel && (result = CHBinaryTreeCompareNodeToKey(comparison, current, aKey, aPrefix))) {
+		current = current->link[result == NSOrderedAscending]; // R on YES
+	}
+	return current;
+}
+
+// Returns the node whose key is nearest to aKey on one side of it (below it if
+// direction is 0, above it if 1), or the sentinel if there is none. If inclusive
+// is YES, a node whose key is equal to aKey is returned instead. A single
+// descent suffices, since each node on the side sought is nearer than the last
+// one passed, and like CHBinaryTreeFindNode(), it writes no shared state.
+static inline CHBinaryTreeNode *CHBinaryTreeFindNearestNode(CHBinaryTreeNode *root, id aKey, u_int64_t aPrefix, NSUInteger direction, BOOL inclusive, CHBinaryTreeNode *sentinel, CHComparison *comparison) {
+	CHBinaryTreeNode *nearest = sentinel, *current = root;
+	NSComparisonResult beyond = direction ? NSOrderedDescending : NSOrderedAscending;
+	while (current != sentinel) {
+		NSComparisonResult result = CHBinaryTreeCompareNodeToKey(comparison, current, aKey, aPrefix);
+		if (result == NSOrderedSame && inclusive) {
+			return current;
+		}
+		if (result == beyond) {
+			nearest = current;
+			current = current->link[!direction];
+		} else {
+			current = current->link[direction];
+		}
+	}
+	return nearest;
+}
+
+// Adds delta to the size of node and each of its ancestors below the header,
+// climbing by parent links rather than searching down from the root.
+static inline void CHBinaryTreeAdjustSizesToRoot(CHBinaryTreeNode *node, CHBinaryTreeNode *header, int32_t delta) {
+	for (; node != header; node = node->parent) {
+		node->size += delta;
+	}
+}
+
+#pragma mark Node allocation
+
+/**
+ A contiguous block of nodes owned by a single tree. Slabs are chained together, newest first, and each is twice the size of the last (up to a fixed limit) so that small trees stay small and large trees need few allocations. (After \link CHAbstractBinarySearchTree#compact -compact\endlink, a tree has a single slab that holds exactly its nodes.) Every node in a slab is either in use in the tree or on the tree's free list, where it is marked by a @c nil object.
+ */
+typedef struct CHBinaryTreeNodeSlab {
+	struct CHBinaryTreeNodeSlab *next; // The slab allocated before this one.
+	NSUInteger capacity; // The number of nodes in this slab.
+	size_t nodeSize; // The size of each node, including any key prefix.
+	CHBinaryTreeNode nodes[]; // The nodes themselves.
+} CHBinaryTreeNodeSlab;
+
+// Returns the node at an index in a slab. Nodes with key prefixes are larger
+// than a CHBinaryTreeNode, so the slab's node size is used instead of indexing.
+static inline CHBinaryTreeNode *CHBinaryTreeNodeSlabNode(CHBinaryTreeNodeSlab *slab, NSUInteger index) {
+	return (CHBinaryTreeNode *) ((char *) slab->nodes + index * slab->nodeSize);
+}
+
+// Returns a node to the free list, releasing its key if it was retained. The
+// object and key pointers are cleared so that slabs can be scanned without
+// knowing which nodes are in use. (Callers must release the object, or move it
+// to another node, before freeing the node.)
+#define CHBinaryTreeNode_FREE(node) { \
+	if ((node)->key != (node)->object) { \
+		[(node)->key release]; \
+	} \
+	(node)->object = nil; \
+	(node)->key = nil; \
+	(node)->right = freeNodes; \
+	freeNodes = (node); \
+}
 
 #pragma mark Stack macros
 
+// The number of nodes a stack holds before it moves to the heap. A red-black or
+// AA tree of n nodes is at most 2·log2(n+1) levels tall, and AVL trees are even
+// shorter, so this holds the path from the header to any node of any balanced
+// tree that fits in a 64-bit address space. Only unbalanced trees (and treaps,
+// with vanishingly small probability) ever outgrow it.
+#define kCHBinaryTreeStackInlineCapacity 128
+
+// A stack starts out in a buffer on the C stack, so that pushing and popping the
+// nodes along a search path doesn't allocate any memory.
 #define CHBinaryTreeStack_DECLARE() \
+	__strong CHBinaryTreeNode* stackBuffer[kCHBinaryTreeStackInlineCapacity]; \
 	__strong CHBinaryTreeNode** stack; \
 	NSUInteger stackCapacity, stackSize
 
 #define CHBinaryTreeStack_INIT() { \
-	stackCapacity = 32; \
-	stack = malloc(kCHBinaryTreeNodeSize * stackCapacity); \
+	stackCapacity = kCHBinaryTreeStackInlineCapacity; \
+	stack = stackBuffer; \
 	stackSize = 0; \
 }
 
 #define CHBinaryTreeStack_FREE(stack) { \
-	free(stack); \
+	if (stack != stackBuffer) { \
+		free(stack); \
+	} \
 	stack = NULL; \
 }
 
+// Doubles the capacity of a full stack, copying it to the heap if it was still
+// in its inline buffer.
+static inline CHBinaryTreeNode **CHBinaryTreeStackGrow(CHBinaryTreeNode **stack, CHBinaryTreeNode **inlineBuffer, NSUInteger capacity) {
+	if (stack == inlineBuffer) {
+		CHBinaryTreeNode **heapStack = malloc(kCHPointerSize * capacity * 2);
+		memcpy(heapStack, stack, kCHPointerSize * capacity);
+		return heapStack;
+	}
+	return realloc(stack, kCHPointerSize * capacity * 2);
+}
+
 // Since this stack starts at 0 and goes to N-1, resizing is pretty simple.
 #define CHBinaryTreeStack_PUSH(node) { \
 	stack[stackSize++] = node; \
 	if (stackSize >= stackCapacity) { \
+		stack = CHBinaryTreeStackGrow(stack, stackBuffer, stackCapacity); \
 		stackCapacity *= 2; \
-		stack = realloc(stack, kCHPointerSize * stackCapacity); \
+	} \
+}
+
+// Adds delta to the size of every node on the stack, such as when a node has
+// been added or removed below all of them.
+#define CHBinaryTreeStack_ADJUST_SIZES(delta) { \
+	for (NSUInteger i = 0; i < stackSize; i++) { \
+		stack[i]->size += (delta); \
 	} \
 }
 
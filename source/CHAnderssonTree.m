@@ -8,13 +8,17 @@
 #import <CHDataStructures/CHAnderssonTree.h>
 #import "CHAbstractBinarySearchTree_Internal.h"
 
-// Remove left horizontal links
+// Remove left horizontal links. The node rotated up takes the place of node,
+// including its parent link, since node may be an expression like x->right.
 #define skew(node) { \
 	if (node->left->level == node->level && node->level != 0) { \
 		CHBinaryTreeNode *save = node->left; \
-		node->left = save->right; \
-		save->right = node; \
+		save->parent = node->parent; \
+		CHBinaryTreeLinkChild(node, 0, save->right); \
+		CHBinaryTreeLinkChild(save, 1, node); \
+		CHBinaryTreeNode_UPDATE_SIZE(node); \
 		node = save; \
+		CHBinaryTreeNode_UPDATE_SIZE(node); \
 	} \
 }
 
@@ -22,9 +26,12 @@
 #define split(node) { \
 	if (node->right->right->level == node->level && node->level != 0) { \
 		CHBinaryTreeNode *save = node->right; \
-		node->right = save->left; \
-		save->left = node; \
+		save->parent = node->parent; \
+		CHBinaryTreeLinkChild(node, 1, save->left); \
+		CHBinaryTreeLinkChild(save, 0, node); \
+		CHBinaryTreeNode_UPDATE_SIZE(node); \
 		node = save; \
+		CHBinaryTreeNode_UPDATE_SIZE(node); \
 		++(node->level); \
 	} \
 }
@@ -38,14 +45,17 @@
 - (void)addObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeFinger_DECLARE(aKey);
 	
 	CHBinaryTreeNode *parent, *current = header;
 	CHBinaryTreeStack_DECLARE();
 	CHBinaryTreeStack_INIT();
 	
-	sentinel->object = anObject; // Assure that we find a spot to insert
+	sentinel->key = aKey; // Assure that we find a spot to insert
 	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
+	while ((comparison = CHBinaryTreeFingerCompare(current, aKey))) {
 		CHBinaryTreeStack_PUSH(current);
 		current = current->link[comparison == NSOrderedAscending]; // R on YES
 	}
@@ -54,18 +64,22 @@
 	if (current != sentinel) {
 		// Replace the existing object with the new object.
 		[current->object release];
-		current->object = anObject;
+		CHBinaryTreeNodeSetObject(current, anObject, aKey);
 		// No need to rebalance up the path since we didn't modify the structure
 		goto done;
 	} else {
-		current = [self _createNodeWithObject:anObject];
+		current = [self _createNodeWithObject:anObject key:aKey];
 		current->level  = 1;
 		++count;
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeStack_ADJUST_SIZES(+1);
+		}
 		// Link from parent as the proper child, based on last comparison
 		parent = CHBinaryTreeStack_POP();
 		NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
-		comparison = [parent->object compare:anObject];
-		parent->link[comparison == NSOrderedAscending] = current; // R if YES
+		comparison = CHBinaryTreeCompare(parent, aKey);
+		CHBinaryTreeLinkChild(parent, comparison == NSOrderedAscending, current); // R if YES
+		CHBinaryTreeFinger_NOTE_LEAF(current);
 	}
 	
 	// Trace back up the path, rebalancing as we go
@@ -74,7 +88,7 @@
 		isRightChild = (parent->right == current);
 		skew(current);
 		split(current);
-		parent->link[isRightChild] = current;
+		CHBinaryTreeLinkChild(parent, isRightChild, current);
 		// Move to the next node up the path to the root
 		current = parent;
 		parent = CHBinaryTreeStack_POP();
@@ -85,24 +99,46 @@ done:
 
 - (void)removeObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self _removeObject:anObject orObjectAtEnd:0];
+}
+
+- (void)_removeObjectAtEnd:(NSUInteger)direction {
+	[self _removeObject:nil orObjectAtEnd:direction];
+}
+
+// Removes anObject or, if it is nil, the first (0) or last (1) object, which is
+// found by following links rather than by comparing objects.
+- (void)_removeObject:(id)anObject orObjectAtEnd:(NSUInteger)direction {
 	if (count == 0) {
 		return;
 	}
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
 	
 	CHBinaryTreeNode *parent, *current = header;
 	CHBinaryTreeStack_DECLARE();
 	CHBinaryTreeStack_INIT();
 	
-	sentinel->object = anObject; // Assure that we stop at a leaf if not found.
-	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
-		CHBinaryTreeStack_PUSH(current);
-		current = current->link[comparison == NSOrderedAscending]; // R on YES
-	}
-	// Exit if the specified node was not found in the tree.
-	if (current == sentinel) {
-		goto done;
+	if (anObject == nil) {
+		// The node at the end has no child in that direction.
+		CHBinaryTreeStack_PUSH(header);
+		current = header->right;
+		while (current->link[direction] != sentinel) {
+			CHBinaryTreeStack_PUSH(current);
+			current = current->link[direction];
+		}
+	} else {
+		CHBinaryTreeKey_DECLARE(anObject);
+		sentinel->key = aKey; // Assure that we stop at a leaf if not found.
+		NSComparisonResult comparison;
+		while ((comparison = CHBinaryTreeCompare(current, aKey))) {
+			CHBinaryTreeStack_PUSH(current);
+			current = current->link[comparison == NSOrderedAscending]; // R on YES
+		}
+		// Exit if the specified node was not found in the tree.
+		if (current == sentinel) {
+			goto done;
+		}
 	}
 	
 	[current->object release]; // Object must be released in any case
@@ -111,8 +147,8 @@ done:
 		// Single/zero child case -- replace node with non-nil child (if exists)
 		parent = CHBinaryTreeStack_TOP;
 		NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
-		parent->link[parent->right == current] = current->link[current->left == sentinel];
-		free(current);
+		CHBinaryTreeLinkChild(parent, parent->right == current, current->link[current->left == sentinel]);
+		CHBinaryTreeNode_FREE(current);
 	} else {
 		// Two child case -- replace with minimum object in right subtree
 		CHBinaryTreeStack_PUSH(current); // Need to start here when rebalancing
@@ -123,9 +159,12 @@ done:
 		}
 		parent = CHBinaryTreeStack_TOP;
 		// Grab object from replacement node, steal its right child, deallocate
-		current->object = replacement->object;
-		parent->link[parent->right == replacement] = replacement->right;
-		free(replacement);
+		CHBinaryTreeNode_TAKE_OBJECT(current, replacement);
+		CHBinaryTreeLinkChild(parent, parent->right == replacement, replacement->right);
+		CHBinaryTreeNode_FREE(replacement);
+	}
+	if (tracksSubtreeSizes) {
+		CHBinaryTreeStack_ADJUST_SIZES(-1);
 	}
 	
 	// Walk back up the path and rebalance as we go
@@ -149,12 +188,19 @@ done:
 			split(current);
 			split(current->right);
 		}
-		parent->link[isRightChild] = current;
+		CHBinaryTreeLinkChild(parent, isRightChild, current);
 	}
 done:
 	CHBinaryTreeStack_FREE(stack);
 }
 
+- (void)_balanceBuiltNode:(CHBinaryTreeNode *)node count:(NSUInteger)subtreeCount depth:(NSUInteger)depth height:(NSUInteger)height {
+	// The level is the number of full levels in the subtree, floor(log2(n+1)).
+	// Left children are always one level lower, and since the right subtree is
+	// never smaller, only right links can be horizontal (and never two in a row).
+	node->level = (u_int32_t) (CHBinaryTreeHeightForCount(subtreeCount + 1) - 1);
+}
+
 - (NSString *)debugDescriptionForNode:(CHBinaryTreeNode *)node {
 	return [NSString stringWithFormat:@"[%d]\t\"%@\"", node->level, node->object];
 }
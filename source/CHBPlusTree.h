@@ -0,0 +1,70 @@
+//
+//  CHBPlusTree.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHSearchTree.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHBPlusTree.h
+ A <a href="http://en.wikipedia.org/wiki/B%2B_tree">B+ tree</a> implementation of CHSearchTree.
+ */
+
+struct CHBPlusTreeNode; // Defined in CHBPlusTree.m
+
+/**
+ A <a href="http://en.wikipedia.org/wiki/B%2B_tree">B+ tree</a>, a balanced N-ary search tree in which every leaf is at the same depth. Each node holds a sorted array of up to (fanout - 1) objects, and each interior node has one more child than it has objects. Every node except the root is kept at least half full by splitting nodes that overflow and by refilling or merging nodes that underflow, so the height of a tree of n objects is O(log n / log fanout). Insertion, removal, and search all take O(log n) time, and need far fewer nodes (and thus cache misses) than a binary tree, since each node is searched with a binary search over a contiguous array.
+
+ Every object is stored in a leaf, and the leaves are linked to their neighbors in sorted order, so an ascending or descending traversal simply walks from leaf to leaf without a stack, and fast enumeration returns the contents of a whole leaf at a time without copying them. An interior node holds the first object of each of its children except the first, which separates that child from its left sibling. Thus, apart from the first object in the tree, the first object in each leaf also appears in exactly one interior node.
+
+ For pre-order, post-order, and level-order traversals, each object is visited only once: at the highest node in which it appears. Within a node, objects are visited in ascending order, as are its children. For example, a tree of the objects A through G with a fanout of 3 might have D in its root, B and F in the next level, and A, BC, DE, and FG in its leaves, in which case a pre-order traversal is <code>D B A C F E G</code> and a level-order traversal is <code>D B F A C E G</code>.
+
+ Objects are ordered by their @c -compare: method, which (as in CHAbstractBinarySearchTree) is looked up once per operation and then called directly.
+ */
+@interface CHBPlusTree<__covariant ObjectType> : NSObject <CHSearchTree>
+{
+	struct CHBPlusTreeNode *root; // The root of the tree, or NULL if empty.
+	NSUInteger height; // The number of levels in the tree, including leaves.
+	NSUInteger capacity; // The maximum number of objects in a node.
+	NSUInteger count; // The number of objects currently in the tree.
+	unsigned long mutations; // Tracks mutations for NSFastEnumeration.
+}
+
+/**
+ Initialize an empty B+ tree whose nodes have a given fanout.
+
+ @param fanout The maximum number of children of each interior node, which is one more than the maximum number of objects in any node. Must be at least 3.
+ @return An initialized B+ tree that contains no objects.
+
+ @throw NSInvalidArgumentException if @a fanout is less than 3.
+
+ @see fanout
+ */
+- (instancetype)initWithFanout:(NSUInteger)fanout NS_DESIGNATED_INITIALIZER;
+
+/**
+ Initialize a B+ tree with the default fanout and the contents of an array.
+
+ Rather than adding each object in turn, the array is sorted (unless it is already in ascending order) and the tree is built from the leaves up in linear time. If several objects in the array compare as equal, only the one occurring last in @a anArray is kept, just as if each had been added with \link #addObject: -addObject:\endlink.
+
+ @param anArray An array containing objects with which to populate a new B+ tree.
+ @return An initialized B+ tree that contains the objects in @a anArray in sorted order.
+ */
+- (instancetype)initWithArray:(NSArray<ObjectType> *)anArray;
+
+/**
+ Returns the fanout of the receiver's nodes.
+
+ @return The maximum number of children of each interior node in the receiver. The default is 32.
+
+ @see initWithFanout:
+ */
+- (NSUInteger)fanout;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,988 @@
+//
+//  CHBPlusTree.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHBPlusTree.h>
+
+#define kCHBPlusTreeDefaultFanout 32
+
+// Every interior node but the root has at least 2 children, so no tree that
+// fits in memory can be this tall.
+#define kCHBPlusTreeMaximumHeight 64
+
+#pragma mark Nodes
+
+/**
+ A node in a CHBPlusTree. The objects in a leaf are the contents of the tree, and are retained by it. In an interior node, @a objects[i] is the first object in the subtree @a children[i+1], and isn't retained again. Nodes are allocated with room for as many objects as the tree's capacity, followed (for interior nodes) by one more child pointer than that, to which @a children points.
+ */
+typedef struct CHBPlusTreeNode {
+	uint32_t count; ///< The number of objects in the node.
+	uint32_t isLeaf; ///< Whether the node is a leaf.
+	struct CHBPlusTreeNode *previous; ///< For a leaf, the leaf with the next smaller objects.
+	struct CHBPlusTreeNode *next; ///< For a leaf, the leaf with the next larger objects.
+	struct CHBPlusTreeNode **children; ///< For an interior node, its subtrees.
+	__unsafe_unretained id objects[]; ///< The objects in the node, in ascending order.
+} CHBPlusTreeNode;
+
+static CHBPlusTreeNode *CHBPlusTreeNodeCreate(NSUInteger capacity, BOOL isLeaf) {
+	size_t size = sizeof(CHBPlusTreeNode) + kCHPointerSize * capacity;
+	CHBPlusTreeNode *node = malloc(isLeaf ? size : size + kCHPointerSize * (capacity + 1));
+	node->count = 0;
+	node->isLeaf = isLeaf;
+	node->previous = NULL;
+	node->next = NULL;
+	node->children = isLeaf ? NULL : (CHBPlusTreeNode **)(node->objects + capacity);
+	return node;
+}
+
+// Frees a node and all the nodes below it, releasing the objects in the leaves.
+static void CHBPlusTreeNodeFree(CHBPlusTreeNode *node) {
+	if (node->isLeaf) {
+		for (NSUInteger i = 0; i < node->count; i++) {
+			[node->objects[i] release];
+		}
+	} else {
+		for (NSUInteger i = 0; i <= node->count; i++) {
+			CHBPlusTreeNodeFree(node->children[i]);
+		}
+	}
+	free(node);
+}
+
+// Returns the index of the first object in a node which isn't less than a given
+// object, and sets found to whether that object is equal to it.
+static inline NSUInteger CHBPlusTreeNodeSearch(CHBPlusTreeNode *node, id anObject, CHComparison *ordering, BOOL *found) {
+	NSUInteger low = 0, high = node->count;
+	while (low < high) {
+		NSUInteger middle = (low + high) / 2;
+		NSComparisonResult comparison = CHComparisonCompare(ordering, node->objects[middle], anObject);
+		if (comparison == NSOrderedAscending) {
+			low = middle + 1;
+		} else if (comparison == NSOrderedDescending) {
+			high = middle;
+		} else {
+			*found = YES;
+			return middle;
+		}
+	}
+	*found = NO;
+	return low;
+}
+
+static inline CHBPlusTreeNode *CHBPlusTreeFirstLeaf(CHBPlusTreeNode *node) {
+	while (!node->isLeaf) {
+		node = node->children[0];
+	}
+	return node;
+}
+
+static inline CHBPlusTreeNode *CHBPlusTreeLastLeaf(CHBPlusTreeNode *node) {
+	while (!node->isLeaf) {
+		node = node->children[node->count];
+	}
+	return node;
+}
+
+// Returns the leaf that may contain a given object.
+static CHBPlusTreeNode *CHBPlusTreeFindLeaf(CHBPlusTreeNode *node, id anObject, CHComparison *ordering) {
+	BOOL found;
+	while (!node->isLeaf) {
+		NSUInteger index = CHBPlusTreeNodeSearch(node, anObject, ordering, &found);
+		node = node->children[found ? index + 1 : index];
+	}
+	return node;
+}
+
+// Returns the object nearest to anObject below it (if direction is 0) or above
+// it (if 1), or one equal to it if inclusive is YES, or nil if there is none. The
+// leaf that may contain anObject holds the nearest object, unless it is at the
+// end of the leaf, in which case it is at the end of the adjacent leaf.
+static id CHBPlusTreeNearest(CHBPlusTreeNode *root, id anObject, NSUInteger direction, BOOL inclusive, CHComparison *ordering) {
+	if (root == NULL) {
+		return nil;
+	}
+	CHBPlusTreeNode *leaf = CHBPlusTreeFindLeaf(root, anObject, ordering);
+	BOOL found;
+	NSUInteger index = CHBPlusTreeNodeSearch(leaf, anObject, ordering, &found);
+	if (found && inclusive) {
+		return leaf->objects[index];
+	}
+	if (direction) {
+		// Skip past an equal object to the first one greater than anObject.
+		if (found) {
+			index++;
+		}
+		if (index < leaf->count) {
+			return leaf->objects[index];
+		}
+		return (leaf->next != NULL) ? leaf->next->objects[0] : nil;
+	} else {
+		// The object before the first one not less than anObject is less.
+		if (index > 0) {
+			return leaf->objects[index - 1];
+		}
+		return (leaf->previous != NULL) ? leaf->previous->objects[leaf->previous->count - 1] : nil;
+	}
+}
+
+// Inserts an object (and, for an interior node, the child to its right) at index.
+static inline void CHBPlusTreeNodeInsert(CHBPlusTreeNode *node, NSUInteger index, id anObject, CHBPlusTreeNode *child) {
+	memmove(node->objects + index + 1, node->objects + index, kCHPointerSize * (node->count - index));
+	node->objects[index] = anObject;
+	if (!node->isLeaf) {
+		memmove(node->children + index + 2, node->children + index + 1, kCHPointerSize * (node->count - index));
+		node->children[index + 1] = child;
+	}
+	node->count++;
+}
+
+// Removes the object (and, for an interior node, the child to its right) at index.
+static inline void CHBPlusTreeNodeRemove(CHBPlusTreeNode *node, NSUInteger index) {
+	node->count--;
+	memmove(node->objects + index, node->objects + index + 1, kCHPointerSize * (node->count - index));
+	if (!node->isLeaf) {
+		memmove(node->children + index + 1, node->children + index + 2, kCHPointerSize * (node->count - index));
+	}
+}
+
+// Splits a full node into two while inserting an object (and child) at index.
+// The lower half stays in node, and the upper half is moved to a new node,
+// which is returned. The first object in the new subtree is returned in
+// separator; for an interior node, it is removed from both halves.
+static CHBPlusTreeNode *CHBPlusTreeNodeSplit(CHBPlusTreeNode *node, NSUInteger capacity, NSUInteger index,
+                                             id anObject, CHBPlusTreeNode *child, id *separator)
+{
+	__unsafe_unretained id objects[capacity + 1];
+	CHBPlusTreeNode *children[capacity + 2];
+	memcpy(objects, node->objects, kCHPointerSize * index);
+	objects[index] = anObject;
+	memcpy(objects + index + 1, node->objects + index, kCHPointerSize * (capacity - index));
+	if (!node->isLeaf) {
+		memcpy(children, node->children, kCHPointerSize * (index + 1));
+		children[index + 1] = child;
+		memcpy(children + index + 2, node->children + index + 1, kCHPointerSize * (capacity - index));
+	}
+	CHBPlusTreeNode *right = CHBPlusTreeNodeCreate(capacity, node->isLeaf);
+	NSUInteger leftCount = (capacity + 1) / 2;
+	// A leaf keeps its separator as the first object of the new node.
+	NSUInteger rightStart = node->isLeaf ? leftCount : leftCount + 1;
+	*separator = objects[leftCount];
+	right->count = (uint32_t)(capacity + 1 - rightStart);
+	memcpy(right->objects, objects + rightStart, kCHPointerSize * right->count);
+	memcpy(node->objects, objects, kCHPointerSize * leftCount);
+	node->count = (uint32_t)leftCount;
+	if (node->isLeaf) {
+		right->previous = node;
+		right->next = node->next;
+		if (right->next != NULL) {
+			right->next->previous = right;
+		}
+		node->next = right;
+	} else {
+		memcpy(node->children, children, kCHPointerSize * (leftCount + 1));
+		memcpy(right->children, children + rightStart, kCHPointerSize * (right->count + 1));
+	}
+	return right;
+}
+
+// Adds an object to a tree, splitting full nodes on the path to it from the
+// leaf up. If an equal object was already present, it is replaced instead and
+// returned (so it can be released); otherwise returns nil.
+static id CHBPlusTreeInsert(CHBPlusTreeNode **root, NSUInteger *height, NSUInteger capacity, id anObject, CHComparison *ordering) {
+	if (*root == NULL) {
+		*root = CHBPlusTreeNodeCreate(capacity, YES);
+		*height = 1;
+	}
+	CHBPlusTreeNode *path[kCHBPlusTreeMaximumHeight];
+	NSUInteger indexes[kCHBPlusTreeMaximumHeight];
+	CHBPlusTreeNode *separatorNode = NULL; // The interior node holding an equal object, if any.
+	NSUInteger separatorIndex = 0;
+	CHBPlusTreeNode *node = *root;
+	BOOL found;
+	for (NSUInteger level = *height - 1; level > 0; level--) {
+		NSUInteger index = CHBPlusTreeNodeSearch(node, anObject, ordering, &found);
+		if (found) {
+			separatorNode = node;
+			separatorIndex = index++;
+		}
+		path[level] = node;
+		indexes[level] = index;
+		node = node->children[index];
+	}
+	NSUInteger index = CHBPlusTreeNodeSearch(node, anObject, ordering, &found);
+	if (found) {
+		id replaced = node->objects[index];
+		node->objects[index] = anObject;
+		if (separatorNode != NULL) {
+			separatorNode->objects[separatorIndex] = anObject;
+		}
+		return replaced;
+	}
+	CHBPlusTreeNode *child = NULL;
+	for (NSUInteger level = 0; level < *height; level++) {
+		if (level > 0) {
+			node = path[level];
+			index = indexes[level];
+		}
+		if (node->count < capacity) {
+			CHBPlusTreeNodeInsert(node, index, anObject, child);
+			return nil;
+		}
+		child = CHBPlusTreeNodeSplit(node, capacity, index, anObject, child, &anObject);
+	}
+	// The root was split, so the tree grows a new root above the two halves.
+	CHBPlusTreeNode *newRoot = CHBPlusTreeNodeCreate(capacity, NO);
+	newRoot->objects[0] = anObject;
+	newRoot->count = 1;
+	newRoot->children[0] = *root;
+	newRoot->children[1] = child;
+	*root = newRoot;
+	(*height)++;
+	return nil;
+}
+
+// Refills a child with fewer than the minimum number of objects, either by
+// moving an object from a sibling (if one can spare it) or by merging it with a
+// sibling. Returns NO if the child was merged, which removes an object from the
+// parent. Both preserve the first object of each subtree in the parent.
+static BOOL CHBPlusTreeNodeRefill(CHBPlusTreeNode *parent, NSUInteger index, NSUInteger minimum) {
+	CHBPlusTreeNode *node = parent->children[index];
+	CHBPlusTreeNode *left = (index > 0) ? parent->children[index - 1] : NULL;
+	CHBPlusTreeNode *right = (index < parent->count) ? parent->children[index + 1] : NULL;
+	if (left != NULL && left->count > minimum) {
+		// Rotate the largest object of the left sibling through the parent.
+		id anObject = left->objects[left->count - 1];
+		memmove(node->objects + 1, node->objects, kCHPointerSize * node->count);
+		if (node->isLeaf) {
+			node->objects[0] = anObject;
+		} else {
+			memmove(node->children + 1, node->children, kCHPointerSize * (node->count + 1));
+			node->objects[0] = parent->objects[index - 1];
+			node->children[0] = left->children[left->count];
+		}
+		parent->objects[index - 1] = anObject;
+		node->count++;
+		left->count--;
+		return YES;
+	}
+	if (right != NULL && right->count > minimum) {
+		// Rotate the smallest object of the right sibling through the parent.
+		if (node->isLeaf) {
+			node->objects[node->count] = right->objects[0];
+			parent->objects[index] = right->objects[1];
+		} else {
+			node->objects[node->count] = parent->objects[index];
+			node->children[node->count + 1] = right->children[0];
+			parent->objects[index] = right->objects[0];
+			memmove(right->children, right->children + 1, kCHPointerSize * right->count);
+		}
+		node->count++;
+		right->count--;
+		memmove(right->objects, right->objects + 1, kCHPointerSize * right->count);
+		return YES;
+	}
+	// Neither sibling has an object to spare, so merge with one of them.
+	if (left != NULL) {
+		right = node;
+		index--;
+	} else {
+		left = node;
+	}
+	if (left->isLeaf) {
+		left->next = right->next;
+		if (left->next != NULL) {
+			left->next->previous = left;
+		}
+	} else {
+		left->objects[left->count++] = parent->objects[index];
+		memcpy(left->children + left->count, right->children, kCHPointerSize * (right->count + 1));
+	}
+	memcpy(left->objects + left->count, right->objects, kCHPointerSize * right->count);
+	left->count += right->count;
+	free(right);
+	CHBPlusTreeNodeRemove(parent, index);
+	return NO;
+}
+
+// Removes an object from a tree, refilling nodes that become less than half
+// full on the path from the leaf up. Returns the removed object (so it can be
+// released), or nil if no equal object was found.
+static id CHBPlusTreeRemove(CHBPlusTreeNode **root, NSUInteger *height, NSUInteger capacity, id anObject, CHComparison *ordering) {
+	if (*root == NULL) {
+		return nil;
+	}
+	CHBPlusTreeNode *path[kCHBPlusTreeMaximumHeight];
+	NSUInteger indexes[kCHBPlusTreeMaximumHeight];
+	CHBPlusTreeNode *separatorNode = NULL; // The interior node holding an equal object, if any.
+	NSUInteger separatorIndex = 0;
+	CHBPlusTreeNode *node = *root;
+	BOOL found;
+	for (NSUInteger level = *height - 1; level > 0; level--) {
+		NSUInteger index = CHBPlusTreeNodeSearch(node, anObject, ordering, &found);
+		if (found) {
+			separatorNode = node;
+			separatorIndex = index++;
+		}
+		path[level] = node;
+		indexes[level] = index;
+		node = node->children[index];
+	}
+	NSUInteger index = CHBPlusTreeNodeSearch(node, anObject, ordering, &found);
+	if (!found) {
+		return nil;
+	}
+	id removed = node->objects[index];
+	CHBPlusTreeNodeRemove(node, index);
+	if (separatorNode != NULL) {
+		// The removed object was first in its leaf, so the one after it takes
+		// its place. (If the leaf is now empty, it will be refilled from, or
+		// merged with, the next leaf, or the separator will be replaced.)
+		separatorNode->objects[separatorIndex] = (node->count > 0) ? node->objects[0]
+		                                       : (node->next != NULL) ? node->next->objects[0] : nil;
+	}
+	NSUInteger minimum = capacity / 2;
+	NSUInteger level = 0;
+	while (level + 1 < *height && node->count < minimum) {
+		level++;
+		node = path[level];
+		if (CHBPlusTreeNodeRefill(node, indexes[level], minimum)) {
+			break;
+		}
+	}
+	// The root may have been left with no objects, in which case it is removed.
+	node = *root;
+	if (node->count == 0) {
+		*root = (*height > 1) ? node->children[0] : NULL;
+		(*height)--;
+		free(node);
+	}
+	return removed;
+}
+
+// Builds a tree from objects in strictly ascending order in linear time. The
+// objects are spread evenly across as few leaves as possible, and the leaves
+// across as few parents as possible, and so on up to the root. The objects are
+// retained by the caller.
+static CHBPlusTreeNode *CHBPlusTreeBuild(__unsafe_unretained id *objects, NSUInteger objectCount, NSUInteger capacity, NSUInteger *height) {
+	*height = 0;
+	if (objectCount == 0) {
+		return NULL;
+	}
+	NSUInteger nodeCount = (objectCount + capacity - 1) / capacity;
+	CHBPlusTreeNode **nodes = malloc(kCHPointerSize * nodeCount);
+	__unsafe_unretained id *firstObjects = (__unsafe_unretained id *) malloc(kCHPointerSize * nodeCount);
+	CHBPlusTreeNode *previous = NULL;
+	for (NSUInteger i = 0; i < nodeCount; i++) {
+		NSUInteger start = i * objectCount / nodeCount, end = (i + 1) * objectCount / nodeCount;
+		CHBPlusTreeNode *leaf = CHBPlusTreeNodeCreate(capacity, YES);
+		leaf->count = (uint32_t)(end - start);
+		memcpy(leaf->objects, objects + start, kCHPointerSize * leaf->count);
+		leaf->previous = previous;
+		if (previous != NULL) {
+			previous->next = leaf;
+		}
+		nodes[i] = previous = leaf;
+		firstObjects[i] = objects[start];
+	}
+	*height = 1;
+	while (nodeCount > 1) {
+		NSUInteger parentCount = (nodeCount + capacity) / (capacity + 1);
+		// Parents are stored over their children, which come at or after them.
+		for (NSUInteger i = 0; i < parentCount; i++) {
+			NSUInteger start = i * nodeCount / parentCount, end = (i + 1) * nodeCount / parentCount;
+			CHBPlusTreeNode *parent = CHBPlusTreeNodeCreate(capacity, NO);
+			parent->count = (uint32_t)(end - start - 1);
+			memcpy(parent->objects, firstObjects + start + 1, kCHPointerSize * parent->count);
+			memcpy(parent->children, nodes + start, kCHPointerSize * (end - start));
+			nodes[i] = parent;
+			firstObjects[i] = firstObjects[start];
+		}
+		nodeCount = parentCount;
+		(*height)++;
+	}
+	CHBPlusTreeNode *root = nodes[0];
+	free(nodes);
+	free(firstObjects);
+	return root;
+}
+
+// Returns the index of the first object in a node that isn't also in one of its
+// ancestors. Only the first object in the tree isn't in an interior node.
+static inline NSUInteger CHBPlusTreeNodeFirstOwnIndex(CHBPlusTreeNode *node) {
+	return (node->isLeaf && node->previous != NULL) ? 1 : 0;
+}
+
+#pragma mark -
+
+/**
+ An NSEnumerator for traversing a CHBPlusTree in a specified order. Ascending and descending traversals follow the links between leaves. Other traversals keep a stack (or queue) of nodes, and return the objects in each node that don't also appear in an ancestor as it is visited.
+ */
+@interface CHBPlusTreeEnumerator : NSEnumerator
+
+- (instancetype)initWithTree:(CHBPlusTree *)tree
+                        root:(CHBPlusTreeNode *)root
+              traversalOrder:(CHTraversalOrder)order
+             mutationPointer:(unsigned long *)mutations;
+
+@end
+
+@implementation CHBPlusTreeEnumerator
+{
+	__strong CHBPlusTree *searchTree; // The tree being enumerated.
+	CHTraversalOrder traversalOrder; // Order in which to traverse the tree.
+	CHBPlusTreeNode *current; // The node whose objects are being enumerated.
+	NSUInteger index; // The next object in current (or after it, if descending).
+	NSUInteger end; // The index after the last object in current to enumerate.
+	CHBPlusTreeNode **nodes; // Nodes yet to be visited (or, for post-order, the path).
+	NSUInteger *childIndexes; // For post-order, the next child of each node in the path.
+	NSUInteger nodeCapacity, nodeHead, nodeTail; // Bounds of nodes, used as a stack or queue.
+	unsigned long mutationCount; // Stores the collection's initial mutation.
+	unsigned long *mutationPtr; // Pointer for checking changes in mutation.
+}
+
+/**
+ Create an enumerator which traverses a given tree in the specified order.
+
+ @param tree The tree being enumerated. This collection is to be retained while the enumerator has not exhausted all its objects.
+ @param root The root node of @a tree, or @c NULL if it is empty.
+ @param order The traversal order to use for enumerating the given @a tree.
+ @param mutations A pointer to the collection's mutation count for invalidation.
+ @return An initialized CHBPlusTreeEnumerator which will enumerate objects in @a tree in the order specified by @a order.
+ */
+- (instancetype)initWithTree:(CHBPlusTree *)tree
+                        root:(CHBPlusTreeNode *)root
+              traversalOrder:(CHTraversalOrder)order
+             mutationPointer:(unsigned long *)mutations
+{
+	if (!isValidTraversalOrder(order)) {
+		CHRaiseInvalidArgumentException(@"Invalid traversal order");
+	}
+	self = [super init];
+	if (self) {
+		traversalOrder = order;
+		mutationCount = *mutations;
+		mutationPtr = mutations;
+		if (root != NULL) {
+			searchTree = [tree retain];
+			if (order == CHTraversalOrderAscending) {
+				current = CHBPlusTreeFirstLeaf(root);
+				end = current->count;
+			} else if (order == CHTraversalOrderDescending) {
+				current = CHBPlusTreeLastLeaf(root);
+				index = current->count;
+			} else {
+				nodeCapacity = 32;
+				nodes = malloc(kCHPointerSize * nodeCapacity);
+				nodes[nodeTail++] = root;
+				if (order == CHTraversalOrderPostOrder) {
+					childIndexes = malloc(sizeof(NSUInteger) * nodeCapacity);
+					childIndexes[0] = 0;
+				}
+			}
+		}
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[self _collectionExhausted];
+	[super dealloc];
+}
+
+- (void)_collectionExhausted {
+	[searchTree release];
+	searchTree = nil;
+	current = NULL;
+	free(nodes);
+	nodes = NULL;
+	free(childIndexes);
+	childIndexes = NULL;
+}
+
+- (NSArray *)allObjects {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	NSMutableArray *array = [NSMutableArray array];
+	id anObject;
+	while ((anObject = [self nextObject])) {
+		[array addObject:anObject];
+	}
+	return array;
+}
+
+// Adds a node to the stack or queue, which are the same until they're removed.
+- (void)_addNode:(CHBPlusTreeNode *)node {
+	if (nodeTail == nodeCapacity) {
+		nodeCapacity *= 2;
+		nodes = realloc(nodes, kCHPointerSize * nodeCapacity);
+		if (childIndexes != NULL) {
+			childIndexes = realloc(childIndexes, sizeof(NSUInteger) * nodeCapacity);
+		}
+	}
+	nodes[nodeTail++] = node;
+}
+
+// Finds the next node whose own objects should be enumerated, and sets current
+// to it, or to NULL if there are no more nodes.
+- (void)_advanceToNextNode {
+	current = NULL;
+	while (current == NULL && nodeHead < nodeTail) {
+		switch (traversalOrder) {
+			case CHTraversalOrderPreOrder: {
+				// Children are pushed in reverse so the first is popped next.
+				current = nodes[--nodeTail];
+				for (NSUInteger i = current->isLeaf ? 0 : current->count + 1; i > 0; i--) {
+					[self _addNode:current->children[i - 1]];
+				}
+				break;
+			}
+			case CHTraversalOrderPostOrder: {
+				// The stack holds the path to the current node; a node is only
+				// visited once all of its children have been.
+				CHBPlusTreeNode *node = nodes[nodeTail - 1];
+				NSUInteger childIndex = childIndexes[nodeTail - 1];
+				if (!node->isLeaf && childIndex <= node->count) {
+					childIndexes[nodeTail - 1]++;
+					[self _addNode:node->children[childIndex]];
+					childIndexes[nodeTail - 1] = 0;
+				} else {
+					current = nodes[--nodeTail];
+				}
+				break;
+			}
+			default: {
+				current = nodes[nodeHead++];
+				if (!current->isLeaf) {
+					for (NSUInteger i = 0; i <= current->count; i++) {
+						[self _addNode:current->children[i]];
+					}
+				}
+				// Reclaim the space before the head once the queue is empty.
+				if (nodeHead == nodeTail) {
+					nodeHead = nodeTail = 0;
+				}
+				break;
+			}
+		}
+		if (current != NULL) {
+			index = CHBPlusTreeNodeFirstOwnIndex(current);
+			end = current->count;
+			if (index == end) {
+				current = NULL; // The node has no objects of its own.
+			}
+		}
+	}
+}
+
+- (id)nextObject {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	if (searchTree == nil) {
+		return nil;
+	}
+	id anObject;
+	switch (traversalOrder) {
+		case CHTraversalOrderAscending:
+			anObject = current->objects[index++];
+			if (index == end) {
+				current = current->next;
+				index = 0;
+				end = (current != NULL) ? current->count : 0;
+			}
+			break;
+		case CHTraversalOrderDescending:
+			anObject = current->objects[--index];
+			if (index == 0) {
+				current = current->previous;
+				index = (current != NULL) ? current->count : 0;
+			}
+			break;
+		default:
+			if (current == NULL) {
+				[self _advanceToNextNode];
+			}
+			anObject = current->objects[index++];
+			if (index == end) {
+				[self _advanceToNextNode];
+			}
+			break;
+	}
+	if (current == NULL) {
+		// Keep the last object alive after the tree is released.
+		[[anObject retain] autorelease];
+		[self _collectionExhausted];
+	}
+	return anObject;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CHBPlusTree
+
+- (void)dealloc {
+	[self removeAllObjects];
+	[super dealloc];
+}
+
+- (instancetype)init {
+	return [self initWithFanout:kCHBPlusTreeDefaultFanout];
+}
+
+// This is the designated initializer for CHBPlusTree.
+- (instancetype)initWithFanout:(NSUInteger)fanout {
+	if (fanout < 3) {
+		CHRaiseInvalidArgumentException(@"Fanout must be at least 3");
+	}
+	self = [super init];
+	if (self) {
+		root = NULL;
+		height = 0;
+		capacity = fanout - 1;
+		count = 0;
+		mutations = 0;
+	}
+	return self;
+}
+
+- (instancetype)initWithArray:(NSArray *)anArray {
+	self = [self initWithFanout:kCHBPlusTreeDefaultFanout];
+	if (self) {
+		[self addObjectsFromArray:anArray];
+	}
+	return self;
+}
+
+// Replaces the contents of an empty tree with objects in ascending order.
+- (void)_buildWithSortedObjects:(__unsafe_unretained id *)objects count:(NSUInteger)objectCount {
+	NSAssert(count == 0, @"Illegal state, tree must be empty before building!");
+	for (NSUInteger i = 0; i < objectCount; i++) {
+		[objects[i] retain];
+	}
+	root = CHBPlusTreeBuild(objects, objectCount, capacity, &height);
+	count = objectCount;
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	self = [self initWithFanout:[decoder decodeIntegerForKey:@"fanout"]];
+	if (self) {
+		[self addObjectsFromArray:[decoder decodeObjectForKey:@"objects"]];
+	}
+	return self;
+}
+
+// Since the objects are archived in ascending order, the tree is rebuilt in
+// linear time when it is unarchived.
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[encoder encodeInteger:(NSInteger)[self fanout] forKey:@"fanout"];
+	[encoder encodeObject:[self allObjects] forKey:@"objects"];
+}
+
+#pragma mark <NSCopying>
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+	CHBPlusTree *newTree = [[[self class] allocWithZone:zone] initWithFanout:[self fanout]];
+	if (count > 0) {
+		__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * count);
+		NSUInteger objectCount = 0;
+		for (CHBPlusTreeNode *leaf = CHBPlusTreeFirstLeaf(root); leaf != NULL; leaf = leaf->next) {
+			memcpy(objects + objectCount, leaf->objects, kCHPointerSize * leaf->count);
+			objectCount += leaf->count;
+		}
+		[newTree _buildWithSortedObjects:objects count:objectCount];
+		free(objects);
+	}
+	return newTree;
+}
+
+#pragma mark <NSFastEnumeration>
+
+// Each call returns the objects in one leaf directly from the leaf itself. The
+// next leaf is kept in the extra state.
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	CHBPlusTreeNode *leaf;
+	if (state->state == 0) {
+		state->state = 1;
+		state->mutationsPtr = &mutations;
+		leaf = (root != NULL) ? CHBPlusTreeFirstLeaf(root) : NULL;
+	} else {
+		leaf = (CHBPlusTreeNode *) state->extra[0];
+	}
+	if (leaf == NULL) {
+		return 0;
+	}
+	state->itemsPtr = leaf->objects;
+	state->extra[0] = (unsigned long) leaf->next;
+	return leaf->count;
+}
+
+#pragma mark Querying Contents
+
+- (NSArray *)allObjects {
+	NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+	for (CHBPlusTreeNode *leaf = (root != NULL) ? CHBPlusTreeFirstLeaf(root) : NULL; leaf != NULL; leaf = leaf->next) {
+		[array addObjectsFromArray:[NSArray arrayWithObjects:leaf->objects count:leaf->count]];
+	}
+	return array;
+}
+
+- (NSArray *)allObjectsWithTraversalOrder:(CHTraversalOrder)order {
+	if (order == CHTraversalOrderAscending) {
+		return [self allObjects];
+	}
+	return [[self objectEnumeratorWithTraversalOrder:order] allObjects];
+}
+
+- (id)anyObject {
+	return [self firstObject];
+}
+
+- (id)ceilingObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHBPlusTreeNearest(root, anObject, 1, YES, &ordering);
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self member:anObject] != nil);
+}
+
+- (NSUInteger)count {
+	return count;
+}
+
+- (NSString *)description {
+	return [[self allObjects] description];
+}
+
+- (NSUInteger)fanout {
+	return capacity + 1;
+}
+
+- (id)firstObject {
+	return (root != NULL) ? CHBPlusTreeFirstLeaf(root)->objects[0] : nil;
+}
+
+- (id)floorObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHBPlusTreeNearest(root, anObject, 0, YES, &ordering);
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects(count, [self firstObject], [self lastObject]);
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
+		return [self isEqualToSortedSet:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+- (BOOL)isEqualToSearchTree:(id<CHSearchTree>)otherTree {
+	return CHCollectionsAreEqual(self, otherTree);
+}
+
+- (BOOL)isEqualToSortedSet:(id<CHSortedSet>)otherSortedSet {
+	return CHCollectionsAreEqual(self, otherSortedSet);
+}
+
+- (id)lastObject {
+	if (root == NULL) {
+		return nil;
+	}
+	CHBPlusTreeNode *leaf = CHBPlusTreeLastLeaf(root);
+	return leaf->objects[leaf->count - 1];
+}
+
+- (id)member:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	if (root == NULL) {
+		return nil;
+	}
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	CHBPlusTreeNode *leaf = CHBPlusTreeFindLeaf(root, anObject, &ordering);
+	BOOL found;
+	NSUInteger index = CHBPlusTreeNodeSearch(leaf, anObject, &ordering, &found);
+	return found ? leaf->objects[index] : nil;
+}
+
+- (id)objectAfter:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHBPlusTreeNearest(root, anObject, 1, NO, &ordering);
+}
+
+- (id)objectBefore:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHBPlusTreeNearest(root, anObject, 0, NO, &ordering);
+}
+
+- (NSEnumerator *)objectEnumerator {
+	return [self objectEnumeratorWithTraversalOrder:CHTraversalOrderAscending];
+}
+
+- (NSEnumerator *)objectEnumeratorWithTraversalOrder:(CHTraversalOrder)order {
+	return [[[CHBPlusTreeEnumerator alloc] initWithTree:self
+	                                               root:root
+	                                     traversalOrder:order
+	                                    mutationPointer:&mutations] autorelease];
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	return [self objectEnumeratorWithTraversalOrder:CHTraversalOrderDescending];
+}
+
+- (NSSet *)set {
+	NSMutableSet *set = [NSMutableSet setWithCapacity:count];
+	for (id anObject in self) {
+		[set addObject:anObject];
+	}
+	return set;
+}
+
+/*
+ \copydoc CHSortedSet::subsetFromObject:toObject:
+
+ \attention This implementation scans the leaves for the objects in the subset, then builds the subset from them directly in O(k) time, since they are already sorted.
+ */
+- (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	// If both parameters are nil, return a copy containing all the objects.
+	if (start == nil && end == nil) {
+		return [[self copy] autorelease];
+	}
+	CHBPlusTree *subset = [[[[self class] alloc] initWithFanout:[self fanout]] autorelease];
+	if (count == 0) {
+		return subset;
+	}
+	// Objects must be at or above start, and at or below end, unless end doesn't
+	// come after start (in which case either will do). As for other trees, equal
+	// endpoints include everything, or everything but the endpoint if excluded.
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	BOOL includesLow = !(options & CHSubsetConstructionExcludeLowEndpoint);
+	BOOL includesHigh = !(options & CHSubsetConstructionExcludeHighEndpoint);
+	NSComparisonResult comparison = (start != nil && end != nil) ? CHComparisonCompare(&ordering, start, end) : NSOrderedAscending;
+	BOOL isInverted = (comparison != NSOrderedAscending);
+	if (comparison == NSOrderedSame && !(includesLow && includesHigh)) {
+		includesLow = includesHigh = NO;
+	}
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * count);
+	NSUInteger objectCount = 0;
+	for (CHBPlusTreeNode *leaf = CHBPlusTreeFirstLeaf(root); leaf != NULL; leaf = leaf->next) {
+		for (NSUInteger i = 0; i < leaf->count; i++) {
+			id anObject = leaf->objects[i];
+			NSComparisonResult low = (start != nil) ? CHComparisonCompare(&ordering, anObject, start) : NSOrderedDescending;
+			NSComparisonResult high = (end != nil) ? CHComparisonCompare(&ordering, anObject, end) : NSOrderedAscending;
+			BOOL isAboveLow = (low == NSOrderedDescending || (includesLow && low == NSOrderedSame));
+			BOOL isBelowHigh = (high == NSOrderedAscending || (includesHigh && high == NSOrderedSame));
+			if (isInverted ? (isAboveLow || isBelowHigh) : (isAboveLow && isBelowHigh)) {
+				objects[objectCount++] = anObject;
+			}
+		}
+	}
+	[subset _buildWithSortedObjects:objects count:objectCount];
+	free(objects);
+	return subset;
+}
+
+#pragma mark Modifying Contents
+
+- (void)addObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	++mutations;
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	id replaced = CHBPlusTreeInsert(&root, &height, capacity, [anObject retain], &ordering);
+	if (replaced != nil) {
+		[replaced release];
+	} else {
+		++count;
+	}
+}
+
+// An empty tree is built directly from the sorted objects in linear time. The
+// input is only sorted if it isn't already in ascending order.
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	NSUInteger arrayCount = [anArray count];
+	if (count > 0 || arrayCount < 2) {
+		for (id anObject in anArray) {
+			[self addObject:anObject];
+		}
+		return;
+	}
+	++mutations;
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * arrayCount);
+	[anArray getObjects:objects range:NSMakeRange(0, arrayCount)];
+	NSUInteger index = 1;
+	while (index < arrayCount && CHComparisonCompare(&ordering, objects[index-1], objects[index]) == NSOrderedAscending) {
+		index++;
+	}
+	if (index < arrayCount) {
+		// A stable sort means the last of several equal objects is kept, just as
+		// if each one had been added by -addObject: in turn.
+		__block CHComparison sortOrdering = ordering;
+		NSArray *sorted = [anArray sortedArrayWithOptions:NSSortStable
+		                                  usingComparator:^(id object1, id object2) {
+			return CHComparisonCompare(&sortOrdering, object1, object2);
+		}];
+		[sorted getObjects:objects range:NSMakeRange(0, arrayCount)];
+		NSUInteger uniqueCount = 0;
+		for (index = 0; index < arrayCount; index++) {
+			if (index + 1 < arrayCount && CHComparisonCompare(&ordering, objects[index], objects[index+1]) == NSOrderedSame) {
+				continue;
+			}
+			objects[uniqueCount++] = objects[index];
+		}
+		arrayCount = uniqueCount;
+	}
+	[self _buildWithSortedObjects:objects count:arrayCount];
+	free(objects);
+}
+
+- (void)removeAllObjects {
+	if (root != NULL) {
+		++mutations;
+		CHBPlusTreeNodeFree(root);
+		root = NULL;
+		height = 0;
+		count = 0;
+	}
+}
+
+- (void)removeFirstObject {
+	id object = [self firstObject];
+	if (object) { // Avoid removing nil
+		[self removeObject:object];
+	}
+}
+
+- (void)removeLastObject {
+	id object = [self lastObject];
+	if (object) { // Avoid removing nil
+		[self removeObject:object];
+	}
+}
+
+- (void)removeObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	id removed = CHBPlusTreeRemove(&root, &height, capacity, anObject, &ordering);
+	if (removed != nil) {
+		++mutations;
+		--count;
+		[removed release];
+	}
+}
+
+@end
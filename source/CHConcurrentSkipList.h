@@ -0,0 +1,38 @@
+//
+//  CHConcurrentSkipList.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHSortedSet.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHConcurrentSkipList.h
+ A lock-free <a href="http://en.wikipedia.org/wiki/Skip_list">skip list</a> implementation of CHSortedSet, which many threads can modify at once.
+ */
+
+struct CHConcurrentSkipListNode; // Defined in CHConcurrentSkipList.m
+struct CHConcurrentSkipListSlot; // Defined in CHConcurrentSkipList.m
+
+/**
+ A <a href="http://en.wikipedia.org/wiki/Skip_list">skip list</a> which any number of threads can search and modify at the same time without locks. Each node is in a sorted linked list at the bottom level, and in the list at each of a random number of levels above it, with a quarter as many nodes at each level as below it, so a search skips over most of the list and takes O(log n) expected time.
+
+ Nodes are added and removed with atomic compare-and-swap operations, as described in <em>The Art of Multiprocessor Programming</em> by Herlihy and Shavit. A node is removed by first marking each of its links, then unlinking it at each level (which any thread that comes across it may do). Since other threads may still be looking at a node after it is unlinked, its memory is reclaimed with <a href="http://www.cl.cam.ac.uk/techreports/UCAM-CL-TR-579.pdf">epoch-based reclamation</a>: each operation announces the epoch in which it started, and a removed node (along with its object) is only freed once every operation that was running when it was removed has finished.
+
+ Operations are linearizable, but enumeration (including fast enumeration) is weakly consistent: it never raises a mutation exception, it returns each object at most once and in ascending order, and it includes the objects that were present for the whole enumeration. Objects added or removed during enumeration may or may not be included. The count is exact whenever no other thread is modifying the skip list. Objects returned by methods such as \link #member: -member:\endlink are retained and autoreleased before they are returned, so they remain valid even if another thread removes them.
+
+ Objects are ordered by their @c -compare: method, which (as in CHAbstractBinarySearchTree) is looked up once per operation and then called directly.
+ */
+@interface CHConcurrentSkipList<__covariant ObjectType> : NSObject <CHSortedSet>
+{
+	struct CHConcurrentSkipListNode *head; // A node with every level and no object.
+	struct CHConcurrentSkipListSlot *slots; // Each thread's epoch, count, and removed nodes.
+	uint64_t epoch; // The current epoch, which is only accessed atomically.
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
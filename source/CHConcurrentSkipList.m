@@ -0,0 +1,687 @@
+//
+//  CHConcurrentSkipList.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHConcurrentSkipList.h>
+#import <pthread.h>
+#import <sched.h>
+
+// With a quarter as many nodes at each level as below it, this many levels
+// are enough for any skip list that fits in memory.
+#define kCHConcurrentSkipListMaximumLevels 32
+
+// The number of threads that can operate on a skip list at once. Others wait
+// for one of them to finish.
+#define kCHConcurrentSkipListSlotCount 32
+
+// How many nodes a thread removes before trying to advance the epoch.
+#define kCHConcurrentSkipListRetireInterval 32
+
+// Each slot has a cache line to itself, so threads don't contend for them.
+#define kCHConcurrentSkipListSlotAlignment 128
+
+#pragma mark Nodes
+
+/**
+ A node in a CHConcurrentSkipList. Each link points to the next node at that level, or is 0 at the end of the list. The lowest bit of a link is set once the node has been removed, after which the link never changes. The node retains its object, which may be replaced by an equal one.
+ */
+typedef struct CHConcurrentSkipListNode {
+	__unsafe_unretained id object; ///< The object stored in the node, which is only accessed atomically.
+	struct CHConcurrentSkipListNode *retiredNext; ///< The next removed node that is waiting to be freed.
+	uint32_t levels; ///< The number of levels the node is in, which is the size of @a next.
+	uint32_t finished; ///< How many of the node's inserter and remover are done with it.
+	uintptr_t next[]; ///< The link to the next node at each level, with a removal mark.
+} CHConcurrentSkipListNode;
+
+#define CHMarked(link)   ((link) & 1)
+#define CHUnmarked(link) ((CHConcurrentSkipListNode *) ((link) & ~(uintptr_t) 1))
+
+static CHConcurrentSkipListNode *CHConcurrentSkipListNodeCreate(id anObject, uint32_t levels) {
+	CHConcurrentSkipListNode *node = malloc(sizeof(CHConcurrentSkipListNode) + sizeof(uintptr_t) * levels);
+	node->object = [anObject retain];
+	node->retiredNext = NULL;
+	node->levels = levels;
+	node->finished = 0;
+	memset(node->next, 0, sizeof(uintptr_t) * levels);
+	return node;
+}
+
+static void CHConcurrentSkipListNodeFree(CHConcurrentSkipListNode *node) {
+	[node->object release];
+	free(node);
+}
+
+static inline id CHConcurrentSkipListNodeObject(CHConcurrentSkipListNode *node) {
+	return __atomic_load_n((void **) &node->object, __ATOMIC_ACQUIRE);
+}
+
+static inline uintptr_t CHConcurrentSkipListNodeLink(CHConcurrentSkipListNode *node, uint32_t level) {
+	return __atomic_load_n(&node->next[level], __ATOMIC_ACQUIRE);
+}
+
+static inline BOOL CHConcurrentSkipListCAS(uintptr_t *link, uintptr_t expected, uintptr_t desired) {
+	return __atomic_compare_exchange_n(link, &expected, desired, NO, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+// Chooses how many levels a new node is in. Each thread has its own generator,
+// so threads don't contend for it.
+static uint32_t CHConcurrentSkipListRandomLevels() {
+	static __thread uint64_t state = 0;
+	if (state == 0) {
+		state = ((uint64_t) (uintptr_t) pthread_self() * 0x9E3779B97F4A7C15ull) | 1;
+	}
+	state ^= state << 13; // xorshift64
+	state ^= state >> 7;
+	state ^= state << 17;
+	// Each pair of trailing zero bits adds a level, with probability 1/4.
+	return 1 + (uint32_t) __builtin_ctzll(state | (1ull << (2 * (kCHConcurrentSkipListMaximumLevels - 1)))) / 2;
+}
+
+#pragma mark Epochs
+
+/**
+ A thread claims one of these while it operates on a skip list, and announces in it the epoch in which it started. The epoch only advances when every thread operating on the skip list has announced the current one, so a node removed in some epoch is no longer visible to any thread two epochs later. Each slot keeps lists of the nodes removed by its threads in each of the last three epochs, and frees them once it is safe to do so. It also keeps a share of the count, so that threads that add and remove objects at once don't all update the same count.
+ */
+typedef struct CHConcurrentSkipListSlot {
+	uint64_t announcement; ///< 0 if unclaimed, or the epoch of the thread that claimed it times 2, plus 1.
+	int64_t countDelta; ///< The number of objects added less the number removed by its threads.
+	CHConcurrentSkipListNode *retired[3]; ///< The nodes removed in each of the last 3 epochs, indexed by epoch mod 3.
+	uint64_t retiredEpoch[3]; ///< The epoch in which each list of nodes was removed.
+	uint32_t retiredSinceAdvance; ///< The nodes removed since it last tried to advance the epoch.
+} __attribute__((aligned(kCHConcurrentSkipListSlotAlignment))) CHConcurrentSkipListSlot;
+
+/**
+ The state of an operation on a skip list, including the slot it claimed and its copy of the ordering.
+ */
+typedef struct CHConcurrentSkipListOperation {
+	CHConcurrentSkipListNode *head; ///< The skip list's head node.
+	CHConcurrentSkipListSlot *slots; ///< The skip list's slots.
+	uint64_t *epoch; ///< The skip list's current epoch.
+	CHConcurrentSkipListSlot *slot; ///< The slot claimed by the operation.
+	CHComparison ordering; ///< The ordering, whose cache is filled in as needed.
+} CHConcurrentSkipListOperation;
+
+static void CHConcurrentSkipListFreeRetired(CHConcurrentSkipListSlot *slot, NSUInteger index) {
+	CHConcurrentSkipListNode *node = slot->retired[index];
+	while (node != NULL) {
+		CHConcurrentSkipListNode *next = node->retiredNext;
+		CHConcurrentSkipListNodeFree(node);
+		node = next;
+	}
+	slot->retired[index] = NULL;
+}
+
+// Claims a slot (preferring the one the thread used last, if it's free) and
+// announces the current epoch in it, then frees any nodes it holds that were
+// removed at least two epochs ago.
+static CHConcurrentSkipListOperation CHConcurrentSkipListBegin(CHConcurrentSkipListNode *head, CHConcurrentSkipListSlot *slots, uint64_t *epoch) {
+	uint64_t currentEpoch = __atomic_load_n(epoch, __ATOMIC_SEQ_CST);
+	uint64_t announcement = (currentEpoch << 1) | 1;
+	NSUInteger index = (NSUInteger) (((uint64_t) (uintptr_t) pthread_self() * 0x9E3779B97F4A7C15ull) >> 32);
+	CHConcurrentSkipListSlot *slot;
+	for (NSUInteger attempt = 1; ; attempt++, index++) {
+		slot = &slots[index % kCHConcurrentSkipListSlotCount];
+		uint64_t unclaimed = 0;
+		if (__atomic_load_n(&slot->announcement, __ATOMIC_RELAXED) == 0 &&
+		    __atomic_compare_exchange_n(&slot->announcement, &unclaimed, announcement, NO, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+			break;
+		}
+		if (attempt % kCHConcurrentSkipListSlotCount == 0) {
+			sched_yield();
+		}
+	}
+	for (NSUInteger i = 0; i < 3; i++) {
+		if (slot->retired[i] != NULL && slot->retiredEpoch[i] + 2 <= currentEpoch) {
+			CHConcurrentSkipListFreeRetired(slot, i);
+		}
+	}
+	CHConcurrentSkipListOperation operation = {head, slots, epoch, slot, {NULL, NULL, Nil, NULL}};
+	return operation;
+}
+
+static inline void CHConcurrentSkipListEnd(CHConcurrentSkipListOperation *operation) {
+	__atomic_store_n(&operation->slot->announcement, 0, __ATOMIC_RELEASE);
+}
+
+// Advances the epoch if every thread operating on the skip list has announced
+// the current one.
+static void CHConcurrentSkipListTryAdvance(CHConcurrentSkipListOperation *operation, uint64_t currentEpoch) {
+	for (NSUInteger i = 0; i < kCHConcurrentSkipListSlotCount; i++) {
+		uint64_t announcement = __atomic_load_n(&operation->slots[i].announcement, __ATOMIC_SEQ_CST);
+		if (announcement != 0 && (announcement >> 1) != currentEpoch) {
+			return;
+		}
+	}
+	__atomic_compare_exchange_n(operation->epoch, &currentEpoch, currentEpoch + 1, NO, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+// Defers freeing a node that is no longer in the skip list until no thread can
+// still be looking at it.
+static void CHConcurrentSkipListRetire(CHConcurrentSkipListOperation *operation, CHConcurrentSkipListNode *node) {
+	// The node is tagged with the epoch after it was unlinked, not the one the
+	// operation announced, since threads that announced a later epoch may have
+	// started before it was unlinked.
+	CHConcurrentSkipListSlot *slot = operation->slot;
+	uint64_t currentEpoch = __atomic_load_n(operation->epoch, __ATOMIC_SEQ_CST);
+	NSUInteger index = (NSUInteger) (currentEpoch % 3);
+	// A list from 3 or more epochs ago is safe to free.
+	if (slot->retired[index] != NULL && slot->retiredEpoch[index] != currentEpoch) {
+		CHConcurrentSkipListFreeRetired(slot, index);
+	}
+	node->retiredNext = slot->retired[index];
+	slot->retired[index] = node;
+	slot->retiredEpoch[index] = currentEpoch;
+	if (++slot->retiredSinceAdvance == kCHConcurrentSkipListRetireInterval) {
+		slot->retiredSinceAdvance = 0;
+		CHConcurrentSkipListTryAdvance(operation, currentEpoch);
+	}
+}
+
+static inline void CHConcurrentSkipListAdjustCount(CHConcurrentSkipListOperation *operation, int64_t delta) {
+	int64_t *countDelta = &operation->slot->countDelta;
+	__atomic_store_n(countDelta, __atomic_load_n(countDelta, __ATOMIC_RELAXED) + delta, __ATOMIC_RELAXED);
+}
+
+#pragma mark Searching and modifying
+
+/**
+ Finds the nodes before and after the position of an object at each level, unlinking any removed nodes along the way.
+
+ @param operation The operation in progress.
+ @param anObject The object to search for.
+ @param preds Set to the last node before the position at each level, which may be the head.
+ @param succs Set to the first node at or after the position at each level, or @c NULL.
+ @return Whether @a succs[0] contains an object equal to @a anObject.
+ */
+static BOOL CHConcurrentSkipListFind(CHConcurrentSkipListOperation *operation, id anObject,
+                                     CHConcurrentSkipListNode **preds, CHConcurrentSkipListNode **succs)
+{
+	NSComparisonResult comparison;
+retry:
+	comparison = NSOrderedDescending;
+	CHConcurrentSkipListNode *pred = operation->head;
+	for (uint32_t level = kCHConcurrentSkipListMaximumLevels; level-- > 0; ) {
+		CHConcurrentSkipListNode *current = CHUnmarked(CHConcurrentSkipListNodeLink(pred, level));
+		comparison = NSOrderedDescending;
+		while (current != NULL) {
+			uintptr_t successor = CHConcurrentSkipListNodeLink(current, level);
+			if (CHMarked(successor)) {
+				// Unlink the removed node, unless pred itself has been removed.
+				if (!CHConcurrentSkipListCAS(&pred->next[level], (uintptr_t) current, successor & ~(uintptr_t) 1)) {
+					goto retry;
+				}
+				current = CHUnmarked(successor);
+				continue;
+			}
+			comparison = CHComparisonCompare(&operation->ordering, CHConcurrentSkipListNodeObject(current), anObject);
+			if (comparison == NSOrderedAscending) {
+				pred = current;
+				current = CHUnmarked(successor);
+			} else {
+				break;
+			}
+		}
+		preds[level] = pred;
+		succs[level] = current;
+	}
+	return (succs[0] != NULL && comparison == NSOrderedSame);
+}
+
+// Returns the first node after a node at a level that hasn't been removed, or
+// NULL. Searches only step onto such nodes, since the links of a removed node
+// may point past nodes added after it was removed.
+static inline CHConcurrentSkipListNode *CHConcurrentSkipListNextNode(CHConcurrentSkipListNode *node, uint32_t level) {
+	CHConcurrentSkipListNode *next = CHUnmarked(CHConcurrentSkipListNodeLink(node, level));
+	while (next != NULL && CHMarked(CHConcurrentSkipListNodeLink(next, level))) {
+		next = CHUnmarked(CHConcurrentSkipListNodeLink(next, level));
+	}
+	return next;
+}
+
+// Searches without modifying anything, and returns the first node that isn't less
+// than the object (or, if after is YES, greater than it) or NULL. If predecessor
+// isn't NULL, it is set to the last node before that one, or NULL if there is none.
+static CHConcurrentSkipListNode *CHConcurrentSkipListSearch(CHConcurrentSkipListOperation *operation, id anObject, BOOL after,
+                                                            CHConcurrentSkipListNode **predecessor)
+{
+	CHConcurrentSkipListNode *pred = operation->head, *current = NULL;
+	NSComparisonResult stop = after ? NSOrderedDescending : NSOrderedSame;
+	for (uint32_t level = kCHConcurrentSkipListMaximumLevels; level-- > 0; ) {
+		current = CHConcurrentSkipListNextNode(pred, level);
+		while (current != NULL && CHComparisonCompare(&operation->ordering, CHConcurrentSkipListNodeObject(current), anObject) < stop) {
+			pred = current;
+			current = CHConcurrentSkipListNextNode(current, level);
+		}
+	}
+	if (predecessor != NULL) {
+		*predecessor = (pred != operation->head) ? pred : NULL;
+	}
+	return current;
+}
+
+// Returns the node nearest to an object below it (if direction is 0) or above it
+// (if 1), or one equal to it if inclusive is YES, or NULL. The node below is the
+// one before the first node above, so either takes a single search.
+static CHConcurrentSkipListNode *CHConcurrentSkipListNearestNode(CHConcurrentSkipListOperation *operation, id anObject,
+                                                                 NSUInteger direction, BOOL inclusive)
+{
+	CHConcurrentSkipListNode *pred;
+	CHConcurrentSkipListNode *node = CHConcurrentSkipListSearch(operation, anObject, (direction != 0) != inclusive, &pred);
+	return direction ? node : pred;
+}
+
+static CHConcurrentSkipListNode *CHConcurrentSkipListLastNode(CHConcurrentSkipListOperation *operation) {
+	CHConcurrentSkipListNode *pred = operation->head;
+	for (uint32_t level = kCHConcurrentSkipListMaximumLevels; level-- > 0; ) {
+		for (CHConcurrentSkipListNode *node = CHConcurrentSkipListNextNode(pred, level); node != NULL;
+		     node = CHConcurrentSkipListNextNode(node, level)) {
+			pred = node;
+		}
+	}
+	return (pred != operation->head) ? pred : NULL;
+}
+
+// Called by the inserter and the remover of a node once each is done with it.
+// The second one unlinks it from every level, after which nothing can link to it
+// again, and retires it. Searching for its object is enough to find it at every
+// level, since a node with an equal object can only be added after it.
+static void CHConcurrentSkipListFinish(CHConcurrentSkipListOperation *operation, CHConcurrentSkipListNode *node) {
+	if (__atomic_fetch_add(&node->finished, 1, __ATOMIC_ACQ_REL) == 1) {
+		CHConcurrentSkipListNode *preds[kCHConcurrentSkipListMaximumLevels], *succs[kCHConcurrentSkipListMaximumLevels];
+		CHConcurrentSkipListFind(operation, CHConcurrentSkipListNodeObject(node), preds, succs);
+		CHConcurrentSkipListRetire(operation, node);
+	}
+}
+
+// Adds an object, or replaces an equal one, and returns whether it was added.
+static BOOL CHConcurrentSkipListInsert(CHConcurrentSkipListOperation *operation, id anObject) {
+	CHConcurrentSkipListNode *preds[kCHConcurrentSkipListMaximumLevels], *succs[kCHConcurrentSkipListMaximumLevels];
+	CHConcurrentSkipListNode *node = NULL;
+	uint32_t levels = CHConcurrentSkipListRandomLevels();
+	while (YES) {
+		if (CHConcurrentSkipListFind(operation, anObject, preds, succs)) {
+			// Swap in the new object. The old one is released once no other
+			// thread can be comparing against it, by retiring a node holding it.
+			id replaced = __atomic_exchange_n((void **) &succs[0]->object, (void *) [anObject retain], __ATOMIC_ACQ_REL);
+			if (node == NULL) {
+				node = CHConcurrentSkipListNodeCreate(nil, 0);
+			}
+			[node->object release];
+			node->object = replaced;
+			CHConcurrentSkipListRetire(operation, node);
+			return NO;
+		}
+		if (node == NULL) {
+			node = CHConcurrentSkipListNodeCreate(anObject, levels);
+		}
+		for (uint32_t level = 0; level < levels; level++) {
+			node->next[level] = (uintptr_t) succs[level];
+		}
+		// The node is in the skip list once it is linked at the bottom level.
+		if (CHConcurrentSkipListCAS(&preds[0]->next[0], (uintptr_t) succs[0], (uintptr_t) node)) {
+			break;
+		}
+	}
+	CHConcurrentSkipListAdjustCount(operation, 1);
+	for (uint32_t level = 1; level < levels; level++) {
+		while (YES) {
+			uintptr_t link = CHConcurrentSkipListNodeLink(node, level);
+			// Stop if the node is being removed (and its links are being marked).
+			if (CHMarked(link) ||
+			    (link != (uintptr_t) succs[level] && !CHConcurrentSkipListCAS(&node->next[level], link, (uintptr_t) succs[level]))) {
+				goto finished;
+			}
+			if (CHConcurrentSkipListCAS(&preds[level]->next[level], (uintptr_t) succs[level], (uintptr_t) node)) {
+				break;
+			}
+			if (!CHConcurrentSkipListFind(operation, anObject, preds, succs) || succs[0] != node) {
+				goto finished;
+			}
+		}
+	}
+finished:
+	CHConcurrentSkipListFinish(operation, node);
+	return YES;
+}
+
+// Removes a node found in the skip list, and returns whether this thread removed
+// it (rather than another thread).
+static BOOL CHConcurrentSkipListRemoveNode(CHConcurrentSkipListOperation *operation, CHConcurrentSkipListNode *node) {
+	for (uint32_t level = node->levels; level-- > 1; ) {
+		uintptr_t link = CHConcurrentSkipListNodeLink(node, level);
+		while (!CHMarked(link) && !CHConcurrentSkipListCAS(&node->next[level], link, link | 1)) {
+			link = CHConcurrentSkipListNodeLink(node, level);
+		}
+	}
+	// Whichever thread marks the bottom level removes the node.
+	uintptr_t link = CHConcurrentSkipListNodeLink(node, 0);
+	while (YES) {
+		if (CHMarked(link)) {
+			return NO;
+		}
+		if (CHConcurrentSkipListCAS(&node->next[0], link, link | 1)) {
+			break;
+		}
+		link = CHConcurrentSkipListNodeLink(node, 0);
+	}
+	CHConcurrentSkipListAdjustCount(operation, -1);
+	CHConcurrentSkipListFinish(operation, node);
+	return YES;
+}
+
+// Runs the statements as an operation on the skip list, in which the variable
+// operation is defined. The operation ends even if a comparison raises.
+#define CHWithOperation(...) { \
+	CHConcurrentSkipListOperation operation = CHConcurrentSkipListBegin(head, slots, &epoch); \
+	@try { __VA_ARGS__ } \
+	@finally { CHConcurrentSkipListEnd(&operation); } \
+}
+
+// Fast enumeration is weakly consistent, so it never raises a mutation exception.
+static unsigned long kCHConcurrentSkipListMutations = 0;
+
+#pragma mark -
+
+@implementation CHConcurrentSkipList
+
+- (void)dealloc {
+	// No other thread can be using the skip list, so everything can be freed.
+	CHConcurrentSkipListNode *node = CHUnmarked(head->next[0]);
+	while (node != NULL) {
+		CHConcurrentSkipListNode *next = CHUnmarked(node->next[0]);
+		CHConcurrentSkipListNodeFree(node);
+		node = next;
+	}
+	free(head);
+	for (NSUInteger i = 0; i < kCHConcurrentSkipListSlotCount; i++) {
+		for (NSUInteger j = 0; j < 3; j++) {
+			CHConcurrentSkipListFreeRetired(&slots[i], j);
+		}
+	}
+	free(slots);
+	[super dealloc];
+}
+
+// This is the designated initializer for CHConcurrentSkipList.
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		head = CHConcurrentSkipListNodeCreate(nil, kCHConcurrentSkipListMaximumLevels);
+		size_t size = sizeof(CHConcurrentSkipListSlot) * kCHConcurrentSkipListSlotCount;
+		posix_memalign((void **) &slots, kCHConcurrentSkipListSlotAlignment, size);
+		memset(slots, 0, size);
+		epoch = 0;
+	}
+	return self;
+}
+
+- (instancetype)initWithArray:(NSArray *)anArray {
+	self = [self init];
+	if (self) {
+		[self addObjectsFromArray:anArray];
+	}
+	return self;
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	return [self initWithArray:[decoder decodeObjectForKey:@"objects"]];
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[encoder encodeObject:[self allObjects] forKey:@"objects"];
+}
+
+#pragma mark <NSCopying>
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+	return [[[self class] allocWithZone:zone] initWithArray:[self allObjects]];
+}
+
+#pragma mark <NSFastEnumeration>
+
+// Each call is a separate operation, which returns the objects following the
+// last object from the previous call (kept in the extra state). The objects are
+// retained and autoreleased, since they may be removed between calls.
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	NSUInteger batchCount = 0;
+	CHWithOperation(
+		CHConcurrentSkipListNode *node;
+		if (state->state == 0) {
+			state->state = 1;
+			state->mutationsPtr = &kCHConcurrentSkipListMutations;
+			node = CHConcurrentSkipListNextNode(head, 0);
+		} else {
+			node = CHConcurrentSkipListSearch(&operation, (id) state->extra[0], YES, NULL);
+		}
+		while (batchCount < len && node != NULL) {
+			stackbuf[batchCount++] = [[CHConcurrentSkipListNodeObject(node) retain] autorelease];
+			node = CHConcurrentSkipListNextNode(node, 0);
+		}
+	)
+	if (batchCount > 0) {
+		state->extra[0] = (unsigned long) stackbuf[batchCount - 1];
+	}
+	state->itemsPtr = stackbuf;
+	return batchCount;
+}
+
+#pragma mark Querying Contents
+
+// Like enumeration, this is weakly consistent, so the object returned may have
+// been removed by another thread during the search.
+- (id)_objectNearestToObject:(id)anObject direction:(NSUInteger)direction inclusive:(BOOL)inclusive {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	id nearest = nil;
+	CHWithOperation(
+		CHConcurrentSkipListNode *node = CHConcurrentSkipListNearestNode(&operation, anObject, direction, inclusive);
+		if (node != NULL) {
+			nearest = [[CHConcurrentSkipListNodeObject(node) retain] autorelease];
+		}
+	)
+	return nearest;
+}
+
+- (NSArray *)allObjects {
+	NSMutableArray *array = [NSMutableArray array];
+	CHWithOperation(
+		for (CHConcurrentSkipListNode *node = CHConcurrentSkipListNextNode(head, 0); node != NULL;
+		     node = CHConcurrentSkipListNextNode(node, 0)) {
+			[array addObject:CHConcurrentSkipListNodeObject(node)];
+		}
+	)
+	return array;
+}
+
+- (id)anyObject {
+	return [self firstObject];
+}
+
+- (id)ceilingObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:YES];
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self member:anObject] != nil);
+}
+
+- (NSUInteger)count {
+	int64_t count = 0;
+	for (NSUInteger i = 0; i < kCHConcurrentSkipListSlotCount; i++) {
+		count += __atomic_load_n(&slots[i].countDelta, __ATOMIC_RELAXED);
+	}
+	return (count > 0) ? (NSUInteger) count : 0;
+}
+
+- (NSString *)description {
+	return [[self allObjects] description];
+}
+
+- (id)firstObject {
+	id anObject = nil;
+	CHWithOperation(
+		CHConcurrentSkipListNode *node = CHConcurrentSkipListNextNode(head, 0);
+		if (node != NULL) {
+			anObject = [[CHConcurrentSkipListNodeObject(node) retain] autorelease];
+		}
+	)
+	return anObject;
+}
+
+- (id)floorObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:YES];
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects([self count], [self firstObject], [self lastObject]);
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
+		return [self isEqualToSortedSet:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+- (BOOL)isEqualToSortedSet:(id<CHSortedSet>)otherSortedSet {
+	return CHCollectionsAreEqual(self, otherSortedSet);
+}
+
+- (id)lastObject {
+	id anObject = nil;
+	CHWithOperation(
+		CHConcurrentSkipListNode *node = CHConcurrentSkipListLastNode(&operation);
+		if (node != NULL) {
+			anObject = [[CHConcurrentSkipListNodeObject(node) retain] autorelease];
+		}
+	)
+	return anObject;
+}
+
+- (id)member:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	id member = nil;
+	CHWithOperation(
+		CHConcurrentSkipListNode *node = CHConcurrentSkipListSearch(&operation, anObject, NO, NULL);
+		if (node != NULL && !CHMarked(CHConcurrentSkipListNodeLink(node, 0))) {
+			id candidate = CHConcurrentSkipListNodeObject(node);
+			if (CHComparisonCompare(&operation.ordering, candidate, anObject) == NSOrderedSame) {
+				member = [[candidate retain] autorelease];
+			}
+		}
+	)
+	return member;
+}
+
+- (id)objectAfter:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:NO];
+}
+
+- (id)objectBefore:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:NO];
+}
+
+- (NSEnumerator *)objectEnumerator {
+	return [[self allObjects] objectEnumerator];
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	return [[self allObjects] reverseObjectEnumerator];
+}
+
+- (NSSet *)set {
+	return [NSSet setWithArray:[self allObjects]];
+}
+
+/*
+ \copydoc CHSortedSet::subsetFromObject:toObject:
+
+ \attention This implementation is weakly consistent, like enumeration.
+ */
+- (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	// If both parameters are nil, return a copy containing all the objects.
+	if (start == nil && end == nil) {
+		return [[self copy] autorelease];
+	}
+	// Objects must be at or above start, and at or below end, unless end doesn't
+	// come after start (in which case either will do). As for other trees, equal
+	// endpoints include everything, or everything but the endpoint if excluded.
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	BOOL includesLow = !(options & CHSubsetConstructionExcludeLowEndpoint);
+	BOOL includesHigh = !(options & CHSubsetConstructionExcludeHighEndpoint);
+	NSComparisonResult comparison = (start != nil && end != nil) ? CHComparisonCompare(&ordering, start, end) : NSOrderedAscending;
+	BOOL isInverted = (comparison != NSOrderedAscending);
+	if (comparison == NSOrderedSame && !(includesLow && includesHigh)) {
+		includesLow = includesHigh = NO;
+	}
+	NSMutableArray *objects = [NSMutableArray array];
+	for (id anObject in self) {
+		NSComparisonResult low = (start != nil) ? CHComparisonCompare(&ordering, anObject, start) : NSOrderedDescending;
+		NSComparisonResult high = (end != nil) ? CHComparisonCompare(&ordering, anObject, end) : NSOrderedAscending;
+		BOOL isAboveLow = (low == NSOrderedDescending || (includesLow && low == NSOrderedSame));
+		BOOL isBelowHigh = (high == NSOrderedAscending || (includesHigh && high == NSOrderedSame));
+		if (isInverted ? (isAboveLow || isBelowHigh) : (isAboveLow && isBelowHigh)) {
+			[objects addObject:anObject];
+		}
+	}
+	return [[[[self class] alloc] initWithArray:objects] autorelease];
+}
+
+#pragma mark Modifying Contents
+
+- (void)addObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHWithOperation(
+		CHConcurrentSkipListInsert(&operation, anObject);
+	)
+}
+
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	for (id anObject in anArray) {
+		[self addObject:anObject];
+	}
+}
+
+- (void)removeAllObjects {
+	CHWithOperation(
+		CHConcurrentSkipListNode *node;
+		while ((node = CHConcurrentSkipListNextNode(head, 0)) != NULL) {
+			CHConcurrentSkipListRemoveNode(&operation, node);
+		}
+	)
+}
+
+// If another thread removes the first object first, the next one is removed.
+- (void)removeFirstObject {
+	CHWithOperation(
+		CHConcurrentSkipListNode *node;
+		while ((node = CHConcurrentSkipListNextNode(head, 0)) != NULL &&
+		       !CHConcurrentSkipListRemoveNode(&operation, node))
+		{}
+	)
+}
+
+- (void)removeLastObject {
+	CHWithOperation(
+		CHConcurrentSkipListNode *node;
+		while ((node = CHConcurrentSkipListLastNode(&operation)) != NULL && !CHConcurrentSkipListRemoveNode(&operation, node))
+		{}
+	)
+}
+
+- (void)removeObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHWithOperation(
+		CHConcurrentSkipListNode *preds[kCHConcurrentSkipListMaximumLevels], *succs[kCHConcurrentSkipListMaximumLevels];
+		if (CHConcurrentSkipListFind(&operation, anObject, preds, succs)) {
+			CHConcurrentSkipListRemoveNode(&operation, succs[0]);
+		}
+	)
+}
+
+@end
@@ -0,0 +1,51 @@
+//
+//  CHConcurrentSortedSet.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHSortedSet.h>
+#import <pthread.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHConcurrentSortedSet.h
+ A CHSortedSet wrapper that many threads can read at once while one thread modifies it.
+ */
+
+/**
+ A sorted set that can be shared by several threads, which wraps another CHSortedSet and guards it with a reader/writer lock. Any number of threads may search or enumerate the set at the same time, while methods that modify the set wait until no other thread is using it.
+
+ This relies on the wrapped set not modifying itself when it is only read. Binary search trees (subclasses of CHAbstractBinarySearchTree) search without storing anything in the tree, as do CHBPlusTree and CHInt64SortedSet, so any of them may be wrapped. The exception is CHSplayTree, which reorganizes itself on every search, and must not be wrapped. Once a set has been wrapped, it must only be used through the wrapper.
+
+ Objects returned by \link #member: -member:\endlink, \link #firstObject -firstObject\endlink, and similar methods are retained and autoreleased before the lock is released, so they remain valid even if another thread removes them from the set. Enumerators and fast enumeration work on a snapshot of the set taken when enumeration begins, so they never raise a mutation exception, and another thread can modify the set during enumeration without affecting it.
+ */
+@interface CHConcurrentSortedSet<__covariant ObjectType> : NSObject <CHSortedSet>
+{
+	id<CHSortedSet> sortedSet; // The wrapped set, used only while holding the lock.
+	pthread_rwlock_t lock; // Held by any number of readers, or a single writer.
+}
+
+/**
+ Initialize a concurrent sorted set that wraps an AVL tree (which has the shortest height of the binary search trees, and is thus fastest to search) containing the objects in an array.
+
+ @param anArray An array containing objects with which to populate a new sorted set.
+ @return An initialized concurrent sorted set that contains the objects in @a anArray.
+ */
+- (instancetype)initWithArray:(NSArray<ObjectType> *)anArray;
+
+/**
+ Initialize a concurrent sorted set that wraps an existing sorted set.
+
+ @param aSortedSet The sorted set to wrap, which is retained. It must not be used directly afterward, except through the receiver.
+ @return An initialized concurrent sorted set that contains the objects in @a aSortedSet.
+
+ @throw NSInvalidArgumentException if @a aSortedSet is @c nil.
+ */
+- (instancetype)initWithSortedSet:(id<CHSortedSet>)aSortedSet NS_DESIGNATED_INITIALIZER;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,291 @@
+//
+//  CHConcurrentSortedSet.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHConcurrentSortedSet.h>
+#import <CHDataStructures/CHAVLTree.h>
+
+// Runs the statements while holding the lock for reading (shared with other
+// readers) or for writing (exclusive). The lock is released even if the wrapped
+// set raises an exception, such as from a comparison.
+#define CHWithReadLock(...) { \
+	pthread_rwlock_rdlock(&lock); \
+	@try { __VA_ARGS__ } \
+	@finally { pthread_rwlock_unlock(&lock); } \
+}
+
+#define CHWithWriteLock(...) { \
+	pthread_rwlock_wrlock(&lock); \
+	@try { __VA_ARGS__ } \
+	@finally { pthread_rwlock_unlock(&lock); } \
+}
+
+// Fast enumeration works on a snapshot, which can't change during enumeration.
+static unsigned long kCHSnapshotMutations = 0;
+
+@implementation CHConcurrentSortedSet
+
+- (void)dealloc {
+	[sortedSet release];
+	pthread_rwlock_destroy(&lock);
+	[super dealloc];
+}
+
+- (instancetype)init {
+	return [self initWithArray:@[]];
+}
+
+- (instancetype)initWithArray:(NSArray *)anArray {
+	return [self initWithSortedSet:[[[CHAVLTree alloc] initWithArray:anArray] autorelease]];
+}
+
+- (instancetype)initWithSortedSet:(id<CHSortedSet>)aSortedSet {
+	CHRaiseInvalidArgumentExceptionIfNil(aSortedSet);
+	self = [super init];
+	if (self) {
+		sortedSet = [aSortedSet retain];
+		pthread_rwlock_init(&lock, NULL);
+	}
+	return self;
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	return [self initWithSortedSet:[decoder decodeObjectForKey:@"sortedSet"]];
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	CHWithReadLock(
+		[encoder encodeObject:sortedSet forKey:@"sortedSet"];
+	)
+}
+
+#pragma mark <NSCopying>
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+	id<CHSortedSet> copiedSet;
+	CHWithReadLock(
+		copiedSet = [sortedSet copy];
+	)
+	CHConcurrentSortedSet *copy = [[CHConcurrentSortedSet allocWithZone:zone] initWithSortedSet:copiedSet];
+	[copiedSet release];
+	return copy;
+}
+
+#pragma mark <NSFastEnumeration>
+
+// The snapshot is autoreleased, so nothing leaks if enumeration stops early.
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	NSArray *snapshot;
+	if (state->state == 0) {
+		snapshot = [self allObjects];
+		state->state = 1;
+		state->mutationsPtr = &kCHSnapshotMutations;
+		state->extra[0] = (unsigned long) snapshot;
+		state->extra[1] = 0;
+	} else {
+		snapshot = (NSArray *) state->extra[0];
+	}
+	NSUInteger index = (NSUInteger) state->extra[1];
+	NSUInteger batchCount = MIN(len, [snapshot count] - index);
+	[snapshot getObjects:stackbuf range:NSMakeRange(index, batchCount)];
+	state->extra[1] = (unsigned long) (index + batchCount);
+	state->itemsPtr = stackbuf;
+	return batchCount;
+}
+
+#pragma mark Querying Contents
+
+- (NSArray *)allObjects {
+	NSArray *allObjects;
+	CHWithReadLock(
+		allObjects = [sortedSet allObjects];
+	)
+	return allObjects;
+}
+
+- (id)anyObject {
+	id anObject;
+	CHWithReadLock(
+		anObject = [[[sortedSet anyObject] retain] autorelease];
+	)
+	return anObject;
+}
+
+- (id)ceilingObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	id nearest;
+	CHWithReadLock(
+		nearest = [[[sortedSet ceilingObject:anObject] retain] autorelease];
+	)
+	return nearest;
+}
+
+- (BOOL)containsObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	BOOL containsObject;
+	CHWithReadLock(
+		containsObject = [sortedSet containsObject:anObject];
+	)
+	return containsObject;
+}
+
+- (NSUInteger)count {
+	NSUInteger count;
+	CHWithReadLock(
+		count = [sortedSet count];
+	)
+	return count;
+}
+
+- (NSString *)description {
+	NSString *description;
+	CHWithReadLock(
+		description = [sortedSet description];
+	)
+	return description;
+}
+
+- (id)firstObject {
+	id anObject;
+	CHWithReadLock(
+		anObject = [[[sortedSet firstObject] retain] autorelease];
+	)
+	return anObject;
+}
+
+- (id)floorObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	id nearest;
+	CHWithReadLock(
+		nearest = [[[sortedSet floorObject:anObject] retain] autorelease];
+	)
+	return nearest;
+}
+
+- (NSUInteger)hash {
+	NSUInteger hash;
+	CHWithReadLock(
+		hash = [sortedSet hash];
+	)
+	return hash;
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
+		return [self isEqualToSortedSet:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+// The lock isn't held while the other set is read, since it may also be locked.
+- (BOOL)isEqualToSortedSet:(id<CHSortedSet>)otherSortedSet {
+	return CHCollectionsAreEqual(self, otherSortedSet);
+}
+
+- (id)lastObject {
+	id anObject;
+	CHWithReadLock(
+		anObject = [[[sortedSet lastObject] retain] autorelease];
+	)
+	return anObject;
+}
+
+- (id)member:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	id member;
+	CHWithReadLock(
+		member = [[[sortedSet member:anObject] retain] autorelease];
+	)
+	return member;
+}
+
+- (id)objectAfter:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	id nearest;
+	CHWithReadLock(
+		nearest = [[[sortedSet objectAfter:anObject] retain] autorelease];
+	)
+	return nearest;
+}
+
+- (id)objectBefore:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	id nearest;
+	CHWithReadLock(
+		nearest = [[[sortedSet objectBefore:anObject] retain] autorelease];
+	)
+	return nearest;
+}
+
+- (NSEnumerator *)objectEnumerator {
+	return [[self allObjects] objectEnumerator];
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	return [[self allObjects] reverseObjectEnumerator];
+}
+
+- (NSSet *)set {
+	NSSet *set;
+	CHWithReadLock(
+		set = [sortedSet set];
+	)
+	return set;
+}
+
+// The subset is an ordinary sorted set of the wrapped class, and isn't shared.
+- (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	id<CHSortedSet> subset;
+	CHWithReadLock(
+		subset = [sortedSet subsetFromObject:start toObject:end options:options];
+	)
+	return subset;
+}
+
+#pragma mark Modifying Contents
+
+- (void)addObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHWithWriteLock(
+		[sortedSet addObject:anObject];
+	)
+}
+
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	CHWithWriteLock(
+		[sortedSet addObjectsFromArray:anArray];
+	)
+}
+
+- (void)removeAllObjects {
+	CHWithWriteLock(
+		[sortedSet removeAllObjects];
+	)
+}
+
+- (void)removeFirstObject {
+	CHWithWriteLock(
+		[sortedSet removeFirstObject];
+	)
+}
+
+- (void)removeLastObject {
+	CHWithWriteLock(
+		[sortedSet removeLastObject];
+	)
+}
+
+- (void)removeObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHWithWriteLock(
+		[sortedSet removeObject:anObject];
+	)
+}
+
+@end
@@ -21,11 +21,17 @@
 #import <CHDataStructures/CHBidirectionalDictionary.h>
 #import <CHDataStructures/CHBinaryHeap.h>
 #import <CHDataStructures/CHAVLTree.h>
+#import <CHDataStructures/CHBPlusTree.h>
 #import <CHDataStructures/CHCircularBuffer.h>
 #import <CHDataStructures/CHCircularBufferDeque.h>
 #import <CHDataStructures/CHCircularBufferQueue.h>
 #import <CHDataStructures/CHCircularBufferStack.h>
+#import <CHDataStructures/CHConcurrentSkipList.h>
+#import <CHDataStructures/CHConcurrentSortedSet.h>
 #import <CHDataStructures/CHDoublyLinkedList.h>
+#import <CHDataStructures/CHFrozenSortedSet.h>
+#import <CHDataStructures/CHImplicitTreap.h>
+#import <CHDataStructures/CHInt64SortedSet.h>
 #import <CHDataStructures/CHListDeque.h>
 #import <CHDataStructures/CHListQueue.h>
 #import <CHDataStructures/CHListStack.h>
@@ -33,9 +39,12 @@
 #import <CHDataStructures/CHMutableArrayHeap.h>
 #import <CHDataStructures/CHOrderedDictionary.h>
 #import <CHDataStructures/CHOrderedSet.h>
+#import <CHDataStructures/CHPersistentAVLTree.h>
 #import <CHDataStructures/CHRedBlackTree.h>
+#import <CHDataStructures/CHScapegoatTree.h>
 #import <CHDataStructures/CHSinglyLinkedList.h>
 #import <CHDataStructures/CHSortedDictionary.h>
+#import <CHDataStructures/CHSplayTree.h>
 #import <CHDataStructures/CHTreap.h>
 #import <CHDataStructures/CHUnbalancedTree.h>
 
@@ -0,0 +1,56 @@
+//
+//  CHFrozenSortedSet.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHSortedSet.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHFrozenSortedSet.h
+ An immutable implementation of CHSortedSet, stored in a single array in Eytzinger order for fast searching.
+ */
+
+/**
+ An immutable sorted set, built once from an array or another sorted set, whose objects are stored in a single array in <a href="https://arxiv.org/abs/1509.05053">Eytzinger order</a> (the order of a breadth-first traversal of a perfectly balanced binary search tree). The children of the object at index @a k are at indexes 2k and 2k+1, so the array is an implicit binary search tree: no links are stored, and each object takes only the space of a single pointer, where tree classes such as CHRedBlackTree use a node of several pointers for each object.
+
+ A search (such as \link #member: -member:\endlink or \link #ceilingObject: -ceilingObject:\endlink) descends the implicit tree from index 1 to the bottom without leaving the loop early, choosing the next index arithmetically from the result of each comparison rather than with a branch. Since the eight descendants of a node three levels down occupy contiguous slots (a single cache line), each step prefetches that line, so the memory for several levels of the search is loaded in parallel rather than one level at a time. The objects near the top of the tree, which every search visits, are packed together at the start of the array.
+
+ Objects are ordered by their @c -compare: method, which (as in CHAbstractBinarySearchTree) is looked up once per operation and then called directly. The set is built in O(n log n) time, or O(n) if the objects are already in ascending order, as they are when taken from a sorted set that uses @c -compare:. Finding the next object in ascending order (as when enumerating) takes amortized O(1) time.
+
+ Any method that would modify the set raises an exception. Copying the set returns the same set, and a subset is a new CHFrozenSortedSet, built in O(log n + k) time for k objects.
+ */
+@interface CHFrozenSortedSet<__covariant ObjectType> : NSObject <CHSortedSet>
+{
+	__unsafe_unretained id *objects; // The objects in Eytzinger order, from index 1.
+	NSUInteger count; // The number of objects in the set; it never changes.
+}
+
+/**
+ Initialize a frozen sorted set with the contents of an array.
+
+ The array is sorted (unless it is already in ascending order). If several objects in the array compare as equal, only the one occurring last in @a anArray is kept, just as if each had been added to a mutable sorted set in turn.
+
+ @param anArray An array containing the objects with which to populate the new set.
+ @return An initialized frozen sorted set that contains the objects in @a anArray in sorted order.
+ */
+- (instancetype)initWithArray:(NSArray<ObjectType> *)anArray NS_DESIGNATED_INITIALIZER;
+
+/**
+ Initialize a frozen sorted set with the contents of another sorted set.
+
+ @param sortedSet A sorted set containing the objects with which to populate the new set.
+ @return An initialized frozen sorted set that contains the objects in @a sortedSet, ordered by their @c -compare: method.
+
+ @throw NSInvalidArgumentException if @a sortedSet is @c nil.
+
+ @attention If @a sortedSet orders its objects some other way (such as a tree created with a comparator), the objects are sorted again.
+ */
+- (instancetype)initWithSortedSet:(id<CHSortedSet>)sortedSet;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,454 @@
+//
+//  CHFrozenSortedSet.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHFrozenSortedSet.h>
+
+// The array of objects is aligned to a cache line, so that the slots for the
+// descendants of an object three levels down (8k to 8k+7) share a single line.
+#define kCHFrozenSortedSetAlignment 64
+#define kCHFrozenSortedSetPrefetchDistance 8
+
+#pragma mark Eytzinger layout
+
+// Stores sorted objects in the slots of the implicit subtree rooted at index k,
+// in the same order as an in-order traversal, and returns the index of the next
+// sorted object. The recursion only goes log2(count) deep.
+static NSUInteger CHFrozenSortedSetFill(__unsafe_unretained id *objects, NSUInteger count, NSUInteger k, __unsafe_unretained id *sorted, NSUInteger next) {
+	if (k <= count) {
+		next = CHFrozenSortedSetFill(objects, count, 2 * k, sorted, next);
+		objects[k] = [sorted[next++] retain];
+		next = CHFrozenSortedSetFill(objects, count, 2 * k + 1, sorted, next);
+	}
+	return next;
+}
+
+// Returns the index of the first (if dir is 0) or last (if 1) object, or 0 if
+// there are no objects.
+static inline NSUInteger CHFrozenSortedSetEnd(NSUInteger count, NSUInteger dir) {
+	if (count == 0) {
+		return 0;
+	}
+	NSUInteger k = 1;
+	while (2 * k + dir <= count) {
+		k = 2 * k + dir;
+	}
+	return k;
+}
+
+// Returns the index of the object after (if dir is 1) or before (if 0) the one
+// at index k, or 0 if there is none. This is the nearest object in the subtree on
+// that side, if there is one, or else the nearest ancestor on that side.
+static inline NSUInteger CHFrozenSortedSetStep(NSUInteger k, NSUInteger count, NSUInteger dir) {
+	if (2 * k + dir <= count) {
+		k = 2 * k + dir;
+		while (2 * k + !dir <= count) {
+			k = 2 * k + !dir;
+		}
+		return k;
+	}
+	// Climb past each ancestor reached from its child on that side.
+	while ((k & 1) == dir) {
+		k >>= 1;
+	}
+	return k >> 1;
+}
+
+// Returns the index of the first object greater than anObject (if after is YES)
+// or not less than it (if NO), or 0 if there is none.
+//
+// The search never stops early: it goes down to an empty slot below the bottom
+// level, and the index of each step is computed from the comparison instead of
+// branching on it. The index records the path taken, one bit per level, and the
+// answer is the last node from which the path went left, which is found by
+// removing the trailing 1 bits (the steps to the right after it) and one more.
+static inline NSUInteger CHFrozenSortedSetSearch(__unsafe_unretained id *objects, NSUInteger count, id anObject, BOOL after, CHComparison *ordering) {
+	NSUInteger k = 1;
+	while (k <= count) {
+		__builtin_prefetch(objects + kCHFrozenSortedSetPrefetchDistance * k);
+		k = 2 * k + (CHComparisonCompare(ordering, objects[k], anObject) < (NSComparisonResult) after);
+	}
+	return k >> (__builtin_ctzl(~k) + 1);
+}
+
+#pragma mark -
+
+/**
+ An NSEnumerator for traversing a CHFrozenSortedSet in ascending or descending order, by stepping from each index to the next in the implicit tree.
+ */
+@interface CHFrozenSortedSetEnumerator : NSEnumerator
+
+- (instancetype)initWithSet:(CHFrozenSortedSet *)set
+                    objects:(__unsafe_unretained id *)objects
+                      count:(NSUInteger)count
+                    reverse:(BOOL)reverse;
+
+@end
+
+@implementation CHFrozenSortedSetEnumerator
+{
+	__strong CHFrozenSortedSet *sortedSet; // The set being enumerated.
+	__unsafe_unretained id *objects; // The objects of the set in Eytzinger order.
+	NSUInteger count; // The number of objects in the set.
+	NSUInteger index; // The index of the next object, or 0 if there are no more.
+	NSUInteger dir; // The direction in which to step (1 if ascending).
+}
+
+/**
+ Create an enumerator which traverses a given set in ascending or descending order.
+
+ @param set The set being enumerated. This collection is to be retained while the enumerator has not exhausted all its objects.
+ @param setObjects The objects of @a set in Eytzinger order.
+ @param setCount The number of objects in @a set.
+ @param reverse Whether to enumerate the objects in descending order.
+ @return An initialized CHFrozenSortedSetEnumerator which will enumerate objects in @a set.
+ */
+- (instancetype)initWithSet:(CHFrozenSortedSet *)set
+                    objects:(__unsafe_unretained id *)setObjects
+                      count:(NSUInteger)setCount
+                    reverse:(BOOL)reverse
+{
+	self = [super init];
+	if (self) {
+		objects = setObjects;
+		count = setCount;
+		dir = reverse ? 0 : 1;
+		index = CHFrozenSortedSetEnd(count, !dir);
+		if (index != 0) {
+			sortedSet = [set retain];
+		}
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[sortedSet release];
+	[super dealloc];
+}
+
+- (id)nextObject {
+	if (index == 0) {
+		return nil;
+	}
+	id anObject = objects[index];
+	index = CHFrozenSortedSetStep(index, count, dir);
+	if (index == 0) {
+		// Keep the last object alive after the set is released.
+		[[anObject retain] autorelease];
+		[sortedSet release];
+		sortedSet = nil;
+	}
+	return anObject;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CHFrozenSortedSet
+
+- (void)dealloc {
+	for (NSUInteger k = 1; k <= count; k++) {
+		[objects[k] release];
+	}
+	free(objects);
+	[super dealloc];
+}
+
+- (instancetype)init {
+	return [self initWithArray:@[]];
+}
+
+// This is the designated initializer for CHFrozenSortedSet.
+- (instancetype)initWithArray:(NSArray *)anArray {
+	self = [super init];
+	if (self) {
+		NSUInteger arrayCount = [anArray count];
+		if (arrayCount == 0) {
+			return self;
+		}
+		__unsafe_unretained id *sorted = (__unsafe_unretained id *) malloc(kCHPointerSize * arrayCount);
+		[anArray getObjects:sorted range:NSMakeRange(0, arrayCount)];
+		CHComparison ordering = {NULL, NULL, Nil, NULL};
+		NSUInteger index = 1;
+		while (index < arrayCount && CHComparisonCompare(&ordering, sorted[index-1], sorted[index]) == NSOrderedAscending) {
+			index++;
+		}
+		if (index < arrayCount) {
+			// A stable sort means the last of several equal objects is kept, just as
+			// if each one had been added to a mutable sorted set in turn.
+			__block CHComparison sortOrdering = ordering;
+			NSArray *sortedArray = [anArray sortedArrayWithOptions:NSSortStable
+			                                       usingComparator:^(id object1, id object2) {
+				return CHComparisonCompare(&sortOrdering, object1, object2);
+			}];
+			[sortedArray getObjects:sorted range:NSMakeRange(0, arrayCount)];
+			NSUInteger uniqueCount = 0;
+			for (index = 0; index < arrayCount; index++) {
+				if (index + 1 < arrayCount && CHComparisonCompare(&ordering, sorted[index], sorted[index+1]) == NSOrderedSame) {
+					continue;
+				}
+				sorted[uniqueCount++] = sorted[index];
+			}
+			arrayCount = uniqueCount;
+		}
+		[self _fillWithSortedObjects:sorted count:arrayCount];
+		free(sorted);
+	}
+	return self;
+}
+
+- (instancetype)initWithSortedSet:(id<CHSortedSet>)sortedSet {
+	CHRaiseInvalidArgumentExceptionIfNil(sortedSet);
+	return [self initWithArray:[sortedSet allObjects]];
+}
+
+// Slot 0 is never used, so that the children of index k are at 2k and 2k+1.
+- (void)_fillWithSortedObjects:(__unsafe_unretained id *)sorted count:(NSUInteger)sortedCount {
+	if (sortedCount == 0) {
+		return;
+	}
+	void *slots = NULL;
+	if (posix_memalign(&slots, kCHFrozenSortedSetAlignment, kCHPointerSize * (sortedCount + 1)) != 0) {
+		[NSException raise:NSMallocException format:@"%s -- Unable to allocate %lu objects", __PRETTY_FUNCTION__, (unsigned long)sortedCount];
+	}
+	objects = (__unsafe_unretained id *) slots;
+	objects[0] = nil;
+	count = sortedCount;
+	CHFrozenSortedSetFill(objects, count, 1, sorted, 0);
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	return [self initWithArray:[decoder decodeObjectForKey:@"objects"]];
+}
+
+// Since the objects are archived in ascending order, the set is rebuilt in
+// linear time when it is unarchived.
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[encoder encodeObject:[self allObjects] forKey:@"objects"];
+}
+
+#pragma mark <NSCopying>
+
+// The set can never change, so it can simply be shared.
+- (instancetype)copyWithZone:(NSZone *)zone {
+	return [self retain];
+}
+
+#pragma mark <NSFastEnumeration>
+
+// The index of the next object is kept in the extra state. Since the set never
+// changes, the mutation pointer refers to its count.
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	NSUInteger k;
+	if (state->state == 0) {
+		state->state = 1;
+		state->mutationsPtr = (unsigned long *) &count;
+		k = CHFrozenSortedSetEnd(count, 0);
+	} else {
+		k = state->extra[0];
+	}
+	NSUInteger batchCount = 0;
+	while (batchCount < len && k != 0) {
+		stackbuf[batchCount++] = objects[k];
+		k = CHFrozenSortedSetStep(k, count, 1);
+	}
+	state->extra[0] = k;
+	state->itemsPtr = stackbuf;
+	return batchCount;
+}
+
+#pragma mark Querying Contents
+
+// Returns the object nearest to anObject below it (if direction is 0) or above
+// it (if 1), or one equal to it if inclusive is YES, or nil if there is none.
+// The nearest object below is the one before the nearest object above.
+- (id)_objectNearestToObject:(id)anObject direction:(NSUInteger)direction inclusive:(BOOL)inclusive {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	NSUInteger k = CHFrozenSortedSetSearch(objects, count, anObject, (direction == 0) == inclusive, &ordering);
+	if (direction == 0) {
+		k = (k != 0) ? CHFrozenSortedSetStep(k, count, 0) : CHFrozenSortedSetEnd(count, 1);
+	}
+	return (k != 0) ? objects[k] : nil;
+}
+
+- (NSArray *)allObjects {
+	NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+	for (id anObject in self) {
+		[array addObject:anObject];
+	}
+	return array;
+}
+
+- (id)anyObject {
+	return (count > 0) ? objects[1] : nil;
+}
+
+- (id)ceilingObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:YES];
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self member:anObject] != nil);
+}
+
+- (NSUInteger)count {
+	return count;
+}
+
+- (NSString *)description {
+	return [[self allObjects] description];
+}
+
+- (id)firstObject {
+	return (count > 0) ? objects[CHFrozenSortedSetEnd(count, 0)] : nil;
+}
+
+- (id)floorObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:YES];
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects(count, [self firstObject], [self lastObject]);
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
+		return [self isEqualToSortedSet:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+- (BOOL)isEqualToSortedSet:(id<CHSortedSet>)otherSortedSet {
+	return CHCollectionsAreEqual(self, otherSortedSet);
+}
+
+- (id)lastObject {
+	return (count > 0) ? objects[CHFrozenSortedSetEnd(count, 1)] : nil;
+}
+
+// The search finds the first object not less than anObject, so it is only a
+// member if that object is equal to it.
+- (id)member:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	NSUInteger k = CHFrozenSortedSetSearch(objects, count, anObject, NO, &ordering);
+	if (k == 0 || CHComparisonCompare(&ordering, objects[k], anObject) != NSOrderedSame) {
+		return nil;
+	}
+	return objects[k];
+}
+
+- (id)objectAfter:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:NO];
+}
+
+- (id)objectBefore:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:NO];
+}
+
+- (NSEnumerator *)objectEnumerator {
+	return [[[CHFrozenSortedSetEnumerator alloc] initWithSet:self
+	                                                 objects:objects
+	                                                   count:count
+	                                                 reverse:NO] autorelease];
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	return [[[CHFrozenSortedSetEnumerator alloc] initWithSet:self
+	                                                 objects:objects
+	                                                   count:count
+	                                                 reverse:YES] autorelease];
+}
+
+- (NSSet *)set {
+	NSMutableSet *set = [NSMutableSet setWithCapacity:count];
+	for (id anObject in self) {
+		[set addObject:anObject];
+	}
+	return set;
+}
+
+/*
+ \copydoc CHSortedSet::subsetFromObject:toObject:
+
+ \attention This implementation searches for the first object in the range, then steps through the objects in ascending order until passing the end of the range, so it takes O(log n + k) time for a subset of k objects.
+ */
+- (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	// If both parameters are nil, the subset would contain all the objects.
+	if (start == nil && end == nil) {
+		return [[self retain] autorelease];
+	}
+	CHFrozenSortedSet *subset = [[[[self class] alloc] init] autorelease];
+	if (count == 0) {
+		return subset;
+	}
+	// Objects must be at or above start, and at or below end, unless end doesn't
+	// come after start (in which case either will do). As for other sorted sets,
+	// equal endpoints include everything, or everything but the endpoint if excluded.
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	BOOL includesLow = !(options & CHSubsetConstructionExcludeLowEndpoint);
+	BOOL includesHigh = !(options & CHSubsetConstructionExcludeHighEndpoint);
+	NSComparisonResult comparison = (start != nil && end != nil) ? CHComparisonCompare(&ordering, start, end) : NSOrderedAscending;
+	if (comparison == NSOrderedSame) {
+		if (includesLow && includesHigh) {
+			return [[self retain] autorelease];
+		}
+		includesLow = includesHigh = NO;
+	}
+	// The objects below the high endpoint start at the first object if the range
+	// is inverted, and those above the low endpoint continue to the last object.
+	NSUInteger low = (start != nil) ? CHFrozenSortedSetSearch(objects, count, start, !includesLow, &ordering)
+	                                : CHFrozenSortedSetEnd(count, 0);
+	NSUInteger high = (end != nil) ? CHFrozenSortedSetSearch(objects, count, end, includesHigh, &ordering) : 0;
+	NSUInteger runs[2][2] = {{low, high}, {0, 0}};
+	if (comparison != NSOrderedAscending) {
+		runs[0][0] = CHFrozenSortedSetEnd(count, 0);
+		runs[1][0] = low;
+	}
+	__unsafe_unretained id *sorted = (__unsafe_unretained id *) malloc(kCHPointerSize * count);
+	NSUInteger sortedCount = 0;
+	for (NSUInteger run = 0; run < 2; run++) {
+		for (NSUInteger k = runs[run][0]; k != runs[run][1]; k = CHFrozenSortedSetStep(k, count, 1)) {
+			sorted[sortedCount++] = objects[k];
+		}
+	}
+	[subset _fillWithSortedObjects:sorted count:sortedCount];
+	free(sorted);
+	return subset;
+}
+
+#pragma mark Modifying Contents
+
+- (void)addObject:(id)anObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeAllObjects {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeFirstObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeLastObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+- (void)removeObject:(id)anObject {
+	CHRaiseUnsupportedOperationException();
+}
+
+@end
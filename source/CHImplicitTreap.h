@@ -0,0 +1,78 @@
+//
+//  CHImplicitTreap.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHLinkedList.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHImplicitTreap.h
+ An implicit treap implementation of CHLinkedList, with O(log n) access by index.
+ */
+
+struct CHBinaryTreeNode; // Defined in CHAbstractBinarySearchTree.h
+
+/**
+ An <a href="http://en.wikipedia.org/wiki/Treap#Implicit_treap">implicit treap</a>, a sequence of objects stored in a treap which is ordered by position rather than by comparing objects. Like CHTreap, it uses CHBinaryTreeNode structs, each with a random priority, and keeps the nodes arranged so that every node has a higher priority than its children, which makes the tree balanced with high probability. Unlike CHTreap, a node's place in the tree is never found by calling @c -compare: — each node records the size of its subtree, and the index of a node is the number of nodes that precede it in an in-order traversal, so the position of any index can be found by descending from the root, comparing the index against the size of each left subtree.
+
+ This gives a list with O(log n) expected time for \link #objectAtIndex: -objectAtIndex:\endlink, \link #insertObject:atIndex: -insertObject:atIndex:\endlink, \link #removeObjectAtIndex: -removeObjectAtIndex:\endlink and \link #replaceObjectAtIndex:withObject: -replaceObjectAtIndex:withObject:\endlink, wherever the index is in the list, where CHDoublyLinkedList and NSMutableArray take O(n) time for changes in the middle of a long list. Insertion and removal use the same rotations as CHTreap: a new node is added as a leaf and rotated up past any parent with a lower priority, and a node is removed by rotating it down until it becomes a leaf.
+
+ Two operations are made possible by the lack of a search key. \link #splitAtIndex: -splitAtIndex:\endlink moves the objects from an index onward into a new treap, and \link #concatenateTreap: -concatenateTreap:\endlink moves all the objects of another treap onto the end of the receiver; both take O(log n) expected time, no matter how many objects are moved. Together, these make it possible to cut and paste ranges of a long sequence (such as the text of a document or a playlist) in logarithmic time. \link #initWithArray: -initWithArray:\endlink and \link #addObjectsFromArray: -addObjectsFromArray:\endlink build a balanced subtree from the array in O(n) time, with priorities chosen as in CHTreap, rather than inserting the objects one at a time.
+
+ Searching for an object (as in \link #indexOfObject: -indexOfObject:\endlink or \link #removeObject: -removeObject:\endlink) still takes O(n) time, since the objects have no order that can guide a search. The price of fast indexed access is that each node has a parent link, subtree size and priority in addition to two child links, so an implicit treap uses more memory than a linked list.
+ */
+@interface CHImplicitTreap<__covariant ObjectType> : NSObject <CHLinkedList>
+{
+	struct CHBinaryTreeNode *header; // Dummy header; its right child is the root.
+	NSUInteger count; // The number of objects currently in the treap.
+	unsigned long mutations; // Tracks mutations for NSFastEnumeration.
+}
+
+- (instancetype)initWithArray:(NSArray<ObjectType> *)array NS_DESIGNATED_INITIALIZER;
+
+/**
+ Returns an enumerator that accesses each object in the receiver from back to front.
+
+ @return An enumerator that accesses each object in the receiver from back to front. The enumerator returned is never @c nil; if the receiver is empty, the enumerator will always return @c nil for \link NSEnumerator#nextObject -nextObject\endlink and an empty array for \link NSEnumerator#allObjects -allObjects\endlink.
+
+ @attention The enumerator retains the collection. Once all objects in the enumerator have been consumed, the collection is released.
+ @warning Modifying a collection while it is being enumerated is unsafe, and may cause a mutation exception to be raised.
+ */
+- (NSEnumerator<ObjectType> *)reverseObjectEnumerator;
+
+#pragma mark Splitting and Joining
+/** @name Splitting and Joining */
+// @{
+
+/**
+ Removes the objects at and after a given index from the receiver, and returns them in a new treap. The objects are moved without being copied or retained again, in O(log n) expected time.
+
+ @param index The index of the first object to move to the new treap. If it is equal to the count of the receiver, the new treap is empty.
+ @return A new treap containing the objects which were at @a index and above in the receiver, in the same order.
+
+ @throw NSRangeException if @a index is greater than the count of the receiver.
+
+ @see concatenateTreap:
+ */
+- (CHImplicitTreap<ObjectType> *)splitAtIndex:(NSUInteger)index;
+
+/**
+ Moves all the objects in another treap onto the end of the receiver, leaving the other treap empty. The objects are moved without being copied or retained again, in O(log n) expected time.
+
+ @param otherTreap The treap whose objects are to be appended to the receiver.
+
+ @throw NSInvalidArgumentException if @a otherTreap is @c nil or is the receiver.
+
+ @see addObjectsFromArray:
+ @see splitAtIndex:
+ */
+- (void)concatenateTreap:(CHImplicitTreap<ObjectType> *)otherTreap;
+
+// @}
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,589 @@
+//
+//  CHImplicitTreap.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHImplicitTreap.h>
+#import <CHDataStructures/CHTreap.h>
+#import "CHAbstractBinarySearchTree_Internal.h"
+
+// All treaps share a single sentinel, which is never written to, so that a
+// subtree can be moved from one treap to another without visiting its leaves.
+// Its size of 0 and priority of 0 let it stand in for an empty subtree.
+static CHBinaryTreeNode CHImplicitTreapSentinel;
+static CHBinaryTreeNode *const sentinel = &CHImplicitTreapSentinel;
+
+// Like CHBinaryTreeLinkChild, but leaves the shared sentinel untouched.
+static inline void CHImplicitTreapLinkChild(CHBinaryTreeNode *node, NSUInteger direction, CHBinaryTreeNode *child) {
+	node->link[direction] = child;
+	if (child != sentinel) {
+		child->parent = node;
+	}
+}
+
+// Rotates node in the given direction (0 is left, 1 is right), lifting its child
+// on the other side into its place. The same rotation CHTreap uses, except that
+// the parent is found through the parent link rather than passed in.
+static inline void CHImplicitTreapRotate(CHBinaryTreeNode *node, NSUInteger direction) {
+	CHBinaryTreeNode *parent = node->parent, *save = node->link[!direction];
+	CHImplicitTreapLinkChild(parent, parent->right == node, save);
+	CHImplicitTreapLinkChild(node, !direction, save->link[direction]);
+	CHImplicitTreapLinkChild(save, direction, node);
+	CHBinaryTreeNode_UPDATE_SIZE(node);
+	CHBinaryTreeNode_UPDATE_SIZE(save);
+}
+
+// Nodes are allocated one at a time, rather than from a per-tree slab, since
+// splitting and concatenating move them from one treap to another.
+static inline CHBinaryTreeNode *CHImplicitTreapCreateNode(id anObject, u_int32_t priority) {
+	CHBinaryTreeNode *node = malloc(kCHBinaryTreeNodeSize);
+	node->object = anObject;
+	node->left = node->right = sentinel;
+	node->parent = NULL;
+	node->priority = priority;
+	node->size = 1;
+	return node;
+}
+
+// Returns the node at a given index of the subtree rooted at node, which must
+// contain more than index nodes.
+static inline CHBinaryTreeNode *CHImplicitTreapNodeAtIndex(CHBinaryTreeNode *node, NSUInteger index) {
+	while (index != node->left->size) {
+		if (index < node->left->size) {
+			node = node->left;
+		} else {
+			index -= node->left->size + 1;
+			node = node->right;
+		}
+	}
+	return node;
+}
+
+// Builds a subtree from count objects (retaining each one) and returns its root,
+// using the same scheme as -[CHAbstractBinarySearchTree _buildTreeWithSortedObjects:count:]
+// and the same priorities as CHTreap, so the subtree is balanced and its nodes
+// obey the heap property.
+static CHBinaryTreeNode *CHImplicitTreapBuildSubtree(__unsafe_unretained id *objects, NSUInteger count, NSUInteger depth, NSUInteger height) {
+	if (count == 0) {
+		return sentinel;
+	}
+	NSUInteger middle = count / 2;
+	CHBinaryTreeNode *node = CHImplicitTreapCreateNode([objects[middle] retain],
+	                                                   CHTreapPriorityForDepth(depth, height));
+	CHImplicitTreapLinkChild(node, 0, CHImplicitTreapBuildSubtree(objects, middle, depth + 1, height));
+	CHImplicitTreapLinkChild(node, 1, CHImplicitTreapBuildSubtree(objects + middle + 1, count - middle - 1, depth + 1, height));
+	node->size = count;
+	return node;
+}
+
+// Releases the objects in the subtree rooted at node and frees its nodes. Each
+// node with a left child is rotated right until the subtree is a vine that can
+// be freed from the top down, so no stack is needed.
+static void CHImplicitTreapFreeSubtree(CHBinaryTreeNode *node) {
+	CHBinaryTreeNode *child;
+	while (node != sentinel) {
+		if (node->left == sentinel) {
+			child = node->right;
+			[node->object release];
+			free(node);
+		} else {
+			child = node->left;
+			node->left = child->right;
+			child->right = node;
+		}
+		node = child;
+	}
+}
+
+/**
+ An NSEnumerator for traversing a CHImplicitTreap in forward or reverse order.
+ */
+@interface CHImplicitTreapEnumerator : NSEnumerator
+
+@end
+
+@implementation CHImplicitTreapEnumerator
+{
+	CHImplicitTreap *collection; // The source of enumerated objects.
+	CHBinaryTreeNode *current; // The next node to be enumerated.
+	CHBinaryTreeNode *header; // Node that signifies completion.
+	BOOL descending; // Whether the enumerator is proceeding from back to front.
+	unsigned long mutationCount; // Stores the collection's initial mutation.
+	unsigned long *mutationPtr; // Pointer for checking changes in mutation.
+	NSUInteger remainingCount; ///< Number of elements in @a collection remaining to be enumerated.
+}
+
+/**
+ Create an enumerator which traverses a treap in either forward or reverse order.
+
+ @param treap The treap being enumerated. This collection is to be retained while the enumerator has not exhausted all its objects.
+ @param headerNode The header node of the treap, whose right child is the root.
+ @param isDescending Whether to enumerate from back to front.
+ @param mutations A pointer to the collection's mutation count, for invalidation.
+ @return An initialized CHImplicitTreapEnumerator which will enumerate objects in @a treap in the order specified by @a isDescending.
+ */
+- (instancetype)initWithTreap:(CHImplicitTreap *)treap
+                       header:(CHBinaryTreeNode *)headerNode
+                   descending:(BOOL)isDescending
+              mutationPointer:(unsigned long *)mutations
+{
+	self = [super init];
+	if (self) {
+		remainingCount = [treap count];
+		collection = remainingCount ? [treap retain] : nil;
+		header = headerNode;
+		current = remainingCount ? CHBinaryTreeFirstNode(header->right, isDescending, sentinel) : header;
+		descending = isDescending;
+		mutationCount = *mutations;
+		mutationPtr = mutations;
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[collection release];
+	[super dealloc];
+}
+
+- (id)nextObject {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	if (current == header) {
+		[self _collectionExhausted];
+		return nil;
+	}
+	remainingCount--;
+	id object = current->object;
+	current = CHBinaryTreeNextNode(current, descending, header, sentinel);
+	return object;
+}
+
+- (NSArray *)allObjects {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	if (remainingCount == 0) {
+		return @[];
+	}
+	NSMutableArray *array = [[NSMutableArray alloc] initWithCapacity:remainingCount];
+	while (current != header) {
+		[array addObject:current->object];
+		current = CHBinaryTreeNextNode(current, descending, header, sentinel);
+	}
+	[self _collectionExhausted];
+	return [array autorelease];
+}
+
+- (void)_collectionExhausted {
+	[collection release];
+	collection = nil;
+	current = header;
+	remainingCount = 0;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CHImplicitTreap
+
+// Inserts a node (whose size must be 1) so that it ends up at the given index,
+// then rotates it up past any parent with a lower priority. A node with the
+// priority CHTreapNotFound rises all the way up to become the root.
+- (void)_insertNode:(CHBinaryTreeNode *)node atIndex:(NSUInteger)index {
+	CHBinaryTreeNode *parent = header, *current = header->right;
+	NSUInteger direction = 1;
+	while (current != sentinel) {
+		current->size++;
+		parent = current;
+		direction = (index > current->left->size); // R on YES
+		if (direction) {
+			index -= current->left->size + 1;
+		}
+		current = current->link[direction];
+	}
+	CHImplicitTreapLinkChild(parent, direction, node);
+	// The header has the highest priority, so the loop always stops beneath it.
+	while (node->priority > node->parent->priority) {
+		parent = node->parent;
+		CHImplicitTreapRotate(parent, parent->left == node);
+	}
+}
+
+// Rotates a node down, always lifting the child with the higher priority, until
+// it is a leaf, then unlinks and frees it. The caller must release its object.
+- (void)_removeNode:(CHBinaryTreeNode *)node {
+	while (node->left != sentinel || node->right != sentinel) {
+		NSUInteger lift = (node->left == sentinel ||
+		                   (node->right != sentinel && node->right->priority > node->left->priority)); // R on YES
+		CHImplicitTreapRotate(node, !lift);
+	}
+	CHBinaryTreeNode *parent = node->parent;
+	CHImplicitTreapLinkChild(parent, parent->right == node, sentinel);
+	for (; parent != header; parent = parent->parent) {
+		parent->size--;
+	}
+	free(node);
+}
+
+// Appends a subtree of nodes from another treap (or a newly built one) to the
+// receiver, by making both trees children of a dummy root and then removing it.
+- (void)_appendSubtree:(CHBinaryTreeNode *)root count:(NSUInteger)subtreeCount {
+	if (subtreeCount == 0) {
+		return;
+	}
+	if (count > 0) {
+		CHBinaryTreeNode *dummy = CHImplicitTreapCreateNode(nil, CHTreapNotFound);
+		CHImplicitTreapLinkChild(dummy, 0, header->right);
+		CHImplicitTreapLinkChild(dummy, 1, root);
+		CHBinaryTreeNode_UPDATE_SIZE(dummy);
+		CHImplicitTreapLinkChild(header, 1, dummy);
+		[self _removeNode:dummy];
+	} else {
+		CHImplicitTreapLinkChild(header, 1, root);
+	}
+	count += subtreeCount;
+}
+
+#pragma mark -
+
+- (void)dealloc {
+	[self removeAllObjects];
+	free(header);
+	[super dealloc];
+}
+
+- (instancetype)init {
+	return [self initWithArray:@[]];
+}
+
+// This is the designated initializer for CHImplicitTreap
+- (instancetype)initWithArray:(NSArray *)anArray {
+	self = [super init];
+	if (self) {
+		header = CHImplicitTreapCreateNode(nil, CHTreapNotFound); // This is the highest possible priority
+		header->size = 0;
+		count = 0;
+		mutations = 0;
+		[self addObjectsFromArray:anArray];
+	}
+	return self;
+}
+
+- (NSString *)description {
+	return [[self allObjects] description];
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	return [self initWithArray:[decoder decodeObjectForKey:@"objects"]];
+}
+
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[encoder encodeObject:[[self objectEnumerator] allObjects] forKey:@"objects"];
+}
+
+#pragma mark <NSCopying>
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+	return [[CHImplicitTreap allocWithZone:zone] initWithArray:[self allObjects]];
+}
+
+#pragma mark <NSFastEnumeration>
+
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	CHBinaryTreeNode *currentNode;
+	// On the first call, start at the first node, otherwise at the last saved node
+	if (state->state == 0) {
+		currentNode = (count > 0) ? CHBinaryTreeFirstNode(header->right, NO, sentinel) : header;
+		state->itemsPtr = stackbuf;
+		state->mutationsPtr = &mutations;
+	} else if (state->state == 1) {
+		return 0;
+	} else {
+		currentNode = (CHBinaryTreeNode *) state->state;
+	}
+
+	// Accumulate objects from the treap until we reach the header, or the maximum
+	NSUInteger batchCount = 0;
+	while (currentNode != header && batchCount < len) {
+		stackbuf[batchCount] = currentNode->object;
+		currentNode = CHBinaryTreeNextNode(currentNode, NO, header, sentinel);
+		batchCount++;
+	}
+	if (currentNode == header) {
+		state->state = 1; // used as a termination flag
+	} else {
+		state->state = (unsigned long)currentNode;
+	}
+	return batchCount;
+}
+
+#pragma mark Querying Contents
+
+- (NSArray *)allObjects {
+	return [[self objectEnumerator] allObjects];
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self indexOfObject:anObject] != NSNotFound);
+}
+
+- (BOOL)containsObjectIdenticalTo:(id)anObject {
+	return ([self indexOfObjectIdenticalTo:anObject] != NSNotFound);
+}
+
+- (NSUInteger)count {
+	return count;
+}
+
+- (id)firstObject {
+	return (count > 0) ? CHBinaryTreeFirstNode(header->right, NO, sentinel)->object : nil;
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects(count, [self firstObject], [self lastObject]);
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHLinkedList)]) {
+		return [self isEqualToLinkedList:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+- (BOOL)isEqualToLinkedList:(id<CHLinkedList>)otherLinkedList {
+	return CHCollectionsAreEqual(self, otherLinkedList);
+}
+
+- (id)lastObject {
+	return (count > 0) ? CHBinaryTreeFirstNode(header->right, YES, sentinel)->object : nil;
+}
+
+- (NSUInteger)indexOfObject:(id)anObject {
+	return [self _indexOfObject:anObject withEqualityTest:&CHObjectsAreEqual];
+}
+
+- (NSUInteger)indexOfObjectIdenticalTo:(id)anObject {
+	return [self _indexOfObject:anObject withEqualityTest:&CHObjectsAreIdentical];
+}
+
+- (NSUInteger)_indexOfObject:(id)anObject withEqualityTest:(CHObjectEqualityTest)objectsMatch {
+	NSUInteger index = 0;
+	for (id object in self) {
+		if (objectsMatch(object, anObject)) {
+			return index;
+		}
+		++index;
+	}
+	return NSNotFound;
+}
+
+- (id)objectAtIndex:(NSUInteger)index {
+	CHRaiseIndexOutOfRangeExceptionIf(index, >=, count);
+	return CHImplicitTreapNodeAtIndex(header->right, index)->object;
+}
+
+- (NSEnumerator *)objectEnumerator {
+	return [[[CHImplicitTreapEnumerator alloc] initWithTreap:self
+	                                                  header:header
+	                                              descending:NO
+	                                         mutationPointer:&mutations] autorelease];
+}
+
+- (NSArray *)objectsAtIndexes:(NSIndexSet *)indexes {
+	CHRaiseInvalidArgumentExceptionIfNil(indexes);
+	if ([indexes count] == 0) {
+		return @[];
+	}
+	CHRaiseIndexOutOfRangeExceptionIf([indexes lastIndex], >=, count);
+	NSMutableArray *objects = [NSMutableArray arrayWithCapacity:[indexes count]];
+	NSUInteger index = [indexes firstIndex];
+	while (index != NSNotFound) {
+		[objects addObject:CHImplicitTreapNodeAtIndex(header->right, index)->object];
+		index = [indexes indexGreaterThanIndex:index];
+	}
+	return objects;
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	return [[[CHImplicitTreapEnumerator alloc] initWithTreap:self
+	                                                  header:header
+	                                              descending:YES
+	                                         mutationPointer:&mutations] autorelease];
+}
+
+#pragma mark Modifying Contents
+
+- (void)addObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self insertObject:anObject atIndex:count];
+}
+
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	NSUInteger arrayCount = [anArray count];
+	if (arrayCount == 0) {
+		return;
+	}
+	++mutations;
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * arrayCount);
+	[anArray getObjects:objects range:NSMakeRange(0, arrayCount)];
+	CHBinaryTreeNode *root = CHImplicitTreapBuildSubtree(objects, arrayCount, 0,
+	                                                     CHBinaryTreeHeightForCount(arrayCount));
+	free(objects);
+	[self _appendSubtree:root count:arrayCount];
+}
+
+- (void)concatenateTreap:(CHImplicitTreap *)otherTreap {
+	CHRaiseInvalidArgumentExceptionIfNil(otherTreap);
+	if (otherTreap == self) {
+		CHRaiseInvalidArgumentException(@"Cannot concatenate a treap to itself.");
+	}
+	++mutations;
+	++(otherTreap->mutations);
+	CHBinaryTreeNode *root = otherTreap->header->right;
+	NSUInteger otherCount = otherTreap->count;
+	otherTreap->header->right = sentinel;
+	otherTreap->count = 0;
+	[self _appendSubtree:root count:otherCount];
+}
+
+- (void)exchangeObjectAtIndex:(NSUInteger)idx1 withObjectAtIndex:(NSUInteger)idx2 {
+	CHRaiseIndexOutOfRangeExceptionIf(idx1, >=, count);
+	CHRaiseIndexOutOfRangeExceptionIf(idx2, >=, count);
+	if (idx1 != idx2) {
+		CHBinaryTreeNode *node1 = CHImplicitTreapNodeAtIndex(header->right, idx1);
+		CHBinaryTreeNode *node2 = CHImplicitTreapNodeAtIndex(header->right, idx2);
+		id tempObject = node1->object;
+		node1->object = node2->object;
+		node2->object = tempObject;
+		++mutations;
+	}
+}
+
+- (void)insertObject:(id)anObject atIndex:(NSUInteger)index {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHRaiseIndexOutOfRangeExceptionIf(index, >, count);
+	++mutations;
+	// New nodes never get CHTreapNotFound, which is reserved for the header.
+	[self _insertNode:CHImplicitTreapCreateNode([anObject retain], arc4random_uniform(CHTreapNotFound))
+	          atIndex:index];
+	++count;
+}
+
+- (void)insertObjects:(NSArray *)objects atIndexes:(NSIndexSet *)indexes {
+	CHRaiseInvalidArgumentExceptionIfNil(objects);
+	CHRaiseInvalidArgumentExceptionIfNil(indexes);
+	if ([objects count] != [indexes count]) {
+		CHRaiseInvalidArgumentException(@"Unequal object and index counts.");
+	}
+	NSUInteger index = [indexes firstIndex];
+	for (id anObject in objects) {
+		[self insertObject:anObject atIndex:index];
+		index = [indexes indexGreaterThanIndex:index];
+	}
+}
+
+- (void)prependObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self insertObject:anObject atIndex:0];
+}
+
+- (void)removeAllObjects {
+	CHImplicitTreapFreeSubtree(header->right);
+	header->right = sentinel;
+	count = 0;
+	++mutations;
+}
+
+- (void)removeFirstObject {
+	if (count > 0) {
+		[self removeObjectAtIndex:0];
+	}
+}
+
+- (void)removeLastObject {
+	if (count > 0) {
+		[self removeObjectAtIndex:count - 1];
+	}
+}
+
+- (void)_removeObject:(id)anObject withEqualityTest:(CHObjectEqualityTest)objectsMatch {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	if (count == 0) {
+		return;
+	}
+	NSMutableIndexSet *indexes = [NSMutableIndexSet indexSet];
+	NSUInteger index = 0;
+	for (id object in self) {
+		if (objectsMatch(object, anObject)) {
+			[indexes addIndex:index];
+		}
+		++index;
+	}
+	[self removeObjectsAtIndexes:indexes];
+}
+
+- (void)removeObject:(id)anObject {
+	[self _removeObject:anObject withEqualityTest:&CHObjectsAreEqual];
+}
+
+- (void)removeObjectAtIndex:(NSUInteger)index {
+	CHRaiseIndexOutOfRangeExceptionIf(index, >=, count);
+	++mutations;
+	CHBinaryTreeNode *node = CHImplicitTreapNodeAtIndex(header->right, index);
+	[node->object release];
+	[self _removeNode:node];
+	--count;
+}
+
+- (void)removeObjectIdenticalTo:(id)anObject {
+	[self _removeObject:anObject withEqualityTest:&CHObjectsAreIdentical];
+}
+
+- (void)removeObjectsAtIndexes:(NSIndexSet *)indexes {
+	CHRaiseInvalidArgumentExceptionIfNil(indexes);
+	if ([indexes count]) {
+		CHRaiseIndexOutOfRangeExceptionIf([indexes lastIndex], >=, count);
+		// Remove from the back, so the remaining indexes stay valid.
+		NSUInteger index = [indexes lastIndex];
+		while (index != NSNotFound) {
+			[self removeObjectAtIndex:index];
+			index = [indexes indexLessThanIndex:index];
+		}
+	}
+}
+
+- (void)replaceObjectAtIndex:(NSUInteger)index withObject:(id)anObject {
+	CHRaiseIndexOutOfRangeExceptionIf(index, >=, count);
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHBinaryTreeNode *node = CHImplicitTreapNodeAtIndex(header->right, index);
+	[node->object autorelease];
+	node->object = [anObject retain];
+}
+
+#pragma mark Splitting and Joining
+
+- (CHImplicitTreap *)splitAtIndex:(NSUInteger)index {
+	CHRaiseIndexOutOfRangeExceptionIf(index, >, count);
+	++mutations;
+	// A dummy node inserted at the index rises to the root, so its left subtree
+	// holds the objects before the index and its right subtree the rest.
+	CHBinaryTreeNode *dummy = CHImplicitTreapCreateNode(nil, CHTreapNotFound);
+	[self _insertNode:dummy atIndex:index];
+	NSAssert(header->right == dummy, @"Illegal state, dummy node should be the root!");
+	CHImplicitTreap *otherTreap = [[[[self class] alloc] init] autorelease];
+	CHImplicitTreapLinkChild(otherTreap->header, 1, dummy->right);
+	otherTreap->count = count - index;
+	CHImplicitTreapLinkChild(header, 1, dummy->left);
+	count = index;
+	free(dummy);
+	return otherTreap;
+}
+
+@end
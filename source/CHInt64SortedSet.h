@@ -0,0 +1,95 @@
+//
+//  CHInt64SortedSet.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHSortedSet.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHInt64SortedSet.h
+ A CHSortedSet implementation that stores 64-bit integers without boxing them.
+ */
+
+struct CHInt64Node; // Defined in CHInt64SortedSet.m
+
+/**
+ A sorted set of 64-bit integers, stored unboxed in a <a href="http://en.wikipedia.org/wiki/B%2B_tree">B+ tree</a>. This is intended for the common case of a sorted set that holds nothing but NSNumber identifiers, for which a binary search tree spends most of its time chasing pointers to nodes and sending @c -compare: to the numbers in them.
+
+ Each node holds up to 16 keys in two adjacent cache lines, along with the count of keys and either links to child nodes or (for leaves) links to neighboring leaves. Unused key slots are filled with @c INT64_MAX, so finding a key's position within a node takes a fixed number of vector comparisons of the entire node, without branches. (The compiler generates SSE or NEON instructions as appropriate for the target.) All keys are stored in the leaves, which are linked together in sorted order, so enumeration never revisits interior nodes. Nodes (other than the root) are always at least half full, so a set of n integers takes O(log n) time for insertion, removal, and search, but the tree is only a third to a quarter as tall as a balanced binary tree of the same size.
+
+ Like other sorted sets, this class accepts and returns objects, but only at the edges of its API: an object is converted to an integer using @c -longLongValue when it is passed in, and integers are boxed in new NSNumber objects only when they are returned. As a result, the objects returned by the receiver are equal to (but not necessarily identical to) the objects that were added, and numbers with a fractional part are truncated. The methods that take and return @c int64_t values, such as #addInt64: and #containsInt64:, avoid boxing entirely.
+
+ Unlike the binary search trees in this framework, this class can't be given a comparator, since it always orders its contents numerically.
+ */
+@interface CHInt64SortedSet : NSObject <CHSortedSet>
+{
+	struct CHInt64Node *root; // The root of the tree, or NULL if empty.
+	NSUInteger height; // The number of levels in the tree, including leaves.
+	NSUInteger count; // The number of integers currently in the set.
+	unsigned long mutations; // Tracks mutations for NSFastEnumeration.
+}
+
+/**
+ Initialize a sorted set with the contents of an array of numbers.
+
+ Rather than adding each number in turn, the integers are sorted (unless they are already in ascending order) and the tree is built directly in linear time.
+
+ @param anArray An array of NSNumber objects with which to populate a new sorted set.
+ @return An initialized sorted set that contains the integer values of the objects in @a anArray.
+
+ @throw NSInvalidArgumentException if @a anArray contains an object that isn't an NSNumber.
+ */
+- (instancetype)initWithArray:(NSArray<NSNumber *> *)anArray NS_DESIGNATED_INITIALIZER;
+
+#pragma mark Unboxed Integers
+/** @name Unboxed Integers */
+// @{
+
+/**
+ Adds a given integer to the receiver, if it is not already a member.
+
+ @param key The integer to add to the receiver.
+
+ @see addInt64s:count:
+ @see addObject:
+ */
+- (void)addInt64:(int64_t)key;
+
+/**
+ Adds the integers in a given C array to the receiver. If the receiver is empty, the integers are sorted (unless they are already in ascending order) and the tree is built directly in linear time.
+
+ @param keys A C array of integers to add to the receiver, in any order. It may contain duplicates.
+ @param keyCount The number of integers in @a keys.
+
+ @see addInt64:
+ @see addObjectsFromArray:
+ */
+- (void)addInt64s:(const int64_t *)keys count:(NSUInteger)keyCount;
+
+/**
+ Determine whether the receiver contains a given integer.
+
+ @param key The integer to test for membership in the receiver.
+ @return @c YES if the receiver contains @a key, otherwise @c NO.
+
+ @see containsObject:
+ */
+- (BOOL)containsInt64:(int64_t)key;
+
+/**
+ Remove a given integer from the receiver. If the receiver doesn't contain @a key, there is no effect.
+
+ @param key The integer to be removed from the receiver.
+
+ @see removeObject:
+ */
+- (void)removeInt64:(int64_t)key;
+
+// @}
+@end
+
+NS_ASSUME_NONNULL_END
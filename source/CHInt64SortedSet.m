@@ -0,0 +1,893 @@
+//
+//  CHInt64SortedSet.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHInt64SortedSet.h>
+
+#pragma mark Nodes
+
+// Each node's keys fill exactly two 64-byte cache lines. Every node except the
+// root has at least half this many keys, and an interior node has one more
+// child than it has keys.
+#define kCHInt64NodeCapacity 16
+#define kCHInt64NodeMinimum (kCHInt64NodeCapacity / 2)
+
+// Generous for any count that fits in an NSUInteger, since every interior node
+// but the root has at least 9 children and every leaf at least 8 keys.
+#define kCHInt64TreeMaximumHeight 32
+
+// Unused key slots hold the largest possible key, so a node can be searched by
+// comparing all its slots without regard to its count.
+#define kCHInt64KeyPadding INT64_MAX
+
+/**
+ A node in a CHInt64SortedSet. In an interior node, @a keys[i] separates the keys in @a children[i] (which are less) from those in @a children[i+1] (which are greater or equal). Leaves hold the keys themselves, and are linked to their neighbors in sorted order. Leaves are allocated without space for @a children, so only @a previous and @a next may be used for them.
+ */
+typedef struct CHInt64Node {
+	int64_t keys[kCHInt64NodeCapacity] __attribute__((aligned(64))); ///< Sorted keys, then padding.
+	uint32_t count; ///< The number of keys in use.
+	union {
+		struct {
+			struct CHInt64Node *previous; ///< The leaf with the next smaller keys.
+			struct CHInt64Node *next;     ///< The leaf with the next larger keys.
+		};
+		struct CHInt64Node *children[kCHInt64NodeCapacity + 1]; ///< Subtrees of an interior node.
+	};
+} CHInt64Node;
+
+#define kCHInt64LeafSize (offsetof(CHInt64Node, next) + sizeof(CHInt64Node *))
+
+static CHInt64Node *CHInt64NodeCreate(BOOL isLeaf) {
+	void *node = NULL;
+	posix_memalign(&node, 64, isLeaf ? kCHInt64LeafSize : sizeof(CHInt64Node));
+	CHInt64Node *newNode = node;
+	for (NSUInteger i = 0; i < kCHInt64NodeCapacity; i++) {
+		newNode->keys[i] = kCHInt64KeyPadding;
+	}
+	newNode->count = 0;
+	newNode->previous = NULL;
+	newNode->next = NULL;
+	return newNode;
+}
+
+// Frees a node and (if it isn't a leaf) all the nodes below it.
+static void CHInt64NodeFree(CHInt64Node *node, NSUInteger level) {
+	if (level > 0) {
+		for (NSUInteger i = 0; i <= node->count; i++) {
+			CHInt64NodeFree(node->children[i], level - 1);
+		}
+	}
+	free(node);
+}
+
+#if defined(__clang__)
+
+typedef int64_t CHInt64Vector __attribute__((ext_vector_type(4)));
+
+// Returns the number of keys in a node that are less than a given key. Each
+// vector comparison yields -1 for every lane in which the node's key is less,
+// so the negated sum of the results is the count. Since the padding is never
+// less than any key, the whole node can be compared without branching.
+static inline NSUInteger CHInt64NodeRank(const CHInt64Node *node, int64_t key) {
+	const CHInt64Vector *vectors = (const CHInt64Vector *)node->keys;
+	CHInt64Vector less = (CHInt64Vector)(vectors[0] < key);
+	for (NSUInteger i = 1; i < kCHInt64NodeCapacity / 4; i++) {
+		less += (CHInt64Vector)(vectors[i] < key);
+	}
+	return (NSUInteger)-(less[0] + less[1] + less[2] + less[3]);
+}
+
+#else
+
+// Returns the number of keys in a node that are less than a given key.
+static inline NSUInteger CHInt64NodeRank(const CHInt64Node *node, int64_t key) {
+	NSUInteger low = 0, high = node->count;
+	while (low < high) {
+		NSUInteger middle = (low + high) / 2;
+		if (node->keys[middle] < key) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+#endif
+
+// Returns the index of the child of an interior node that may contain a key.
+static inline NSUInteger CHInt64NodeChildIndex(const CHInt64Node *node, int64_t key) {
+	NSUInteger index = CHInt64NodeRank(node, key);
+	return (index < node->count && node->keys[index] == key) ? index + 1 : index;
+}
+
+static inline CHInt64Node *CHInt64TreeFirstLeaf(CHInt64Node *node, NSUInteger height) {
+	for (NSUInteger level = height; level > 1; level--) {
+		node = node->children[0];
+	}
+	return node;
+}
+
+static inline CHInt64Node *CHInt64TreeLastLeaf(CHInt64Node *node, NSUInteger height) {
+	for (NSUInteger level = height; level > 1; level--) {
+		node = node->children[node->count];
+	}
+	return node;
+}
+
+static BOOL CHInt64TreeContains(CHInt64Node *node, NSUInteger height, int64_t key) {
+	if (node == NULL) {
+		return NO;
+	}
+	for (NSUInteger level = height; level > 1; level--) {
+		node = node->children[CHInt64NodeChildIndex(node, key)];
+	}
+	NSUInteger index = CHInt64NodeRank(node, key);
+	return (index < node->count && node->keys[index] == key);
+}
+
+// Finds the key nearest to a given key below it (if direction is 0) or above it
+// (if 1), or an equal key if inclusive is YES, and returns whether there is one.
+// The leaf that may contain the key holds the nearest key, unless it is at the
+// end of the leaf, in which case it is at the end of the adjacent leaf.
+static BOOL CHInt64TreeNearest(CHInt64Node *node, NSUInteger height, int64_t key, NSUInteger direction, BOOL inclusive, int64_t *nearest) {
+	if (node == NULL) {
+		return NO;
+	}
+	for (NSUInteger level = height; level > 1; level--) {
+		node = node->children[CHInt64NodeChildIndex(node, key)];
+	}
+	NSUInteger index = CHInt64NodeRank(node, key);
+	BOOL found = (index < node->count && node->keys[index] == key);
+	if (found && inclusive) {
+		*nearest = key;
+		return YES;
+	}
+	if (direction) {
+		if (found) {
+			index++;
+		}
+		if (index < node->count) {
+			*nearest = node->keys[index];
+			return YES;
+		}
+		node = node->next;
+		index = 0;
+	} else {
+		if (index > 0) {
+			*nearest = node->keys[index - 1];
+			return YES;
+		}
+		node = node->previous;
+		index = (node != NULL) ? node->count - 1 : 0;
+	}
+	if (node == NULL) {
+		return NO;
+	}
+	*nearest = node->keys[index];
+	return YES;
+}
+
+// Inserts a key (and, for an interior node, the child to its right) at index.
+static inline void CHInt64NodeInsert(CHInt64Node *node, NSUInteger index, int64_t key, CHInt64Node *child, BOOL isLeaf) {
+	memmove(node->keys + index + 1, node->keys + index, sizeof(int64_t) * (node->count - index));
+	node->keys[index] = key;
+	if (!isLeaf) {
+		memmove(node->children + index + 2, node->children + index + 1, sizeof(CHInt64Node *) * (node->count - index));
+		node->children[index + 1] = child;
+	}
+	node->count++;
+}
+
+// Removes the key (and, for an interior node, the child to its right) at index.
+static inline void CHInt64NodeRemove(CHInt64Node *node, NSUInteger index, BOOL isLeaf) {
+	node->count--;
+	memmove(node->keys + index, node->keys + index + 1, sizeof(int64_t) * (node->count - index));
+	node->keys[node->count] = kCHInt64KeyPadding;
+	if (!isLeaf) {
+		memmove(node->children + index + 1, node->children + index + 2, sizeof(CHInt64Node *) * (node->count - index));
+	}
+}
+
+// Splits a full node into two while inserting a key (and child) at index. The
+// lower half stays in node, and the upper half is moved to a new node, which is
+// returned. The key that separates them is returned in separator; for an
+// interior node, it is removed from both halves.
+static CHInt64Node *CHInt64NodeSplit(CHInt64Node *node, NSUInteger index, int64_t key, CHInt64Node *child, BOOL isLeaf, int64_t *separator) {
+	int64_t keys[kCHInt64NodeCapacity + 1];
+	CHInt64Node *children[kCHInt64NodeCapacity + 2];
+	memcpy(keys, node->keys, sizeof(int64_t) * index);
+	keys[index] = key;
+	memcpy(keys + index + 1, node->keys + index, sizeof(int64_t) * (kCHInt64NodeCapacity - index));
+	if (!isLeaf) {
+		memcpy(children, node->children, sizeof(CHInt64Node *) * (index + 1));
+		children[index + 1] = child;
+		memcpy(children + index + 2, node->children + index + 1, sizeof(CHInt64Node *) * (kCHInt64NodeCapacity - index));
+	}
+	CHInt64Node *right = CHInt64NodeCreate(isLeaf);
+	// A leaf keeps its separator as the first key of the new node.
+	NSUInteger rightStart = isLeaf ? kCHInt64NodeMinimum : kCHInt64NodeMinimum + 1;
+	*separator = keys[kCHInt64NodeMinimum];
+	right->count = (uint32_t)(kCHInt64NodeCapacity + 1 - rightStart);
+	memcpy(right->keys, keys + rightStart, sizeof(int64_t) * right->count);
+	memcpy(node->keys, keys, sizeof(int64_t) * kCHInt64NodeMinimum);
+	for (NSUInteger i = kCHInt64NodeMinimum; i < kCHInt64NodeCapacity; i++) {
+		node->keys[i] = kCHInt64KeyPadding;
+	}
+	node->count = kCHInt64NodeMinimum;
+	if (isLeaf) {
+		right->previous = node;
+		right->next = node->next;
+		if (right->next != NULL) {
+			right->next->previous = right;
+		}
+		node->next = right;
+	} else {
+		memcpy(node->children, children, sizeof(CHInt64Node *) * (kCHInt64NodeMinimum + 1));
+		memcpy(right->children, children + rightStart, sizeof(CHInt64Node *) * (right->count + 1));
+	}
+	return right;
+}
+
+// Adds a key to a tree, splitting full nodes on the path to it from the leaf
+// up. Returns whether the key was added (NO if it was already present).
+static BOOL CHInt64TreeInsert(CHInt64Node **root, NSUInteger *height, int64_t key) {
+	if (*root == NULL) {
+		*root = CHInt64NodeCreate(YES);
+		*height = 1;
+	}
+	CHInt64Node *path[kCHInt64TreeMaximumHeight];
+	NSUInteger indexes[kCHInt64TreeMaximumHeight];
+	CHInt64Node *node = *root;
+	for (NSUInteger level = *height - 1; level > 0; level--) {
+		path[level] = node;
+		indexes[level] = CHInt64NodeChildIndex(node, key);
+		node = node->children[indexes[level]];
+	}
+	NSUInteger index = CHInt64NodeRank(node, key);
+	if (index < node->count && node->keys[index] == key) {
+		return NO;
+	}
+	CHInt64Node *child = NULL;
+	for (NSUInteger level = 0; level < *height; level++) {
+		if (level > 0) {
+			node = path[level];
+			index = indexes[level];
+		}
+		if (node->count < kCHInt64NodeCapacity) {
+			CHInt64NodeInsert(node, index, key, child, (level == 0));
+			return YES;
+		}
+		child = CHInt64NodeSplit(node, index, key, child, (level == 0), &key);
+	}
+	// The root was split, so the tree grows a new root above the two halves.
+	CHInt64Node *newRoot = CHInt64NodeCreate(NO);
+	newRoot->keys[0] = key;
+	newRoot->count = 1;
+	newRoot->children[0] = *root;
+	newRoot->children[1] = child;
+	*root = newRoot;
+	(*height)++;
+	return YES;
+}
+
+// Refills a node with fewer than the minimum number of keys, either by moving a
+// key from a sibling (if one can spare it) or by merging it with a sibling.
+// Returns NO if the node was merged, which removes a key from the parent.
+static BOOL CHInt64NodeRefill(CHInt64Node *parent, NSUInteger index, BOOL isLeaf) {
+	CHInt64Node *node = parent->children[index];
+	CHInt64Node *left = (index > 0) ? parent->children[index - 1] : NULL;
+	CHInt64Node *right = (index < parent->count) ? parent->children[index + 1] : NULL;
+	if (left != NULL && left->count > kCHInt64NodeMinimum) {
+		// Rotate the largest key of the left sibling through the parent.
+		int64_t key = left->keys[left->count - 1];
+		memmove(node->keys + 1, node->keys, sizeof(int64_t) * node->count);
+		if (isLeaf) {
+			node->keys[0] = key;
+			parent->keys[index - 1] = key;
+		} else {
+			memmove(node->children + 1, node->children, sizeof(CHInt64Node *) * (node->count + 1));
+			node->keys[0] = parent->keys[index - 1];
+			node->children[0] = left->children[left->count];
+			parent->keys[index - 1] = key;
+		}
+		node->count++;
+		left->count--;
+		left->keys[left->count] = kCHInt64KeyPadding;
+		return YES;
+	}
+	if (right != NULL && right->count > kCHInt64NodeMinimum) {
+		// Rotate the smallest key of the right sibling through the parent.
+		if (isLeaf) {
+			node->keys[node->count] = right->keys[0];
+			parent->keys[index] = right->keys[1];
+		} else {
+			node->keys[node->count] = parent->keys[index];
+			node->children[node->count + 1] = right->children[0];
+			parent->keys[index] = right->keys[0];
+			memmove(right->children, right->children + 1, sizeof(CHInt64Node *) * right->count);
+		}
+		node->count++;
+		right->count--;
+		memmove(right->keys, right->keys + 1, sizeof(int64_t) * right->count);
+		right->keys[right->count] = kCHInt64KeyPadding;
+		return YES;
+	}
+	// Neither sibling has a key to spare, so merge with one of them.
+	if (left != NULL) {
+		right = node;
+		index--;
+	} else {
+		left = node;
+	}
+	if (isLeaf) {
+		left->next = right->next;
+		if (left->next != NULL) {
+			left->next->previous = left;
+		}
+	} else {
+		left->keys[left->count++] = parent->keys[index];
+		memcpy(left->children + left->count, right->children, sizeof(CHInt64Node *) * (right->count + 1));
+	}
+	memcpy(left->keys + left->count, right->keys, sizeof(int64_t) * right->count);
+	left->count += right->count;
+	free(right);
+	CHInt64NodeRemove(parent, index, NO);
+	return NO;
+}
+
+// Removes a key from a tree, refilling nodes that become less than half full on
+// the path from the leaf up. Returns whether the key was found and removed.
+static BOOL CHInt64TreeRemove(CHInt64Node **root, NSUInteger *height, int64_t key) {
+	if (*root == NULL) {
+		return NO;
+	}
+	CHInt64Node *path[kCHInt64TreeMaximumHeight];
+	NSUInteger indexes[kCHInt64TreeMaximumHeight];
+	CHInt64Node *node = *root;
+	for (NSUInteger level = *height - 1; level > 0; level--) {
+		path[level] = node;
+		indexes[level] = CHInt64NodeChildIndex(node, key);
+		node = node->children[indexes[level]];
+	}
+	NSUInteger index = CHInt64NodeRank(node, key);
+	if (index >= node->count || node->keys[index] != key) {
+		return NO;
+	}
+	CHInt64NodeRemove(node, index, YES);
+	NSUInteger level = 0;
+	while (level + 1 < *height && node->count < kCHInt64NodeMinimum) {
+		level++;
+		node = path[level];
+		if (CHInt64NodeRefill(node, indexes[level], (level == 1))) {
+			return YES;
+		}
+	}
+	// The root may have been left with no keys, in which case it is removed.
+	node = *root;
+	if (node->count == 0) {
+		*root = (*height > 1) ? node->children[0] : NULL;
+		(*height)--;
+		free(node);
+	}
+	return YES;
+}
+
+// Builds a tree from keys in strictly ascending order in linear time. The keys
+// are spread evenly across as few leaves as possible, and the leaves across as
+// few parents as possible, and so on up to the root.
+static CHInt64Node *CHInt64TreeBuild(const int64_t *keys, NSUInteger keyCount, NSUInteger *height) {
+	*height = 0;
+	if (keyCount == 0) {
+		return NULL;
+	}
+	NSUInteger nodeCount = (keyCount + kCHInt64NodeCapacity - 1) / kCHInt64NodeCapacity;
+	CHInt64Node **nodes = malloc(sizeof(CHInt64Node *) * nodeCount);
+	int64_t *minimums = malloc(sizeof(int64_t) * nodeCount);
+	CHInt64Node *previous = NULL;
+	for (NSUInteger i = 0; i < nodeCount; i++) {
+		NSUInteger start = i * keyCount / nodeCount, end = (i + 1) * keyCount / nodeCount;
+		CHInt64Node *leaf = CHInt64NodeCreate(YES);
+		leaf->count = (uint32_t)(end - start);
+		memcpy(leaf->keys, keys + start, sizeof(int64_t) * leaf->count);
+		leaf->previous = previous;
+		if (previous != NULL) {
+			previous->next = leaf;
+		}
+		nodes[i] = previous = leaf;
+		minimums[i] = keys[start];
+	}
+	*height = 1;
+	while (nodeCount > 1) {
+		NSUInteger parentCount = (nodeCount + kCHInt64NodeCapacity) / (kCHInt64NodeCapacity + 1);
+		// Parents are stored over their children, which come at or after them.
+		for (NSUInteger i = 0; i < parentCount; i++) {
+			NSUInteger start = i * nodeCount / parentCount, end = (i + 1) * nodeCount / parentCount;
+			CHInt64Node *parent = CHInt64NodeCreate(NO);
+			parent->count = (uint32_t)(end - start - 1);
+			memcpy(parent->keys, minimums + start + 1, sizeof(int64_t) * parent->count);
+			memcpy(parent->children, nodes + start, sizeof(CHInt64Node *) * (end - start));
+			nodes[i] = parent;
+			minimums[i] = minimums[start];
+		}
+		nodeCount = parentCount;
+		(*height)++;
+	}
+	CHInt64Node *root = nodes[0];
+	free(nodes);
+	free(minimums);
+	return root;
+}
+
+static int CHInt64Compare(const void *key1, const void *key2) {
+	int64_t a = *(const int64_t *)key1, b = *(const int64_t *)key2;
+	return (a > b) - (a < b);
+}
+
+// Sorts keys in place (unless they are already sorted) and removes duplicates.
+// Returns the number of distinct keys.
+static NSUInteger CHInt64SortUnique(int64_t *keys, NSUInteger keyCount) {
+	if (keyCount < 2) {
+		return keyCount;
+	}
+	for (NSUInteger i = 1; i < keyCount; i++) {
+		if (keys[i - 1] > keys[i]) {
+			qsort(keys, keyCount, sizeof(int64_t), CHInt64Compare);
+			break;
+		}
+	}
+	NSUInteger uniqueCount = 1;
+	for (NSUInteger i = 1; i < keyCount; i++) {
+		if (keys[i] != keys[uniqueCount - 1]) {
+			keys[uniqueCount++] = keys[i];
+		}
+	}
+	return uniqueCount;
+}
+
+// Converts an object to a key at the edge of the API.
+static inline int64_t CHInt64KeyForObject(id anObject) {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	if (![anObject isKindOfClass:[NSNumber class]]) {
+		CHRaiseInvalidArgumentException(@"Object is not an NSNumber");
+	}
+	return [anObject longLongValue];
+}
+
+#pragma mark -
+
+/**
+ An NSEnumerator for traversing a CHInt64SortedSet in ascending or descending order. Since the leaves are linked together, the enumerator only needs to remember the current leaf and the position in it.
+ */
+@interface CHInt64SortedSetEnumerator : NSEnumerator
+
+- (instancetype)initWithSortedSet:(CHInt64SortedSet *)sortedSet
+                             leaf:(CHInt64Node *)leaf
+                          reverse:(BOOL)reverse
+                  mutationPointer:(unsigned long *)mutations;
+
+@end
+
+@implementation CHInt64SortedSetEnumerator
+{
+	__strong CHInt64SortedSet *set; // The set being enumerated.
+	CHInt64Node *current; // The leaf containing the next key to be enumerated.
+	NSUInteger index; // The position in current of the next key (or after it, if reversed).
+	BOOL isReversed; // Whether to enumerate in descending order.
+	unsigned long mutationCount; // Stores the collection's initial mutation.
+	unsigned long *mutationPtr; // Pointer for checking changes in mutation.
+}
+
+/**
+ Create an enumerator which traverses a given set in ascending or descending order.
+
+ @param sortedSet The set being enumerated. This collection is to be retained while the enumerator has not exhausted all its objects.
+ @param leaf The first leaf of @a sortedSet if enumerating in ascending order, otherwise the last; or @c NULL if the set is empty.
+ @param reverse Whether to enumerate in descending order.
+ @param mutations A pointer to the collection's mutation count for invalidation.
+ @return An initialized CHInt64SortedSetEnumerator which will enumerate objects in @a sortedSet.
+ */
+- (instancetype)initWithSortedSet:(CHInt64SortedSet *)sortedSet
+                             leaf:(CHInt64Node *)leaf
+                          reverse:(BOOL)reverse
+                  mutationPointer:(unsigned long *)mutations
+{
+	self = [super init];
+	if (self) {
+		set = (leaf != NULL) ? [sortedSet retain] : nil;
+		current = leaf;
+		index = (reverse && leaf != NULL) ? leaf->count : 0;
+		isReversed = reverse;
+		mutationCount = *mutations;
+		mutationPtr = mutations;
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[set release];
+	[super dealloc];
+}
+
+- (NSArray *)allObjects {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	NSMutableArray *array = [NSMutableArray array];
+	id anObject;
+	while ((anObject = [self nextObject])) {
+		[array addObject:anObject];
+	}
+	return array;
+}
+
+- (id)nextObject {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	if (current == NULL) {
+		return nil;
+	}
+	int64_t key;
+	if (isReversed) {
+		key = current->keys[--index];
+		if (index == 0) {
+			current = current->previous;
+			index = (current != NULL) ? current->count : 0;
+		}
+	} else {
+		key = current->keys[index++];
+		if (index == current->count) {
+			current = current->next;
+			index = 0;
+		}
+	}
+	if (current == NULL) {
+		[set release];
+		set = nil;
+	}
+	return [NSNumber numberWithLongLong:key];
+}
+
+@end
+
+#pragma mark -
+
+@implementation CHInt64SortedSet
+
+- (void)dealloc {
+	if (root != NULL) {
+		CHInt64NodeFree(root, height - 1);
+	}
+	[super dealloc];
+}
+
+- (instancetype)init {
+	return [self initWithArray:@[]];
+}
+
+// This is the designated initializer for CHInt64SortedSet.
+- (instancetype)initWithArray:(NSArray *)anArray {
+	self = [super init];
+	if (self) {
+		root = NULL;
+		height = 0;
+		count = 0;
+		mutations = 0;
+		[self addObjectsFromArray:anArray];
+	}
+	return self;
+}
+
+// Replaces the contents of an empty set with keys, which may be in any order.
+- (void)_buildWithKeys:(int64_t *)keys count:(NSUInteger)keyCount {
+	count = CHInt64SortUnique(keys, keyCount);
+	root = CHInt64TreeBuild(keys, count, &height);
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	return [self initWithArray:[decoder decodeObjectForKey:@"objects"]];
+}
+
+// Uses the same archived form as the binary search trees.
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[encoder encodeObject:[self allObjects] forKey:@"objects"];
+}
+
+#pragma mark <NSCopying>
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+	CHInt64SortedSet *newSet = [[[self class] allocWithZone:zone] init];
+	if (count > 0) {
+		int64_t *keys = malloc(sizeof(int64_t) * count);
+		NSUInteger keyCount = 0;
+		for (CHInt64Node *leaf = CHInt64TreeFirstLeaf(root, height); leaf != NULL; leaf = leaf->next) {
+			memcpy(keys + keyCount, leaf->keys, sizeof(int64_t) * leaf->count);
+			keyCount += leaf->count;
+		}
+		[newSet _buildWithKeys:keys count:keyCount];
+		free(keys);
+	}
+	return newSet;
+}
+
+#pragma mark <NSFastEnumeration>
+
+// The current leaf and the index in it are kept in the extra state. Since the
+// keys are boxed on demand, the objects are only valid until the autorelease
+// pool in which the enumeration started is drained.
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	CHInt64Node *leaf;
+	NSUInteger index;
+	if (state->state == 0) {
+		state->state = 1;
+		state->itemsPtr = stackbuf;
+		state->mutationsPtr = &mutations;
+		leaf = (root != NULL) ? CHInt64TreeFirstLeaf(root, height) : NULL;
+		index = 0;
+	} else {
+		leaf = (CHInt64Node *) state->extra[0];
+		index = (NSUInteger) state->extra[1];
+	}
+	NSUInteger batchCount = 0;
+	while (leaf != NULL && batchCount < len) {
+		stackbuf[batchCount++] = [NSNumber numberWithLongLong:leaf->keys[index++]];
+		if (index == leaf->count) {
+			leaf = leaf->next;
+			index = 0;
+		}
+	}
+	state->extra[0] = (unsigned long) leaf;
+	state->extra[1] = (unsigned long) index;
+	return batchCount;
+}
+
+#pragma mark Querying Contents
+
+// Objects are converted to keys as elsewhere, so a fractional part is truncated.
+- (id)_objectNearestToObject:(id)anObject direction:(NSUInteger)direction inclusive:(BOOL)inclusive {
+	int64_t nearest;
+	if (CHInt64TreeNearest(root, height, CHInt64KeyForObject(anObject), direction, inclusive, &nearest)) {
+		return [NSNumber numberWithLongLong:nearest];
+	}
+	return nil;
+}
+
+- (NSArray *)allObjects {
+	NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+	for (id anObject in self) {
+		[array addObject:anObject];
+	}
+	return array;
+}
+
+- (id)anyObject {
+	return [self firstObject];
+}
+
+- (id)ceilingObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:YES];
+}
+
+- (BOOL)containsInt64:(int64_t)key {
+	return CHInt64TreeContains(root, height, key);
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self member:anObject] != nil);
+}
+
+- (NSUInteger)count {
+	return count;
+}
+
+- (NSString *)description {
+	return [[self allObjects] description];
+}
+
+- (id)firstObject {
+	if (root == NULL) {
+		return nil;
+	}
+	CHInt64Node *leaf = CHInt64TreeFirstLeaf(root, height);
+	return [NSNumber numberWithLongLong:leaf->keys[0]];
+}
+
+- (id)floorObject:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:YES];
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects(count, [self firstObject], [self lastObject]);
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
+		return [self isEqualToSortedSet:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+- (BOOL)isEqualToSortedSet:(id<CHSortedSet>)otherSortedSet {
+	return CHCollectionsAreEqual(self, otherSortedSet);
+}
+
+- (id)lastObject {
+	if (root == NULL) {
+		return nil;
+	}
+	CHInt64Node *leaf = CHInt64TreeLastLeaf(root, height);
+	return [NSNumber numberWithLongLong:leaf->keys[leaf->count - 1]];
+}
+
+// Objects other than NSNumbers are never members, so they're simply not found.
+- (id)member:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	if (![anObject isKindOfClass:[NSNumber class]]) {
+		return nil;
+	}
+	int64_t key = [anObject longLongValue];
+	return CHInt64TreeContains(root, height, key) ? [NSNumber numberWithLongLong:key] : nil;
+}
+
+- (id)objectAfter:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:1 inclusive:NO];
+}
+
+- (id)objectBefore:(id)anObject {
+	return [self _objectNearestToObject:anObject direction:0 inclusive:NO];
+}
+
+- (NSEnumerator *)objectEnumerator {
+	return [[[CHInt64SortedSetEnumerator alloc]
+	         initWithSortedSet:self
+	                      leaf:(root != NULL) ? CHInt64TreeFirstLeaf(root, height) : NULL
+	                   reverse:NO
+	           mutationPointer:&mutations] autorelease];
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	return [[[CHInt64SortedSetEnumerator alloc]
+	         initWithSortedSet:self
+	                      leaf:(root != NULL) ? CHInt64TreeLastLeaf(root, height) : NULL
+	                   reverse:YES
+	           mutationPointer:&mutations] autorelease];
+}
+
+- (NSSet *)set {
+	NSMutableSet *set = [NSMutableSet setWithCapacity:count];
+	for (id anObject in self) {
+		[set addObject:anObject];
+	}
+	return set;
+}
+
+/*
+ \copydoc CHSortedSet::subsetFromObject:toObject:
+
+ \attention This implementation copies the keys in the subset from the leaves, then builds the subset from them directly in O(k) time, since they are already sorted.
+ */
+- (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	// If both parameters are nil, return a copy containing all the objects.
+	if (start == nil && end == nil) {
+		return [[self copy] autorelease];
+	}
+	CHInt64SortedSet *subset = [[[[self class] alloc] init] autorelease];
+	if (count == 0) {
+		return subset;
+	}
+	// Keys must be at or above low, and at or below high, unless they are
+	// outside the range between high and low (in which case either will do).
+	BOOL hasLow = (start != nil), hasHigh = (end != nil);
+	int64_t low = hasLow ? CHInt64KeyForObject(start) : 0;
+	int64_t high = hasHigh ? CHInt64KeyForObject(end) : 0;
+	BOOL includesLow = !(options & CHSubsetConstructionExcludeLowEndpoint);
+	BOOL includesHigh = !(options & CHSubsetConstructionExcludeHighEndpoint);
+	BOOL isInverted = (hasLow && hasHigh && low > high);
+	int64_t *keys = malloc(sizeof(int64_t) * count);
+	NSUInteger keyCount = 0;
+	for (CHInt64Node *leaf = CHInt64TreeFirstLeaf(root, height); leaf != NULL; leaf = leaf->next) {
+		for (NSUInteger i = 0; i < leaf->count; i++) {
+			int64_t key = leaf->keys[i];
+			BOOL isAboveLow = !hasLow || key > low || (includesLow && key == low);
+			BOOL isBelowHigh = !hasHigh || key < high || (includesHigh && key == high);
+			if (isInverted ? (isAboveLow || isBelowHigh) : (isAboveLow && isBelowHigh)) {
+				keys[keyCount++] = key;
+			}
+		}
+	}
+	[subset _buildWithKeys:keys count:keyCount];
+	free(keys);
+	return subset;
+}
+
+#pragma mark Modifying Contents
+
+- (void)addInt64:(int64_t)key {
+	++mutations;
+	if (CHInt64TreeInsert(&root, &height, key)) {
+		++count;
+	}
+}
+
+- (void)addInt64s:(const int64_t *)keys count:(NSUInteger)keyCount {
+	if (keyCount == 0) {
+		return;
+	}
+	++mutations;
+	if (count == 0 && keyCount > 1) {
+		int64_t *sortedKeys = malloc(sizeof(int64_t) * keyCount);
+		memcpy(sortedKeys, keys, sizeof(int64_t) * keyCount);
+		[self _buildWithKeys:sortedKeys count:keyCount];
+		free(sortedKeys);
+		return;
+	}
+	for (NSUInteger i = 0; i < keyCount; i++) {
+		if (CHInt64TreeInsert(&root, &height, keys[i])) {
+			++count;
+		}
+	}
+}
+
+- (void)addObject:(id)anObject {
+	[self addInt64:CHInt64KeyForObject(anObject)];
+}
+
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	NSUInteger arrayCount = [anArray count];
+	if (arrayCount == 0) {
+		return;
+	}
+	// The buffer is autoreleased, so it isn't leaked if an object is invalid.
+	int64_t *keys = [[NSMutableData dataWithLength:sizeof(int64_t) * arrayCount] mutableBytes];
+	NSUInteger keyCount = 0;
+	for (id anObject in anArray) {
+		keys[keyCount++] = CHInt64KeyForObject(anObject);
+	}
+	[self addInt64s:keys count:keyCount];
+}
+
+- (void)removeAllObjects {
+	if (root != NULL) {
+		++mutations;
+		CHInt64NodeFree(root, height - 1);
+		root = NULL;
+		height = 0;
+		count = 0;
+	}
+}
+
+- (void)removeFirstObject {
+	if (root != NULL) {
+		[self removeInt64:CHInt64TreeFirstLeaf(root, height)->keys[0]];
+	}
+}
+
+- (void)removeInt64:(int64_t)key {
+	if (CHInt64TreeRemove(&root, &height, key)) {
+		++mutations;
+		--count;
+	}
+}
+
+- (void)removeLastObject {
+	if (root != NULL) {
+		CHInt64Node *leaf = CHInt64TreeLastLeaf(root, height);
+		[self removeInt64:leaf->keys[leaf->count - 1]];
+	}
+}
+
+- (void)removeObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	if ([anObject isKindOfClass:[NSNumber class]]) {
+		[self removeInt64:[anObject longLongValue]];
+	}
+}
+
+@end
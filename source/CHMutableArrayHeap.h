@@ -16,16 +16,51 @@ NS_ASSUME_NONNULL_BEGIN
 
 /**
  A simple CHHeap implemented as a subclass of NSMutableArray.
+ 
+ Objects are ordered by their @c -compare: method, unless the heap is created with a comparator block or comparison function instead. Rather than sending @c -compare: for every comparison, adding or removing an object looks up the method once and calls it directly.
  */
 @interface CHMutableArrayHeap<__covariant ObjectType> : NSMutableArray <CHHeap> {
 	NSMutableArray *array; // An array to use for storing objects in the heap.
 	NSComparisonResult sortOrder; // Whether to sort objects ascending or not.
 	unsigned long mutations; // Used to track mutations for NSFastEnumeration.
+	CHComparison ordering; // How objects are compared; its cache is never used.
+	NSComparator comparator; // The block used by ordering, if any.
 }
 
 - (instancetype)initWithCapacity:(NSUInteger)capacity NS_DESIGNATED_INITIALIZER; // Inherited from NSMutableArray
 - (instancetype)initWithOrdering:(NSComparisonResult)order array:(NSArray<ObjectType> *)array NS_DESIGNATED_INITIALIZER;
 
+/**
+ Initialize an empty heap with a given sort ordering, which compares objects using a comparator rather than their @c -compare: method.
+ 
+ @param order The sort order to use, either @c NSOrderedAscending or @c NSOrderedDescending. The root element of the heap will be the smallest or largest (according to @a cmptr), respectively. For any other value, an @c NSInvalidArgumentException is raised.
+ @param cmptr A comparator block that defines a total ordering of the objects to be added. The block is copied.
+ @return An initialized heap that contains no objects and will sort in the specified order using @a cmptr.
+ 
+ @throw NSInvalidArgumentException if @a cmptr is @c nil.
+ 
+ @attention A heap created this way can't be archived, since blocks can't be encoded.
+ 
+ @see initWithOrdering:comparisonFunction:context:
+ */
+- (instancetype)initWithOrdering:(NSComparisonResult)order comparator:(NSComparator)cmptr;
+
+/**
+ Initialize an empty heap with a given sort ordering, which compares objects using a C function rather than their @c -compare: method. Calling a function avoids the overhead of sending a message for each comparison.
+ 
+ @param order The sort order to use, either @c NSOrderedAscending or @c NSOrderedDescending. The root element of the heap will be the smallest or largest (according to @a function), respectively. For any other value, an @c NSInvalidArgumentException is raised.
+ @param function A function that defines a total ordering of the objects to be added.
+ @param context A pointer that is passed to @a function with each pair of objects to be compared. It is not retained.
+ @return An initialized heap that contains no objects and will sort in the specified order using @a function.
+ 
+ @throw NSInvalidArgumentException if @a function is @c NULL.
+ 
+ @attention A heap created this way can't be archived, since functions can't be encoded.
+ 
+ @see initWithOrdering:comparator:
+ */
+- (instancetype)initWithOrdering:(NSComparisonResult)order comparisonFunction:(CHComparisonFunction)function context:(nullable void *)context;
+
 /**
  Determine whether the receiver contains a given object, matched using the == operator.
  
@@ -12,6 +12,7 @@
 - (void)heapifyFromIndex:(NSUInteger)parentIndex {
 	NSUInteger leftIndex, rightIndex;
 	id parent, leftChild, rightChild;
+	CHComparison localOrdering = ordering;
 	
 	// Bubble the specified node down until the heap property is satisfied.
 	NSUInteger count = [array count];
@@ -23,15 +24,15 @@
 		leftChild = [array objectAtIndex:leftIndex];
 		rightChild = (rightIndex < count) ? [array objectAtIndex:rightIndex] : nil;
 		// A binary heap is always a complete tree, so left will never be nil.
-		if (rightChild == nil || [leftChild compare:rightChild] == sortOrder) {
-			if ([parent compare:leftChild] != sortOrder) {
+		if (rightChild == nil || CHComparisonCompare(&localOrdering, leftChild, rightChild) == sortOrder) {
+			if (CHComparisonCompare(&localOrdering, parent, leftChild) != sortOrder) {
 				[array exchangeObjectAtIndex:parentIndex withObjectAtIndex:leftIndex];
 				parentIndex = leftIndex;
 			} else {
 				break;
 			}
 		} else {
-			if ([parent compare:rightChild] != sortOrder) {
+			if (CHComparisonCompare(&localOrdering, parent, rightChild) != sortOrder) {
 				[array exchangeObjectAtIndex:parentIndex withObjectAtIndex:rightIndex];
 				parentIndex = rightIndex;
 			} else {
@@ -45,6 +46,7 @@
 
 - (void)dealloc {
 	[array release];
+	[comparator release];
 	[super dealloc];
 }
 
@@ -83,6 +85,29 @@
 	return self;
 }
 
+- (instancetype)initWithOrdering:(NSComparisonResult)order comparator:(NSComparator)cmptr {
+	CHRaiseInvalidArgumentExceptionIfNil(cmptr);
+	self = [self initWithOrdering:order array:@[]];
+	if (self) {
+		comparator = [cmptr copy];
+		ordering.function = CHCompareUsingComparator;
+		ordering.context = (void *)comparator;
+	}
+	return self;
+}
+
+- (instancetype)initWithOrdering:(NSComparisonResult)order comparisonFunction:(CHComparisonFunction)function context:(void *)context {
+	if (function == NULL) {
+		CHRaiseInvalidArgumentException(@"Invalid NULL comparison function");
+	}
+	self = [self initWithOrdering:order array:@[]];
+	if (self) {
+		ordering.function = function;
+		ordering.context = context;
+	}
+	return self;
+}
+
 #pragma mark <NSCoding>
 
 // Overridden from NSMutableArray to encode/decode as the proper class.
@@ -98,6 +123,9 @@
 }
 
 - (void)encodeWithCoder:(NSCoder *)encoder {
+	if (ordering.function != NULL) {
+		CHRaiseInvalidArgumentException(@"A heap with a comparator or comparison function can't be archived");
+	}
 	[super encodeWithCoder:encoder];
 	[encoder encodeObject:array forKey:@"array"];
 	[encoder encodeBool:(sortOrder == NSOrderedAscending) forKey:@"sortAscending"];
@@ -106,7 +134,14 @@
 #pragma mark <NSCopying>
 
 - (instancetype)copyWithZone:(NSZone *)zone {
-	return [[[self class] allocWithZone:zone] initWithOrdering:sortOrder array:array];
+	CHMutableArrayHeap *heap = [[[self class] allocWithZone:zone] initWithOrdering:sortOrder array:@[]];
+	heap->ordering = ordering;
+	if (comparator != nil) {
+		heap->comparator = [comparator copy];
+		heap->ordering.context = (void *)heap->comparator;
+	}
+	[heap addObjectsFromArray:array];
+	return heap;
 }
 
 #pragma mark <NSFastEnumeration>
@@ -145,6 +180,15 @@
 }
 
 - (NSArray *)allObjectsInSortedOrder {
+	if (ordering.function != NULL) {
+		__block CHComparison sortOrdering = ordering;
+		NSComparisonResult order = sortOrder;
+		return [array sortedArrayUsingComparator:^(id object1, id object2) {
+			NSComparisonResult comparison = CHComparisonCompare(&sortOrdering, object1, object2);
+			return (comparison == order) ? NSOrderedAscending
+			     : (comparison == NSOrderedSame) ? NSOrderedSame : NSOrderedDescending;
+		}];
+	}
 	NSSortDescriptor *sortDescriptor = [[NSSortDescriptor alloc]
 	                                    initWithKey:nil
 	                                      ascending:(sortOrder == NSOrderedAscending)];
@@ -209,11 +253,12 @@
 	++mutations;
 	[array addObject:anObject];
 	// Bubble the new object (at the end of the array) up the heap as necessary.
+	CHComparison localOrdering = ordering;
 	NSUInteger parentIndex;
 	NSUInteger index = [array count] - 1;
 	while (index > 0) {
 		parentIndex = (index - 1) / 2;
-		if ([[array objectAtIndex:parentIndex] compare:anObject] != sortOrder) {
+		if (CHComparisonCompare(&localOrdering, [array objectAtIndex:parentIndex], anObject) != sortOrder) {
 			[array exchangeObjectAtIndex:parentIndex withObjectAtIndex:index];
 			index = parentIndex;
 		} else {
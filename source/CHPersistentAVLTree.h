@@ -0,0 +1,54 @@
+//
+//  CHPersistentAVLTree.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHSortedSet.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHPersistentAVLTree.h
+ A persistent <a href="http://en.wikipedia.org/wiki/Avl_tree">AVL tree</a> implementation of CHSortedSet, which takes snapshots in constant time.
+ */
+
+struct CHPersistentAVLTreeNode; // Defined in CHPersistentAVLTree.m
+
+/**
+ An <a href="http://en.wikipedia.org/wiki/Avl_tree">AVL tree</a> whose nodes may be shared by several trees, so that it can be <a href="http://en.wikipedia.org/wiki/Persistent_data_structure">persistent</a>. A \link #snapshot -snapshot\endlink of the tree takes O(1) time, since it merely shares the root node of the tree, and remains unchanged as the tree is modified afterward. Copying the tree with @c -copy is also O(1) for the same reason.
+
+ Each node counts the trees and nodes that refer to it, and is only modified in place if nothing else does. Otherwise, an insertion or removal copies the O(log n) nodes on the path from the root to the affected node (<a href="http://en.wikipedia.org/wiki/Persistent_data_structure#Path_copying">path copying</a>), and leaves the shared nodes alone. Nodes are freed (and release their objects) once nothing refers to them, so when the last snapshot that shares a node is deallocated, the node is reclaimed.
+
+ Since the nodes of a snapshot are never modified, any number of threads can read a snapshot without locks, even while another thread modifies the tree from which it was taken. (The tree itself, like other collections, must not be read while it is being modified.) Reference counts are updated atomically, so snapshots may be released on any thread.
+
+ Objects are ordered by their @c -compare: method, which (as in CHAbstractBinarySearchTree) is looked up once per operation and then called directly.
+ */
+@interface CHPersistentAVLTree<__covariant ObjectType> : NSObject <CHSortedSet>
+{
+	struct CHPersistentAVLTreeNode *root; // The root of the tree, or NULL if empty.
+	NSUInteger count; // The number of objects currently in the tree.
+	unsigned long mutations; // Tracks mutations for NSFastEnumeration.
+	BOOL isSnapshot; // Whether the tree is an immutable snapshot.
+}
+
+/**
+ Returns an immutable sorted set that contains the objects currently in the receiver, sharing its nodes. The snapshot is unaffected by later changes to the receiver.
+
+ @return A snapshot of the receiver, which is an immutable CHPersistentAVLTree. Methods that would modify it raise an exception.
+
+ @attention This method takes O(1) time. The first time the receiver is modified afterward, it copies each node it changes instead of modifying the snapshot.
+ */
+- (CHPersistentAVLTree<ObjectType> *)snapshot;
+
+/**
+ Returns whether the receiver is an immutable snapshot.
+
+ @return @c YES if the receiver was created by \link #snapshot -snapshot\endlink, otherwise @c NO.
+ */
+- (BOOL)isSnapshot;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,668 @@
+//
+//  CHPersistentAVLTree.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHPersistentAVLTree.h>
+
+// An AVL tree of height h has at least F(h+2)-1 nodes, where F is the Fibonacci
+// sequence, so no tree that fits in memory can be this tall.
+#define kCHPersistentAVLTreeMaximumHeight 96
+
+#define CHRaiseUnsupportedOperationExceptionIfSnapshot() \
+if (isSnapshot) { \
+	CHRaiseUnsupportedOperationException(); \
+}
+
+#pragma mark Nodes
+
+/**
+ A node in a CHPersistentAVLTree, which may be shared by several trees. A node retains its object, and holds a reference to each of its children. It is freed when the last tree or node that refers to it gives up its reference. A node may only be modified by the holder of its only reference.
+ */
+typedef struct CHPersistentAVLTreeNode {
+	__unsafe_unretained id object; ///< The object stored in the node.
+	struct CHPersistentAVLTreeNode *link[2]; ///< The left and right subtrees, which may be @c NULL.
+	uint32_t references; ///< The number of trees and nodes that refer to the node.
+	int32_t height; ///< The number of nodes on the longest path down to a leaf.
+} CHPersistentAVLTreeNode;
+
+static inline int32_t CHPersistentAVLTreeHeight(CHPersistentAVLTreeNode *node) {
+	return (node != NULL) ? node->height : 0;
+}
+
+static inline void CHPersistentAVLTreeUpdateHeight(CHPersistentAVLTreeNode *node) {
+	node->height = 1 + MAX(CHPersistentAVLTreeHeight(node->link[0]), CHPersistentAVLTreeHeight(node->link[1]));
+}
+
+// Takes over the references to the children, and retains the object.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeNodeCreate(id anObject, CHPersistentAVLTreeNode *left, CHPersistentAVLTreeNode *right) {
+	CHPersistentAVLTreeNode *node = malloc(sizeof(CHPersistentAVLTreeNode));
+	node->object = [anObject retain];
+	node->link[0] = left;
+	node->link[1] = right;
+	node->references = 1;
+	CHPersistentAVLTreeUpdateHeight(node);
+	return node;
+}
+
+static inline CHPersistentAVLTreeNode *CHPersistentAVLTreeNodeRetain(CHPersistentAVLTreeNode *node) {
+	if (node != NULL) {
+		__atomic_fetch_add(&node->references, 1, __ATOMIC_RELAXED);
+	}
+	return node;
+}
+
+// Gives up a reference to a node, and frees it (and any of its descendants that
+// aren't shared) if it was the last one.
+static void CHPersistentAVLTreeNodeRelease(CHPersistentAVLTreeNode *node) {
+	if (node != NULL && __atomic_sub_fetch(&node->references, 1, __ATOMIC_ACQ_REL) == 0) {
+		[node->object release];
+		CHPersistentAVLTreeNodeRelease(node->link[0]);
+		CHPersistentAVLTreeNodeRelease(node->link[1]);
+		free(node);
+	}
+}
+
+// Returns a node that the caller can modify in place in exchange for its
+// reference to a given node. If anything else refers to the node, it is copied.
+// Since only the holder of the only reference can add more, a node that has
+// just one reference can't become shared while the caller modifies it.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeNodeMakeUnique(CHPersistentAVLTreeNode *node) {
+	if (__atomic_load_n(&node->references, __ATOMIC_ACQUIRE) == 1) {
+		return node;
+	}
+	CHPersistentAVLTreeNode *copy = CHPersistentAVLTreeNodeCreate(node->object,
+	                                                              CHPersistentAVLTreeNodeRetain(node->link[0]),
+	                                                              CHPersistentAVLTreeNodeRetain(node->link[1]));
+	CHPersistentAVLTreeNodeRelease(node);
+	return copy;
+}
+
+// Rotates a node the caller may modify down in direction dir (0 for left, 1 for
+// right), and returns the child that takes its place.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeRotate(CHPersistentAVLTreeNode *node, int dir) {
+	CHPersistentAVLTreeNode *child = CHPersistentAVLTreeNodeMakeUnique(node->link[!dir]);
+	node->link[!dir] = child->link[dir];
+	child->link[dir] = node;
+	CHPersistentAVLTreeUpdateHeight(node);
+	CHPersistentAVLTreeUpdateHeight(child);
+	return child;
+}
+
+// Restores the balance of a node the caller may modify, whose subtrees differ
+// in height by at most 2, and returns the root of the rebalanced subtree.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeRebalance(CHPersistentAVLTreeNode *node) {
+	int32_t balance = CHPersistentAVLTreeHeight(node->link[1]) - CHPersistentAVLTreeHeight(node->link[0]);
+	if (balance < -1 || balance > 1) {
+		int heavy = (balance > 0); // The side with the taller subtree
+		CHPersistentAVLTreeNode *child = node->link[heavy];
+		if (CHPersistentAVLTreeHeight(child->link[!heavy]) > CHPersistentAVLTreeHeight(child->link[heavy])) {
+			node->link[heavy] = CHPersistentAVLTreeRotate(CHPersistentAVLTreeNodeMakeUnique(child), heavy);
+		}
+		return CHPersistentAVLTreeRotate(node, !heavy);
+	}
+	CHPersistentAVLTreeUpdateHeight(node);
+	return node;
+}
+
+// Inserts an object in the subtree rooted at a node, in exchange for the caller's
+// reference to it, and returns the new root of the subtree. If an equal object is
+// replaced, it is returned in replaced, and the caller must release it.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeInsert(CHPersistentAVLTreeNode *node, id anObject, CHComparison *ordering, id *replaced) {
+	if (node == NULL) {
+		return CHPersistentAVLTreeNodeCreate(anObject, NULL, NULL);
+	}
+	NSComparisonResult comparison = CHComparisonCompare(ordering, node->object, anObject);
+	node = CHPersistentAVLTreeNodeMakeUnique(node);
+	if (comparison == NSOrderedSame) {
+		*replaced = node->object;
+		node->object = [anObject retain];
+		return node;
+	}
+	int dir = (comparison == NSOrderedAscending); // R on YES
+	node->link[dir] = CHPersistentAVLTreeInsert(node->link[dir], anObject, ordering, replaced);
+	return (*replaced == nil) ? CHPersistentAVLTreeRebalance(node) : node;
+}
+
+// Removes the first (or last) node in a subtree, in exchange for the caller's
+// reference to its root, and returns the new root. The object in the removed node
+// is retained and returned in removed.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeRemoveEnd(CHPersistentAVLTreeNode *node, int dir, id *removed) {
+	if (node->link[dir] == NULL) {
+		*removed = [node->object retain];
+		CHPersistentAVLTreeNode *child = CHPersistentAVLTreeNodeRetain(node->link[!dir]);
+		CHPersistentAVLTreeNodeRelease(node);
+		return child;
+	}
+	node = CHPersistentAVLTreeNodeMakeUnique(node);
+	node->link[dir] = CHPersistentAVLTreeRemoveEnd(node->link[dir], dir, removed);
+	return CHPersistentAVLTreeRebalance(node);
+}
+
+// Removes the node at the end of a path, given as the direction taken at each
+// of depth levels below a node, in exchange for the caller's reference to that
+// node, and returns the new root of the subtree. No objects are compared.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeRemoveAlongPath(CHPersistentAVLTreeNode *node, const int *dirs, NSUInteger depth) {
+	if (depth > 0) {
+		node = CHPersistentAVLTreeNodeMakeUnique(node);
+		node->link[dirs[0]] = CHPersistentAVLTreeRemoveAlongPath(node->link[dirs[0]], dirs + 1, depth - 1);
+		return CHPersistentAVLTreeRebalance(node);
+	}
+	if (node->link[0] == NULL || node->link[1] == NULL) {
+		CHPersistentAVLTreeNode *child = CHPersistentAVLTreeNodeRetain(node->link[node->link[0] == NULL]);
+		CHPersistentAVLTreeNodeRelease(node);
+		return child;
+	}
+	// Replace the object with its successor, which is removed from the right.
+	node = CHPersistentAVLTreeNodeMakeUnique(node);
+	id successor;
+	node->link[1] = CHPersistentAVLTreeRemoveEnd(node->link[1], 0, &successor);
+	[node->object release];
+	node->object = successor;
+	return CHPersistentAVLTreeRebalance(node);
+}
+
+// Removes an object equal to anObject from the subtree rooted at a node, in
+// exchange for the caller's reference to it, and returns the new root of the
+// subtree. The path to the object is found first, without modifying anything,
+// since removal copies each shared node on it; if there is no such object,
+// removed is set to NO and the node is returned unchanged.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeRemove(CHPersistentAVLTreeNode *node, id anObject, CHComparison *ordering, BOOL *removed) {
+	int dirs[kCHPersistentAVLTreeMaximumHeight];
+	NSUInteger depth = 0;
+	CHPersistentAVLTreeNode *current = node;
+	NSComparisonResult comparison;
+	while (current != NULL && (comparison = CHComparisonCompare(ordering, current->object, anObject))) {
+		dirs[depth] = (comparison == NSOrderedAscending); // R on YES
+		current = current->link[dirs[depth++]];
+	}
+	*removed = (current != NULL);
+	return (current != NULL) ? CHPersistentAVLTreeRemoveAlongPath(node, dirs, depth) : node;
+}
+
+// Builds a perfectly balanced tree of objects in ascending order in O(n) time.
+static CHPersistentAVLTreeNode *CHPersistentAVLTreeBuild(__unsafe_unretained id *objects, NSUInteger objectCount) {
+	if (objectCount == 0) {
+		return NULL;
+	}
+	NSUInteger middle = objectCount / 2;
+	return CHPersistentAVLTreeNodeCreate(objects[middle],
+	                                     CHPersistentAVLTreeBuild(objects, middle),
+	                                     CHPersistentAVLTreeBuild(objects + middle + 1, objectCount - middle - 1));
+}
+
+static inline CHPersistentAVLTreeNode *CHPersistentAVLTreeEnd(CHPersistentAVLTreeNode *node, int dir) {
+	while (node->link[dir] != NULL) {
+		node = node->link[dir];
+	}
+	return node;
+}
+
+// Returns the object nearest to anObject below it (if dir is 0) or above it (if
+// 1), or one equal to it if inclusive is YES, or nil if there is none.
+static id CHPersistentAVLTreeNearest(CHPersistentAVLTreeNode *node, id anObject, int dir, BOOL inclusive, CHComparison *ordering) {
+	id nearest = nil;
+	NSComparisonResult beyond = dir ? NSOrderedDescending : NSOrderedAscending;
+	while (node != NULL) {
+		NSComparisonResult comparison = CHComparisonCompare(ordering, node->object, anObject);
+		if (comparison == NSOrderedSame && inclusive) {
+			return node->object;
+		}
+		if (comparison == beyond) {
+			nearest = node->object;
+			node = node->link[!dir];
+		} else {
+			node = node->link[dir];
+		}
+	}
+	return nearest;
+}
+
+// Pushes a node and the nodes down its left (or right) spine onto a stack.
+static inline void CHPersistentAVLTreePushSpine(CHPersistentAVLTreeNode **stack, NSUInteger *depth, CHPersistentAVLTreeNode *node, int dir) {
+	while (node != NULL) {
+		stack[(*depth)++] = node;
+		node = node->link[dir];
+	}
+}
+
+#pragma mark -
+
+/**
+ An NSEnumerator for traversing a CHPersistentAVLTree in ascending or descending order, using a stack of the nodes whose objects have yet to be visited.
+ */
+@interface CHPersistentAVLTreeEnumerator : NSEnumerator
+
+- (instancetype)initWithTree:(CHPersistentAVLTree *)tree
+                        root:(CHPersistentAVLTreeNode *)root
+                     reverse:(BOOL)reverse
+             mutationPointer:(unsigned long *)mutations;
+
+@end
+
+@implementation CHPersistentAVLTreeEnumerator
+{
+	__strong CHPersistentAVLTree *searchTree; // The tree being enumerated.
+	int dir; // The direction in which to find the first object (0 if ascending).
+	CHPersistentAVLTreeNode *stack[kCHPersistentAVLTreeMaximumHeight]; // Nodes yet to be visited.
+	NSUInteger depth; // The number of nodes in the stack.
+	unsigned long mutationCount; // Stores the collection's initial mutation.
+	unsigned long *mutationPtr; // Pointer for checking changes in mutation.
+}
+
+/**
+ Create an enumerator which traverses a given tree in ascending or descending order.
+
+ @param tree The tree being enumerated. This collection is to be retained while the enumerator has not exhausted all its objects.
+ @param root The root node of @a tree, or @c NULL if it is empty.
+ @param reverse Whether to enumerate the objects in descending order.
+ @param mutations A pointer to the collection's mutation count for invalidation.
+ @return An initialized CHPersistentAVLTreeEnumerator which will enumerate objects in @a tree.
+ */
+- (instancetype)initWithTree:(CHPersistentAVLTree *)tree
+                        root:(CHPersistentAVLTreeNode *)root
+                     reverse:(BOOL)reverse
+             mutationPointer:(unsigned long *)mutations
+{
+	self = [super init];
+	if (self) {
+		dir = reverse ? 1 : 0;
+		mutationCount = *mutations;
+		mutationPtr = mutations;
+		if (root != NULL) {
+			searchTree = [tree retain];
+			CHPersistentAVLTreePushSpine(stack, &depth, root, dir);
+		}
+	}
+	return self;
+}
+
+- (void)dealloc {
+	[searchTree release];
+	[super dealloc];
+}
+
+- (NSArray *)allObjects {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	NSMutableArray *array = [NSMutableArray array];
+	id anObject;
+	while ((anObject = [self nextObject])) {
+		[array addObject:anObject];
+	}
+	return array;
+}
+
+- (id)nextObject {
+	if (mutationCount != *mutationPtr) {
+		CHRaiseMutatedCollectionException();
+	}
+	if (depth == 0) {
+		return nil;
+	}
+	CHPersistentAVLTreeNode *node = stack[--depth];
+	CHPersistentAVLTreePushSpine(stack, &depth, node->link[!dir], dir);
+	id anObject = node->object;
+	if (depth == 0) {
+		// Keep the last object alive after the tree is released.
+		[[anObject retain] autorelease];
+		[searchTree release];
+		searchTree = nil;
+	}
+	return anObject;
+}
+
+@end
+
+#pragma mark -
+
+@implementation CHPersistentAVLTree
+
+- (void)dealloc {
+	CHPersistentAVLTreeNodeRelease(root);
+	[super dealloc];
+}
+
+- (instancetype)init {
+	return [self _initWithRoot:NULL count:0 snapshot:NO];
+}
+
+- (instancetype)initWithArray:(NSArray *)anArray {
+	self = [self init];
+	if (self) {
+		[self addObjectsFromArray:anArray];
+	}
+	return self;
+}
+
+// This is the designated initializer for CHPersistentAVLTree. The receiver takes
+// a new reference to the given root node, which may be shared.
+- (instancetype)_initWithRoot:(CHPersistentAVLTreeNode *)aRoot count:(NSUInteger)aCount snapshot:(BOOL)snapshot {
+	self = [super init];
+	if (self) {
+		root = CHPersistentAVLTreeNodeRetain(aRoot);
+		count = aCount;
+		mutations = 0;
+		isSnapshot = snapshot;
+	}
+	return self;
+}
+
+#pragma mark <NSCoding>
+
+- (instancetype)initWithCoder:(NSCoder *)decoder {
+	self = [self initWithArray:[decoder decodeObjectForKey:@"objects"]];
+	if (self) {
+		isSnapshot = [decoder decodeBoolForKey:@"snapshot"];
+	}
+	return self;
+}
+
+// Since the objects are archived in ascending order, the tree is rebuilt in
+// linear time when it is unarchived.
+- (void)encodeWithCoder:(NSCoder *)encoder {
+	[encoder encodeObject:[self allObjects] forKey:@"objects"];
+	[encoder encodeBool:isSnapshot forKey:@"snapshot"];
+}
+
+#pragma mark <NSCopying>
+
+// A copy shares the receiver's nodes, so it takes O(1) time. An immutable
+// snapshot can simply be shared itself.
+- (instancetype)copyWithZone:(NSZone *)zone {
+	if (isSnapshot) {
+		return [self retain];
+	}
+	return [[[self class] allocWithZone:zone] _initWithRoot:root count:count snapshot:NO];
+}
+
+#pragma mark <NSFastEnumeration>
+
+// Each call fills the buffer with the objects that follow the last object from
+// the previous call, which is kept in the extra state. The path to the first of
+// them is found again by searching for it, so the state needs no stack.
+- (NSUInteger)countByEnumeratingWithState:(NSFastEnumerationState *)state objects:(id *)stackbuf count:(NSUInteger)len {
+	CHPersistentAVLTreeNode *stack[kCHPersistentAVLTreeMaximumHeight];
+	NSUInteger depth = 0;
+	if (state->state == 0) {
+		state->state = 1;
+		state->mutationsPtr = &mutations;
+		CHPersistentAVLTreePushSpine(stack, &depth, root, 0);
+	} else {
+		__unsafe_unretained id lastObject = (id) state->extra[0];
+		CHComparison ordering = {NULL, NULL, Nil, NULL};
+		for (CHPersistentAVLTreeNode *node = root; node != NULL; ) {
+			if (CHComparisonCompare(&ordering, node->object, lastObject) == NSOrderedDescending) {
+				stack[depth++] = node;
+				node = node->link[0];
+			} else {
+				node = node->link[1];
+			}
+		}
+	}
+	NSUInteger batchCount = 0;
+	while (batchCount < len && depth > 0) {
+		CHPersistentAVLTreeNode *node = stack[--depth];
+		stackbuf[batchCount++] = node->object;
+		CHPersistentAVLTreePushSpine(stack, &depth, node->link[1], 0);
+	}
+	if (batchCount > 0) {
+		state->extra[0] = (unsigned long) stackbuf[batchCount - 1];
+	}
+	state->itemsPtr = stackbuf;
+	return batchCount;
+}
+
+#pragma mark Querying Contents
+
+- (NSArray *)allObjects {
+	NSMutableArray *array = [NSMutableArray arrayWithCapacity:count];
+	for (id anObject in self) {
+		[array addObject:anObject];
+	}
+	return array;
+}
+
+- (id)anyObject {
+	return (root != NULL) ? root->object : nil;
+}
+
+- (id)ceilingObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHPersistentAVLTreeNearest(root, anObject, 1, YES, &ordering);
+}
+
+- (BOOL)containsObject:(id)anObject {
+	return ([self member:anObject] != nil);
+}
+
+- (NSUInteger)count {
+	return count;
+}
+
+- (NSString *)description {
+	return [[self allObjects] description];
+}
+
+- (id)firstObject {
+	return (root != NULL) ? CHPersistentAVLTreeEnd(root, 0)->object : nil;
+}
+
+- (id)floorObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHPersistentAVLTreeNearest(root, anObject, 0, YES, &ordering);
+}
+
+- (NSUInteger)hash {
+	return CHHashOfCountAndObjects(count, [self firstObject], [self lastObject]);
+}
+
+- (BOOL)isEqual:(id)otherObject {
+	if ([otherObject conformsToProtocol:@protocol(CHSortedSet)]) {
+		return [self isEqualToSortedSet:otherObject];
+	} else {
+		return NO;
+	}
+}
+
+- (BOOL)isEqualToSortedSet:(id<CHSortedSet>)otherSortedSet {
+	return CHCollectionsAreEqual(self, otherSortedSet);
+}
+
+- (BOOL)isSnapshot {
+	return isSnapshot;
+}
+
+- (id)lastObject {
+	return (root != NULL) ? CHPersistentAVLTreeEnd(root, 1)->object : nil;
+}
+
+- (id)member:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	CHPersistentAVLTreeNode *node = root;
+	NSComparisonResult comparison;
+	while (node != NULL && (comparison = CHComparisonCompare(&ordering, node->object, anObject))) {
+		node = node->link[comparison == NSOrderedAscending]; // R on YES
+	}
+	return (node != NULL) ? node->object : nil;
+}
+
+- (id)objectAfter:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHPersistentAVLTreeNearest(root, anObject, 1, NO, &ordering);
+}
+
+- (id)objectBefore:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	return CHPersistentAVLTreeNearest(root, anObject, 0, NO, &ordering);
+}
+
+- (NSEnumerator *)objectEnumerator {
+	return [[[CHPersistentAVLTreeEnumerator alloc] initWithTree:self
+	                                                       root:root
+	                                                    reverse:NO
+	                                            mutationPointer:&mutations] autorelease];
+}
+
+- (NSEnumerator *)reverseObjectEnumerator {
+	return [[[CHPersistentAVLTreeEnumerator alloc] initWithTree:self
+	                                                       root:root
+	                                                    reverse:YES
+	                                            mutationPointer:&mutations] autorelease];
+}
+
+- (NSSet *)set {
+	NSMutableSet *set = [NSMutableSet setWithCapacity:count];
+	for (id anObject in self) {
+		[set addObject:anObject];
+	}
+	return set;
+}
+
+- (CHPersistentAVLTree *)snapshot {
+	if (isSnapshot) {
+		return [[self retain] autorelease];
+	}
+	return [[[[self class] alloc] _initWithRoot:root count:count snapshot:YES] autorelease];
+}
+
+/*
+ \copydoc CHSortedSet::subsetFromObject:toObject:
+
+ \attention This implementation collects the objects in the subset in ascending order, then builds the subset from them directly in O(k) time. The subset is never a snapshot, even if the receiver is.
+ */
+- (id<CHSortedSet>)subsetFromObject:(id)start toObject:(id)end options:(CHSubsetConstructionOptions)options {
+	// If both parameters are nil, return a copy containing all the objects.
+	if (start == nil && end == nil) {
+		return [[[[self class] alloc] _initWithRoot:root count:count snapshot:NO] autorelease];
+	}
+	CHPersistentAVLTree *subset = [[[[self class] alloc] init] autorelease];
+	if (count == 0) {
+		return subset;
+	}
+	// Objects must be at or above start, and at or below end, unless end doesn't
+	// come after start (in which case either will do). As for other trees, equal
+	// endpoints include everything, or everything but the endpoint if excluded.
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	BOOL includesLow = !(options & CHSubsetConstructionExcludeLowEndpoint);
+	BOOL includesHigh = !(options & CHSubsetConstructionExcludeHighEndpoint);
+	NSComparisonResult comparison = (start != nil && end != nil) ? CHComparisonCompare(&ordering, start, end) : NSOrderedAscending;
+	BOOL isInverted = (comparison != NSOrderedAscending);
+	if (comparison == NSOrderedSame && !(includesLow && includesHigh)) {
+		includesLow = includesHigh = NO;
+	}
+	__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * count);
+	NSUInteger objectCount = 0;
+	for (id anObject in self) {
+		NSComparisonResult low = (start != nil) ? CHComparisonCompare(&ordering, anObject, start) : NSOrderedDescending;
+		NSComparisonResult high = (end != nil) ? CHComparisonCompare(&ordering, anObject, end) : NSOrderedAscending;
+		BOOL isAboveLow = (low == NSOrderedDescending || (includesLow && low == NSOrderedSame));
+		BOOL isBelowHigh = (high == NSOrderedAscending || (includesHigh && high == NSOrderedSame));
+		if (isInverted ? (isAboveLow || isBelowHigh) : (isAboveLow && isBelowHigh)) {
+			objects[objectCount++] = anObject;
+		}
+	}
+	subset->root = CHPersistentAVLTreeBuild(objects, objectCount);
+	subset->count = objectCount;
+	free(objects);
+	return subset;
+}
+
+#pragma mark Modifying Contents
+
+- (void)addObject:(id)anObject {
+	CHRaiseUnsupportedOperationExceptionIfSnapshot();
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	++mutations;
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	id replaced = nil;
+	root = CHPersistentAVLTreeInsert(root, anObject, &ordering, &replaced);
+	if (replaced != nil) {
+		[replaced release];
+	} else {
+		++count;
+	}
+}
+
+// An empty tree is built directly from objects that are already in ascending
+// order (such as when unarchiving) in linear time.
+- (void)addObjectsFromArray:(NSArray *)anArray {
+	CHRaiseUnsupportedOperationExceptionIfSnapshot();
+	NSUInteger arrayCount = [anArray count];
+	if (count == 0 && arrayCount > 1) {
+		CHComparison ordering = {NULL, NULL, Nil, NULL};
+		__unsafe_unretained id *objects = (__unsafe_unretained id *) malloc(kCHPointerSize * arrayCount);
+		[anArray getObjects:objects range:NSMakeRange(0, arrayCount)];
+		NSUInteger index = 1;
+		while (index < arrayCount && CHComparisonCompare(&ordering, objects[index-1], objects[index]) == NSOrderedAscending) {
+			index++;
+		}
+		if (index == arrayCount) {
+			++mutations;
+			CHPersistentAVLTreeNodeRelease(root);
+			root = CHPersistentAVLTreeBuild(objects, arrayCount);
+			count = arrayCount;
+		}
+		free(objects);
+		if (index == arrayCount) {
+			return;
+		}
+	}
+	for (id anObject in anArray) {
+		[self addObject:anObject];
+	}
+}
+
+- (void)removeAllObjects {
+	CHRaiseUnsupportedOperationExceptionIfSnapshot();
+	if (root != NULL) {
+		++mutations;
+		CHPersistentAVLTreeNodeRelease(root);
+		root = NULL;
+		count = 0;
+	}
+}
+
+- (void)removeFirstObject {
+	CHRaiseUnsupportedOperationExceptionIfSnapshot();
+	if (root != NULL) {
+		++mutations;
+		--count;
+		id removed;
+		root = CHPersistentAVLTreeRemoveEnd(root, 0, &removed);
+		[removed release];
+	}
+}
+
+- (void)removeLastObject {
+	CHRaiseUnsupportedOperationExceptionIfSnapshot();
+	if (root != NULL) {
+		++mutations;
+		--count;
+		id removed;
+		root = CHPersistentAVLTreeRemoveEnd(root, 1, &removed);
+		[removed release];
+	}
+}
+
+- (void)removeObject:(id)anObject {
+	CHRaiseUnsupportedOperationExceptionIfSnapshot();
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	CHComparison ordering = {NULL, NULL, Nil, NULL};
+	BOOL removed;
+	root = CHPersistentAVLTreeRemove(root, anObject, &ordering, &removed);
+	if (removed) {
+		++mutations;
+		--count;
+	}
+}
+
+@end
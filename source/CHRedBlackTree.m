@@ -11,37 +11,47 @@
 
 #pragma mark C Functions for Optimized Operations
 
+// In each rotation, the node returned takes the place of node under its parent,
+// and so gets its parent link.
+
 static CHBinaryTreeNode * rotateNodeWithLeftChild(CHBinaryTreeNode *node) {
 	CHBinaryTreeNode *leftChild = node->left;
-	node->left = leftChild->right;
-	leftChild->right = node;
+	leftChild->parent = node->parent;
+	CHBinaryTreeLinkChild(node, 0, leftChild->right);
+	CHBinaryTreeLinkChild(leftChild, 1, node);
 	node->color = kRED;
 	leftChild->color = kBLACK;
+	CHBinaryTreeNode_UPDATE_SIZE(node);
+	CHBinaryTreeNode_UPDATE_SIZE(leftChild);
 	return leftChild;
 }
 
 static CHBinaryTreeNode * rotateNodeWithRightChild(CHBinaryTreeNode *node) {
 	CHBinaryTreeNode *rightChild = node->right;
-	node->right = rightChild->left;
-	rightChild->left = node;
+	rightChild->parent = node->parent;
+	CHBinaryTreeLinkChild(node, 1, rightChild->left);
+	CHBinaryTreeLinkChild(rightChild, 0, node);
 	node->color = kRED;
 	rightChild->color = kBLACK;
+	CHBinaryTreeNode_UPDATE_SIZE(node);
+	CHBinaryTreeNode_UPDATE_SIZE(rightChild);
 	return rightChild;
 }
 
-static CHBinaryTreeNode * rotateObjectOnAncestor(id anObject, CHBinaryTreeNode *ancestor) {
-	if ([ancestor->object compare:anObject] == NSOrderedDescending) {
-		if ([ancestor->left->object compare:anObject] == NSOrderedDescending) {
-			ancestor->left = rotateNodeWithLeftChild(ancestor->left);
+// The ancestor may be the header, but its children never are.
+static CHBinaryTreeNode * rotateObjectOnAncestor(id aKey, u_int64_t aPrefix, CHBinaryTreeNode *ancestor, CHComparison *comparison, id headerObject) {
+	if (CHBinaryTreeCompareNode(comparison, headerObject, ancestor, aKey, aPrefix) == NSOrderedDescending) {
+		if (CHBinaryTreeCompareNodeToKey(comparison, ancestor->left, aKey, aPrefix) == NSOrderedDescending) {
+			CHBinaryTreeLinkChild(ancestor, 0, rotateNodeWithLeftChild(ancestor->left));
 		} else {
-			ancestor->left = rotateNodeWithRightChild(ancestor->left);
+			CHBinaryTreeLinkChild(ancestor, 0, rotateNodeWithRightChild(ancestor->left));
 		}
 		return ancestor->left;
 	} else {
-		if ([ancestor->right->object compare:anObject] == NSOrderedDescending) {
-			ancestor->right = rotateNodeWithLeftChild(ancestor->right);
+		if (CHBinaryTreeCompareNodeToKey(comparison, ancestor->right, aKey, aPrefix) == NSOrderedDescending) {
+			CHBinaryTreeLinkChild(ancestor, 1, rotateNodeWithLeftChild(ancestor->right));
 		} else {
-			ancestor->right = rotateNodeWithRightChild(ancestor->right);
+			CHBinaryTreeLinkChild(ancestor, 1, rotateNodeWithRightChild(ancestor->right));
 		}
 		return ancestor->right;
 	}
@@ -49,15 +59,18 @@ static CHBinaryTreeNode * rotateObjectOnAncestor(id anObject, CHBinaryTreeNode *
 
 static CHBinaryTreeNode * singleRotation(CHBinaryTreeNode *node, BOOL goingRight) {
 	CHBinaryTreeNode *save = node->link[!goingRight];
-	node->link[!goingRight] = save->link[goingRight];
-	save->link[goingRight] = node;
+	save->parent = node->parent;
+	CHBinaryTreeLinkChild(node, !goingRight, save->link[goingRight]);
+	CHBinaryTreeLinkChild(save, goingRight, node);
 	node->color = kRED;
 	save->color = kBLACK;
+	CHBinaryTreeNode_UPDATE_SIZE(node);
+	CHBinaryTreeNode_UPDATE_SIZE(save);
 	return save;
 }
 
 static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, BOOL goingRight) {
-	node->link[!goingRight] = singleRotation(node->link[!goingRight], !goingRight);
+	CHBinaryTreeLinkChild(node, !goingRight, singleRotation(node->link[!goingRight], !goingRight));
 	return singleRotation(node, goingRight);
 }
 
@@ -73,13 +86,16 @@ static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, BOOL goingRight
 - (void)addObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeFinger_DECLARE(aKey);
 
 	CHBinaryTreeNode *current, *parent, *grandparent, *greatgrandparent;
 	greatgrandparent = grandparent = parent = current = header;
 	
-	sentinel->object = anObject;
+	sentinel->key = aKey;
 	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
+	while ((comparison = CHBinaryTreeFingerCompare(current, aKey))) {
 		greatgrandparent = grandparent;
 		grandparent = parent;
 		parent = current;
@@ -100,10 +116,10 @@ static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, BOOL goingRight
 //						? singleRotation(grandparent, !lastWentRight)
 //						: doubleRotation(grandparent, !lastWentRight);
 				grandparent->color = kRED;
-				if ([grandparent->object compare:anObject] != [parent->object compare:anObject]) {
-					parent = rotateObjectOnAncestor(anObject, grandparent);
+				if (CHBinaryTreeCompare(grandparent, aKey) != CHBinaryTreeCompare(parent, aKey)) {
+					parent = rotateObjectOnAncestor(aKey, aPrefix, grandparent, &localComparison, headerObject);
 				}
-				current = rotateObjectOnAncestor(anObject, greatgrandparent);
+				current = rotateObjectOnAncestor(aKey, aPrefix, greatgrandparent, &localComparison, headerObject);
 				current->color = kBLACK;
 			}
 		}
@@ -113,12 +129,18 @@ static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, BOOL goingRight
 	if (current != sentinel) {
 		// If an existing node matched, simply replace the existing value.
 		[current->object release];
-		current->object = anObject;
+		CHBinaryTreeNodeSetObject(current, anObject, aKey);
 	} else {
 		++count;
-		current = [self _createNodeWithObject:anObject];
+		current = [self _createNodeWithObject:anObject key:aKey];
 		
-		parent->link[([parent->object compare:anObject] == NSOrderedAscending)] = current;
+		CHBinaryTreeLinkChild(parent, (CHBinaryTreeCompare(parent, aKey) == NSOrderedAscending), current);
+		CHBinaryTreeFinger_NOTE_LEAF(current);
+		// Rotations on the way down kept sizes correct, so only the ancestors of
+		// the new node need to grow. (The rotation below is also safe.)
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, +1);
+		}
 		
 		// one last reorientation check...
 		
@@ -129,10 +151,10 @@ static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, BOOL goingRight
 		// Fix red violation
 		if (parent->color == kRED) 	{
 			grandparent->color = kRED;
-			if ([grandparent->object compare:anObject] != [parent->object compare:anObject]) {
-				rotateObjectOnAncestor(anObject, grandparent);
+			if (CHBinaryTreeCompare(grandparent, aKey) != CHBinaryTreeCompare(parent, aKey)) {
+				rotateObjectOnAncestor(aKey, aPrefix, grandparent, &localComparison, headerObject);
 			}
-			current = rotateObjectOnAncestor(anObject, greatgrandparent);
+			current = rotateObjectOnAncestor(aKey, aPrefix, greatgrandparent, &localComparison, headerObject);
 			current->color = kBLACK;
 		}
 		header->right->color = kBLACK;  // Always reset root to black
@@ -150,34 +172,53 @@ static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, BOOL goingRight
  */
 - (void)removeObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self _removeObject:anObject orObjectAtEnd:0];
+}
+
+- (void)_removeObjectAtEnd:(NSUInteger)direction {
+	[self _removeObject:nil orObjectAtEnd:direction];
+}
+
+// Removes anObject or, if it is nil, the first (0) or last (1) object. Removal
+// is top-down, so the search path is fixed by the choice made at each node;
+// heading for the end of the tree only means always going the same way.
+- (void)_removeObject:(id)anObject orObjectAtEnd:(NSUInteger)direction {
 	if (count == 0) {
 		return;
 	}
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
 	
 	CHBinaryTreeNode *current, *parent, *grandparent;
 	parent = current = header;
 	
 	CHBinaryTreeNode *found = NULL, *sibling;
-	sentinel->object = anObject;
+	__unsafe_unretained id aKey = (anObject != nil) ? CHBinaryTreeKeyForObject(keyPath, anObject) : nil;
+	CHBinaryTreePrefix_DECLARE(aKey);
+	sentinel->key = aKey;
 	NSComparisonResult comparison;
 	BOOL isGoingRight = YES, prevWentRight = YES;
 	while (current->link[isGoingRight] != sentinel) {
 		grandparent = parent;
 		parent = current;
 		current = current->link[isGoingRight];
-		comparison = [current->object compare:anObject];
 		prevWentRight = isGoingRight;
-		isGoingRight = (comparison != NSOrderedDescending);
-		if (comparison == NSOrderedSame) {
-			found = current; // Save a pointer; removal happens outside the loop
+		if (anObject == nil) {
+			isGoingRight = direction;
+			found = current; // The last node found is the one at the end
+		} else {
+			comparison = CHBinaryTreeCompare(current, aKey);
+			isGoingRight = (comparison != NSOrderedDescending);
+			if (comparison == NSOrderedSame) {
+				found = current; // Save a pointer; removal happens outside the loop
+			}
 		}
 		
 		// There are only potential violations when removing a black node.
 		// If so, push the child red node down using rotations and color flips.
 		if (current->color != kRED && current->link[isGoingRight]->color != kRED) {
 			if (current->link[!isGoingRight]->color == kRED) {
-				parent->link[prevWentRight] = singleRotation(current, isGoingRight);
+				CHBinaryTreeLinkChild(parent, prevWentRight, singleRotation(current, isGoingRight));
 				parent = parent->link[prevWentRight];
 			} else {
 				sibling = parent->link[prevWentRight];
@@ -206,16 +247,25 @@ static CHBinaryTreeNode * doubleRotation(CHBinaryTreeNode *node, BOOL goingRight
 	
 	// Transfer replacement value up to outgoing node, remove the "donor" node.
 	if (found != NULL) {
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, -1);
+		}
 		[found->object release];
-		found->object = current->object;
-		parent->link[(parent->right == current)]
-			= current->link[(current->left == sentinel)];
-		free(current);
+		CHBinaryTreeNode_TAKE_OBJECT(found, current);
+		CHBinaryTreeLinkChild(parent, (parent->right == current),
+		                      current->link[(current->left == sentinel)]);
+		CHBinaryTreeNode_FREE(current);
 		--count;
 	}
 	header->right->color = kBLACK; // Make the root black for simplified logic
 }
 
+- (void)_balanceBuiltNode:(CHBinaryTreeNode *)node count:(NSUInteger)subtreeCount depth:(NSUInteger)depth height:(NSUInteger)height {
+	// All leaves are on the lowest two levels, so coloring only the lowest level
+	// red gives every path the same black height. The root is always black.
+	node->color = (depth > 0 && depth == height - 1) ? kRED : kBLACK;
+}
+
 - (NSString *)debugDescriptionForNode:(CHBinaryTreeNode *)node {
 	return [NSString stringWithFormat:@"[%s]\t\"%@\"",
 			(node->color == kRED) ? " RED " : "BLACK", node->object];
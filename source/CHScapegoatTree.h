@@ -0,0 +1,37 @@
+//
+//  CHScapegoatTree.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHAbstractBinarySearchTree.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHScapegoatTree.h
+ A <a href="http://en.wikipedia.org/wiki/Scapegoat_tree">scapegoat tree</a> implementation of CHSearchTree.
+ */
+
+/**
+ A <a href="http://en.wikipedia.org/wiki/Scapegoat_tree">scapegoat tree</a>, a balanced binary tree which stores no balancing information in its nodes. Rather than adjusting the tree a little with every change, it is left alone until some part of it becomes too unbalanced, and then that part is rebuilt from scratch into a perfectly balanced subtree.
+
+ Objects are added and removed exactly as in CHUnbalancedTree. If a new node ends up deeper than log<sub>3/2</sub>(n), where n is the number of objects in the tree, the path back toward the root is searched for a "scapegoat": an ancestor whose subtree is too tall for the number of nodes in it, and which must therefore be badly unbalanced. (At least one such ancestor always exists, since the root is one if nothing else is.) The scapegoat's subtree is then rebuilt in time proportional to its size, by collecting its objects in order and building a perfectly balanced subtree from them, just as \link #initWithArray: -initWithArray:\endlink does. Removal never makes the tree taller, but once fewer than 2/3 as many objects remain as the tree has held since it was last rebuilt, the whole tree is rebuilt.
+
+ The height of the tree is always O(log n), so searches take O(log n) time in the worst case, and since a subtree of m nodes can only become unbalanced after O(m) changes beneath it, insertion and removal take amortized O(log n) time. Searching is done exactly as in CHUnbalancedTree, with nothing to maintain, so lookups are as fast as in an unbalanced tree of the same shape. Rebuilding reuses the nodes of the subtree, so it doesn't allocate any more of them.
+
+ Scapegoat trees were originally described in the following paper:
+
+ <div style="margin: 0 25px; font-weight: bold;">
+ I. Galperin and R. L. Rivest. "Scapegoat Trees." <em>Proceedings of the Fourth Annual ACM-SIAM Symposium on Discrete Algorithms</em>, pp. 165-174, 1993.
+ </div>
+ */
+@interface CHScapegoatTree<__covariant ObjectType> : CHAbstractBinarySearchTree
+{
+	NSUInteger maxCount; // The most objects held since the tree was last rebuilt.
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
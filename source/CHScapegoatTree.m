@@ -0,0 +1,208 @@
+//
+//  CHScapegoatTree.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHScapegoatTree.h>
+#import "CHAbstractBinarySearchTree_Internal.h"
+
+// Returns whether a node at the given depth (the root is at depth 0) is deeper
+// than log3/2(n) allows in a tree or subtree of n nodes.
+static inline BOOL CHScapegoatTreeIsTooDeep(NSUInteger depth, NSUInteger n) {
+	// No depth within log2(n) is too deep, which spares computing the power.
+	if (depth < CHBinaryTreeHeightForCount(n)) {
+		return NO;
+	}
+	return pow(1.5, depth) > n;
+}
+
+// Visits the nodes of the subtree rooted at root in ascending order, storing
+// them in nodes (unless it is NULL), and returns how many there are. Parent
+// links are used to climb back up, so no stack is needed.
+static NSUInteger CHScapegoatTreeCollectNodes(CHBinaryTreeNode *root, CHBinaryTreeNode *sentinel, CHBinaryTreeNode **nodes) {
+	if (root == sentinel) {
+		return 0;
+	}
+	NSUInteger nodeCount = 0;
+	CHBinaryTreeNode *node = CHBinaryTreeFirstNode(root, NO, sentinel);
+	while (YES) {
+		if (nodes != NULL) {
+			nodes[nodeCount] = node;
+		}
+		nodeCount++;
+		if (node->right != sentinel) {
+			node = CHBinaryTreeFirstNode(node->right, NO, sentinel);
+			continue;
+		}
+		// Climb until arriving from the left; that parent is the next node.
+		while (node != root && node->parent->right == node) {
+			node = node->parent;
+		}
+		if (node == root) {
+			return nodeCount;
+		}
+		node = node->parent;
+	}
+}
+
+// Links nodes, which are in ascending order, into a perfectly balanced subtree
+// and returns its root. As when building a tree from sorted objects, the extra
+// node goes in the right subtree when the count is even.
+static CHBinaryTreeNode *CHScapegoatTreeLinkNodes(CHBinaryTreeNode **nodes, NSUInteger nodeCount, CHBinaryTreeNode *sentinel) {
+	if (nodeCount == 0) {
+		return sentinel;
+	}
+	NSUInteger leftCount = (nodeCount - 1) / 2;
+	CHBinaryTreeNode *node = nodes[leftCount];
+	CHBinaryTreeLinkChild(node, 0, CHScapegoatTreeLinkNodes(nodes, leftCount, sentinel));
+	CHBinaryTreeLinkChild(node, 1, CHScapegoatTreeLinkNodes(nodes + leftCount + 1, nodeCount - leftCount - 1, sentinel));
+	node->size = (u_int32_t) nodeCount;
+	return node;
+}
+
+@implementation CHScapegoatTree
+
+// Rebuilds the subtree rooted at node into a perfectly balanced one, in place.
+// The same nodes are relinked, so their objects, keys and key prefixes stay put.
+- (void)_rebuildSubtreeAtNode:(CHBinaryTreeNode *)node count:(NSUInteger)subtreeCount {
+	CHBinaryTreeNode *parent = node->parent;
+	NSUInteger direction = (parent->right == node);
+	CHBinaryTreeNode **nodes = malloc(kCHPointerSize * subtreeCount);
+	CHScapegoatTreeCollectNodes(node, sentinel, nodes);
+	CHBinaryTreeLinkChild(parent, direction, CHScapegoatTreeLinkNodes(nodes, subtreeCount, sentinel));
+	free(nodes);
+}
+
+- (void)addObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeFinger_DECLARE(aKey);
+	CHBinaryTreeStack_DECLARE();
+	CHBinaryTreeStack_INIT();
+
+	CHBinaryTreeNode *parent = header, *current = header->right;
+	sentinel->key = aKey; // Assure that we find a spot to insert
+	NSComparisonResult comparison;
+	while ((comparison = CHBinaryTreeFingerCompare(current, aKey))) {
+		CHBinaryTreeStack_PUSH(current);
+		parent = current;
+		current = current->link[comparison == NSOrderedAscending]; // R on YES
+	}
+
+	[anObject retain]; // Must retain whether replacing value or adding new node
+	if (current != sentinel) {
+		// Replace the existing object with the new object.
+		[current->object release];
+		CHBinaryTreeNodeSetObject(current, anObject, aKey);
+		CHBinaryTreeStack_FREE(stack);
+		return;
+	}
+	// Create a new node to hold the value being inserted
+	current = [self _createNodeWithObject:anObject key:aKey];
+	if (++count > maxCount) {
+		maxCount = count;
+	}
+	// Link from parent as the proper child, based on last comparison
+	comparison = CHBinaryTreeCompare(parent, aKey); // restore prior compare
+	CHBinaryTreeLinkChild(parent, comparison == NSOrderedAscending, current);
+	CHBinaryTreeFinger_NOTE_LEAF(current);
+	if (tracksSubtreeSizes) {
+		CHBinaryTreeStack_ADJUST_SIZES(+1);
+	}
+
+	// The stack holds the new node's ancestors, so its size is the node's depth.
+	if (CHScapegoatTreeIsTooDeep(stackSize, count)) {
+		// Climb until finding an ancestor whose subtree is too short for the new
+		// node's depth within it. (The root qualifies, if nothing else does.)
+		NSUInteger height = 0, subtreeCount = 1;
+		CHBinaryTreeNode *child = current, *ancestor, *sibling;
+		while ((ancestor = CHBinaryTreeStack_POP())) {
+			sibling = ancestor->link[ancestor->left == child];
+			subtreeCount += 1 + (tracksSubtreeSizes ? sibling->size
+			                     : CHScapegoatTreeCollectNodes(sibling, sentinel, NULL));
+			if (CHScapegoatTreeIsTooDeep(++height, subtreeCount)) {
+				[self _rebuildSubtreeAtNode:ancestor count:subtreeCount];
+				break;
+			}
+			child = ancestor;
+		}
+	}
+	CHBinaryTreeStack_FREE(stack);
+}
+
+- (void)removeAllObjects {
+	[super removeAllObjects];
+	maxCount = 0;
+}
+
+// Removal is the same as for CHUnbalancedTree, which never makes the tree taller,
+// but the tree is rebuilt once enough objects have been removed.
+- (void)removeObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	if (count == 0) {
+		return;
+	}
+	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+
+	CHBinaryTreeNode *parent = nil, *current = header;
+
+	sentinel->key = aKey; // Assure that we find a spot to insert
+	NSComparisonResult comparison;
+	while ((comparison = CHBinaryTreeCompare(current, aKey))) {
+		parent = current;
+		current = current->link[comparison == NSOrderedAscending]; // R on YES
+	}
+	NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
+	// Exit if the specified node was not found in the tree.
+	if (current == sentinel) {
+		return;
+	}
+	[current->object release]; // Object must be released in any case
+	// Trees that are copied or built all at once start counting from here.
+	if (count > maxCount) {
+		maxCount = count;
+	}
+	--count;
+	if (current->left == sentinel || current->right == sentinel) {
+		// One or both of the child pointers are null, so removal is simpler
+		CHBinaryTreeLinkChild(parent, parent->right == current,
+		                      current->link[current->left == sentinel]);
+		CHBinaryTreeNode_FREE(current);
+		// Every ancestor of the removed node loses one.
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, -1);
+		}
+	} else {
+		// The most complex case: removing a node with 2 non-null children
+		// (Replace object with the leftmost object in the right subtree.)
+		parent = current;
+		CHBinaryTreeNode *replacement = current->right;
+		while (replacement->left != sentinel) {
+			parent = replacement;
+			replacement = replacement->left;
+		}
+		CHBinaryTreeNode_TAKE_OBJECT(current, replacement);
+		CHBinaryTreeLinkChild(parent, parent->right == replacement, replacement->right);
+		CHBinaryTreeNode_FREE(replacement);
+		// Every ancestor of the replacement (including current) loses one.
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, -1);
+		}
+	}
+
+	// Rebuild the whole tree once fewer than 2/3 of the most objects remain.
+	if (count * 3 < maxCount * 2) {
+		if (count > 0) {
+			[self _rebuildSubtreeAtNode:header->right count:count];
+		}
+		maxCount = count;
+	}
+}
+
+@end
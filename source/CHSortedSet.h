@@ -98,6 +98,20 @@ typedef NS_OPTIONS(NSUInteger, CHSubsetConstructionOptions) {
  */
 - (nullable id)anyObject;
 
+/**
+ Returns the least object in the receiver which is greater than or equal to a given object, according to natural sorted order. The object need not be a member of the receiver.
+ 
+ @param anObject The object with which to compare the objects in the receiver.
+ @return The least object in the receiver which is not less than @a anObject, or @c nil if there is none.
+ 
+ @throw NSInvalidArgumentException if @a anObject is @c nil.
+ 
+ @see floorObject:
+ @see member:
+ @see objectAfter:
+ */
+- (nullable id)ceilingObject:(id)anObject;
+
 /**
  Returns the number of objects currently in the receiver.
  
@@ -131,6 +145,20 @@ typedef NS_OPTIONS(NSUInteger, CHSubsetConstructionOptions) {
  */
 - (nullable id)firstObject;
 
+/**
+ Returns the greatest object in the receiver which is less than or equal to a given object, according to natural sorted order. The object need not be a member of the receiver.
+ 
+ @param anObject The object with which to compare the objects in the receiver.
+ @return The greatest object in the receiver which is not greater than @a anObject, or @c nil if there is none.
+ 
+ @throw NSInvalidArgumentException if @a anObject is @c nil.
+ 
+ @see ceilingObject:
+ @see member:
+ @see objectBefore:
+ */
+- (nullable id)floorObject:(id)anObject;
+
 /**
  Compares the receiving sorted set to another sorted set. Two sorted sets have equal contents if they each hold the same number of objects and objects at a given position in each sorted set satisfy the \link NSObject-p#isEqual: -isEqual:\endlink test.
  
@@ -164,6 +192,32 @@ typedef NS_OPTIONS(NSUInteger, CHSubsetConstructionOptions) {
  */
 - (nullable id)member:(id)anObject;
 
+/**
+ Returns the least object in the receiver which is strictly greater than a given object, according to natural sorted order. The object need not be a member of the receiver; if it is, this is the object which follows it.
+ 
+ @param anObject The object with which to compare the objects in the receiver.
+ @return The least object in the receiver which is greater than @a anObject, or @c nil if there is none.
+ 
+ @throw NSInvalidArgumentException if @a anObject is @c nil.
+ 
+ @see ceilingObject:
+ @see objectBefore:
+ */
+- (nullable id)objectAfter:(id)anObject;
+
+/**
+ Returns the greatest object in the receiver which is strictly less than a given object, according to natural sorted order. The object need not be a member of the receiver; if it is, this is the object which precedes it.
+ 
+ @param anObject The object with which to compare the objects in the receiver.
+ @return The greatest object in the receiver which is less than @a anObject, or @c nil if there is none.
+ 
+ @throw NSInvalidArgumentException if @a anObject is @c nil.
+ 
+ @see floorObject:
+ @see objectAfter:
+ */
+- (nullable id)objectBefore:(id)anObject;
+
 /**
  Returns an enumerator that accesses each object in the receiver in ascending order.
  
@@ -0,0 +1,34 @@
+//
+//  CHSplayTree.h
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHAbstractBinarySearchTree.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ @file CHSplayTree.h
+ A <a href="http://en.wikipedia.org/wiki/Splay_tree">splay tree</a> implementation of CHSearchTree.
+ */
+
+/**
+ A <a href="http://en.wikipedia.org/wiki/Splay_tree">splay tree</a>, a self-adjusting binary search tree which moves each object it accesses to the root. Rather than keeping the tree balanced, every search, insertion and removal "splays" the tree around the object in question, with rotations that also roughly halve the depth of every node along the search path. No balancing information is stored in the nodes.
+
+ Although a single operation may take O(n) time, any sequence of m operations on a tree of n objects takes O((m+n) log n) time, so each operation takes amortized O(log n) time, just like a balanced tree. More importantly, frequently-accessed objects stay near the root, so when some objects are searched for much more often than others (as with a Zipf distribution), a splay tree can be considerably faster than a balanced tree, which gives every object the same O(log n) cost. Accessing every object in sorted order takes only O(n) time overall, or amortized O(1) per object.
+
+ This implementation uses <em>top-down</em> splaying, which splays the tree on the way down from the root, so it needs neither recursion nor a stack. The nodes along the search path are split off into a left tree (of smaller objects) and a right tree (of larger objects), which are reassembled beneath the node where the search stops. The algorithms have been adapted from the following paper:
+
+ <div style="margin: 0 25px; font-weight: bold;">
+ D. D. Sleator and R. E. Tarjan. "Self-Adjusting Binary Search Trees." <em>Journal of the ACM</em>, 32(3):652-686, 1985.
+ </div>
+
+ @warning Since @c -member:, @c -memberForKey: and @c -containsObject: reorganize the tree, searching a splay tree counts as modifying it: a splay tree must not be searched while it is being enumerated (which raises an exception, as for any other mutation), and it can't be searched by several threads at once, even with a read-write lock such as CHConcurrentSortedSet uses. Methods that don't search for a specific object, such as @c -firstObject, @c -objectAtIndex: and enumeration, leave the tree unchanged. Searching a live view (from \link CHAbstractBinarySearchTree#subsetViewFromObject:toObject:options: -subsetViewFromObject:toObject:options:\endlink) doesn't splay the tree, so the view stays valid, but searching the tree itself invalidates any view of it, just as adding an object would. (A subset from \link CHSortedSet#subsetFromObject:toObject:options: -subsetFromObject:toObject:options:\endlink is an independent copy, so it is unaffected either way.)
+ */
+@interface CHSplayTree<__covariant ObjectType> : CHAbstractBinarySearchTree
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,161 @@
+//
+//  CHSplayTree.m
+//  CHDataStructures
+//
+//  Copyright © 2008-2021, Quinn Taylor
+//
+
+#import <CHDataStructures/CHSplayTree.h>
+#import "CHAbstractBinarySearchTree_Internal.h"
+
+// Splays the subtree rooted at root (which must not be the sentinel) around
+// aKey, and returns the new root of the subtree, which is the node whose key is
+// equal to aKey if there is one, or else the last node on the search path.
+// The caller must link the new root to its parent.
+//
+// The nodes passed on the way down are hung on the left tree (all smaller than
+// aKey) or the right tree (all larger), whose roots are kept in the scratch
+// node's right and left links, respectively. Whenever the search would move two
+// steps in the same direction, the first two nodes are rotated first, which is
+// what keeps the amortized cost of each operation at O(log n).
+static CHBinaryTreeNode *CHSplayTreeSplay(CHBinaryTreeNode *root, id aKey, u_int64_t aPrefix, CHBinaryTreeNode *sentinel, CHComparison *comparison, BOOL tracksSubtreeSizes) {
+	CHBinaryTreeNode scratch;
+	scratch.left = scratch.right = sentinel;
+	// hook[0] is the leftmost node of the right tree, and hook[1] the rightmost
+	// node of the left tree; the next node in each is linked beneath them.
+	CHBinaryTreeNode *hook[2] = {&scratch, &scratch};
+	CHBinaryTreeNode *current = root, *child;
+	NSComparisonResult result = CHBinaryTreeCompareNodeToKey(comparison, current, aKey, aPrefix), childResult;
+	while (result != NSOrderedSame) {
+		NSUInteger direction = (result == NSOrderedAscending); // R on YES
+		child = current->link[direction];
+		if (child == sentinel) {
+			break;
+		}
+		childResult = CHBinaryTreeCompareNodeToKey(comparison, child, aKey, aPrefix);
+		if (childResult == result) {
+			// Zig-zig: rotate the child above the current node.
+			CHBinaryTreeLinkChild(current, direction, child->link[!direction]);
+			CHBinaryTreeLinkChild(child, !direction, current);
+			CHBinaryTreeNode_UPDATE_SIZE(current);
+			current = child;
+			child = current->link[direction];
+			if (child == sentinel) {
+				break;
+			}
+			childResult = CHBinaryTreeCompareNodeToKey(comparison, child, aKey, aPrefix);
+		}
+		// Hang the current node on the tree on the other side, and move down to
+		// the child, which has already been compared, so each node is compared
+		// only once.
+		CHBinaryTreeLinkChild(hook[direction], direction, current);
+		hook[direction] = current;
+		current = child;
+		result = childResult;
+	}
+	// Reassemble: the current node's subtrees go beneath the side trees, which
+	// then become its subtrees.
+	CHBinaryTreeLinkChild(hook[1], 1, current->left);
+	CHBinaryTreeLinkChild(hook[0], 0, current->right);
+	if (tracksSubtreeSizes) {
+		// Only the nodes along the inner edge of each side tree changed.
+		for (NSUInteger side = 0; side < 2; side++) {
+			for (CHBinaryTreeNode *node = hook[side]; node != &scratch; node = node->parent) {
+				CHBinaryTreeNode_UPDATE_SIZE(node);
+			}
+		}
+	}
+	CHBinaryTreeLinkChild(current, 0, scratch.right);
+	CHBinaryTreeLinkChild(current, 1, scratch.left);
+	CHBinaryTreeNode_UPDATE_SIZE(current);
+	return current;
+}
+
+@implementation CHSplayTree
+
+// Since splaying reorganizes the tree, this counts as a mutation. (The inherited
+// -member: finds the key of the object and calls this.)
+- (id)memberForKey:(id)aKey {
+	CHRaiseInvalidArgumentExceptionIfNil(aKey);
+	if (count == 0) {
+		return nil;
+	}
+	++mutations;
+	CHComparison localComparison = keyOrdering;
+	CHBinaryTreePrefix_DECLARE(aKey);
+	CHBinaryTreeNode *root = CHSplayTreeSplay(header->right, aKey, aPrefix, sentinel,
+	                                          &localComparison, tracksSubtreeSizes);
+	CHBinaryTreeLinkChild(header, 1, root);
+	if (CHBinaryTreeCompareNodeToKey(&localComparison, root, aKey, aPrefix) == NSOrderedSame) {
+		return root->object;
+	}
+	return nil;
+}
+
+- (void)addObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	++mutations;
+	CHComparison localComparison = keyOrdering;
+	CHBinaryTreeKey_DECLARE(anObject);
+	[anObject retain]; // Must retain whether replacing value or adding new node
+	if (count == 0) {
+		CHBinaryTreeLinkChild(header, 1, [self _createNodeWithObject:anObject key:aKey]);
+		++count;
+		return;
+	}
+	CHBinaryTreeNode *root = CHSplayTreeSplay(header->right, aKey, aPrefix, sentinel,
+	                                          &localComparison, tracksSubtreeSizes);
+	NSComparisonResult comparison = CHBinaryTreeCompareNodeToKey(&localComparison, root, aKey, aPrefix);
+	if (comparison == NSOrderedSame) {
+		// Replace the existing object with the new object.
+		[root->object release];
+		CHBinaryTreeNodeSetObject(root, anObject, aKey);
+	} else {
+		// The new node becomes the root. The old root goes on the side where it
+		// belongs, and its subtree on the other side moves to the new node.
+		NSUInteger side = (comparison == NSOrderedDescending); // R on YES
+		CHBinaryTreeNode *node = [self _createNodeWithObject:anObject key:aKey];
+		CHBinaryTreeLinkChild(node, !side, root->link[!side]);
+		CHBinaryTreeLinkChild(root, !side, sentinel);
+		CHBinaryTreeLinkChild(node, side, root);
+		CHBinaryTreeNode_UPDATE_SIZE(root);
+		CHBinaryTreeNode_UPDATE_SIZE(node);
+		root = node;
+		++count;
+	}
+	CHBinaryTreeLinkChild(header, 1, root);
+}
+
+// Once the node to remove has been splayed to the root, splaying its left
+// subtree for the same object brings the largest node in that subtree to the
+// top, and since that node has no right child, the right subtree goes there.
+- (void)removeObject:(id)anObject {
+	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	if (count == 0) {
+		return;
+	}
+	++mutations;
+	CHComparison localComparison = keyOrdering;
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeNode *root = CHSplayTreeSplay(header->right, aKey, aPrefix, sentinel,
+	                                          &localComparison, tracksSubtreeSizes);
+	if (CHBinaryTreeCompareNodeToKey(&localComparison, root, aKey, aPrefix) != NSOrderedSame) {
+		CHBinaryTreeLinkChild(header, 1, root);
+		return;
+	}
+	CHBinaryTreeNode *replacement;
+	if (root->left == sentinel) {
+		replacement = root->right;
+	} else {
+		replacement = CHSplayTreeSplay(root->left, aKey, aPrefix, sentinel,
+		                               &localComparison, tracksSubtreeSizes);
+		CHBinaryTreeLinkChild(replacement, 1, root->right);
+		CHBinaryTreeNode_UPDATE_SIZE(replacement);
+	}
+	CHBinaryTreeLinkChild(header, 1, replacement);
+	[root->object release];
+	CHBinaryTreeNode_FREE(root);
+	--count;
+}
+
+@end
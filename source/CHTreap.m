@@ -11,11 +11,13 @@
 @implementation CHTreap
 
 // Two-way single rotation; 'dir' is the side to which the root should rotate.
-#define singleRotation(node,dir,parent) {         \
-	CHBinaryTreeNode *save = node->link[!dir];    \
-	node->link[!dir] = save->link[dir];           \
-	save->link[dir] = node;                       \
-	parent->link[(parent->right == node)] = save; \
+#define singleRotation(node,dir,parent) {                         \
+	CHBinaryTreeNode *save = node->link[!dir];                    \
+	CHBinaryTreeLinkChild(node, !dir, save->link[dir]);           \
+	CHBinaryTreeLinkChild(save, dir, node);                       \
+	CHBinaryTreeLinkChild(parent, (parent->right == node), save); \
+	CHBinaryTreeNode_UPDATE_SIZE(node);                           \
+	CHBinaryTreeNode_UPDATE_SIZE(save);                           \
 }
 
 - (void)_subclassSetup {
@@ -29,14 +31,17 @@
 - (void)addObject:(id)anObject withPriority:(NSUInteger)priority {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeFinger_DECLARE(aKey);
 
 	CHBinaryTreeNode *parent, *current = header;
 	CHBinaryTreeStack_DECLARE();
 	CHBinaryTreeStack_INIT();
 	
-	sentinel->object = anObject; // Assure that we find a spot to insert
+	sentinel->key = aKey; // Assure that we find a spot to insert
 	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
+	while ((comparison = CHBinaryTreeFingerCompare(current, aKey))) {
 		CHBinaryTreeStack_PUSH(current);
 		current = current->link[comparison == NSOrderedAscending]; // R on YES
 	}
@@ -48,7 +53,7 @@
 	if (current != sentinel) {
 		// Replace the existing object with the new object.
 		[current->object release];
-		current->object = anObject;
+		CHBinaryTreeNodeSetObject(current, anObject, aKey);
 		// Assign new priority; bubble down if needed, or just wait to bubble up
 		current->priority = (u_int32_t) (priority % CHTreapNotFound);
 		while (current->left != current->right) { // sentinel check
@@ -57,17 +62,23 @@
 				break;
 			}
 			NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
+			// The child rotated up to take its place becomes the new parent.
+			CHBinaryTreeNode *child = current->link[direction];
 			singleRotation(current, !direction, parent);
-			parent = current;
-			current = current->link[!direction];
+			parent = child;
 		}
 	} else {
-		current = [self _createNodeWithObject:anObject];
+		current = [self _createNodeWithObject:anObject key:aKey];
 		current->priority = (u_int32_t) (priority % CHTreapNotFound);
 		++count;
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeStack_ADJUST_SIZES(+1);
+			parent->size++; // Already popped from the stack
+		}
 		// Link from parent as the correct child, based on the last comparison
-		comparison = [parent->object compare:anObject];
-		parent->link[comparison == NSOrderedAscending] = current; // R if YES
+		comparison = CHBinaryTreeCompare(parent, aKey);
+		CHBinaryTreeLinkChild(parent, comparison == NSOrderedAscending, current); // R if YES
+		CHBinaryTreeFinger_NOTE_LEAF(current);
 	}
 	
 	// Trace back up the path, rotating as we go to satisfy the heap property.
@@ -85,22 +96,43 @@
 
 - (void)removeObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
+	[self _removeObject:anObject orObjectAtEnd:0];
+}
+
+- (void)_removeObjectAtEnd:(NSUInteger)direction {
+	[self _removeObject:nil orObjectAtEnd:direction];
+}
+
+// Removes anObject or, if it is nil, the first (0) or last (1) object, which is
+// found by following links rather than by comparing objects.
+- (void)_removeObject:(id)anObject orObjectAtEnd:(NSUInteger)end {
 	if (count == 0) {
 		return;
 	}
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
 	
-	CHBinaryTreeNode *parent = nil, *current = header;
+	CHBinaryTreeNode *parent = header, *current = header->right;
 	NSComparisonResult comparison;
 	u_int32_t direction;
 	
-	// First, we must locate the object to be removed, or we exit if not found
-	sentinel->object = anObject; // Assure that we stop at a sentinel leaf node
-	while ((comparison = [current->object compare:anObject])) {
-		parent = current;
-		current = current->link[comparison == NSOrderedAscending]; // R on YES
+	if (anObject == nil) {
+		while (current->link[end] != sentinel) {
+			parent = current;
+			current = current->link[end];
+		}
+	} else {
+		// First, we must locate the object to be removed, or we exit if not found
+		parent = nil;
+		current = header;
+		CHBinaryTreeKey_DECLARE(anObject);
+		sentinel->key = aKey; // Assure that we stop at a sentinel leaf node
+		while ((comparison = CHBinaryTreeCompare(current, aKey))) {
+			parent = current;
+			current = current->link[comparison == NSOrderedAscending]; // R on YES
+		}
+		NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
 	}
-	NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
 	
 	if (current != sentinel) {
 		// Percolate node down the tree, always rotating towards lower priority
@@ -112,21 +144,27 @@
 			parent = parent->link[isRightChild];
 		}
 //		NSAssert(parent != nil, @"Illegal state, parent should never be nil!");
-		parent->link[parent->right == current] = sentinel;
+		CHBinaryTreeLinkChild(parent, parent->right == current, sentinel);
+		// Rotations kept sizes correct, but the path has changed, so climb it
+		// from the parent, which needs no comparisons.
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, -1);
+		}
 		[current->object release];
-		free(current);
+		CHBinaryTreeNode_FREE(current);
 		--count;
 	}
 }
 
+- (void)_balanceBuiltNode:(CHBinaryTreeNode *)node count:(NSUInteger)subtreeCount depth:(NSUInteger)depth height:(NSUInteger)height {
+	node->priority = CHTreapPriorityForDepth(depth, height);
+}
+
 - (NSUInteger)priorityForObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
-	sentinel->object = anObject; // Make sure the target value is always "found"
-	CHBinaryTreeNode *current = header->right;
-	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
-		current = current->link[comparison == NSOrderedAscending]; // R on YES
-	}
+	CHComparison localComparison = keyOrdering;
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeNode *current = CHBinaryTreeFindNode(header->right, aKey, aPrefix, sentinel, &localComparison);
 	return (current != sentinel) ? current->priority : CHTreapNotFound;
 }
 
@@ -14,11 +14,14 @@
 - (void)addObject:(id)anObject {
 	CHRaiseInvalidArgumentExceptionIfNil(anObject);
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
+	CHBinaryTreeFinger_DECLARE(aKey);
 	
 	CHBinaryTreeNode *parent = header, *current = header->right;
-	sentinel->object = anObject; // Assure that we find a spot to insert
+	sentinel->key = aKey; // Assure that we find a spot to insert
 	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
+	while ((comparison = CHBinaryTreeFingerCompare(current, aKey))) {
 		parent = current;
 		current = current->link[comparison == NSOrderedAscending]; // R on YES
 	}
@@ -27,14 +30,18 @@
 	if (current != sentinel) {
 		// Replace the existing object with the new object.
 		[current->object release];
-		current->object = anObject;		
+		CHBinaryTreeNodeSetObject(current, anObject, aKey);		
 	} else {
 		// Create a new node to hold the value being inserted
-		current = [self _createNodeWithObject:anObject];
+		current = [self _createNodeWithObject:anObject key:aKey];
 		++count;
 		// Link from parent as the proper child, based on last comparison
-		comparison = [parent->object compare:anObject]; // restore prior compare
-		parent->link[comparison == NSOrderedAscending] = current;
+		comparison = CHBinaryTreeCompare(parent, aKey); // restore prior compare
+		CHBinaryTreeLinkChild(parent, comparison == NSOrderedAscending, current);
+		CHBinaryTreeFinger_NOTE_LEAF(current);
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, +1);
+		}
 	}
 }
 
@@ -47,12 +54,14 @@
 		return;
 	}
 	++mutations;
+	CHBinaryTreeComparison_DECLARE();
+	CHBinaryTreeKey_DECLARE(anObject);
 	
 	CHBinaryTreeNode *parent = nil, *current = header;
 	
-	sentinel->object = anObject; // Assure that we find a spot to insert
+	sentinel->key = aKey; // Assure that we find a spot to insert
 	NSComparisonResult comparison;
-	while ((comparison = [current->object compare:anObject])) {
+	while ((comparison = CHBinaryTreeCompare(current, aKey))) {
 		parent = current;
 		current = current->link[comparison == NSOrderedAscending]; // R on YES
 	}
@@ -65,9 +74,13 @@
 	--count;
 	if (current->left == sentinel || current->right == sentinel) {
 		// One or both of the child pointers are null, so removal is simpler
-		parent->link[parent->right == current]
-			= current->link[current->left == sentinel];
-		free(current);
+		CHBinaryTreeLinkChild(parent, parent->right == current,
+		                      current->link[current->left == sentinel]);
+		CHBinaryTreeNode_FREE(current);
+		// Every ancestor of the removed node loses one.
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, -1);
+		}
 	} else {
 		// The most complex case: removing a node with 2 non-null children
 		// (Replace object with the leftmost object in the right subtree.)
@@ -77,9 +90,13 @@
 			parent = replacement;
 			replacement = replacement->left;
 		}
-		current->object = replacement->object;
-		parent->link[parent->right == replacement] = replacement->right;
-		free(replacement);
+		CHBinaryTreeNode_TAKE_OBJECT(current, replacement);
+		CHBinaryTreeLinkChild(parent, parent->right == replacement, replacement->right);
+		CHBinaryTreeNode_FREE(replacement);
+		// Every ancestor of the replacement (including current) loses one.
+		if (tracksSubtreeSizes) {
+			CHBinaryTreeAdjustSizesToRoot(parent, header, -1);
+		}
 	}
 }
 
@@ -6,6 +6,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <objc/runtime.h>
 
 /**
  @file CHUtil.h
@@ -66,6 +67,56 @@ HIDDEN NSUInteger CHHashOfCountAndObjects(NSUInteger count, id o1, id o2);
 
 #pragma mark -
 
+/**
+ A C function for comparing two objects, of the same form accepted by @c -[NSArray sortedArrayUsingFunction:context:]. It returns @c NSOrderedAscending, @c NSOrderedSame, or @c NSOrderedDescending as the first object is less than, equal to, or greater than the second.
+ */
+typedef NSInteger (*CHComparisonFunction)(id, id, void *);
+
+/**
+ The ordering used by a sorted collection, plus a cache that lets repeated comparisons call the @c -compare: method directly instead of sending a message each time.
+ 
+ A collection keeps one of these to describe its ordering, and copies it to a local variable at the start of each operation, which then fills in the cache as it goes. Since each copy has its own cache, several threads can compare objects on behalf of the same collection at once.
+ */
+typedef struct CHComparison {
+	CHComparisonFunction function; ///< Compares objects, or @c NULL to use @c -compare:.
+	void *context; ///< Passed to @a function as its third argument.
+	Class cachedClass; ///< The class of the last object sent @c -compare:.
+	NSComparisonResult (*cachedCompare)(id, SEL, id); ///< The @c -compare: method of @a cachedClass.
+} CHComparison;
+
+/**
+ Compares two objects using the function in a CHComparison or, if there is none, the @c -compare: method of the first object. The method is looked up only when the class of the first object changes, which for most collections is only the first time.
+ 
+ @param comparison The ordering to use; its cache may be updated.
+ @param o1 The first object to be compared.
+ @param o2 The second object to be compared.
+ @return The result of comparing @a o1 to @a o2.
+ */
+static inline NSComparisonResult CHComparisonCompare(CHComparison *comparison, id o1, id o2) {
+	if (comparison->function != NULL) {
+		return (NSComparisonResult) comparison->function(o1, o2, comparison->context);
+	}
+	Class receiverClass = object_getClass(o1);
+	if (receiverClass != comparison->cachedClass) {
+		comparison->cachedClass = receiverClass;
+		comparison->cachedCompare = (NSComparisonResult (*)(id, SEL, id))
+			class_getMethodImplementation(receiverClass, @selector(compare:));
+	}
+	return comparison->cachedCompare(o1, @selector(compare:), o2);
+}
+
+/**
+ Simple function for comparing objects with an NSComparator, to be used as a CHComparisonFunction whose context is the comparator.
+ 
+ @param o1 The first object to be compared.
+ @param o2 The second object to be compared.
+ @param comparator The NSComparator block to call.
+ @return <code>comparator(o1, o2)</code>
+ */
+HIDDEN NSInteger CHCompareUsingComparator(id o1, id o2, void *comparator);
+
+#pragma mark -
+
 /**
  Convenience macro for raising an exception for an invalid index.
  */
@@ -44,6 +44,10 @@ NSUInteger CHHashOfCountAndObjects(NSUInteger count, id object1, id object2) {
 	return hash ^ (31*[object1 hash]) ^ ((31*[object2 hash]) << 4);
 }
 
+NSInteger CHCompareUsingComparator(id o1, id o2, void *comparator) {
+	return ((NSComparator) comparator)(o1, o2);
+}
+
 #pragma mark -
 
 void CHQuietLog(NSString *format, ...) {
@@ -9,6 +9,7 @@
 #import <CHDataStructures/CHDataStructures.h>
 #import <sys/time.h>
 #import <objc/runtime.h>
+#import <pthread.h>
 
 @interface CHAbstractBinarySearchTree (Height)
 - (NSUInteger)height;
@@ -33,6 +34,19 @@
 
 @end
 
+@interface CHBPlusTree (Height)
+- (NSUInteger)height;
+@end
+
+@implementation CHBPlusTree (Height)
+
+// Every leaf is at the same depth, so the tree tracks its own height.
+- (NSUInteger)height {
+	return height;
+}
+
+@end
+
 #pragma mark -
 
 static NSEnumerator *objectEnumerator, *arrayEnumerator;
@@ -487,6 +501,81 @@ void benchmarkTree(Class testClass) {
 	[pool drain];
 }
 
+// Compares the set operations on search trees with the equivalent loops of
+// -addObject:, -containsObject: and -removeObject:. The two sets overlap by a
+// third, since one has multiples of 2 and the other multiples of 3.
+void benchmarkSetAlgebra(Class testClass) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	CHQuietLog(@"\n%@", testClass);
+	
+	NSMutableArray *sizes = [NSMutableArray array];
+	for (NSUInteger size = 10000; size <= 10000000; size *= 10) {
+		[sizes addObject:@(size)];
+	}
+	NSArray *operations = @[@"union", @"intersect", @"minus"];
+	
+	printf("(Operation)              ");
+	for (NSNumber *size in sizes) {
+		printf("\t%-8lu", [size unsignedLongValue]);
+	}
+	for (NSString *operation in operations) {
+		for (int naive = 1; naive >= 0; naive--) {
+			if (naive) {
+				printf("\n%-9s (loop)         ", [operation UTF8String]);
+			} else {
+				printf("\n%-9s (sorted set)   ", [operation UTF8String]);
+			}
+			for (NSNumber *size in sizes) {
+				NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+				NSUInteger count = [size unsignedIntegerValue];
+				NSMutableArray *doubles = [NSMutableArray arrayWithCapacity:count];
+				NSMutableArray *triples = [NSMutableArray arrayWithCapacity:count];
+				for (NSUInteger item = 0; item < count; item++) {
+					[doubles addObject:@(item * 2)];
+					[triples addObject:@(item * 3)];
+				}
+				CHAbstractBinarySearchTree *tree = [[testClass alloc] initWithArray:doubles];
+				CHAbstractBinarySearchTree *other = [[testClass alloc] initWithArray:triples];
+				startTime = timestamp();
+				if ([operation isEqualToString:@"union"]) {
+					if (naive) {
+						for (id anObject in other) {
+							[tree addObject:anObject];
+						}
+					} else {
+						[tree unionWithSortedSet:other];
+					}
+				} else if ([operation isEqualToString:@"intersect"]) {
+					if (naive) {
+						for (id anObject in [tree allObjects]) {
+							if (![other containsObject:anObject]) {
+								[tree removeObject:anObject];
+							}
+						}
+					} else {
+						[tree intersectWithSortedSet:other];
+					}
+				} else {
+					if (naive) {
+						for (id anObject in other) {
+							[tree removeObject:anObject];
+						}
+					} else {
+						[tree minusSortedSet:other];
+					}
+				}
+				printf("\t%f", timestamp() - startTime);
+				[tree release];
+				[other release];
+				[pool2 drain];
+			}
+		}
+	}
+	
+	CHQuietLog(@"");
+	[pool drain];
+}
+
 NSArray * randomNumberArray(NSUInteger count) {
 	NSMutableSet *objectSet = [NSMutableSet set];
 	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
@@ -497,6 +586,672 @@ NSArray * randomNumberArray(NSUInteger count) {
 	return [objectSet allObjects];
 }
 
+static NSInteger compareNumbers(id number1, id number2, void *context) {
+	return [number1 compare:number2];
+}
+
+// Compares objects normally, but also counts the comparisons.
+static NSInteger countComparisons(id object1, id object2, void *context) {
+	++*(NSUInteger *)context;
+	return [object1 compare:object2];
+}
+
+// Reports how many comparisons per second can be made with each kind of
+// ordering, first in isolation and then while searching trees. Sending the
+// -compare: message for every comparison is how trees and heaps used to work.
+void benchmarkComparisons(NSArray *testClasses) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSArray *numbers = randomNumberArray(size);
+	NSComparator comparator = ^(id number1, id number2) {
+		return [number1 compare:number2];
+	};
+	double duration;
+	
+	CHQuietLog(@"\nComparisons per second (millions)");
+	CHComparison orderings[] = {
+		{NULL, NULL, Nil, NULL},
+		{compareNumbers, NULL, Nil, NULL},
+		{CHCompareUsingComparator, (void *)comparator, Nil, NULL},
+	};
+	const char *orderingNames[] = {"-compare: (cached)", "function", "comparator"};
+	
+	id previous = [numbers lastObject];
+	NSInteger checksum = 0; // Keeps the comparisons from being optimized out
+	startTime = timestamp();
+	for (id number in numbers) {
+		checksum += [previous compare:number];
+		previous = number;
+	}
+	duration = timestamp() - startTime;
+	printf("%-24s\t%f\n", "-compare: (message)", size / duration / 1e6);
+	for (NSUInteger i = 0; i < 3; i++) {
+		CHComparison ordering = orderings[i];
+		previous = [numbers lastObject];
+		startTime = timestamp();
+		for (id number in numbers) {
+			checksum += CHComparisonCompare(&ordering, previous, number);
+			previous = number;
+		}
+		duration = timestamp() - startTime;
+		printf("%-24s\t%f\n", orderingNames[i], size / duration / 1e6);
+	}
+	
+	printf("\n(-member: on %lu objects)", (unsigned long)size);
+	printf("\t%-18s\t%-18s\t%-18s", orderingNames[0], orderingNames[1], orderingNames[2]);
+	for (Class aClass in testClasses) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		printf("\n%-30s", class_getName(aClass));
+		// Each ordering is the same, so a search makes the same comparisons with any
+		// of them. Count them once, then time the searches with each ordering.
+		NSUInteger comparisonCount = 0;
+		CHAbstractBinarySearchTree *tree = [[aClass alloc] initWithComparisonFunction:countComparisons
+		                                                                      context:&comparisonCount];
+		[tree addObjectsFromArray:numbers];
+		comparisonCount = 0;
+		for (id number in numbers) {
+			[tree member:number];
+		}
+		[tree release];
+		CHAbstractBinarySearchTree *trees[] = {
+			[[aClass alloc] init],
+			[[aClass alloc] initWithComparisonFunction:compareNumbers context:NULL],
+			[[aClass alloc] initWithComparator:comparator],
+		};
+		for (NSUInteger i = 0; i < 3; i++) {
+			[trees[i] addObjectsFromArray:numbers];
+			startTime = timestamp();
+			for (id number in numbers) {
+				[trees[i] member:number];
+			}
+			duration = timestamp() - startTime;
+			printf("\t%-18f", comparisonCount / duration / 1e6);
+			[trees[i] release];
+		}
+		[pool2 drain];
+	}
+	printf("\n");
+	if (checksum == NSIntegerMax) {
+		printf("%ld\n", (long)checksum);
+	}
+	[pool drain];
+}
+
+// Compares adding and searching for integers in a CHInt64SortedSet with and
+// without boxing them, alongside a red-black tree of the same numbers.
+void benchmarkInt64SortedSet(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSArray *numbers = randomNumberArray(size);
+	int64_t *keys = malloc(sizeof(int64_t) * size);
+	NSUInteger index = 0;
+	for (NSNumber *number in numbers) {
+		keys[index++] = [number longLongValue];
+	}
+	double duration;
+	
+	CHQuietLog(@"\nOperations per second on %lu integers (millions)", (unsigned long)size);
+	printf("%-30s\t%-18s\t%-18s\n", "", "addObject:", "containsObject:");
+	id<CHSortedSet> sets[] = {[[CHRedBlackTree alloc] init], [[CHInt64SortedSet alloc] init]};
+	for (NSUInteger i = 0; i < 2; i++) {
+		printf("%-30s", class_getName([sets[i] class]));
+		startTime = timestamp();
+		for (id number in numbers) {
+			[sets[i] addObject:number];
+		}
+		duration = timestamp() - startTime;
+		printf("\t%-18f", size / duration / 1e6);
+		startTime = timestamp();
+		for (id number in numbers) {
+			[sets[i] containsObject:number];
+		}
+		duration = timestamp() - startTime;
+		printf("\t%-18f\n", size / duration / 1e6);
+		[sets[i] release];
+	}
+	
+	CHInt64SortedSet *set = [[CHInt64SortedSet alloc] init];
+	printf("%-30s", "CHInt64SortedSet (unboxed)");
+	startTime = timestamp();
+	for (NSUInteger i = 0; i < size; i++) {
+		[set addInt64:keys[i]];
+	}
+	duration = timestamp() - startTime;
+	printf("\t%-18f", size / duration / 1e6);
+	NSUInteger found = 0; // Keeps the searches from being optimized out
+	startTime = timestamp();
+	for (NSUInteger i = 0; i < size; i++) {
+		found += [set containsInt64:keys[i]];
+	}
+	duration = timestamp() - startTime;
+	printf("\t%-18f\n", size / duration / 1e6);
+	if (found != size) {
+		printf("Only found %lu integers\n", (unsigned long)found);
+	}
+	[set release];
+	free(keys);
+	[pool drain];
+}
+
+// Reports how many lookups per second balanced and splay trees make, and how
+// many comparisons each lookup takes, when every object is equally likely to be
+// searched for, and when the searches follow a Zipf distribution (in which the
+// k-th most popular object is searched for in proportion to 1/k).
+void benchmarkZipfLookups(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSArray *numbers = randomNumberArray(size);
+	// Shuffle the objects so that popular ones are scattered across the tree.
+	__unsafe_unretained id *ranked = (__unsafe_unretained id *) malloc(kCHPointerSize * size);
+	[numbers getObjects:ranked range:NSMakeRange(0, size)];
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		NSUInteger j = arc4random_uniform((u_int32_t) (i + 1));
+		id swap = ranked[i];
+		ranked[i] = ranked[j];
+		ranked[j] = swap;
+	}
+	// Pick each Zipf-distributed object by binary search of the cumulative weights.
+	double *cumulativeWeights = malloc(sizeof(double) * size);
+	double totalWeight = 0.0;
+	for (NSUInteger i = 0; i < size; i++) {
+		totalWeight += 1.0 / (i + 1);
+		cumulativeWeights[i] = totalWeight;
+	}
+	__unsafe_unretained id *uniformKeys = (__unsafe_unretained id *) malloc(kCHPointerSize * size);
+	__unsafe_unretained id *zipfKeys = (__unsafe_unretained id *) malloc(kCHPointerSize * size);
+	for (NSUInteger i = 0; i < size; i++) {
+		uniformKeys[i] = ranked[arc4random_uniform((u_int32_t) size)];
+		double target = totalWeight * arc4random() / ((double) UINT32_MAX + 1.0);
+		NSUInteger low = 0, high = size - 1;
+		while (low < high) {
+			NSUInteger middle = (low + high) / 2;
+			if (cumulativeWeights[middle] <= target) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		zipfKeys[i] = ranked[low];
+	}
+	free(cumulativeWeights);
+	__unsafe_unretained id *distributions[] = {uniformKeys, zipfKeys};
+	double duration;
+	
+	CHQuietLog(@"\nLookups per second on %lu objects (millions), and comparisons per lookup", (unsigned long)size);
+	printf("%-30s\t%-18s\t%-18s\t%-18s\t%-18s\n", "", "uniform", "(comparisons)", "Zipf", "(comparisons)");
+	for (Class aClass in @[[CHAVLTree class], [CHRedBlackTree class], [CHSplayTree class]]) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		printf("%-30s", class_getName(aClass));
+		for (NSUInteger d = 0; d < 2; d++) {
+			__unsafe_unretained id *keys = distributions[d];
+			CHAbstractBinarySearchTree *tree = [[aClass alloc] initWithArray:numbers];
+			startTime = timestamp();
+			for (NSUInteger i = 0; i < size; i++) {
+				[tree member:keys[i]];
+			}
+			duration = timestamp() - startTime;
+			[tree release];
+			// Splay trees change shape as they are searched, so count separately.
+			NSUInteger comparisonCount = 0;
+			tree = [[aClass alloc] initWithComparisonFunction:countComparisons
+			                                          context:&comparisonCount];
+			[tree addObjectsFromArray:numbers];
+			comparisonCount = 0;
+			for (NSUInteger i = 0; i < size; i++) {
+				[tree member:keys[i]];
+			}
+			[tree release];
+			printf("\t%-18f\t%-18f", size / duration / 1e6, (double) comparisonCount / size);
+		}
+		printf("\n");
+		[pool2 drain];
+	}
+	free(ranked);
+	free(uniformKeys);
+	free(zipfKeys);
+	[pool drain];
+}
+
+// Reports how many objects per second trees can dequeue from alternate ends, as
+// a double-ended priority queue does, and how many comparisons each one takes.
+// Splay and unbalanced trees still find the end object and then search for it.
+void benchmarkPriorityQueue(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSArray *numbers = randomNumberArray(size);
+	double duration;
+	
+	CHQuietLog(@"\nDequeues per second from both ends of %lu objects (millions), and comparisons per dequeue", (unsigned long)size);
+	NSArray *classes = @[[CHAnderssonTree class], [CHAVLTree class], [CHRedBlackTree class],
+	                     [CHTreap class], [CHSplayTree class], [CHUnbalancedTree class]];
+	for (Class aClass in classes) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		NSUInteger comparisonCount = 0;
+		CHAbstractBinarySearchTree *tree = [[aClass alloc] initWithComparisonFunction:countComparisons
+		                                                                      context:&comparisonCount];
+		[tree addObjectsFromArray:numbers];
+		comparisonCount = 0;
+		startTime = timestamp();
+		for (NSUInteger i = 0; i < size; i++) {
+			if (i & 1) {
+				[tree removeLastObject];
+			} else {
+				[tree removeFirstObject];
+			}
+		}
+		duration = timestamp() - startTime;
+		[tree release];
+		printf("%-30s\t%-18f\t%-18f\n", class_getName(aClass),
+		       size / duration / 1e6, (double) comparisonCount / size);
+		[pool2 drain];
+	}
+	[pool drain];
+}
+
+// Reports how many lookups per second trees make in random order before and
+// after -compact. The trees are built by adding objects in random order, so
+// neighboring nodes in the tree are scattered across the node slabs.
+void benchmarkCompactLookups(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSArray *numbers = randomNumberArray(size);
+	NSMutableArray *keys = [[numbers mutableCopy] autorelease];
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		[keys exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((u_int32_t) (i + 1))];
+	}
+	double duration;
+
+	CHQuietLog(@"\nLookups per second on %lu objects (millions), before and after compacting", (unsigned long)size);
+	printf("%-30s\t%-18s\t%-18s\t%-18s\n", "", "scattered", "compacted", "(compact seconds)");
+	NSArray *classes = @[[CHAnderssonTree class], [CHAVLTree class], [CHRedBlackTree class],
+	                     [CHScapegoatTree class], [CHTreap class]];
+	for (Class aClass in classes) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		printf("%-30s", class_getName(aClass));
+		CHAbstractBinarySearchTree *tree = [[aClass alloc] init];
+		for (id number in numbers) {
+			[tree addObject:number];
+		}
+		startTime = timestamp();
+		for (id number in keys) {
+			[tree member:number];
+		}
+		duration = timestamp() - startTime;
+		printf("\t%-18f", size / duration / 1e6);
+		startTime = timestamp();
+		[tree compact];
+		double compactDuration = timestamp() - startTime;
+		startTime = timestamp();
+		for (id number in keys) {
+			[tree member:number];
+		}
+		duration = timestamp() - startTime;
+		printf("\t%-18f\t%-18f\n", size / duration / 1e6, compactDuration);
+		[tree release];
+		[pool2 drain];
+	}
+	[pool drain];
+}
+
+// Reports how many objects per second trees can add, and how many comparisons
+// each addition takes, when the objects arrive in nearly ascending order (as
+// timestamps often do) and when they arrive in random order. One object in 20
+// arrives late, behind as many as 64 objects that are greater than it.
+// (An unbalanced tree would degenerate into a list of 1,000,000 nodes.)
+void benchmarkNearlyAscendingInsertion(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	__unsafe_unretained id *ascending = (__unsafe_unretained id *) malloc(kCHPointerSize * size);
+	for (NSUInteger i = 0; i < size; i++) {
+		ascending[i] = @(i);
+	}
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		if (arc4random_uniform(20) == 0) {
+			NSUInteger delay = MIN(1 + arc4random_uniform(64), size - 1 - i);
+			id late = ascending[i];
+			memmove(ascending + i, ascending + i + 1, kCHPointerSize * delay);
+			ascending[i + delay] = late;
+		}
+	}
+	NSArray *nearlyAscending = [NSArray arrayWithObjects:ascending count:size];
+	free(ascending);
+	NSMutableArray *shuffled = [[nearlyAscending mutableCopy] autorelease];
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		[shuffled exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((u_int32_t) (i + 1))];
+	}
+	NSArray *orders[] = {nearlyAscending, shuffled};
+	double duration;
+
+	CHQuietLog(@"\nAdditions per second of %lu objects (millions), and comparisons per addition", (unsigned long)size);
+	printf("%-30s\t%-18s\t%-18s\t%-18s\t%-18s\n", "", "nearly ascending", "(comparisons)", "random", "(comparisons)");
+	NSArray *classes = @[[CHAnderssonTree class], [CHAVLTree class], [CHRedBlackTree class],
+	                     [CHScapegoatTree class], [CHSplayTree class], [CHTreap class]];
+	for (Class aClass in classes) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		printf("%-30s", class_getName(aClass));
+		for (NSUInteger o = 0; o < 2; o++) {
+			CHAbstractBinarySearchTree *tree = [[aClass alloc] init];
+			startTime = timestamp();
+			for (id number in orders[o]) {
+				[tree addObject:number];
+			}
+			duration = timestamp() - startTime;
+			[tree release];
+			NSUInteger comparisonCount = 0;
+			tree = [[aClass alloc] initWithComparisonFunction:countComparisons
+			                                          context:&comparisonCount];
+			for (id number in orders[o]) {
+				[tree addObject:number];
+			}
+			[tree release];
+			printf("\t%-18f\t%-18f", size / duration / 1e6, (double) comparisonCount / size);
+		}
+		printf("\n");
+		[pool2 drain];
+	}
+	[pool drain];
+}
+
+// Reports how many lookups per second a frozen sorted set makes in random order,
+// compared to compacted trees and to a binary search of a sorted array, with the
+// same objects. Half of the keys are absent, so every search reaches the bottom.
+void benchmarkFrozenSortedSetLookups(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSMutableArray *sorted = [NSMutableArray arrayWithCapacity:size];
+	NSMutableArray *keys = [NSMutableArray arrayWithCapacity:size];
+	for (NSUInteger i = 0; i < size; i++) {
+		[sorted addObject:@(2 * i)];
+		[keys addObject:@(2 * i + arc4random_uniform(2))];
+	}
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		[keys exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((u_int32_t) (i + 1))];
+	}
+	double duration;
+
+	CHQuietLog(@"\nLookups per second on %lu objects (millions)", (unsigned long)size);
+	// Trees built from sorted objects are balanced, even a CHUnbalancedTree, and
+	// a CHSplayTree reorganizes itself as it is searched.
+	NSArray *classes = @[[CHFrozenSortedSet class], [CHAnderssonTree class], [CHAVLTree class],
+	                     [CHRedBlackTree class], [CHScapegoatTree class], [CHSplayTree class],
+	                     [CHTreap class], [CHUnbalancedTree class]];
+	for (Class aClass in classes) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		id<CHSortedSet> set = [[aClass alloc] initWithArray:sorted];
+		if ([set isKindOfClass:[CHAbstractBinarySearchTree class]]) {
+			[(CHAbstractBinarySearchTree *)set compact];
+		}
+		startTime = timestamp();
+		for (id number in keys) {
+			[set member:number];
+		}
+		duration = timestamp() - startTime;
+		printf("%-30s\t%-18f\n", class_getName(aClass), size / duration / 1e6);
+		[set release];
+		[pool2 drain];
+	}
+	startTime = timestamp();
+	for (id number in keys) {
+		[sorted indexOfObject:number inSortedRange:NSMakeRange(0, size) options:0 usingComparator:^(id object1, id object2) {
+			return [object1 compare:object2];
+		}];
+	}
+	duration = timestamp() - startTime;
+	printf("%-30s\t%-18f\n", "NSArray (binary search)", size / duration / 1e6);
+	[pool drain];
+}
+
+// Reports how many lookups per second trees make when searching for a batch of
+// objects at once with -membersOfObjects:, compared to calling -member: for each
+// one, for batches of several sizes. Half of the objects are absent.
+void benchmarkBatchedLookups(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000, lookupCount = 1000000;
+	NSMutableArray *sorted = [NSMutableArray arrayWithCapacity:size];
+	NSMutableArray *keys = [NSMutableArray arrayWithCapacity:lookupCount];
+	for (NSUInteger i = 0; i < size; i++) {
+		[sorted addObject:@(2 * i)];
+	}
+	NSMutableArray *shuffled = [[sorted mutableCopy] autorelease];
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		[shuffled exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((u_int32_t) (i + 1))];
+	}
+	for (NSUInteger i = 0; i < lookupCount; i++) {
+		[keys addObject:@(arc4random_uniform((u_int32_t) (2 * size)))];
+	}
+	NSUInteger batchSizes[] = {16, 256, 4096, 262144};
+	double duration;
+
+	CHQuietLog(@"\nLookups per second on %lu objects (millions), one at a time and in batches", (unsigned long)size);
+	printf("%-30s\t%-18s", "", "single");
+	for (NSUInteger b = 0; b < 4; b++) {
+		printf("\tbatches of %-7lu", (unsigned long)batchSizes[b]);
+	}
+	printf("\n");
+	NSArray *classes = @[[CHAnderssonTree class], [CHAVLTree class], [CHRedBlackTree class], [CHTreap class]];
+	for (Class aClass in classes) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		printf("%-30s", class_getName(aClass));
+		CHAbstractBinarySearchTree *tree = [[aClass alloc] init];
+		// Adding in random order scatters neighboring nodes through memory.
+		for (id number in shuffled) {
+			[tree addObject:number];
+		}
+		startTime = timestamp();
+		for (id number in keys) {
+			[tree member:number];
+		}
+		duration = timestamp() - startTime;
+		printf("\t%-18f", lookupCount / duration / 1e6);
+		for (NSUInteger b = 0; b < 4; b++) {
+			NSMutableArray *batches = [NSMutableArray array];
+			for (NSUInteger i = 0; i < lookupCount; i += batchSizes[b]) {
+				NSRange range = NSMakeRange(i, MIN(batchSizes[b], lookupCount - i));
+				[batches addObject:[keys subarrayWithRange:range]];
+			}
+			startTime = timestamp();
+			for (NSArray *batch in batches) {
+				[tree membersOfObjects:batch];
+			}
+			duration = timestamp() - startTime;
+			printf("\t%-18f", lookupCount / duration / 1e6);
+		}
+		printf("\n");
+		[tree release];
+		[pool2 drain];
+	}
+	[pool drain];
+}
+
+// Compares trees that order records by a key path, which find each record's key
+// once when it is added, with trees whose comparator looks up the keys of both
+// records at every comparison.
+void benchmarkKeyPathOrdering(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 200000;
+	NSMutableArray *records = [NSMutableArray arrayWithCapacity:size];
+	for (NSUInteger i = 0; i < size; i++) {
+		[records addObject:@{@"rank": @(i), @"name": [NSString stringWithFormat:@"%lu", (unsigned long)i]}];
+	}
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		[records exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((u_int32_t) (i + 1))];
+	}
+	NSComparator byRank = ^(NSDictionary *record1, NSDictionary *record2) {
+		return [[record1 valueForKeyPath:@"rank"] compare:[record2 valueForKeyPath:@"rank"]];
+	};
+	double duration;
+	
+	CHQuietLog(@"\nOrdering %lu records by rank (seconds)", (unsigned long)size);
+	printf("%-30s\t%-18s\t%-18s\t%-18s\t%-18s\n", "",
+	       "comparator: add", "comparator: member", "key path: add", "key path: member");
+	NSArray *classes = @[[CHAnderssonTree class], [CHAVLTree class], [CHRedBlackTree class], [CHTreap class]];
+	for (Class aClass in classes) {
+		NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+		printf("%-30s", class_getName(aClass));
+		CHAbstractBinarySearchTree *trees[2] = {
+			[[aClass alloc] initWithComparator:byRank],
+			[[aClass alloc] initWithKeyPath:@"rank"],
+		};
+		for (NSUInteger t = 0; t < 2; t++) {
+			startTime = timestamp();
+			for (id record in records) {
+				[trees[t] addObject:record];
+			}
+			duration = timestamp() - startTime;
+			printf("\t%-18f", duration);
+			startTime = timestamp();
+			for (id record in records) {
+				[trees[t] member:record];
+			}
+			duration = timestamp() - startTime;
+			printf("\t%-18f", duration);
+			[trees[t] release];
+		}
+		printf("\n");
+		[pool2 drain];
+	}
+	[pool drain];
+}
+
+// Compares trees of string keys with and without cached key prefixes, using
+// English words (which share short prefixes) and UUIDs (which are random).
+void benchmarkKeyPrefixes(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 200000;
+	NSString *dictionary = [NSString stringWithContentsOfFile:@"/usr/share/dict/words"
+	                                                 encoding:NSUTF8StringEncoding
+	                                                    error:NULL];
+	NSMutableArray *words = [NSMutableArray arrayWithCapacity:size];
+	for (NSString *word in [dictionary componentsSeparatedByString:@"\n"]) {
+		if ([word length] > 0 && [words count] < size) {
+			[words addObject:word];
+		}
+	}
+	// Without a word list, invent words from a few common English prefixes.
+	NSArray *stems = @[@"inter", @"under", @"over", @"counter", @"re", @"pre", @"trans", @"un"];
+	while ([words count] < size) {
+		[words addObject:[NSString stringWithFormat:@"%@national%lu",
+		                  [stems objectAtIndex:[words count] % [stems count]], (unsigned long)[words count]]];
+	}
+	NSMutableArray *uuids = [NSMutableArray arrayWithCapacity:size];
+	for (NSUInteger i = 0; i < size; i++) {
+		[uuids addObject:[[NSUUID UUID] UUIDString]];
+	}
+	for (NSUInteger i = size - 1; i > 0; i--) {
+		[words exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((u_int32_t) (i + 1))];
+	}
+	double duration;
+	
+	NSArray *keySets = @[words, uuids];
+	NSArray *keySetNames = @[@"words", @"UUIDs"];
+	for (NSUInteger k = 0; k < [keySets count]; k++) {
+		NSArray *keys = [keySets objectAtIndex:k];
+		CHQuietLog(@"\nAdding and finding %lu %@ (seconds)", (unsigned long)[keys count], [keySetNames objectAtIndex:k]);
+		printf("%-30s\t%-18s\t%-18s\t%-18s\t%-18s\n", "",
+		       "plain: add", "plain: member", "prefixes: add", "prefixes: member");
+		NSArray *classes = @[[CHAnderssonTree class], [CHAVLTree class], [CHRedBlackTree class], [CHTreap class]];
+		for (Class aClass in classes) {
+			NSAutoreleasePool *pool2 = [[NSAutoreleasePool alloc] init];
+			printf("%-30s", class_getName(aClass));
+			for (NSUInteger t = 0; t < 2; t++) {
+				CHAbstractBinarySearchTree *tree = [[aClass alloc] init];
+				[tree setCachesKeyPrefixes:(t == 1)];
+				startTime = timestamp();
+				for (id key in keys) {
+					[tree addObject:key];
+				}
+				duration = timestamp() - startTime;
+				printf("\t%-18f", duration);
+				startTime = timestamp();
+				for (id key in keys) {
+					[tree member:key];
+				}
+				duration = timestamp() - startTime;
+				printf("\t%-18f", duration);
+				[tree release];
+			}
+			printf("\n");
+			[pool2 drain];
+		}
+	}
+	[pool drain];
+}
+
+// Reports how many lookups per second a shared set can answer as more threads
+// read it at once. Readers share the lock, so lookups should scale with cores.
+void benchmarkConcurrentReads(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSArray *numbers = randomNumberArray(size);
+	CHConcurrentSortedSet *set = [[CHConcurrentSortedSet alloc] initWithArray:numbers];
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	CHQuietLog(@"\nConcurrent lookups per second on %lu objects (millions)", (unsigned long)size);
+	printf("%-30s\t%-18s\n", "", "containsObject:");
+	for (size_t threads = 1; threads <= 8; threads *= 2) {
+		printf("%-30s", [[NSString stringWithFormat:@"%zu thread(s)", threads] UTF8String]);
+		__block NSUInteger found = 0;
+		startTime = timestamp();
+		dispatch_apply(threads, queue, ^(size_t thread) {
+			NSUInteger foundByThread = 0;
+			for (id number in numbers) {
+				foundByThread += [set containsObject:number];
+			}
+			@synchronized (set) {
+				found += foundByThread;
+			}
+		});
+		double duration = timestamp() - startTime;
+		printf("\t%-18f\n", threads * size / duration / 1e6);
+		if (found != threads * size) {
+			printf("Only found %lu objects\n", (unsigned long)found);
+		}
+	}
+	[set release];
+	[pool drain];
+}
+
+// Reports how many insertions per second several threads can make at once into
+// a lock-free skip list, and into a red-black tree guarded by a mutex.
+void benchmarkConcurrentInsertion(void) {
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	NSUInteger size = 1000000;
+	NSArray *numbers = randomNumberArray(size);
+	dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+	
+	CHQuietLog(@"\nConcurrent insertions per second of %lu objects (millions)", (unsigned long)size);
+	printf("%-30s\t%-18s\t%-18s\n", "", "CHConcurrentSkipList", "CHRedBlackTree+mutex");
+	for (size_t threads = 1; threads <= 8; threads *= 2) {
+		printf("%-30s", [[NSString stringWithFormat:@"%zu thread(s)", threads] UTF8String]);
+		NSUInteger perThread = size / threads;
+		
+		CHConcurrentSkipList *skipList = [[CHConcurrentSkipList alloc] init];
+		startTime = timestamp();
+		dispatch_apply(threads, queue, ^(size_t thread) {
+			for (NSUInteger i = thread * perThread; i < (thread + 1) * perThread; i++) {
+				[skipList addObject:numbers[i]];
+			}
+		});
+		printf("\t%-18f", threads * perThread / (timestamp() - startTime) / 1e6);
+		[skipList release];
+		
+		CHRedBlackTree *tree = [[CHRedBlackTree alloc] init];
+		__block pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+		startTime = timestamp();
+		dispatch_apply(threads, queue, ^(size_t thread) {
+			for (NSUInteger i = thread * perThread; i < (thread + 1) * perThread; i++) {
+				pthread_mutex_lock(&mutex);
+				[tree addObject:numbers[i]];
+				pthread_mutex_unlock(&mutex);
+			}
+		});
+		printf("\t%-18f\n", threads * perThread / (timestamp() - startTime) / 1e6);
+		pthread_mutex_destroy(&mutex);
+		[tree release];
+	}
+	[pool drain];
+}
+
 int main(int argc, const char * argv[]) {
 	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
 	NSUInteger limit = 100000;
@@ -533,14 +1288,18 @@ int main(int argc, const char * argv[]) {
 	
 	// Create more disordered sets of values for testing heap and tree subclasses
 	
-	CHQuietLog(@"\n<CHSearchTree> Implemenations");
+	CHQuietLog(@"\n<CHSortedSet> Implemenations");
 	
 	NSArray *testClasses = @[
 		[CHAnderssonTree class],
 		[CHAVLTree class],
+		[CHBPlusTree class],
 		[CHRedBlackTree class],
+		[CHScapegoatTree class],
+		[CHSplayTree class],
 		[CHTreap class],
 		[CHUnbalancedTree class],
+		[CHInt64SortedSet class],
 	];
 	NSMutableDictionary *treeResults = [NSMutableDictionary dictionary];
 	NSMutableDictionary *dictionary;
@@ -549,13 +1308,15 @@ int main(int argc, const char * argv[]) {
 		[dictionary setObject:[NSMutableArray array] forKey:@"addObject"];
 		[dictionary setObject:[NSMutableArray array] forKey:@"member"];
 		[dictionary setObject:[NSMutableArray array] forKey:@"removeObject"];
+		[dictionary setObject:[NSMutableArray array] forKey:@"churn"];
+		[dictionary setObject:[NSMutableArray array] forKey:@"removeAllObjects"];
 		if ([aClass conformsToProtocol:@protocol(CHSearchTree)]) {
 			[dictionary setObject:[NSMutableArray array] forKey:@"height"];
 		}
 		[treeResults setObject:dictionary forKey:NSStringFromClass(aClass)];
 	}
 	
-	CHAbstractBinarySearchTree *tree;
+	id<CHSortedSet> tree;
 	double duration;
 	struct timespec sleepDelay = {0,1}, sleepRemain;
 	
@@ -610,8 +1371,19 @@ int main(int argc, const char * argv[]) {
 				if ([aClass conformsToProtocol:@protocol(CHSearchTree)]) {
 					[[dictionary objectForKey:@"height"] addObject:
 					 [NSString stringWithFormat:@"%lu,%lu",
-					  jitteredSize, [tree height]]];
+					  jitteredSize, [(id)tree height]]];
+				}
+				
+				// removeObject: and addObject: interleaved (reuses freed nodes)
+				nanosleep(&sleepDelay, &sleepRemain);
+				startTime = timestamp();
+				for (id anObject in randomNumbers) {
+					[tree removeObject:anObject];
+					[tree addObject:anObject];
 				}
+				duration = timestamp() - startTime;
+				[[dictionary objectForKey:@"churn"] addObject:
+				 [NSString stringWithFormat:@"%lu,%f", jitteredSize, duration/(2*size)*scale]];
 				
 				// removeObject:
 				nanosleep(&sleepDelay, &sleepRemain);
@@ -623,12 +1395,47 @@ int main(int argc, const char * argv[]) {
 				[[dictionary objectForKey:@"removeObject"] addObject:
 				 [NSString stringWithFormat:@"%lu,%f", jitteredSize, duration/size*scale]];
 				
+				// removeAllObjects
+				[tree addObjectsFromArray:randomNumbers];
+				nanosleep(&sleepDelay, &sleepRemain);
+				startTime = timestamp();
+				[tree removeAllObjects];
+				duration = timestamp() - startTime;
+				[[dictionary objectForKey:@"removeAllObjects"] addObject:
+				 [NSString stringWithFormat:@"%lu,%f", jitteredSize, duration/size*scale]];
+				
 				[tree release];
 				[pool2 drain];
 			}
 		}
 	}
 	
+	// Only binary search trees have orderings and set operations.
+	NSPredicate *isBinarySearchTree = [NSPredicate predicateWithBlock:^BOOL(id aClass, NSDictionary *bindings) {
+		return [aClass isSubclassOfClass:[CHAbstractBinarySearchTree class]];
+	}];
+	NSArray *treeClasses = [testClasses filteredArrayUsingPredicate:isBinarySearchTree];
+	benchmarkComparisons(treeClasses);
+	benchmarkInt64SortedSet();
+	benchmarkZipfLookups();
+	benchmarkPriorityQueue();
+	benchmarkNearlyAscendingInsertion();
+	benchmarkCompactLookups();
+	benchmarkFrozenSortedSetLookups();
+	benchmarkBatchedLookups();
+	benchmarkKeyPathOrdering();
+	benchmarkKeyPrefixes();
+	benchmarkConcurrentReads();
+	benchmarkConcurrentInsertion();
+	
+	CHQuietLog(@"\n\nSet operations on <CHSearchTree> Implemenations");
+	for (Class aClass in treeClasses) {
+		// Adding the ascending objects one at a time degenerates into a list.
+		if (aClass != [CHUnbalancedTree class]) {
+			benchmarkSetAlgebra(aClass);
+		}
+	}
+	
 	NSString *path = @"../../benchmark_data/";
 	NSFileManager *fileManager = [NSFileManager defaultManager];
 	if (![fileManager fileExistsAtPath:path]) {
@@ -10,6 +10,11 @@
 #import <CHDataStructures/CHMutableArrayHeap.h>
 #import "NSObject+TestUtilities.h"
 
+// A comparison function for strings, whose context points to the options.
+static NSInteger compareStringsWithOptions(id string1, id string2, void *context) {
+	return [string1 compare:string2 options:*(NSStringCompareOptions *)context];
+}
+
 @interface CHMutableArrayHeap (Test)
 
 - (BOOL)isValid;
@@ -22,6 +27,7 @@
 	id parent, leftChild, rightChild;
 	NSUInteger parentIndex = 0, leftIndex, rightIndex;
 	NSUInteger arraySize = [array count];
+	CHComparison localOrdering = ordering;
 	// Iterate from 0 to n/2-1 and check that children hold heap's sort order
 	while (parentIndex < arraySize / 2) {
 		leftIndex = parentIndex * 2 + 1;
@@ -29,10 +35,10 @@
 		parent = [array objectAtIndex:parentIndex];
 		leftChild = (leftIndex < arraySize) ? [array objectAtIndex:leftIndex] : nil;
 		rightChild = (rightIndex < arraySize) ? [array objectAtIndex:rightIndex] : nil;
-		if (leftChild && [parent compare:leftChild] == -sortOrder) {
+		if (leftChild && CHComparisonCompare(&localOrdering, parent, leftChild) == -sortOrder) {
 			return NO;
 		}
-		if (rightChild && [parent compare:rightChild] == -sortOrder) {
+		if (rightChild && CHComparisonCompare(&localOrdering, parent, rightChild) == -sortOrder) {
 			return NO;
 		}
 		++parentIndex;
@@ -169,6 +175,42 @@
 	}
 }
 
+- (void)testInitWithComparator {
+	XCTAssertThrows([[CHMutableArrayHeap alloc] initWithOrdering:NSOrderedAscending comparator:nil]);
+	NSComparator byLength = ^(id string1, id string2) {
+		return [@([string1 length]) compare:@([string2 length])];
+	};
+	NSArray *strings = @[@"ccc",@"a",@"eeeee",@"bb",@"dddd"];
+	heap = [[[CHMutableArrayHeap alloc] initWithOrdering:NSOrderedDescending
+	                                          comparator:byLength] autorelease];
+	[heap addObjectsFromArray:strings];
+	XCTAssertTrue([heap isValid]);
+	XCTAssertEqualObjects([heap allObjectsInSortedOrder],
+	                      (@[@"eeeee",@"dddd",@"ccc",@"bb",@"a"]));
+	[heap removeFirstObject];
+	XCTAssertEqualObjects([heap firstObject], @"dddd");
+	XCTAssertEqualObjects([[[heap copy] autorelease] allObjectsInSortedOrder],
+	                      (@[@"dddd",@"ccc",@"bb",@"a"]));
+	XCTAssertThrows([heap copyUsingNSCoding]);
+}
+
+- (void)testInitWithComparisonFunction {
+	XCTAssertThrows([[CHMutableArrayHeap alloc] initWithOrdering:NSOrderedAscending
+	                                          comparisonFunction:NULL
+	                                                     context:NULL]);
+	NSStringCompareOptions options = NSCaseInsensitiveSearch;
+	heap = [[[CHMutableArrayHeap alloc] initWithOrdering:NSOrderedAscending
+	                                  comparisonFunction:compareStringsWithOptions
+	                                             context:&options] autorelease];
+	for (id anObject in @[@"c",@"E",@"a",@"D",@"b"]) {
+		[heap addObject:anObject];
+	}
+	XCTAssertTrue([heap isValid]);
+	XCTAssertEqualObjects([heap allObjectsInSortedOrder], (@[@"a",@"b",@"c",@"D",@"E"]));
+	[heap removeFirstObject];
+	XCTAssertEqualObjects([heap firstObject], @"b");
+}
+
 - (void)testAddObject {
 	for (Class aClass in heapClasses) {
 		heap = [[[aClass alloc] init] autorelease];
@@ -8,6 +8,7 @@
 #import <XCTest/XCTest.h>
 #import <CHDataStructures/CHLinkedList.h>
 #import <CHDataStructures/CHDoublyLinkedList.h>
+#import <CHDataStructures/CHImplicitTreap.h>
 #import <CHDataStructures/CHSinglyLinkedList.h>
 #import "NSObject+TestUtilities.h"
 
@@ -24,6 +25,7 @@
 	abc = @[@"A",@"B",@"C"];
 	linkedListClasses = @[
 		[CHDoublyLinkedList class],
+		[CHImplicitTreap class],
 		[CHSinglyLinkedList class],
 	];
 }
@@ -306,8 +308,8 @@
 		[pool drain];
 		XCTAssertEqual([list retainCount], 1);	
 		
-		// For doubly-linked list, test reverse enumeration order as well
-		if (aClass == [CHDoublyLinkedList class]) {
+		// For lists that support it, test reverse enumeration order as well
+		if ([list respondsToSelector:@selector(reverseObjectEnumerator)]) {
 			e = [(CHDoublyLinkedList *)list reverseObjectEnumerator];
 			XCTAssertEqualObjects([e nextObject], @"C");
 			XCTAssertEqualObjects([e nextObject], @"B");
@@ -664,3 +666,100 @@
 }
 
 @end
+
+#pragma mark -
+
+@interface CHImplicitTreapTest : XCTestCase
+@end
+
+@implementation CHImplicitTreapTest
+
+- (void)testSplitAtIndex {
+	NSArray *objects = @[@"A",@"B",@"C",@"D",@"E"];
+	for (NSUInteger index = 0; index <= [objects count]; index++) {
+		CHImplicitTreap *treap = [[[CHImplicitTreap alloc] initWithArray:objects] autorelease];
+		CHImplicitTreap *rest = [treap splitAtIndex:index];
+		XCTAssertEqualObjects([treap allObjects], [objects subarrayWithRange:NSMakeRange(0, index)]);
+		XCTAssertEqualObjects([rest allObjects], [objects subarrayWithRange:NSMakeRange(index, [objects count] - index)]);
+		XCTAssertEqual([treap count] + [rest count], [objects count]);
+	}
+	CHImplicitTreap *treap = [[[CHImplicitTreap alloc] initWithArray:objects] autorelease];
+	XCTAssertThrows([treap splitAtIndex:[objects count] + 1]);
+	// Splitting is a mutation
+	NSEnumerator *e = [treap objectEnumerator];
+	[treap splitAtIndex:2];
+	XCTAssertThrows([e nextObject]);
+}
+
+- (void)testConcatenateTreap {
+	CHImplicitTreap *treap = [[[CHImplicitTreap alloc] initWithArray:@[@"A",@"B"]] autorelease];
+	CHImplicitTreap *other = [[[CHImplicitTreap alloc] initWithArray:@[@"C",@"D",@"E"]] autorelease];
+	[treap concatenateTreap:other];
+	XCTAssertEqualObjects([treap allObjects], (@[@"A",@"B",@"C",@"D",@"E"]));
+	XCTAssertEqual([other count], 0);
+	XCTAssertEqualObjects([other allObjects], @[]);
+	// The emptied treap remains usable
+	[other addObject:@"F"];
+	[treap concatenateTreap:other];
+	XCTAssertEqualObjects([treap lastObject], @"F");
+	// Concatenating an empty treap, or onto an empty treap, moves everything
+	[treap concatenateTreap:other];
+	XCTAssertEqual([treap count], 6);
+	[other concatenateTreap:treap];
+	XCTAssertEqual([other count], 6);
+	XCTAssertEqual([treap count], 0);
+
+	XCTAssertThrows([treap concatenateTreap:nil]);
+	XCTAssertThrows([treap concatenateTreap:treap]);
+}
+
+- (void)testRandomEditsMatchArray {
+	CHImplicitTreap *treap = [[[CHImplicitTreap alloc] init] autorelease];
+	NSMutableArray *expected = [NSMutableArray array];
+	srandom(17);
+	for (NSUInteger i = 0; i < 5000; i++) {
+		NSUInteger count = [expected count];
+		switch (random() % 4) {
+			case 0:
+			case 1: {
+				NSUInteger index = random() % (count + 1);
+				[treap insertObject:@(i) atIndex:index];
+				[expected insertObject:@(i) atIndex:index];
+				break;
+			}
+			case 2:
+				if (count > 0) {
+					NSUInteger index = random() % count;
+					[treap removeObjectAtIndex:index];
+					[expected removeObjectAtIndex:index];
+				}
+				break;
+			case 3: {
+				// Cut a range out and paste it back at another position
+				NSUInteger start = random() % (count + 1);
+				NSUInteger length = random() % (count - start + 1);
+				CHImplicitTreap *tail = [treap splitAtIndex:start];
+				CHImplicitTreap *rest = [tail splitAtIndex:length];
+				[treap concatenateTreap:rest];
+				NSUInteger position = random() % (count - length + 1);
+				CHImplicitTreap *after = [treap splitAtIndex:position];
+				[treap concatenateTreap:tail];
+				[treap concatenateTreap:after];
+				NSArray *range = [expected subarrayWithRange:NSMakeRange(start, length)];
+				[expected removeObjectsInRange:NSMakeRange(start, length)];
+				[expected insertObjects:range atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(position, length)]];
+				break;
+			}
+		}
+		XCTAssertEqual([treap count], [expected count]);
+		if (i % 100 == 0 && [expected count] > 0) {
+			NSUInteger index = random() % [expected count];
+			XCTAssertEqualObjects([treap objectAtIndex:index], [expected objectAtIndex:index]);
+		}
+	}
+	XCTAssertEqualObjects([treap allObjects], expected);
+	XCTAssertEqualObjects([[treap reverseObjectEnumerator] allObjects],
+	                      [[expected reverseObjectEnumerator] allObjects]);
+}
+
+@end
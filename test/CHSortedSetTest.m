@@ -11,7 +11,15 @@
 #import "CHAbstractBinarySearchTree_Internal.h"
 #import <CHDataStructures/CHAnderssonTree.h>
 #import <CHDataStructures/CHAVLTree.h>
+#import <CHDataStructures/CHBPlusTree.h>
+#import <CHDataStructures/CHConcurrentSkipList.h>
+#import <CHDataStructures/CHConcurrentSortedSet.h>
+#import <CHDataStructures/CHFrozenSortedSet.h>
+#import <CHDataStructures/CHInt64SortedSet.h>
+#import <CHDataStructures/CHPersistentAVLTree.h>
 #import <CHDataStructures/CHRedBlackTree.h>
+#import <CHDataStructures/CHScapegoatTree.h>
+#import <CHDataStructures/CHSplayTree.h>
 #import <CHDataStructures/CHTreap.h>
 #import <CHDataStructures/CHUnbalancedTree.h>
 
@@ -19,6 +27,11 @@
 
 static NSArray *abcde;
 
+// A comparison function for strings, whose context points to the options.
+static NSInteger compareStringsWithOptions(id string1, id string2, void *context) {
+	return [string1 compare:string2 options:*(NSStringCompareOptions *)context];
+}
+
 #define NonConcreteClass() \
 ([self classUnderTest] == nil || [self classUnderTest] == [CHAbstractBinarySearchTree class])
 
@@ -51,6 +64,15 @@ static NSArray *abcde;
 	set = [self createSet];
 }
 
+// Trees build their contents in bulk when -addObjectsFromArray: is sent to an
+// empty tree, so tests that depend on the shape produced by a specific order
+// of insertion must add the objects one at a time.
+- (void)addObjectsIndividually:(NSArray *)array toSet:(id)aSet {
+	for (id anObject in array) {
+		[aSet addObject:anObject];
+	}
+}
+
 - (void)testAddObject {
 	if ([self classUnderTest] == nil) {
 		return;
@@ -187,6 +209,47 @@ static NSArray *abcde;
 	XCTAssertNil([set member:@"bogus"]);
 }
 
+- (void)testNearestObjects {
+	if (NonConcreteClass()) {
+		return;
+	}
+	XCTAssertThrows([set floorObject:nil]);
+	XCTAssertThrows([set ceilingObject:nil]);
+	XCTAssertThrows([set objectBefore:nil]);
+	XCTAssertThrows([set objectAfter:nil]);
+	XCTAssertNil([set floorObject:@"A"]);
+	XCTAssertNil([set ceilingObject:@"A"]);
+	XCTAssertNil([set objectBefore:@"A"]);
+	XCTAssertNil([set objectAfter:@"A"]);
+	
+	// Probe every letter, whether it is a member, between members or beyond them.
+	NSArray *members = @[@"B",@"D",@"F",@"H",@"J",@"L",@"N"];
+	[set addObjectsFromArray:members];
+	for (unichar letter = 'A'; letter <= 'O'; letter++) {
+		NSString *probe = [NSString stringWithCharacters:&letter length:1];
+		id expectedFloor = nil, expectedCeiling = nil, expectedBefore = nil, expectedAfter = nil;
+		for (NSString *member in members) {
+			NSComparisonResult comparison = [member compare:probe];
+			if (comparison != NSOrderedDescending) {
+				expectedFloor = member;
+			}
+			if (comparison == NSOrderedAscending) {
+				expectedBefore = member;
+			}
+			if (comparison != NSOrderedAscending && expectedCeiling == nil) {
+				expectedCeiling = member;
+			}
+			if (comparison == NSOrderedDescending && expectedAfter == nil) {
+				expectedAfter = member;
+			}
+		}
+		XCTAssertEqualObjects([set floorObject:probe], expectedFloor);
+		XCTAssertEqualObjects([set ceilingObject:probe], expectedCeiling);
+		XCTAssertEqualObjects([set objectBefore:probe], expectedBefore);
+		XCTAssertEqualObjects([set objectAfter:probe], expectedAfter);
+	}
+}
+
 - (void)testObjectEnumerator {
 	if (NonConcreteClass()) {
 		return;
@@ -249,6 +312,31 @@ static NSArray *abcde;
 	XCTAssertEqual([set count], 0);
 }
 
+- (void)testRemoveObjectsAndAddAgain {
+	if (NonConcreteClass()) {
+		return;
+	}
+	// Removing and re-adding objects exercises reuse of freed storage
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger number = 0; number < 100; number++) {
+		[numbers addObject:@(number)];
+	}
+	[set addObjectsFromArray:numbers];
+	for (NSUInteger number = 0; number < 100; number += 2) {
+		[set removeObject:@(number)];
+	}
+	XCTAssertEqual([set count], 50);
+	for (NSUInteger number = 0; number < 100; number += 2) {
+		[set addObject:@(number)];
+	}
+	XCTAssertEqualObjects([set allObjects], numbers);
+	// Storage released by -removeAllObjects should be replenished as needed
+	[set removeAllObjects];
+	XCTAssertEqual([set count], 0);
+	[set addObjectsFromArray:numbers];
+	XCTAssertEqualObjects([set allObjects], numbers);
+}
+
 - (void)testRemoveFirstObject {
 	if (NonConcreteClass()) {
 		return;
@@ -410,9 +498,7 @@ static NSArray *abcde;
 	} else {
 		after = [set allObjects];
 	}
-	if ([self classUnderTest] != [CHTreap class]) {
-		XCTAssertEqualObjects(before, after);
-	}
+	XCTAssertEqualObjects(before, after);
 }
 
 - (void)testNSCopying {
@@ -430,7 +516,7 @@ static NSArray *abcde;
 	XCTAssertNotNil(copy);
 	XCTAssertEqual([copy count], [abcde count]);
 	XCTAssertEqual([set hash], [copy hash]);
-	if ([set conformsToProtocol:@protocol(CHSearchTree)] && [self classUnderTest] != [CHTreap class]) {
+	if ([set conformsToProtocol:@protocol(CHSearchTree)]) {
 		XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
 							 [copy allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder]);
 	} else {
@@ -470,6 +556,8 @@ static NSArray *abcde;
 @interface CHAbstractBinarySearchTree (Test)
 
 - (id)headerObject;
+- (void)verifySubtreeSizes;
+- (void)verifyParentLinks;
 
 @end
 
@@ -479,6 +567,46 @@ static NSArray *abcde;
 	return header->object;
 }
 
+// Recursive method for verifying that each node's subtree size is correct.
+- (NSUInteger)verifySizeOfSubtreeAtNode:(CHBinaryTreeNode *)node {
+	if (node == sentinel) {
+		return 0;
+	}
+	NSUInteger size = [self verifySizeOfSubtreeAtNode:node->left]
+	                + [self verifySizeOfSubtreeAtNode:node->right] + 1;
+	if (node->size != size) {
+		[NSException raise:NSInternalInconsistencyException
+		            format:@"Wrong size at node '%@': %u, should be %lu.",
+		                   node->object, node->size, (unsigned long)size];
+	}
+	return size;
+}
+
+- (void)verifySubtreeSizes {
+	if (tracksSubtreeSizes) {
+		[self verifySizeOfSubtreeAtNode:header->right];
+	}
+}
+
+// Recursive method for verifying that each node's children link back to it.
+- (void)verifyParentLinksInSubtreeAtNode:(CHBinaryTreeNode *)node {
+	for (NSUInteger direction = 0; direction < 2; direction++) {
+		CHBinaryTreeNode *child = node->link[direction];
+		if (child == sentinel) {
+			continue;
+		}
+		if (child->parent != node) {
+			[NSException raise:NSInternalInconsistencyException
+			            format:@"Wrong parent at node '%@'.", child->object];
+		}
+		[self verifyParentLinksInSubtreeAtNode:child];
+	}
+}
+
+- (void)verifyParentLinks {
+	[self verifyParentLinksInSubtreeAtNode:header];
+}
+
 @end
 
 @interface CHAbstractBinarySearchTreeTest : CHSortedSetTest
@@ -508,6 +636,81 @@ static NSArray *abcde;
 	XCTAssertThrows([set objectEnumeratorWithTraversalOrder:42]);
 }
 
+- (void)testAddObjectsFromArrayToEmptyTree {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	// Sorted input should produce a perfectly balanced tree
+	NSArray *sorted = @[@"A",@"B",@"C",@"D",@"E",@"F",@"G"];
+	[set addObjectsFromArray:sorted];
+	XCTAssertEqual([set count], [sorted count]);
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
+						 (@[@"D",@"B",@"F",@"A",@"C",@"E",@"G"]));
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+	
+	// Unsorted input should be sorted, keeping the last of any duplicates
+	[set removeAllObjects];
+	NSString *firstB = [NSMutableString stringWithString:@"B"];
+	NSString *lastB = [NSMutableString stringWithString:@"B"];
+	[set addObjectsFromArray:@[@"C",firstB,@"E",@"A",lastB,@"D"]];
+	XCTAssertEqual([set count], [abcde count]);
+	XCTAssertEqualObjects([set allObjects], abcde);
+	XCTAssertTrue([set member:@"B"] == lastB);
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+	
+	// Bulk-built trees of many sizes must remain valid as they are modified
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger size = 1; size <= 64; size++) {
+		[numbers addObject:@(size)];
+		[set removeAllObjects];
+		[set addObjectsFromArray:[[numbers reverseObjectEnumerator] allObjects]];
+		XCTAssertEqualObjects([set allObjects], numbers);
+		if ([set respondsToSelector:@selector(verify)]) {
+			XCTAssertNoThrow([set verify]);
+			[set addObject:@(0)];
+			XCTAssertNoThrow([set verify]);
+			[set removeObject:@(size / 2)];
+			XCTAssertNoThrow([set verify]);
+		}
+	}
+}
+
+- (void)testCountOfObjectsFromObjectToObject {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertEqual([set countOfObjectsFromObject:@"A" toObject:@"E"], (NSUInteger)0);
+	[set addObjectsFromArray:abcde];
+	XCTAssertEqual([set countOfObjectsFromObject:nil toObject:nil], (NSUInteger)5);
+	XCTAssertEqual([set countOfObjectsFromObject:@"B" toObject:@"D"], (NSUInteger)3);
+	XCTAssertEqual([set countOfObjectsFromObject:@"A" toObject:@"A"], (NSUInteger)1);
+	XCTAssertEqual([set countOfObjectsFromObject:@"@" toObject:@"Z"], (NSUInteger)5);
+	XCTAssertEqual([set countOfObjectsFromObject:@"BB" toObject:@"DD"], (NSUInteger)2);
+	XCTAssertEqual([set countOfObjectsFromObject:@"BB" toObject:@"BC"], (NSUInteger)0);
+	XCTAssertEqual([set countOfObjectsFromObject:nil toObject:@"C"], (NSUInteger)3);
+	XCTAssertEqual([set countOfObjectsFromObject:@"C" toObject:nil], (NSUInteger)3);
+	XCTAssertEqual([set countOfObjectsFromObject:@"Z" toObject:nil], (NSUInteger)0);
+	// If start follows end, only objects strictly between them are excluded
+	XCTAssertEqual([set countOfObjectsFromObject:@"D" toObject:@"B"], (NSUInteger)4);
+	XCTAssertEqual([set countOfObjectsFromObject:@"DD" toObject:@"CC"], (NSUInteger)4);
+	XCTAssertEqual([set countOfObjectsFromObject:@"Z" toObject:@"@"], (NSUInteger)0);
+	// Counts should always match the subset for the same range
+	NSArray *bounds = @[@"@",@"A",@"BB",@"C",@"E",@"Z"];
+	for (id start in bounds) {
+		for (id end in bounds) {
+			if (start == end) {
+				continue; // A subset from an object to itself wraps around
+			}
+			XCTAssertEqual([set countOfObjectsFromObject:start toObject:end],
+			               [[set subsetFromObject:start toObject:end options:0] count]);
+		}
+	}
+}
+
 - (void)testDescription {
 	XCTAssertEqualObjects([set description], [[set allObjects] description]);
 }
@@ -520,120 +723,937 @@ static NSArray *abcde;
 	XCTAssertThrows([headerObject autorelease]);
 }
 
-- (void)testIsEqualToSearchTree {
-	if ([self class] != [CHAbstractBinarySearchTreeTest class]) {
+- (void)testIndexOfObject {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
 		return;
 	}
-	NSMutableArray *equalTrees = [NSMutableArray array];
-	NSArray *treeClasses = @[
-		[CHAnderssonTree class],
-		[CHAVLTree class],
-		[CHRedBlackTree class],
-		[CHTreap class],
-		[CHUnbalancedTree class],
-	];
-	for (Class theClass in treeClasses) {
-		[equalTrees addObject:[[theClass alloc] initWithArray:abcde]];
+	XCTAssertThrows([set indexOfObject:nil]);
+	XCTAssertEqual([set indexOfObject:@"A"], (NSUInteger)NSNotFound);
+	[self addObjectsIndividually:abcde toSet:set];
+	for (NSUInteger index = 0; index < [abcde count]; index++) {
+		XCTAssertEqual([set indexOfObject:[abcde objectAtIndex:index]], index);
 	}
-	// Add a repeat of the first class to avoid wrapping.
-	[equalTrees addObject:[equalTrees objectAtIndex:0]];
-	
-	NSArray *sortedSetClasses = @[
-		[CHAnderssonTree class],
-		[CHAVLTree class],
-		[CHRedBlackTree class],
-		[CHTreap class],
-		[CHUnbalancedTree class],
-	];
-	id<CHSearchTree> tree1 = nil;
-	id<CHSearchTree> tree2;
-	for (NSUInteger i = 0; i < [sortedSetClasses count]; i++) {
-		tree1 = [equalTrees objectAtIndex:i];
-		tree2 = [equalTrees objectAtIndex:i+1];
-		XCTAssertEqual([tree1 hash], [tree2 hash]);
-		XCTAssertEqualObjects(tree1, tree2);
+	XCTAssertEqual([set indexOfObject:@"BB"], (NSUInteger)NSNotFound);
+	XCTAssertEqual([set indexOfObject:@"Z"], (NSUInteger)NSNotFound);
+}
+
+- (void)testInitWithComparator {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
 	}
-	XCTAssertFalse([tree1 isEqualToSearchTree:(id)@[]]);
-	XCTAssertThrowsSpecificNamed([tree1 isEqualToSearchTree:(id)[NSString string]], NSException, NSInvalidArgumentException);
+	XCTAssertThrows([[[self classUnderTest] alloc] initWithComparator:nil]);
+	XCTAssertNil([set comparator]);
+	NSComparator descending = ^(id object1, id object2) {
+		return [object2 compare:object1];
+	};
+	set = [[[[self classUnderTest] alloc] initWithComparator:descending] autorelease];
+	XCTAssertNotNil([set comparator]);
+	NSArray *edcba = [[abcde reverseObjectEnumerator] allObjects];
+	[self addObjectsIndividually:abcde toSet:set];
+	XCTAssertEqualObjects([set allObjects], edcba);
+	XCTAssertEqualObjects([set firstObject], @"E");
+	XCTAssertEqualObjects([set member:@"C"], @"C");
+	XCTAssertNil([set member:@"Z"]);
+	XCTAssertEqual([set indexOfObject:@"D"], (NSUInteger)1);
+	XCTAssertEqualObjects([set objectAtIndex:1], @"D");
+	[set removeObject:@"D"];
+	XCTAssertEqualObjects([set allObjects], (@[@"E",@"C",@"B",@"A"]));
+	[set verifySubtreeSizes];
+	
+	// Bulk additions, copies, and subsets must use the same ordering
+	[set removeAllObjects];
+	[set addObjectsFromArray:abcde];
+	XCTAssertEqualObjects([set allObjects], edcba);
+	XCTAssertEqualObjects([[[set copy] autorelease] allObjects], edcba);
+	XCTAssertEqualObjects([[set subsetFromObject:@"D" toObject:@"B" options:0] allObjects],
+	                      (@[@"D",@"C",@"B"]));
+	XCTAssertEqualObjects([[set subsetViewFromObject:@"D" toObject:@"B" options:0] allObjects],
+	                      (@[@"D",@"C",@"B"]));
+	XCTAssertEqual([set countOfObjectsFromObject:@"D" toObject:@"B"], (NSUInteger)3);
+	
+	// Merging with a set in the opposite order must still produce the right order
+	id other = [[[[self classUnderTest] alloc] initWithArray:@[@"C",@"F",@"G"]] autorelease];
+	[set unionWithSortedSet:other];
+	XCTAssertEqualObjects([set allObjects], (@[@"G",@"F",@"E",@"D",@"C",@"B",@"A"]));
+	[set intersectWithSortedSet:other];
+	XCTAssertEqualObjects([set allObjects], (@[@"G",@"F",@"C"]));
+	
+	// Blocks can't be archived
+	XCTAssertThrows([set copyUsingNSCoding]);
 }
 
-@end
+- (void)testInitWithComparisonFunction {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertThrows([[[self classUnderTest] alloc] initWithComparisonFunction:NULL context:NULL]);
+	NSStringCompareOptions options = NSCaseInsensitiveSearch;
+	set = [[[[self classUnderTest] alloc] initWithComparisonFunction:compareStringsWithOptions
+	                                                          context:&options] autorelease];
+	XCTAssertNil([set comparator]);
+	[self addObjectsIndividually:@[@"c",@"A",@"e",@"B",@"d"] toSet:set];
+	XCTAssertEqualObjects([set allObjects], (@[@"A",@"B",@"c",@"d",@"e"]));
+	XCTAssertEqualObjects([set member:@"C"], @"c");
+	[set addObject:@"C"]; // Replaces the equal object
+	XCTAssertEqual([set count], (NSUInteger)5);
+	XCTAssertEqualObjects([set member:@"c"], @"C");
+	[set removeObject:@"b"];
+	XCTAssertEqualObjects([set allObjects], (@[@"A",@"C",@"d",@"e"]));
+	XCTAssertEqualObjects([[[set copy] autorelease] allObjects], (@[@"A",@"C",@"d",@"e"]));
+	XCTAssertThrows([set copyUsingNSCoding]);
+}
+
+- (void)testInitWithKeyPath {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertThrows([[[self classUnderTest] alloc] initWithKeyPath:nil]);
+	XCTAssertNil([set sortDescriptor]);
+	XCTAssertNil([set memberForKey:@"C"]);
+	set = [[[[self classUnderTest] alloc] initWithKeyPath:@"rank"] autorelease];
+	XCTAssertEqualObjects([[set sortDescriptor] key], @"rank");
+	NSDictionary *a = @{@"name":@"A", @"rank":@4};
+	NSDictionary *b = @{@"name":@"B", @"rank":@2};
+	NSDictionary *c = @{@"name":@"C", @"rank":@5};
+	NSDictionary *d = @{@"name":@"D", @"rank":@1};
+	NSDictionary *e = @{@"name":@"E", @"rank":@3};
+	[self addObjectsIndividually:@[a,b,c,d,e] toSet:set];
+	NSArray *ranked = @[d,b,e,a,c];
+	XCTAssertEqualObjects([set allObjects], ranked);
+	XCTAssertEqualObjects([set memberForKey:@2], b);
+	XCTAssertNil([set memberForKey:@6]);
+	XCTAssertThrows([set memberForKey:nil]);
+	XCTAssertEqualObjects([set member:@{@"rank":@5}], c);
+	XCTAssertEqualObjects([set ceilingObject:@{@"rank":@6}], nil);
+	XCTAssertEqualObjects([set floorObject:@{@"rank":@6}], c);
+	XCTAssertEqual([set indexOfObject:@{@"rank":@3}], (NSUInteger)2);
+	// An object with no value for the key path can't be ordered.
+	XCTAssertThrows([set addObject:@{@"name":@"F"}]);
+	XCTAssertEqual([set count], (NSUInteger)5);
+
+	// An object with an equal key replaces the one in the tree.
+	NSDictionary *b2 = @{@"name":@"B2", @"rank":@2};
+	[set addObject:b2];
+	XCTAssertEqual([set count], (NSUInteger)5);
+	XCTAssertEqualObjects([set memberForKey:@2], b2);
+	[set removeObject:@{@"rank":@4}];
+	ranked = @[d,b2,e,c];
+	XCTAssertEqualObjects([set allObjects], ranked);
+	[set verifySubtreeSizes];
+
+	// Copies, subsets, and archives use the same key path.
+	XCTAssertEqualObjects([[[set copy] autorelease] allObjects], ranked);
+	XCTAssertEqualObjects([[[set copy] autorelease] memberForKey:@5], c);
+	XCTAssertEqualObjects([[set subsetFromObject:b2 toObject:e options:0] allObjects], (@[b2,e]));
+	XCTAssertEqualObjects([[set subsetViewFromObject:b2 toObject:e options:0] allObjects], (@[b2,e]));
+	XCTAssertEqualObjects([[set subsetViewFromObject:e toObject:b2 options:0] allObjects], (@[d,b2,e,c]));
+	id decoded = [[set copyUsingNSCoding] autorelease];
+	XCTAssertEqualObjects([decoded allObjects], ranked);
+	XCTAssertEqualObjects([decoded memberForKey:@3], e);
+	[decoded addObject:a];
+	XCTAssertEqualObjects([decoded allObjects], (@[d,b2,e,a,c]));
+
+	// Bulk additions and merges sort by key as well.
+	[set removeAllObjects];
+	[set addObjectsFromArray:@[c,a,e,b,d]];
+	XCTAssertEqualObjects([set allObjects], (@[d,b,e,a,c]));
+	[set intersectWithSortedSet:decoded];
+	XCTAssertEqual([set count], (NSUInteger)5);
+	XCTAssertEqualObjects([set memberForKey:@4], a);
+	XCTAssertEqualObjects([set membersOfObjects:@[@{@"rank":@9},@{@"rank":@1}]], (@[[NSNull null],d]));
+}
 
-#pragma mark -
+- (void)testInitWithSortDescriptor {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertThrows([[[self classUnderTest] alloc] initWithSortDescriptor:nil]);
+	// A descending order with another selector
+	NSSortDescriptor *descriptor = [NSSortDescriptor sortDescriptorWithKey:@"uppercaseString"
+	                                                             ascending:NO
+	                                                              selector:@selector(caseInsensitiveCompare:)];
+	set = [[[[self classUnderTest] alloc] initWithSortDescriptor:descriptor] autorelease];
+	XCTAssertEqualObjects([set sortDescriptor], descriptor);
+	[self addObjectsIndividually:@[@"b",@"E",@"a",@"D",@"c"] toSet:set];
+	XCTAssertEqualObjects([set allObjects], (@[@"E",@"D",@"c",@"b",@"a"]));
+	XCTAssertEqualObjects([set memberForKey:@"C"], @"c");
+	XCTAssertEqualObjects([set member:@"d"], @"D");
+	XCTAssertEqualObjects([set objectAfter:@"D"], @"c");
+	[set removeObject:@"e"];
+	XCTAssertEqualObjects([set allObjects], (@[@"D",@"c",@"b",@"a"]));
+	XCTAssertEqualObjects([[[set copyUsingNSCoding] autorelease] allObjects], (@[@"D",@"c",@"b",@"a"]));
+
+	// A descriptor with no key compares the objects themselves.
+	descriptor = [NSSortDescriptor sortDescriptorWithKey:nil ascending:NO];
+	set = [[[[self classUnderTest] alloc] initWithSortDescriptor:descriptor] autorelease];
+	[set addObjectsFromArray:abcde];
+	XCTAssertEqualObjects([set allObjects], [[abcde reverseObjectEnumerator] allObjects]);
+	XCTAssertEqualObjects([set memberForKey:@"B"], @"B");
+
+	// A descriptor with a comparator works, but can't be archived.
+	descriptor = [NSSortDescriptor sortDescriptorWithKey:@"length" ascending:NO comparator:^(id n1, id n2) {
+		return [n1 compare:n2];
+	}];
+	set = [[[[self classUnderTest] alloc] initWithSortDescriptor:descriptor] autorelease];
+	[set addObjectsFromArray:@[@"aa",@"a",@"aaaa",@"aaa"]];
+	XCTAssertEqualObjects([set allObjects], (@[@"aaaa",@"aaa",@"aa",@"a"]));
+	XCTAssertEqualObjects([set memberForKey:@3], @"aaa");
+	XCTAssertEqualObjects([[[set copy] autorelease] memberForKey:@2], @"aa");
+	XCTAssertThrows([set copyUsingNSCoding]);
+}
+
+- (void)testMinusSortedSet {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	[set addObjectsFromArray:abcde];
+	XCTAssertThrows([set minusSortedSet:nil]);
+	id other = [[[[self classUnderTest] alloc] initWithArray:@[@"B",@"C",@"E",@"F"]] autorelease];
+	[set minusSortedSet:other];
+	XCTAssertEqualObjects([set allObjects], (@[@"A",@"D"]));
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+	[set minusSortedSet:set];
+	XCTAssertEqual([set count], (NSUInteger)0);
+}
 
-@interface CHAnderssonTreeTest : CHAbstractBinarySearchTreeTest
-@end
+- (void)testObjectAtIndex {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertThrowsSpecificNamed([set objectAtIndex:0], NSException, NSRangeException);
+	[self addObjectsIndividually:abcde toSet:set];
+	for (NSUInteger index = 0; index < [abcde count]; index++) {
+		XCTAssertEqualObjects([set objectAtIndex:index], [abcde objectAtIndex:index]);
+	}
+	XCTAssertThrowsSpecificNamed([set objectAtIndex:[abcde count]], NSException, NSRangeException);
+}
 
-@implementation CHAnderssonTreeTest
+- (void)testObjectEnumeratorFromObject {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertThrows([set objectEnumeratorFromObject:nil]);
+	XCTAssertThrows([set reverseObjectEnumeratorFromObject:nil]);
+	XCTAssertEqualObjects([[set objectEnumeratorFromObject:@"A"] allObjects], @[]);
+	
+	[set addObjectsFromArray:@[@"B",@"D",@"F",@"H"]];
+	XCTAssertEqualObjects([[set objectEnumeratorFromObject:@"A"] allObjects], (@[@"B",@"D",@"F",@"H"]));
+	XCTAssertEqualObjects([[set objectEnumeratorFromObject:@"D"] allObjects], (@[@"D",@"F",@"H"]));
+	XCTAssertEqualObjects([[set objectEnumeratorFromObject:@"E"] allObjects], (@[@"F",@"H"]));
+	XCTAssertEqualObjects([[set objectEnumeratorFromObject:@"I"] allObjects], @[]);
+	XCTAssertEqualObjects([[set reverseObjectEnumeratorFromObject:@"A"] allObjects], @[]);
+	XCTAssertEqualObjects([[set reverseObjectEnumeratorFromObject:@"D"] allObjects], (@[@"D",@"B"]));
+	XCTAssertEqualObjects([[set reverseObjectEnumeratorFromObject:@"E"] allObjects], (@[@"D",@"B"]));
+	XCTAssertEqualObjects([[set reverseObjectEnumeratorFromObject:@"I"] allObjects], (@[@"H",@"F",@"D",@"B"]));
+	
+	NSEnumerator *e = [set objectEnumeratorFromObject:@"C"];
+	XCTAssertEqualObjects([e nextObject], @"D");
+	[set addObject:@"E"];
+	XCTAssertThrowsSpecificNamed([e nextObject], NSException, NSGenericException);
+}
 
-- (Class)classUnderTest {
-	return [CHAnderssonTree class];
+- (void)testSetOperationsOnLargeSets {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	// Large enough to merge concurrently, and to search individually for a few
+	NSMutableArray *evens = [NSMutableArray array];
+	NSMutableArray *triples = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 40000; i++) {
+		[evens addObject:@(i * 2)];
+		[triples addObject:@(i * 3)];
+	}
+	NSArray *few = @[@(-1),@(6),@(7),@(60000)];
+	id tripleSet = [[[[self classUnderTest] alloc] initWithArray:triples] autorelease];
+	id fewSet = [[[[self classUnderTest] alloc] initWithArray:few] autorelease];
+	NSArray *operations = @[@"unionWithSortedSet:",@"intersectWithSortedSet:",@"minusSortedSet:"];
+	for (NSString *operation in operations) {
+		for (id other in @[tripleSet, fewSet]) {
+			[set removeAllObjects];
+			[set addObjectsFromArray:evens];
+			[set objectAtIndex:0]; // Sizes must be correct after rebuilding
+			[set performSelector:NSSelectorFromString(operation) withObject:other];
+			// Compare with the same operation on an NSMutableSet
+			NSMutableSet *expected = [NSMutableSet setWithArray:evens];
+			if ([operation hasPrefix:@"union"]) {
+				[expected unionSet:[other set]];
+			} else if ([operation hasPrefix:@"intersect"]) {
+				[expected intersectSet:[other set]];
+			} else {
+				[expected minusSet:[other set]];
+			}
+			XCTAssertEqualObjects([set allObjects],
+			                      [[expected allObjects] sortedArrayUsingSelector:@selector(compare:)]);
+			XCTAssertNoThrow([set verifySubtreeSizes]);
+			if ([set respondsToSelector:@selector(verify)]) {
+				XCTAssertNoThrow([set verify]);
+			}
+		}
+	}
+	XCTAssertEqual([tripleSet count], [triples count]); // Arguments are unchanged
+	XCTAssertEqual([fewSet count], [few count]);
 }
 
-- (void)setUp {
-	set = [self createSet];
-	objects = @[@"B",@"N",@"C",@"L",@"D",@"J",@"E",@"H",@"K",@"M",@"O",@"G",@"A",@"I",@"F"];
-	// When inserted in this order, creates the tree from: Weiss pg. 645
+- (void)testSubtreeSizesAfterModification {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 100; i++) {
+		[numbers addObject:@(i * 37 % 101)];
+	}
+	[set addObjectsFromArray:numbers];
+	[set setTracksSubtreeSizes:YES];
+	XCTAssertEqualObjects([set objectAtIndex:0], [set firstObject]);
+	XCTAssertNoThrow([set verifySubtreeSizes]);
+	// Sizes must stay correct through every kind of insertion and removal.
+	for (NSUInteger i = 0; i < 100; i++) {
+		[set removeObject:@(i * 53 % 101)];
+		[set addObject:@(i * 31 % 151)];
+		[set addObject:@(i * 31 % 151)]; // Replaces the existing object
+		XCTAssertNoThrow([set verifySubtreeSizes]);
+		if ([set respondsToSelector:@selector(verify)]) {
+			XCTAssertNoThrow([set verify]);
+		}
+	}
+	NSArray *allObjects = [set allObjects];
+	for (NSUInteger index = 0; index < [allObjects count]; index++) {
+		XCTAssertEqualObjects([set objectAtIndex:index], [allObjects objectAtIndex:index]);
+		XCTAssertEqual([set indexOfObject:[allObjects objectAtIndex:index]], index);
+	}
+	while ([set count] > 0) {
+		[set removeObject:[set objectAtIndex:[set count] / 2]];
+		XCTAssertNoThrow([set verifySubtreeSizes]);
+	}
 }
 
-- (void)testAddObject {
-	XCTAssertEqual([set count], 0);
-	XCTAssertThrows([set addObject:nil]);
-	XCTAssertEqual([set count], 0);
-	
-	[set addObjectsFromArray:objects];
-	XCTAssertEqual([set count], [objects count]);
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderAscending],
-						 (@[@"A",@"B",@"C",@"D",@"E",@"F",@"G",@"H",@"I",@"J",@"K",@"L",@"M",@"N",@"O"]));
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderDescending],
-						 (@[@"O",@"N",@"M",@"L",@"K",@"J",@"I",@"H",@"G",@"F",@"E",@"D",@"C",@"B",@"A"]));
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
-						 (@[@"E",@"C",@"A",@"B",@"D",@"L",@"H",@"F",@"G",@"J",@"I",@"K",@"N",@"M",@"O"]));
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPostOrder],
-						 (@[@"B",@"A",@"D",@"C",@"G",@"F",@"I",@"K",@"J",@"H",@"M",@"O",@"N",@"L",@"E"]));
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
-						 (@[@"E",@"C",@"L",@"A",@"D",@"H",@"N",@"B",@"F",@"J",@"M",@"O",@"G",@"I",@"K"]));
+- (void)testPositionalQueriesWithoutSubtreeSizes {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	for (NSUInteger i = 0; i < 100; i++) {
+		[set addObject:@(i * 37 % 101)];
+	}
+	// Queries walk the tree instead, and don't start tracking sizes.
+	NSArray *allObjects = [set allObjects];
+	for (NSUInteger index = 0; index < [allObjects count]; index++) {
+		XCTAssertEqualObjects([set objectAtIndex:index], [allObjects objectAtIndex:index]);
+		XCTAssertEqual([set indexOfObject:[allObjects objectAtIndex:index]], index);
+	}
+	XCTAssertEqual([set indexOfObject:@1000], (NSUInteger)NSNotFound);
+	XCTAssertEqual([set countOfObjectsFromObject:@10 toObject:@19], (NSUInteger)10);
+	XCTAssertEqual([set countOfObjectsFromObject:@90 toObject:@9], (NSUInteger)21);
+	XCTAssertEqual([set countOfObjectsFromObject:@(-1) toObject:nil], [set count]);
+	XCTAssertFalse([set tracksSubtreeSizes]);
+	// Turning tracking on and off again doesn't change the answers.
+	[set setTracksSubtreeSizes:YES];
+	XCTAssertTrue([set tracksSubtreeSizes]);
+	XCTAssertNoThrow([set verifySubtreeSizes]);
+	XCTAssertEqual([set countOfObjectsFromObject:@90 toObject:@9], (NSUInteger)21);
+	XCTAssertTrue([[[set copy] autorelease] tracksSubtreeSizes]);
+	[set setTracksSubtreeSizes:NO];
+	[set removeObject:@50];
+	XCTAssertEqualObjects([set objectAtIndex:50], @51);
+	XCTAssertEqual([set indexOfObject:@51], (NSUInteger)50);
+}
+
+- (void)testCopyPreservesShape {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	for (NSUInteger i = 0; i < 200; i++) {
+		[set addObject:@(i * 37 % 211)];
+		if (i % 3 == 0) {
+			[set removeObject:@(i * 53 % 211)];
+		}
+	}
+	[set setTracksSubtreeSizes:YES];
+	XCTAssertEqualObjects([set objectAtIndex:0], [set firstObject]);
+	// The DOT graph includes each node's balancing data, such as its color.
+	NSString *graph = [set dotGraphString];
+	id copy = [[set copy] autorelease];
+	id decoded = [[set copyUsingNSCoding] autorelease];
+	for (id tree in @[copy, decoded]) {
+		XCTAssertEqualObjects([tree dotGraphString], graph);
+		XCTAssertEqual([tree count], [set count]);
+		XCTAssertNoThrow([tree verifyParentLinks]);
+		XCTAssertNoThrow([tree verifySubtreeSizes]);
+		// Copies must remain valid trees as they are modified.
+		for (NSUInteger i = 0; i < 100; i++) {
+			[tree removeObject:@(i * 31 % 211)];
+			[tree addObject:@(i * 43 % 223)];
+		}
+		if ([tree respondsToSelector:@selector(verify)]) {
+			XCTAssertNoThrow([tree verify]);
+		}
+		XCTAssertNoThrow([tree verifyParentLinks]);
+		XCTAssertNoThrow([tree verifySubtreeSizes]);
+	}
+	XCTAssertEqualObjects([set dotGraphString], graph); // The original is unchanged
 	
-	// Test adding identical object--should be replaced, and count stay the same
-	[set addObject:@"A"];
-	XCTAssertEqual([set count], [objects count]);
+	// Subset views are archived without a shape, so the tree is rebuilt.
+	id<CHSortedSet> view = [set subsetViewFromObject:@50 toObject:@150 options:0];
+	decoded = [[(id)view copyUsingNSCoding] autorelease];
+	XCTAssertTrue([decoded isKindOfClass:[self classUnderTest]]);
+	XCTAssertEqualObjects([decoded allObjects], [view allObjects]);
+	XCTAssertNoThrow([decoded verifyParentLinks]);
 }
 
-- (void)testDebugDescriptionForNode {
-	CHBinaryTreeNode *node = malloc(sizeof(CHBinaryTreeNode));
-	node->object = @"A B C";
-	node->level = 1;
-	XCTAssertEqualObjects([set debugDescriptionForNode:node],
-						 @"[1]\t\"A B C\"");
-	free(node);
+- (void)testCompact {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertNoThrow([set compact]);
+	XCTAssertEqual([set count], 0);
+	for (NSUInteger i = 0; i < 200; i++) {
+		[set addObject:@(i * 37 % 211)];
+		if (i % 3 == 0) {
+			[set removeObject:@(i * 53 % 211)];
+		}
+	}
+	[set setTracksSubtreeSizes:YES];
+	XCTAssertEqualObjects([set objectAtIndex:0], [set firstObject]);
+	NSString *graph = [set dotGraphString];
+	NSArray *allObjects = [set allObjects];
+	NSEnumerator *e = [set objectEnumerator];
+	XCTAssertEqualObjects([e nextObject], [allObjects firstObject]);
+	[set compact];
+	XCTAssertThrowsSpecificNamed([e nextObject], NSException, NSGenericException);
+	// Nodes move, but the shape and balancing data don't change.
+	XCTAssertEqualObjects([set dotGraphString], graph);
+	XCTAssertEqualObjects([set allObjects], allObjects);
+	XCTAssertEqualObjects([[set reverseObjectEnumerator] allObjects],
+	                      [[allObjects reverseObjectEnumerator] allObjects]);
+	XCTAssertNoThrow([set verifyParentLinks]);
+	XCTAssertNoThrow([set verifySubtreeSizes]);
+	for (id anObject in allObjects) {
+		XCTAssertEqual([set member:anObject], anObject);
+	}
+	// A compacted tree can still be modified.
+	for (NSUInteger i = 0; i < 100; i++) {
+		[set removeObject:@(i * 31 % 211)];
+		[set addObject:@(i * 43 % 223)];
+	}
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+	XCTAssertNoThrow([set verifyParentLinks]);
+	XCTAssertNoThrow([set verifySubtreeSizes]);
+	allObjects = [set allObjects];
+	[set compact];
+	XCTAssertEqualObjects([set allObjects], allObjects);
+	for (NSUInteger index = 0; index < [allObjects count]; index++) {
+		XCTAssertEqual([set indexOfObject:[allObjects objectAtIndex:index]], index);
+	}
 }
 
-- (void)testDotGraphStringForNode {
-	CHBinaryTreeNode *node = malloc(sizeof(CHBinaryTreeNode));
-	node->object = @"A B C";
-	node->level = 1;
-	XCTAssertEqualObjects([set dotGraphStringForNode:node],
-						 @"  \"A B C\" [label=\"A B C\\n1\"];\n");
-	free(node);
+- (void)testParentLinksAfterModification {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 100; i++) {
+		[numbers addObject:@(i * 37 % 101)];
+	}
+	[set addObjectsFromArray:numbers];
+	XCTAssertNoThrow([set verifyParentLinks]);
+	NSMutableSet *contents = [NSMutableSet setWithArray:numbers];
+	for (NSUInteger i = 0; i < 100; i++) {
+		[set removeObject:@(i * 53 % 101)];
+		[contents removeObject:@(i * 53 % 101)];
+		[set addObject:@(i * 31 % 151)];
+		[contents addObject:@(i * 31 % 151)];
+		XCTAssertNoThrow([set verifyParentLinks]);
+	}
+	// Enumeration follows parent links, so check it against the contents too.
+	NSArray *expected = [[contents allObjects] sortedArrayUsingSelector:@selector(compare:)];
+	XCTAssertEqualObjects([[set objectEnumerator] allObjects], expected);
+	XCTAssertEqualObjects([[set reverseObjectEnumerator] allObjects],
+	                      [[expected reverseObjectEnumerator] allObjects]);
+	NSMutableArray *fastEnumerated = [NSMutableArray array];
+	for (id anObject in set) {
+		[fastEnumerated addObject:anObject];
+	}
+	XCTAssertEqualObjects(fastEnumerated, expected);
+	while ([set count] > 0) {
+		[set removeObject:[set objectAtIndex:[set count] / 2]];
+		XCTAssertNoThrow([set verifyParentLinks]);
+	}
 }
 
-- (void)testRemoveObject {
-	XCTAssertThrows([set removeObject:nil]);
-	XCTAssertNoThrow([set removeObject:@"bogus"]);
-	[set addObjectsFromArray:objects];
-	XCTAssertThrows([set removeObject:nil]);
-	XCTAssertNoThrow([set removeObject:@"bogus"]);
-	XCTAssertEqual([set count], [objects count]);
+- (void)testMembersOfObjects {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertThrows([set membersOfObjects:nil]);
+	XCTAssertThrows([set containsObjects:nil]);
+	XCTAssertEqualObjects([set membersOfObjects:@[@1,@2]], (@[[NSNull null],[NSNull null]]));
+	XCTAssertEqual([[set containsObjects:@[@1]] count], 0);
 	
-	[set removeObject:@"J"];
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
-						 (@[@"E",@"C",@"L",@"A",@"D",@"H",@"N",@"B",@"F",@"I",@"M",@"O",@"G",@"K"]));
-	[set removeObject:@"N"];
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
-						 (@[@"E",@"C",@"H",@"A",@"D",@"F",@"L",@"B",@"G",@"I",@"M",@"K",@"O"]));
-	[set removeObject:@"H"];
-	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
-						 (@[@"E",@"C",@"I",@"A",@"D",@"F",@"L",@"B",@"G",@"K",@"M",@"O"]));
+	for (NSUInteger i = 0; i < 1000; i += 2) {
+		[set addObject:@(i)];
+	}
+	// A few objects are searched for separately, and many in a single sweep.
+	for (NSUInteger probeCount = 10; probeCount <= 2000; probeCount *= 20) {
+		NSMutableArray *probes = [NSMutableArray array];
+		NSMutableArray *expected = [NSMutableArray array];
+		NSMutableIndexSet *expectedIndexes = [NSMutableIndexSet indexSet];
+		for (NSUInteger i = 0; i < probeCount; i++) {
+			NSNumber *probe = @(arc4random_uniform(1100));
+			id member = [set member:probe];
+			[probes addObject:probe];
+			[expected addObject:(member != nil) ? member : [NSNull null]];
+			if (member != nil) {
+				[expectedIndexes addIndex:i];
+			}
+		}
+		XCTAssertEqualObjects([set membersOfObjects:probes], expected);
+		XCTAssertEqualObjects([set containsObjects:probes], expectedIndexes);
+	}
+	// The members are the receiver's objects, not the equal objects searched for.
+	NSString *b = [NSMutableString stringWithString:@"B"];
+	[set removeAllObjects];
+	[set addObjectsFromArray:@[b,@"D"]];
+	NSArray *members = [set membersOfObjects:@[@"D",@"B",@"C"]];
+	XCTAssertEqualObjects(members, (@[@"D",@"B",[NSNull null]]));
+	XCTAssertTrue([members objectAtIndex:1] == b);
+}
+
+- (void)testCachesKeyPrefixes {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertFalse([set cachesKeyPrefixes]);
+	// Strings that share long prefixes, or have no prefix, are compared in full.
+	NSArray *strings = @[@"", @"a", @"aaaaaaaa", @"aaaaaaaab", @"aaaaaaaaa", @"abcdefgh",
+	                     @"abcdefghij", @"B", @"café", @"cafés", @"cafes", @"été",
+	                     @"zebra", @"Zebra", @"aé", @"ab"];
+	id plain = [[[[self classUnderTest] alloc] init] autorelease];
+	[plain addObjectsFromArray:strings];
+	[set setCachesKeyPrefixes:YES];
+	XCTAssertTrue([set cachesKeyPrefixes]);
+	[self addObjectsIndividually:strings toSet:set];
+	XCTAssertEqualObjects([set allObjects], [plain allObjects]);
+	for (NSString *string in strings) {
+		XCTAssertEqualObjects([set member:string], [plain member:string]);
+		XCTAssertEqualObjects([set ceilingObject:[string stringByAppendingString:@"a"]],
+		                      [plain ceilingObject:[string stringByAppendingString:@"a"]]);
+		XCTAssertEqual([set indexOfObject:string], [plain indexOfObject:string]);
+	}
+	XCTAssertEqualObjects([set membersOfObjects:strings], [plain membersOfObjects:strings]);
+	[set removeObject:@"abcdefgh"];
+	[plain removeObject:@"abcdefgh"];
+	XCTAssertEqualObjects([set allObjects], [plain allObjects]);
+	XCTAssertNil([set member:@"abcdefgh"]);
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+	// Copies and archives keep prefixes; turning them off keeps the objects.
+	XCTAssertTrue([[[set copy] autorelease] cachesKeyPrefixes]);
+	XCTAssertTrue([[[set copyUsingNSCoding] autorelease] cachesKeyPrefixes]);
+	XCTAssertEqualObjects([[[set copyUsingNSCoding] autorelease] allObjects], [plain allObjects]);
+	[set setCachesKeyPrefixes:NO];
+	XCTAssertEqualObjects([set allObjects], [plain allObjects]);
+	XCTAssertEqualObjects([set member:@"zebra"], @"zebra");
+
+	// Numbers of different types are ordered by value, including negative ones.
+	NSArray *numbers = @[@-1e300, @-2, @-1.5, @-0.0, @0, @0.25, @1, @(1ULL << 62), @1e300, @(-(1LL << 62))];
+	[set removeAllObjects];
+	[plain removeAllObjects];
+	[plain addObjectsFromArray:numbers];
+	[set addObjectsFromArray:numbers];
+	[set setCachesKeyPrefixes:YES];
+	XCTAssertEqualObjects([set allObjects], [plain allObjects]);
+	for (NSUInteger i = 0; i < 200; i++) {
+		NSNumber *number = @((double)arc4random_uniform(2000) - 1000.5);
+		[set addObject:number];
+		[plain addObject:number];
+	}
+	XCTAssertEqualObjects([set allObjects], [plain allObjects]);
+	XCTAssertEqualObjects([set member:@-2], @-2);
+	XCTAssertEqualObjects([set floorObject:@0.5], @0.25);
+	XCTAssertEqual([set indexOfObject:@1], [plain indexOfObject:@1]);
+
+	// Prefixes follow only the order of -compare:
+	id descending = [[[[self classUnderTest] alloc] initWithComparator:^(id obj1, id obj2) {
+		return [obj2 compare:obj1];
+	}] autorelease];
+	XCTAssertThrows([descending setCachesKeyPrefixes:YES]);
+	XCTAssertNoThrow([descending setCachesKeyPrefixes:NO]);
+	// Keys found by a key path are cached, rather than the objects.
+	set = [[[[self classUnderTest] alloc] initWithKeyPath:@"name"] autorelease];
+	[set setCachesKeyPrefixes:YES];
+	NSDictionary *a = @{@"name":@"Ada Lovelace"}, *b = @{@"name":@"Ada Lovelock"};
+	[set addObjectsFromArray:@[b,a]];
+	XCTAssertEqualObjects([set allObjects], (@[a,b]));
+	XCTAssertEqualObjects([set memberForKey:@"Ada Lovelock"], b);
+}
+
+- (void)testAddObjectsInNearlyAscendingOrder {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	// Every 20th number arrives late, and so is inserted behind the greatest.
+	NSMutableArray *numbers = [NSMutableArray array];
+	NSMutableArray *late = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 500; i++) {
+		if (i % 20 == 7) {
+			[late addObject:@(i)];
+		} else {
+			[numbers addObject:@(i)];
+		}
+		if (i % 20 == 19 || (i % 50 == 0 && [late count] > 1)) {
+			[numbers addObjectsFromArray:late];
+			[late removeAllObjects];
+		}
+		if (i == 250) {
+			[numbers addObject:@50]; // Far from the end
+		}
+	}
+	[numbers addObjectsFromArray:late];
+	for (NSUInteger i = 0; i < [numbers count]; i++) {
+		[set addObject:[numbers objectAtIndex:i]];
+		if (i == 100) {
+			[set setTracksSubtreeSizes:YES];
+			XCTAssertEqualObjects([set objectAtIndex:0], [set firstObject]);
+		}
+		if (i % 25 == 0) {
+			XCTAssertNoThrow([set verifyParentLinks]);
+			XCTAssertNoThrow([set verifySubtreeSizes]);
+			if ([set respondsToSelector:@selector(verify)]) {
+				XCTAssertNoThrow([set verify]);
+			}
+		}
+	}
+	XCTAssertEqual([set count], 500);
+	for (NSUInteger i = 0; i < 500; i++) {
+		XCTAssertEqualObjects([set objectAtIndex:i], @(i));
+		XCTAssertEqual([set indexOfObject:@(i)], i);
+	}
+	// Once the greatest object is removed, insertions must still find their place.
+	[set removeLastObject];
+	[set addObject:@600];
+	[set addObject:@499];
+	[set addObject:@550];
+	XCTAssertEqualObjects([set lastObject], @600);
+	XCTAssertEqual([set indexOfObject:@550], 500);
+	XCTAssertNoThrow([set verifyParentLinks]);
+	XCTAssertNoThrow([set verifySubtreeSizes]);
+}
+
+- (void)testRemoveFirstAndLastObject {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 100; i++) {
+		[numbers addObject:@(i * 37 % 101)];
+	}
+	[self addObjectsIndividually:numbers toSet:set];
+	NSMutableArray *expected = [[[numbers sortedArrayUsingSelector:@selector(compare:)] mutableCopy] autorelease];
+	[set setTracksSubtreeSizes:YES];
+	XCTAssertEqualObjects([set objectAtIndex:0], [set firstObject]);
+	// Use the tree as a double-ended priority queue.
+	while ([expected count] > 0) {
+		if ([expected count] % 3 == 0) {
+			XCTAssertEqualObjects([set lastObject], [expected lastObject]);
+			[set removeLastObject];
+			[expected removeLastObject];
+		} else {
+			XCTAssertEqualObjects([set firstObject], [expected firstObject]);
+			[set removeFirstObject];
+			[expected removeObjectAtIndex:0];
+		}
+		XCTAssertEqual([set count], [expected count]);
+		XCTAssertNoThrow([set verifySubtreeSizes]);
+		XCTAssertNoThrow([set verifyParentLinks]);
+		if ([set respondsToSelector:@selector(verify)]) {
+			XCTAssertNoThrow([set verify]);
+		}
+	}
+	XCTAssertNoThrow([set removeFirstObject]);
+	XCTAssertNoThrow([set removeLastObject]);
+}
+
+- (void)testRemoveFirstObjects {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	NSMutableArray *expected = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 40; i++) {
+		[expected addObject:@(i)];
+	}
+	[set addObjectsFromArray:expected];
+	XCTAssertEqualObjects([set removeFirstObjects:0], @[]);
+	XCTAssertEqual([set count], 40);
+	// Removed one at a time, then by rebuilding the tree from those that remain.
+	for (NSNumber *n in @[@3, @10, @20]) {
+		NSRange range = NSMakeRange(0, [n unsignedIntegerValue]);
+		XCTAssertEqualObjects([set removeFirstObjects:range.length], [expected subarrayWithRange:range]);
+		[expected removeObjectsInRange:range];
+		XCTAssertEqualObjects([set allObjects], expected);
+		XCTAssertNoThrow([set verifyParentLinks]);
+		if ([set respondsToSelector:@selector(verify)]) {
+			XCTAssertNoThrow([set verify]);
+		}
+	}
+	[set addObject:@(100)];
+	[expected addObject:@(100)];
+	XCTAssertEqualObjects([set removeFirstObjects:100], expected);
+	XCTAssertEqual([set count], 0);
+	XCTAssertEqualObjects([set removeFirstObjects:1], @[]);
+}
+
+- (void)testUnionWithSortedSet {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	XCTAssertThrows([set unionWithSortedSet:nil]);
+	id other = [[[[self classUnderTest] alloc] initWithArray:@[@"B",@"D"]] autorelease];
+	[set unionWithSortedSet:other];
+	XCTAssertEqualObjects([set allObjects], (@[@"B",@"D"]));
+	
+	[set addObject:@"C"];
+	NSString *c = [NSMutableString stringWithString:@"C"];
+	other = [[[[self classUnderTest] alloc] initWithArray:@[@"A",c,@"E",@"F"]] autorelease];
+	[set unionWithSortedSet:other];
+	XCTAssertEqualObjects([set allObjects], (@[@"A",@"B",@"C",@"D",@"E",@"F"]));
+	XCTAssertTrue([set member:@"C"] == c); // Objects from the argument replace others
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+	[set unionWithSortedSet:set];
+	XCTAssertEqual([set count], (NSUInteger)6);
+}
+
+- (void)testSubsetViewFromObjectToObject {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	NSArray *acdeg = @[@"A",@"C",@"D",@"E",@"G"];
+	[set addObjectsFromArray:acdeg];
+	id<CHSortedSet> view;
+	
+	// A view should always have the same contents as the equivalent subset
+	NSArray *bounds = @[[NSNull null],@"",@"A",@"B",@"D",@"G",@"H"];
+	for (id start in bounds) {
+		for (id end in bounds) {
+			for (CHSubsetConstructionOptions o = 0; o <= 3; o++) {
+				id low = (start == [NSNull null]) ? nil : start;
+				id high = (end == [NSNull null]) ? nil : end;
+				id<CHSortedSet> subset = [set subsetFromObject:low toObject:high options:o];
+				view = [set subsetViewFromObject:low toObject:high options:o];
+				XCTAssertEqualObjects([view allObjects], [subset allObjects]);
+				XCTAssertEqualObjects([[view reverseObjectEnumerator] allObjects],
+				                      [[subset reverseObjectEnumerator] allObjects]);
+				XCTAssertEqual([view count], [subset count]);
+				XCTAssertEqualObjects([view firstObject], [subset firstObject]);
+				XCTAssertEqualObjects([view lastObject], [subset lastObject]);
+				XCTAssertEqualObjects(view, subset);
+				for (id anObject in acdeg) {
+					XCTAssertEqual([view containsObject:anObject], [subset containsObject:anObject]);
+				}
+				for (id probe in @[@"",@"A",@"B",@"C",@"D",@"F",@"G",@"H"]) {
+					XCTAssertEqualObjects([view floorObject:probe], [subset floorObject:probe]);
+					XCTAssertEqualObjects([view ceilingObject:probe], [subset ceilingObject:probe]);
+					XCTAssertEqualObjects([view objectBefore:probe], [subset objectBefore:probe]);
+					XCTAssertEqualObjects([view objectAfter:probe], [subset objectAfter:probe]);
+				}
+			}
+		}
+	}
+	
+	view = [set subsetViewFromObject:@"B" toObject:@"E" options:0];
+	NSMutableArray *enumerated = [NSMutableArray array];
+	for (id anObject in view) {
+		[enumerated addObject:anObject];
+	}
+	XCTAssertEqualObjects(enumerated, (@[@"C",@"D",@"E"]));
+	XCTAssertNil([view member:@"A"]);
+	XCTAssertNil([view member:@"DD"]);
+	XCTAssertEqualObjects([view member:@"D"], @"D");
+	XCTAssertThrows([view member:nil]);
+	
+	// A copy is an independent tree of the same class
+	id copy = [[view copy] autorelease];
+	XCTAssertEqualObjects([copy class], [set class]);
+	XCTAssertEqualObjects([copy allObjects], (@[@"C",@"D",@"E"]));
+	
+	// The view can't be modified, and is invalidated by changes to the tree
+	XCTAssertThrows([view addObject:@"F"]);
+	XCTAssertThrows([view removeObject:@"C"]);
+	XCTAssertThrows([view removeAllObjects]);
+	NSEnumerator *e = [view objectEnumerator];
+	[set addObject:@"F"];
+	XCTAssertThrowsSpecificNamed([view count], NSException, NSGenericException);
+	XCTAssertThrowsSpecificNamed([view allObjects], NSException, NSGenericException);
+	XCTAssertThrowsSpecificNamed([e nextObject], NSException, NSGenericException);
+	XCTAssertEqualObjects([copy allObjects], (@[@"C",@"D",@"E"]));
+	XCTAssertEqualObjects([[set subsetViewFromObject:@"B" toObject:@"F" options:0] allObjects],
+	                      (@[@"C",@"D",@"E",@"F"]));
+}
+
+- (void)testIntersectWithSortedSet {
+	if ([self class] == [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	[set addObjectsFromArray:abcde];
+	[set intersectWithSortedSet:set];
+	XCTAssertEqualObjects([set allObjects], abcde);
+	XCTAssertThrows([set intersectWithSortedSet:nil]);
+	
+	NSString *c = [NSMutableString stringWithString:@"C"];
+	id other = [[[[self classUnderTest] alloc] initWithArray:@[@"B",c,@"E",@"F"]] autorelease];
+	[set intersectWithSortedSet:other];
+	XCTAssertEqualObjects([set allObjects], (@[@"B",@"C",@"E"]));
+	XCTAssertTrue([set member:@"C"] != c); // The receiver's objects are kept
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+	[set intersectWithSortedSet:[[[[self classUnderTest] alloc] init] autorelease]];
+	XCTAssertEqual([set count], (NSUInteger)0);
+
+	// A small set in the opposite order, several of whose objects match the same
+	// object in the receiver, which compares only the integer part.
+	set = [[[[self classUnderTest] alloc] initWithComparator:^(id obj1, id obj2) {
+		return [@([obj1 integerValue]) compare:@([obj2 integerValue])];
+	}] autorelease];
+	for (NSUInteger i = 0; i < 1000; i++) {
+		[set addObject:@(i)];
+	}
+	other = [[[[self classUnderTest] alloc] initWithComparator:^(id obj1, id obj2) {
+		return [obj2 compare:obj1];
+	}] autorelease];
+	[other addObjectsFromArray:@[@900, @3.5, @3.25, @3, @1, @2000, @500.75]];
+	[set intersectWithSortedSet:other];
+	XCTAssertEqualObjects([set allObjects], (@[@1, @3, @500, @900]));
+	XCTAssertEqual([set count], (NSUInteger)4);
+	XCTAssertEqualObjects([set member:@500], @500);
+	if ([set respondsToSelector:@selector(verify)]) {
+		XCTAssertNoThrow([set verify]);
+	}
+}
+
+- (void)testIsEqualToSearchTree {
+	if ([self class] != [CHAbstractBinarySearchTreeTest class]) {
+		return;
+	}
+	NSMutableArray *equalTrees = [NSMutableArray array];
+	NSArray *treeClasses = @[
+		[CHAnderssonTree class],
+		[CHAVLTree class],
+		[CHRedBlackTree class],
+		[CHScapegoatTree class],
+		[CHSplayTree class],
+		[CHTreap class],
+		[CHUnbalancedTree class],
+	];
+	for (Class theClass in treeClasses) {
+		[equalTrees addObject:[[theClass alloc] initWithArray:abcde]];
+	}
+	// Add a repeat of the first class to avoid wrapping.
+	[equalTrees addObject:[equalTrees objectAtIndex:0]];
+	
+	NSArray *sortedSetClasses = @[
+		[CHAnderssonTree class],
+		[CHAVLTree class],
+		[CHRedBlackTree class],
+		[CHScapegoatTree class],
+		[CHSplayTree class],
+		[CHTreap class],
+		[CHUnbalancedTree class],
+	];
+	id<CHSearchTree> tree1 = nil;
+	id<CHSearchTree> tree2;
+	for (NSUInteger i = 0; i < [sortedSetClasses count]; i++) {
+		tree1 = [equalTrees objectAtIndex:i];
+		tree2 = [equalTrees objectAtIndex:i+1];
+		XCTAssertEqual([tree1 hash], [tree2 hash]);
+		XCTAssertEqualObjects(tree1, tree2);
+	}
+	XCTAssertFalse([tree1 isEqualToSearchTree:(id)@[]]);
+	XCTAssertThrowsSpecificNamed([tree1 isEqualToSearchTree:(id)[NSString string]], NSException, NSInvalidArgumentException);
+}
+
+@end
+
+#pragma mark -
+
+@interface CHAnderssonTreeTest : CHAbstractBinarySearchTreeTest
+@end
+
+@implementation CHAnderssonTreeTest
+
+- (Class)classUnderTest {
+	return [CHAnderssonTree class];
+}
+
+- (void)setUp {
+	set = [self createSet];
+	objects = @[@"B",@"N",@"C",@"L",@"D",@"J",@"E",@"H",@"K",@"M",@"O",@"G",@"A",@"I",@"F"];
+	// When inserted in this order, creates the tree from: Weiss pg. 645
+}
+
+- (void)testAddObject {
+	XCTAssertEqual([set count], 0);
+	XCTAssertThrows([set addObject:nil]);
+	XCTAssertEqual([set count], 0);
+	
+	[self addObjectsIndividually:objects toSet:set];
+	XCTAssertEqual([set count], [objects count]);
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderAscending],
+						 (@[@"A",@"B",@"C",@"D",@"E",@"F",@"G",@"H",@"I",@"J",@"K",@"L",@"M",@"N",@"O"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderDescending],
+						 (@[@"O",@"N",@"M",@"L",@"K",@"J",@"I",@"H",@"G",@"F",@"E",@"D",@"C",@"B",@"A"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"E",@"C",@"A",@"B",@"D",@"L",@"H",@"F",@"G",@"J",@"I",@"K",@"N",@"M",@"O"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPostOrder],
+						 (@[@"B",@"A",@"D",@"C",@"G",@"F",@"I",@"K",@"J",@"H",@"M",@"O",@"N",@"L",@"E"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
+						 (@[@"E",@"C",@"L",@"A",@"D",@"H",@"N",@"B",@"F",@"J",@"M",@"O",@"G",@"I",@"K"]));
+	
+	// Test adding identical object--should be replaced, and count stay the same
+	[set addObject:@"A"];
+	XCTAssertEqual([set count], [objects count]);
+}
+
+- (void)testDebugDescriptionForNode {
+	CHBinaryTreeNode *node = malloc(sizeof(CHBinaryTreeNode));
+	node->object = @"A B C";
+	node->level = 1;
+	XCTAssertEqualObjects([set debugDescriptionForNode:node],
+						 @"[1]\t\"A B C\"");
+	free(node);
+}
+
+- (void)testDotGraphStringForNode {
+	CHBinaryTreeNode *node = malloc(sizeof(CHBinaryTreeNode));
+	node->object = @"A B C";
+	node->level = 1;
+	XCTAssertEqualObjects([set dotGraphStringForNode:node],
+						 @"  \"A B C\" [label=\"A B C\\n1\"];\n");
+	free(node);
+}
+
+- (void)testRemoveObject {
+	XCTAssertThrows([set removeObject:nil]);
+	XCTAssertNoThrow([set removeObject:@"bogus"]);
+	[self addObjectsIndividually:objects toSet:set];
+	XCTAssertThrows([set removeObject:nil]);
+	XCTAssertNoThrow([set removeObject:@"bogus"]);
+	XCTAssertEqual([set count], [objects count]);
+	
+	[set removeObject:@"J"];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
+						 (@[@"E",@"C",@"L",@"A",@"D",@"H",@"N",@"B",@"F",@"I",@"M",@"O",@"G",@"K"]));
+	[set removeObject:@"N"];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
+						 (@[@"E",@"C",@"H",@"A",@"D",@"F",@"L",@"B",@"G",@"I",@"M",@"K",@"O"]));
+	[set removeObject:@"H"];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
+						 (@[@"E",@"C",@"I",@"A",@"D",@"F",@"L",@"B",@"G",@"K",@"M",@"O"]));
 	[set removeObject:@"D"];
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
 						 (@[@"E",@"B",@"I",@"A",@"C",@"F",@"L",@"G",@"K",@"M",@"O"]));
@@ -755,7 +1775,7 @@ static NSArray *abcde;
 
 
 - (void)testAllObjectsWithTraversalOrder {
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderAscending],
 						 (@[@"A",@"B",@"C",@"D",@"E",@"F",@"G",@"H",@"I",@"J",@"K",@"L",@"M",@"N",@"O"]));
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderDescending],
@@ -789,7 +1809,7 @@ static NSArray *abcde;
 - (void)testRemoveObject {
 	XCTAssertThrows([set removeObject:nil]);
 	XCTAssertNoThrow([set removeObject:@"bogus"]);
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	XCTAssertThrows([set removeObject:nil]);
 	XCTAssertNoThrow([set removeObject:@"bogus"]);
 	XCTAssertEqual([set count], [objects count]);
@@ -856,7 +1876,7 @@ static NSArray *abcde;
 
 - (void)testRemoveObjectDoubleLeft {
 	objects = @[@"F",@"B",@"J",@"A",@"D",@"H",@"K",@"C",@"E",@"G",@"I"];
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	[set removeObject:@"A"];
 	[set removeObject:@"D"];
 	XCTAssertNoThrow([set verify]);
@@ -867,7 +1887,7 @@ static NSArray *abcde;
 
 - (void)testRemoveObjectDoubleRight {
 	objects = @[@"F",@"B",@"J",@"A",@"D",@"H",@"K",@"C",@"E",@"G",@"I"];
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	[set removeObject:@"K"];
 	[set removeObject:@"G"];
 	XCTAssertNoThrow([set verify]);
@@ -1015,7 +2035,7 @@ static NSArray *abcde;
 
 - (void)testAddObjectsAscending {
 	objects = @[@"A",@"B",@"C",@"D",@"E",@"F",@"G",@"H",@"I",@"J",@"K",@"L",@"M",@"N",@"O",@"P",@"Q",@"R"];
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	XCTAssertEqual([set count], [objects count]);
 	XCTAssertNoThrow([set verify]);
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
@@ -1024,7 +2044,7 @@ static NSArray *abcde;
 
 - (void)testAddObjectsDescending {
 	objects = @[@"R",@"Q",@"P",@"O",@"N",@"M",@"L",@"K",@"J",@"I",@"H",@"G",@"F",@"E",@"D",@"C",@"B",@"A"];
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	XCTAssertEqual([set count], [objects count]);
 	XCTAssertNoThrow([set verify]);
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
@@ -1032,7 +2052,7 @@ static NSArray *abcde;
 }
 
 - (void)testAllObjectsWithTraversalOrder {
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderAscending],
 						 (@[@"A",@"B",@"C",@"D",@"E",@"F",@"G",@"H",@"I",@"J",@"K",@"L",@"M",@"N"]));
@@ -1090,85 +2110,388 @@ static NSArray *abcde;
 
 #pragma mark -
 
-@interface CHTreap (Test)
+@interface CHScapegoatTree (Test)
 
 - (void)verify; // Raises an exception on error
 
 @end
 
-@implementation CHTreap (Test)
+@implementation CHScapegoatTree (Test)
 
-// Recursive method for verifying that BST and heap properties are not violated.
-- (void)verifySubtreeAtNode:(CHBinaryTreeNode *)node {
+// Recursive method for verifying the BST property; returns the subtree height.
+- (NSUInteger)verifySubtreeAtNode:(CHBinaryTreeNode *)node {
 	if (node == sentinel) {
-		return;
+		return 0;
 	}
-	if (node->left != sentinel) {
-		// Verify BST property
-		if ([node->left->object compare:node->object] == NSOrderedDescending) {
-			[NSException raise:NSInternalInconsistencyException
-			            format:@"BST violation left of %@", node->object];
-		}
-		// Verify heap property
-		if (node->left->priority > node->priority) {
-			[NSException raise:NSInternalInconsistencyException
-			            format:@"Heap violation left of %@", node->object];
-		}
-		// Recursively verity left subtree
-		[self verifySubtreeAtNode:node->left];
+	if (node->left != sentinel && [node->left->object compare:node->object] != NSOrderedAscending) {
+		[NSException raise:NSInternalInconsistencyException
+		            format:@"BST violation left of %@", node->object];
 	}
-	
-	if (node->right != sentinel) {
-		// Verify BST property
-		if ([node->right->object compare:node->object] == NSOrderedAscending) {
-			[NSException raise:NSInternalInconsistencyException
-			            format:@"BST violation right of %@", node->object];
-		}
-		// Verify heap property
-		if (node->right->priority > node->priority) {
-			[NSException raise:NSInternalInconsistencyException
-			            format:@"Heap violation right of %@", node->object];
-		}
-		// Recursively verity right subtree
-		[self verifySubtreeAtNode:node->right];
+	if (node->right != sentinel && [node->right->object compare:node->object] != NSOrderedDescending) {
+		[NSException raise:NSInternalInconsistencyException
+		            format:@"BST violation right of %@", node->object];
 	}
+	return MAX([self verifySubtreeAtNode:node->left], [self verifySubtreeAtNode:node->right]) + 1;
 }
 
 - (void)verify {
-	[self verifySubtreeAtNode:header->right];
+	NSUInteger height = [self verifySubtreeAtNode:header->right];
+	// No node may be deeper than log3/2 of the most objects since the last rebuild.
+	if (count > 0 && pow(1.5, height - 1) > MAX(count, maxCount)) {
+		[NSException raise:NSInternalInconsistencyException
+		            format:@"Height %lu is too great for %lu objects",
+		                   (unsigned long)height, (unsigned long)count];
+	}
+	[self verifyParentLinks];
+	[self verifySubtreeSizes];
 }
 
 @end
 
-@interface CHTreapTest : CHAbstractBinarySearchTreeTest
+@interface CHScapegoatTreeTest : CHAbstractBinarySearchTreeTest
 @end
 
-@implementation CHTreapTest
+@implementation CHScapegoatTreeTest
 
 - (Class)classUnderTest {
-	return [CHTreap class];
+	return [CHScapegoatTree class];
 }
 
 - (void)setUp {
 	set = [self createSet];
-	objects = @[@"G",@"D",@"K",@"B",@"I",@"F",@"L",@"C",@"H",@"E",@"M",@"A",@"J"];
+	objects = @[@"B",@"N",@"C",@"L",@"D",@"J",@"E",@"H",@"K",@"M",@"O",@"G",@"A",@"I",@"F"];
 }
 
 - (void)testAddObject {
 	[super testAddObject];
 	
-	// Repeat a few times to try to get a decent random spread.
-	for (NSUInteger tries = 1, count; tries <= 5; tries++) {
-		[set removeAllObjects];
-		count = 0;
-		for (id anObject in objects) {
-			[set addObject:anObject];
-			XCTAssertEqual([set count], ++count);
-			// Can't test a specific order because of randomly-assigned priorities
-			XCTAssertNoThrow([set verify]);
-		}
+	[set removeAllObjects];
+	NSUInteger count = 0;
+	for (id anObject in objects) {
+		[set addObject:anObject];
+		XCTAssertEqual([set count], ++count);
+		XCTAssertNoThrow([set verify]);
 	}
-}
+	
+	// Ascending objects form a path until one is too deep, then it is rebuilt.
+	[set removeAllObjects];
+	[self addObjectsIndividually:@[@"A",@"B",@"C",@"D"] toSet:set];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"A",@"B",@"C",@"D"]));
+	[set addObject:@"E"];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"C",@"A",@"B",@"D",@"E"]));
+	[set removeAllObjects];
+	for (NSUInteger i = 0; i < 1000; i++) {
+		[set addObject:@(i)];
+	}
+	XCTAssertNoThrow([set verify]);
+	[set setTracksSubtreeSizes:YES];
+	XCTAssertEqualObjects([set objectAtIndex:500], @500);
+	for (NSUInteger i = 2000; i > 1000; i--) {
+		[set addObject:@(i)];
+	}
+	XCTAssertNoThrow([set verify]);
+}
+
+- (void)testRemoveObject {
+	XCTAssertThrows([set removeObject:nil]);
+	XCTAssertNoThrow([set removeObject:@"bogus"]);
+	[self addObjectsIndividually:objects toSet:set];
+	XCTAssertThrows([set removeObject:nil]);
+	XCTAssertNoThrow([set removeObject:@"bogus"]);
+	XCTAssertEqual([set count], [objects count]);
+	
+	NSUInteger count = [objects count];
+	for (id anObject in objects) {
+		[set removeObject:anObject];
+		XCTAssertEqual([set count], --count);
+		XCTAssertFalse([set containsObject:anObject]);
+		XCTAssertNoThrow([set verify]);
+	}
+	
+	// Removing most objects from a bulk-built tree rebuilds it.
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 1000; i++) {
+		[numbers addObject:@(i)];
+	}
+	[set addObjectsFromArray:numbers];
+	[set setTracksSubtreeSizes:YES];
+	for (NSUInteger i = 0; i < 1000; i++) {
+		if (i % 10 != 0) {
+			[set removeObject:@(i)];
+		}
+	}
+	XCTAssertEqual([set count], (NSUInteger)100);
+	XCTAssertNoThrow([set verify]);
+	XCTAssertEqualObjects([set objectAtIndex:50], @500);
+}
+
+- (void)testRebuildKeepsKeys {
+	// Rebuilding relinks nodes rather than finding each object's key again, so
+	// a key stays what it was when its object was added.
+	set = [[[CHScapegoatTree alloc] initWithKeyPath:@"rank"] autorelease];
+	NSMutableDictionary *first = [NSMutableDictionary dictionaryWithObject:@0 forKey:@"rank"];
+	[set addObject:first];
+	[first setObject:@5000 forKey:@"rank"];
+	for (NSUInteger i = 1; i < 1000; i++) {
+		[set addObject:@{@"rank": @(i)}]; // Ascending, so subtrees are rebuilt often
+	}
+	XCTAssertEqual([set count], (NSUInteger)1000);
+	XCTAssertEqualObjects([set memberForKey:@999], @{@"rank": @999});
+	XCTAssertTrue([set memberForKey:@0] == first);
+	XCTAssertTrue([set firstObject] == first);
+	XCTAssertNil([set memberForKey:@5000]);
+}
+
+@end
+
+#pragma mark -
+
+@interface CHSplayTree (Test)
+
+- (void)verify; // Raises an exception on error
+
+@end
+
+@implementation CHSplayTree (Test)
+
+// Recursive method for verifying that the BST property is not violated.
+- (void)verifySubtreeAtNode:(CHBinaryTreeNode *)node {
+	if (node == sentinel) {
+		return;
+	}
+	if (node->left != sentinel && [node->left->object compare:node->object] != NSOrderedAscending) {
+		[NSException raise:NSInternalInconsistencyException
+		            format:@"BST violation left of %@", node->object];
+	}
+	if (node->right != sentinel && [node->right->object compare:node->object] != NSOrderedDescending) {
+		[NSException raise:NSInternalInconsistencyException
+		            format:@"BST violation right of %@", node->object];
+	}
+	[self verifySubtreeAtNode:node->left];
+	[self verifySubtreeAtNode:node->right];
+}
+
+- (void)verify {
+	[self verifySubtreeAtNode:header->right];
+	[self verifyParentLinks];
+	[self verifySubtreeSizes];
+}
+
+@end
+
+@interface CHSplayTreeTest : CHAbstractBinarySearchTreeTest
+@end
+
+@implementation CHSplayTreeTest
+
+- (Class)classUnderTest {
+	return [CHSplayTree class];
+}
+
+- (void)setUp {
+	set = [self createSet];
+	objects = @[@"A",@"B",@"C",@"D",@"E",@"F",@"G"];
+}
+
+- (void)testAddObject {
+	[super testAddObject];
+	
+	// Each object added becomes the root.
+	[set removeAllObjects];
+	for (id anObject in objects) {
+		[set addObject:anObject];
+		XCTAssertEqualObjects([[set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder] firstObject], anObject);
+		XCTAssertNoThrow([set verify]);
+	}
+	// Adding objects in ascending order produces a path down the left side.
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"G",@"F",@"E",@"D",@"C",@"B",@"A"]));
+}
+
+- (void)testMemberSplaysToRoot {
+	[self addObjectsIndividually:objects toSet:set];
+	
+	// Splaying the deepest node also halves the depth of the path to it.
+	XCTAssertEqualObjects([set member:@"A"], @"A");
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"A",@"F",@"D",@"B",@"C",@"E",@"G"]));
+	XCTAssertNoThrow([set verify]);
+	XCTAssertTrue([set containsObject:@"D"]);
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"D",@"A",@"B",@"C",@"F",@"E",@"G"]));
+	XCTAssertNoThrow([set verify]);
+	// An unsuccessful search splays the last node on the search path.
+	XCTAssertNil([set member:@"Z"]);
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"G",@"F",@"D",@"A",@"B",@"C",@"E"]));
+	XCTAssertNoThrow([set verify]);
+	XCTAssertEqualObjects([set allObjects], objects);
+}
+
+- (void)testMemberOfSubsetDoesNotSplay {
+	[self addObjectsIndividually:objects toSet:set];
+	NSArray *shape = [set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder];
+	id subset = [set subsetViewFromObject:@"B" toObject:@"E" options:0];
+	// A view can be searched any number of times, since the tree isn't changed.
+	XCTAssertEqualObjects([subset member:@"A"], nil);
+	XCTAssertEqualObjects([subset member:@"C"], @"C");
+	XCTAssertTrue([subset containsObject:@"E"]);
+	XCTAssertFalse([subset containsObject:@"F"]);
+	XCTAssertEqualObjects([subset member:@"B"], @"B");
+	XCTAssertEqualObjects([subset allObjects], (@[@"B",@"C",@"D",@"E"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder], shape);
+	// Searching the tree itself still splays, which invalidates the view.
+	[set member:@"A"];
+	XCTAssertThrows([subset member:@"C"]);
+}
+
+- (void)testMemberDuringEnumeration {
+	[set addObjectsFromArray:objects];
+	@try {
+		for (id anObject in set) {
+			[set member:anObject];
+		}
+		XCTFail(@"Expected an exception for searching during enumeration.");
+	}
+	@catch (NSException *exception) {
+	}
+}
+
+- (void)testRemoveObject {
+	XCTAssertThrows([set removeObject:nil]);
+	XCTAssertNoThrow([set removeObject:@"bogus"]);
+	[self addObjectsIndividually:objects toSet:set];
+	XCTAssertThrows([set removeObject:nil]);
+	XCTAssertNoThrow([set removeObject:@"bogus"]);
+	XCTAssertEqual([set count], [objects count]);
+	
+	[set removeAllObjects];
+	[self addObjectsIndividually:objects toSet:set];
+	[set removeObject:@"D"];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"C",@"B",@"A",@"F",@"E",@"G"]));
+	XCTAssertNoThrow([set verify]);
+	[set removeObject:@"A"];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+						 (@[@"B",@"C",@"F",@"E",@"G"]));
+	XCTAssertNoThrow([set verify]);
+	
+	for (id anObject in objects) {
+		[set removeObject:anObject];
+		XCTAssertFalse([set containsObject:anObject]);
+		XCTAssertNoThrow([set verify]);
+	}
+	XCTAssertEqual([set count], (NSUInteger)0);
+}
+
+- (void)testSubtreeSizesAfterSplaying {
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger i = 0; i < 100; i++) {
+		[numbers addObject:@(i * 7 % 100)];
+	}
+	[self addObjectsIndividually:numbers toSet:set];
+	[set setTracksSubtreeSizes:YES];
+	XCTAssertEqualObjects([set objectAtIndex:50], @50);
+	for (id anObject in numbers) {
+		XCTAssertEqualObjects([set member:anObject], anObject);
+		XCTAssertEqual([set indexOfObject:anObject], [anObject unsignedIntegerValue]);
+	}
+	XCTAssertNoThrow([set verify]);
+	for (NSUInteger i = 0; i < 100; i += 3) {
+		[set removeObject:@(i)];
+		[set addObject:@(i + 1000)];
+		XCTAssertNoThrow([set verify]);
+	}
+	XCTAssertEqual([set count], (NSUInteger)100);
+	XCTAssertEqualObjects([set objectAtIndex:0], @1);
+	XCTAssertEqualObjects([set lastObject], @1099);
+}
+
+@end
+
+#pragma mark -
+
+@interface CHTreap (Test)
+
+- (void)verify; // Raises an exception on error
+
+@end
+
+@implementation CHTreap (Test)
+
+// Recursive method for verifying that BST and heap properties are not violated.
+- (void)verifySubtreeAtNode:(CHBinaryTreeNode *)node {
+	if (node == sentinel) {
+		return;
+	}
+	if (node->left != sentinel) {
+		// Verify BST property
+		if ([node->left->object compare:node->object] == NSOrderedDescending) {
+			[NSException raise:NSInternalInconsistencyException
+			            format:@"BST violation left of %@", node->object];
+		}
+		// Verify heap property
+		if (node->left->priority > node->priority) {
+			[NSException raise:NSInternalInconsistencyException
+			            format:@"Heap violation left of %@", node->object];
+		}
+		// Recursively verity left subtree
+		[self verifySubtreeAtNode:node->left];
+	}
+	
+	if (node->right != sentinel) {
+		// Verify BST property
+		if ([node->right->object compare:node->object] == NSOrderedAscending) {
+			[NSException raise:NSInternalInconsistencyException
+			            format:@"BST violation right of %@", node->object];
+		}
+		// Verify heap property
+		if (node->right->priority > node->priority) {
+			[NSException raise:NSInternalInconsistencyException
+			            format:@"Heap violation right of %@", node->object];
+		}
+		// Recursively verity right subtree
+		[self verifySubtreeAtNode:node->right];
+	}
+}
+
+- (void)verify {
+	[self verifySubtreeAtNode:header->right];
+}
+
+@end
+
+@interface CHTreapTest : CHAbstractBinarySearchTreeTest
+@end
+
+@implementation CHTreapTest
+
+- (Class)classUnderTest {
+	return [CHTreap class];
+}
+
+- (void)setUp {
+	set = [self createSet];
+	objects = @[@"G",@"D",@"K",@"B",@"I",@"F",@"L",@"C",@"H",@"E",@"M",@"A",@"J"];
+}
+
+- (void)testAddObject {
+	[super testAddObject];
+	
+	// Repeat a few times to try to get a decent random spread.
+	for (NSUInteger tries = 1, count; tries <= 5; tries++) {
+		[set removeAllObjects];
+		count = 0;
+		for (id anObject in objects) {
+			[set addObject:anObject];
+			XCTAssertEqual([set count], ++count);
+			// Can't test a specific order because of randomly-assigned priorities
+			XCTAssertNoThrow([set verify]);
+		}
+	}
+}
 
 - (void)testAddObjectWithPriority {
 	[super testAddObject];
@@ -1323,19 +2646,19 @@ static NSArray *abcde;
 	objects = @[@"F",@"B",@"G",@"A",@"D",@"I",@"C",@"E",@"H"]; // Specified using level-order travesal
 	// Creates the tree from: http://en.wikipedia.org/wiki/Tree_traversal#Example
 
-	outsideTree = [[CHUnbalancedTree alloc] initWithArray:
-				   @[@"C",@"B",@"A",@"D",@"E"]];
-	insideTree = [[CHUnbalancedTree alloc] initWithArray:
-				  @[@"C",@"A",@"B",@"E",@"D"]];
-	zigzagTree = [[CHUnbalancedTree alloc] initWithArray:
-				  @[@"A",@"E",@"B",@"D",@"C"]];
+	outsideTree = [[CHUnbalancedTree alloc] init];
+	[self addObjectsIndividually:@[@"C",@"B",@"A",@"D",@"E"] toSet:outsideTree];
+	insideTree = [[CHUnbalancedTree alloc] init];
+	[self addObjectsIndividually:@[@"C",@"A",@"B",@"E",@"D"] toSet:insideTree];
+	zigzagTree = [[CHUnbalancedTree alloc] init];
+	[self addObjectsIndividually:@[@"A",@"E",@"B",@"D",@"C"] toSet:zigzagTree];
 }
 
 - (void)testAddObject {
 	[super testAddObject];
 	
 	[set removeAllObjects];
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
 						 objects);
 }
@@ -1343,7 +2666,7 @@ static NSArray *abcde;
 - (void)testAllObjectsWithTraversalOrder {
 	[super testAllObjectsWithTraversalOrder];
 	[set removeAllObjects];
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	
 	// Test all traversal orderings by individual tree
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderAscending],
@@ -1425,7 +2748,7 @@ static NSArray *abcde;
 
 	XCTAssertThrows([set removeObject:nil]);
 	XCTAssertNoThrow([set removeObject:@"bogus"]);
-	[set addObjectsFromArray:objects];
+	[self addObjectsIndividually:objects toSet:set];
 	XCTAssertThrows([set removeObject:nil]);
 	XCTAssertNoThrow([set removeObject:@"bogus"]);
 	XCTAssertEqual([set count], [objects count]);
@@ -1458,7 +2781,7 @@ static NSArray *abcde;
 	
 	// 4 - Remove a node with two children
 	[set removeAllObjects];
-	[set addObjectsFromArray:@[@"B",@"A",@"E",@"C",@"D",@"F"]];
+	[self addObjectsIndividually:@[@"B",@"A",@"E",@"C",@"D",@"F"] toSet:set];
 	
 	[set removeObject:@"B"];
 	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
@@ -1475,3 +2798,871 @@ static NSArray *abcde;
 }
 
 @end
+
+#pragma mark -
+
+// A B+ tree of the objects A through G with a fanout of 3 has D in its root, B
+// and F in the next level, and A, BC, DE, and FG in its leaves.
+@interface CHBPlusTreeTest : CHSortedSetTest
+@end
+
+@implementation CHBPlusTreeTest
+
+- (Class)classUnderTest {
+	return [CHBPlusTree class];
+}
+
+- (id)createSet {
+	return [[[CHBPlusTree alloc] initWithFanout:3] autorelease];
+}
+
+- (void)testAllObjectsWithTraversalOrder {
+	[set addObjectsFromArray:@[@"A",@"B",@"C",@"D",@"E",@"F",@"G"]];
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderAscending],
+	                      (@[@"A",@"B",@"C",@"D",@"E",@"F",@"G"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderDescending],
+	                      (@[@"G",@"F",@"E",@"D",@"C",@"B",@"A"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder],
+	                      (@[@"D",@"B",@"A",@"C",@"F",@"E",@"G"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderPostOrder],
+	                      (@[@"A",@"C",@"B",@"E",@"G",@"F",@"D"]));
+	XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderLevelOrder],
+	                      (@[@"D",@"B",@"F",@"A",@"C",@"E",@"G"]));
+	XCTAssertThrows([set allObjectsWithTraversalOrder:(CHTraversalOrder)-1]);
+	
+	// A tree with a single leaf has no separators, so each order is ascending.
+	set = [self createSet];
+	[set addObject:@"B"];
+	[set addObject:@"A"];
+	for (CHTraversalOrder order = CHTraversalOrderPreOrder; order <= CHTraversalOrderLevelOrder; order++) {
+		XCTAssertEqualObjects([set allObjectsWithTraversalOrder:order], (@[@"A",@"B"]));
+	}
+}
+
+- (void)testAddAndRemoveManyObjects {
+	// Each traversal order must visit every object exactly once, however the
+	// nodes have been split and merged.
+	for (NSNumber *fanout in @[@3, @4, @5, @32]) {
+		set = [[[CHBPlusTree alloc] initWithFanout:[fanout unsignedIntegerValue]] autorelease];
+		XCTAssertEqual([set fanout], [fanout unsignedIntegerValue]);
+		NSMutableSet *expected = [NSMutableSet set];
+		srandom(1);
+		for (NSUInteger i = 0; i < 5000; i++) {
+			NSNumber *number = @(random() % 500);
+			if (random() % 5 < 3) {
+				[set addObject:number];
+				[expected addObject:number];
+			} else {
+				[set removeObject:number];
+				[expected removeObject:number];
+			}
+			XCTAssertEqual([set count], [expected count]);
+		}
+		NSArray *sorted = [[expected allObjects] sortedArrayUsingSelector:@selector(compare:)];
+		XCTAssertEqualObjects([set allObjects], sorted);
+		XCTAssertEqualObjects([set allObjectsWithTraversalOrder:CHTraversalOrderDescending],
+		                      [[sorted reverseObjectEnumerator] allObjects]);
+		for (CHTraversalOrder order = CHTraversalOrderPreOrder; order <= CHTraversalOrderLevelOrder; order++) {
+			NSArray *visited = [set allObjectsWithTraversalOrder:order];
+			XCTAssertEqual([visited count], [sorted count]);
+			XCTAssertEqualObjects([NSSet setWithArray:visited], expected);
+		}
+		for (NSUInteger number = 0; number < 500; number++) {
+			XCTAssertEqual([set containsObject:@(number)], [expected containsObject:@(number)]);
+		}
+		for (NSNumber *number in sorted) {
+			[set removeObject:number];
+		}
+		XCTAssertEqual([set count], 0);
+		XCTAssertNil([set firstObject]);
+	}
+}
+
+- (void)testAddObjectReplacesEqualObject {
+	// The replacement must also take the place of the separator in its parent.
+	[set addObjectsFromArray:@[@"A",@"B",@"C",@"D",@"E",@"F",@"G"]];
+	NSString *d = [NSMutableString stringWithString:@"D"];
+	[set addObject:d];
+	XCTAssertEqual([set count], 7);
+	XCTAssertEqual([set member:@"D"], d);
+	XCTAssertEqual([[set allObjectsWithTraversalOrder:CHTraversalOrderPreOrder] firstObject], d);
+}
+
+- (void)testInitWithFanout {
+	XCTAssertThrows([[CHBPlusTree alloc] initWithFanout:2]);
+	XCTAssertEqual([[[[CHBPlusTree alloc] init] autorelease] fanout], 32);
+	XCTAssertEqual([[[[CHBPlusTree alloc] initWithArray:abcde] autorelease] fanout], 32);
+	
+	set = [[[CHBPlusTree alloc] initWithFanout:7] autorelease];
+	[set addObjectsFromArray:abcde];
+	XCTAssertEqual([[[set copy] autorelease] fanout], 7);
+	XCTAssertEqual([[[set copyUsingNSCoding] autorelease] fanout], 7);
+	XCTAssertEqual([(CHBPlusTree *)[set subsetFromObject:@"B" toObject:@"D" options:0] fanout], 7);
+}
+
+- (void)testNSFastEnumerationAcrossLeaves {
+	NSUInteger limit = 100; // Each leaf is returned as a separate batch
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger number = 1; number <= limit; number++) {
+		[numbers addObject:@(number)];
+	}
+	[self addObjectsIndividually:[[numbers reverseObjectEnumerator] allObjects] toSet:set];
+	NSUInteger expected = 1;
+	for (NSNumber *object in set) {
+		XCTAssertEqual([object unsignedIntegerValue], expected++);
+	}
+	XCTAssertEqual(expected, limit + 1);
+}
+
+@end
+
+#pragma mark -
+
+@interface CHConcurrentSkipListTest : CHSortedSetTest
+@end
+
+@implementation CHConcurrentSkipListTest
+
+- (Class)classUnderTest {
+	return [CHConcurrentSkipList class];
+}
+
+- (NSArray *)numbersFrom:(NSUInteger)first to:(NSUInteger)last {
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger number = first; number <= last; number++) {
+		[numbers addObject:@(number)];
+	}
+	return numbers;
+}
+
+// Enumeration is weakly consistent, so the set can be modified meanwhile.
+- (void)testNSFastEnumeration {
+	NSUInteger limit = 100; // More than one batch
+	[set addObjectsFromArray:[self numbersFrom:1 to:limit]];
+	NSMutableArray *enumerated = [NSMutableArray array];
+	for (NSNumber *number in set) {
+		[enumerated addObject:number];
+		[set removeObject:number];
+		if ([number unsignedIntegerValue] <= limit) {
+			[set addObject:@([number unsignedIntegerValue] + 1000)];
+		}
+	}
+	// Objects present throughout are all enumerated, in ascending order.
+	XCTAssertEqualObjects([enumerated subarrayWithRange:NSMakeRange(0, limit)], [self numbersFrom:1 to:limit]);
+	for (NSUInteger i = 1; i < [enumerated count]; i++) {
+		XCTAssertEqual([enumerated[i-1] compare:enumerated[i]], NSOrderedAscending);
+	}
+	XCTAssertEqual([set count] + [enumerated count], 2 * limit);
+}
+
+- (void)testObjectEnumerator {
+	XCTAssertNil([[set objectEnumerator] nextObject]);
+	[set addObjectsFromArray:abcde];
+	NSEnumerator *e = [set objectEnumerator];
+	XCTAssertEqualObjects([e nextObject], @"A");
+	[set removeObject:@"B"];
+	XCTAssertNoThrow([e nextObject]);
+	XCTAssertEqualObjects([[set reverseObjectEnumerator] allObjects], (@[@"E",@"D",@"C",@"A"]));
+}
+
+// Each thread adds its own numbers, and removes the odd ones and some of the
+// first and last objects, so the outcome is known even though they interleave.
+- (void)testConcurrentWriters {
+	NSUInteger threads = 8, perThread = 1000;
+	[set addObject:@(-1)];
+	[set addObject:@(threads * perThread)];
+	dispatch_apply(threads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+		@autoreleasepool {
+			NSUInteger first = thread * perThread;
+			for (NSUInteger number = first; number < first + perThread; number++) {
+				[set addObject:@(number)];
+			}
+			for (NSUInteger number = first + 1; number < first + perThread; number += 2) {
+				[set removeObject:@(number)];
+				[set addObject:@(number - 1)]; // Replaces an equal object
+			}
+		}
+	});
+	XCTAssertEqual([set count], threads * perThread / 2 + 2);
+	XCTAssertEqualObjects([set firstObject], @(-1));
+	XCTAssertEqualObjects([set lastObject], @(threads * perThread));
+	NSMutableArray *expected = [NSMutableArray arrayWithObject:@(-1)];
+	for (NSUInteger number = 0; number < threads * perThread; number += 2) {
+		[expected addObject:@(number)];
+	}
+	[expected addObject:@(threads * perThread)];
+	XCTAssertEqualObjects([set allObjects], expected);
+	
+	// Threads racing to remove the first or last object never remove the same one.
+	__block NSUInteger removals = 0;
+	dispatch_apply(threads, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+		@autoreleasepool {
+			for (NSUInteger i = 0; i < perThread / 8; i++) {
+				if (thread % 2) {
+					[set removeFirstObject];
+				} else {
+					[set removeLastObject];
+				}
+				__atomic_add_fetch(&removals, 1, __ATOMIC_RELAXED);
+			}
+		}
+	});
+	XCTAssertEqual([set count], [expected count] - removals);
+	XCTAssertEqualObjects([set allObjects], [expected subarrayWithRange:NSMakeRange(removals / 2, [expected count] - removals)]);
+	[set removeAllObjects];
+	XCTAssertEqual([set count], 0);
+	XCTAssertNil([set firstObject]);
+	XCTAssertNil([set lastObject]);
+}
+
+@end
+
+#pragma mark -
+
+@interface CHConcurrentSortedSetTest : CHSortedSetTest
+@end
+
+@implementation CHConcurrentSortedSetTest
+
+- (Class)classUnderTest {
+	return [CHConcurrentSortedSet class];
+}
+
+- (void)testInitWithSortedSet {
+	XCTAssertThrows([[[CHConcurrentSortedSet alloc] initWithSortedSet:nil] autorelease]);
+	for (Class aClass in @[[CHAVLTree class], [CHBPlusTree class], [CHRedBlackTree class]]) {
+		id<CHSortedSet> wrapped = [[[aClass alloc] initWithArray:abcde] autorelease];
+		set = [[[CHConcurrentSortedSet alloc] initWithSortedSet:wrapped] autorelease];
+		XCTAssertEqualObjects([set allObjects], abcde);
+		[set removeObject:@"C"];
+		XCTAssertEqual([wrapped count], [abcde count] - 1);
+		XCTAssertEqualObjects([[[set copy] autorelease] allObjects], [wrapped allObjects]);
+		id decoded = [[set copyUsingNSCoding] autorelease];
+		XCTAssertTrue([decoded isKindOfClass:[CHConcurrentSortedSet class]]);
+		XCTAssertEqualObjects([decoded allObjects], [wrapped allObjects]);
+	}
+}
+
+// Enumeration works on a snapshot, so the set can be modified meanwhile.
+- (void)testNSFastEnumeration {
+	[set addObjectsFromArray:abcde];
+	NSMutableArray *enumerated = [NSMutableArray array];
+	for (id anObject in set) {
+		[enumerated addObject:anObject];
+		[set removeObject:anObject];
+		[set addObject:[anObject lowercaseString]];
+	}
+	XCTAssertEqualObjects(enumerated, abcde);
+	XCTAssertEqualObjects([set allObjects], (@[@"a",@"b",@"c",@"d",@"e"]));
+	
+	NSUInteger limit = 100; // More than one batch
+	[set removeAllObjects];
+	[set addObjectsFromArray:[self numbersFrom:1 to:limit]];
+	NSUInteger expected = 1;
+	for (NSNumber *number in set) {
+		XCTAssertEqual([number unsignedIntegerValue], expected++);
+	}
+	XCTAssertEqual(expected, limit + 1);
+}
+
+- (void)testObjectEnumerator {
+	XCTAssertNil([[set objectEnumerator] nextObject]);
+	[set addObjectsFromArray:abcde];
+	NSEnumerator *e = [set objectEnumerator];
+	XCTAssertEqualObjects([e nextObject], @"A");
+	[set addObject:@"F"];
+	XCTAssertNoThrow([e nextObject]);
+	XCTAssertEqualObjects([e allObjects], (@[@"C",@"D",@"E"]));
+	e = [set reverseObjectEnumerator];
+	XCTAssertEqualObjects([e nextObject], @"F");
+}
+
+- (NSArray *)numbersFrom:(NSUInteger)first to:(NSUInteger)last {
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger number = first; number <= last; number++) {
+		[numbers addObject:@(number)];
+	}
+	return numbers;
+}
+
+// Readers must always find the even numbers, which the writer never removes,
+// and never see an odd number that was removed before they started.
+- (void)testConcurrentReadersAndWriter {
+	NSUInteger limit = 2000;
+	[set addObjectsFromArray:[self numbersFrom:1 to:limit]];
+	__block BOOL failed = NO;
+	dispatch_apply(9, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+		@autoreleasepool {
+			for (NSUInteger round = 0; round < 20; round++) {
+				for (NSUInteger number = 1; number <= limit; number += 2) {
+					if (thread == 0) {
+						[set removeObject:@(number)];
+						[set addObject:@(number)];
+					} else if (![set containsObject:@(number + 1)] ||
+					           ![[set member:@(number + 1)] isEqual:@(number + 1)]) {
+						failed = YES;
+					}
+				}
+				if (thread != 0 && [[set firstObject] unsignedIntegerValue] > 2) {
+					failed = YES;
+				}
+			}
+		}
+	});
+	XCTAssertFalse(failed);
+	XCTAssertEqual([set count], limit);
+	XCTAssertEqualObjects([set allObjects], [self numbersFrom:1 to:limit]);
+}
+
+@end
+
+#pragma mark -
+
+@interface CHPersistentAVLTreeTest : CHSortedSetTest
+@end
+
+@implementation CHPersistentAVLTreeTest
+
+- (Class)classUnderTest {
+	return [CHPersistentAVLTree class];
+}
+
+- (void)testSnapshot {
+	[set addObjectsFromArray:abcde];
+	CHPersistentAVLTree *snapshot = [set snapshot];
+	XCTAssertTrue([snapshot isSnapshot]);
+	XCTAssertFalse([set isSnapshot]);
+	XCTAssertEqual([snapshot snapshot], snapshot);
+	XCTAssertEqual([[snapshot copy] autorelease], snapshot);
+	
+	// Changes to the tree must not affect the snapshot, nor the reverse.
+	[set removeObject:@"C"];
+	[set addObject:@"F"];
+	[set removeFirstObject];
+	XCTAssertEqualObjects([set allObjects], (@[@"B",@"D",@"E",@"F"]));
+	XCTAssertEqualObjects([snapshot allObjects], abcde);
+	XCTAssertEqual([snapshot count], [abcde count]);
+	XCTAssertTrue([snapshot containsObject:@"C"]);
+	XCTAssertFalse([snapshot containsObject:@"F"]);
+	XCTAssertThrows([snapshot addObject:@"G"]);
+	XCTAssertThrows([snapshot addObjectsFromArray:abcde]);
+	XCTAssertThrows([snapshot removeObject:@"A"]);
+	XCTAssertThrows([snapshot removeFirstObject]);
+	XCTAssertThrows([snapshot removeLastObject]);
+	XCTAssertThrows([snapshot removeAllObjects]);
+	[set removeAllObjects];
+	XCTAssertEqualObjects([snapshot allObjects], abcde);
+	
+	// A snapshot stays immutable when archived, but subsets of it don't.
+	CHPersistentAVLTree *decoded = [[snapshot copyUsingNSCoding] autorelease];
+	XCTAssertTrue([decoded isSnapshot]);
+	XCTAssertEqualObjects(decoded, snapshot);
+	id<CHSortedSet> subset = [snapshot subsetFromObject:@"B" toObject:@"D" options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@"B",@"C",@"D"]));
+	XCTAssertNoThrow([subset addObject:@"G"]);
+}
+
+- (void)testSnapshotsOfLargeTree {
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSUInteger number = 0; number < 1000; number++) {
+		[numbers addObject:@(number)];
+	}
+	[set addObjectsFromArray:numbers];
+	NSMutableArray *snapshots = [NSMutableArray array];
+	NSMutableArray *contents = [NSMutableArray array];
+	for (NSUInteger number = 0; number < 1000; number += 3) {
+		[snapshots addObject:[set snapshot]];
+		[contents addObject:[set allObjects]];
+		[set removeObject:@(number)];
+		[set addObject:@(number + 1000)];
+	}
+	for (NSUInteger i = 0; i < [snapshots count]; i++) {
+		XCTAssertEqualObjects([snapshots[i] allObjects], contents[i]);
+		XCTAssertEqualObjects([[snapshots[i] reverseObjectEnumerator] allObjects],
+		                      [[contents[i] reverseObjectEnumerator] allObjects]);
+	}
+	// Releasing the snapshots in any order must leave the tree intact.
+	NSArray *allObjects = [set allObjects];
+	[snapshots removeObjectsInRange:NSMakeRange(100, 100)];
+	[snapshots removeAllObjects];
+	XCTAssertEqualObjects([set allObjects], allObjects);
+}
+
+- (void)testCopyIsIndependent {
+	[set addObjectsFromArray:abcde];
+	CHPersistentAVLTree *copy = [[set copy] autorelease];
+	XCTAssertFalse([copy isSnapshot]);
+	[copy removeObject:@"A"];
+	[set addObject:@"F"];
+	XCTAssertEqualObjects([copy allObjects], (@[@"B",@"C",@"D",@"E"]));
+	XCTAssertEqualObjects([set allObjects], (@[@"A",@"B",@"C",@"D",@"E",@"F"]));
+}
+
+// Readers of snapshots need no locks while the tree is modified.
+- (void)testConcurrentSnapshotReaders {
+	NSUInteger limit = 2000;
+	for (NSUInteger number = 0; number < limit; number++) {
+		[set addObject:@(number)];
+	}
+	CHPersistentAVLTree *snapshot = [set snapshot];
+	__block BOOL failed = NO;
+	dispatch_apply(5, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+		@autoreleasepool {
+			for (NSUInteger round = 0; round < 10; round++) {
+				if (thread == 0) {
+					for (NSUInteger number = 0; number < limit; number += 2) {
+						[set removeObject:@(number)];
+						[set addObject:@(number + limit)];
+					}
+					[set removeAllObjects];
+					[set addObjectsFromArray:[snapshot allObjects]];
+				} else {
+					NSUInteger expected = 0;
+					for (NSNumber *number in snapshot) {
+						if ([number unsignedIntegerValue] != expected++) {
+							failed = YES;
+						}
+					}
+					if (expected != limit || ![snapshot containsObject:@(limit / 2)]) {
+						failed = YES;
+					}
+				}
+			}
+		}
+	});
+	XCTAssertFalse(failed);
+	XCTAssertEqual([snapshot count], limit);
+}
+
+@end
+
+#pragma mark -
+
+// CHInt64SortedSet only holds numbers, so it can't reuse the string-based tests
+// in CHSortedSetTest. These compare it against a sorted array of the same keys.
+@interface CHInt64SortedSetTest : XCTestCase {
+	CHInt64SortedSet *set;
+}
+@end
+
+@implementation CHInt64SortedSetTest
+
+- (void)setUp {
+	set = [[[CHInt64SortedSet alloc] init] autorelease];
+}
+
+- (NSArray *)numbersFrom:(NSInteger)first to:(NSInteger)last by:(NSInteger)step {
+	NSMutableArray *numbers = [NSMutableArray array];
+	for (NSInteger number = first; number <= last; number += step) {
+		[numbers addObject:@(number)];
+	}
+	return numbers;
+}
+
+- (void)testAddObject {
+	XCTAssertThrows([set addObject:nil]);
+	XCTAssertThrows([set addObject:@"A"]);
+	XCTAssertEqual([set count], 0);
+	
+	[set addObject:@3];
+	[set addObject:@1];
+	[set addObject:@2];
+	[set addObject:@2];
+	XCTAssertEqual([set count], 3);
+	XCTAssertEqualObjects([set allObjects], (@[@1,@2,@3]));
+	
+	// Values at the extremes are ordinary keys, despite being used as padding.
+	[set addInt64:INT64_MAX];
+	[set addInt64:INT64_MIN];
+	XCTAssertEqual([set count], 5);
+	XCTAssertEqualObjects([set firstObject], @(INT64_MIN));
+	XCTAssertEqualObjects([set lastObject], @(INT64_MAX));
+	XCTAssertTrue([set containsInt64:INT64_MAX]);
+}
+
+- (void)testAddAndRemoveManyKeys {
+	// Keys are drawn from a small range so that many are added and removed more
+	// than once, splitting and merging nodes throughout the tree.
+	NSMutableSet *expected = [NSMutableSet set];
+	srandom(1);
+	for (NSUInteger i = 0; i < 50000; i++) {
+		int64_t key = random() % 4000 - 2000;
+		if (random() % 5 < 3) {
+			[set addInt64:key];
+			[expected addObject:@(key)];
+		} else {
+			[set removeInt64:key];
+			[expected removeObject:@(key)];
+		}
+		XCTAssertEqual([set count], [expected count]);
+	}
+	NSArray *sorted = [[expected allObjects] sortedArrayUsingSelector:@selector(compare:)];
+	XCTAssertEqualObjects([set allObjects], sorted);
+	XCTAssertEqualObjects([[set reverseObjectEnumerator] allObjects],
+	                      [[sorted reverseObjectEnumerator] allObjects]);
+	for (int64_t key = -2001; key <= 2001; key++) {
+		XCTAssertEqual([set containsInt64:key], [expected containsObject:@(key)]);
+	}
+	for (NSNumber *number in sorted) {
+		[set removeObject:number];
+	}
+	XCTAssertEqual([set count], 0);
+	XCTAssertNil([set firstObject]);
+	XCTAssertEqualObjects([set allObjects], @[]);
+}
+
+- (void)testInitWithArray {
+	NSArray *numbers = [self numbersFrom:1 to:1000 by:1];
+	NSMutableArray *shuffled = [NSMutableArray arrayWithArray:numbers];
+	[shuffled addObjectsFromArray:numbers];
+	for (NSUInteger i = [shuffled count] - 1; i > 0; i--) {
+		[shuffled exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((uint32_t)i + 1)];
+	}
+	set = [[[CHInt64SortedSet alloc] initWithArray:shuffled] autorelease];
+	XCTAssertEqual([set count], [numbers count]);
+	XCTAssertEqualObjects([set allObjects], numbers);
+	
+	// Keys can still be added and removed after building the tree in bulk.
+	[set addObject:@0];
+	[set removeObject:@500];
+	XCTAssertEqualObjects([set firstObject], @0);
+	XCTAssertFalse([set containsObject:@500]);
+	XCTAssertEqual([set count], [numbers count]);
+	
+	XCTAssertThrows([[CHInt64SortedSet alloc] initWithArray:@[@1,@"A"]]);
+}
+
+- (void)testMember {
+	[set addObjectsFromArray:@[@1,@2,@3]];
+	XCTAssertEqualObjects([set member:@2], @2);
+	XCTAssertNil([set member:@4]);
+	XCTAssertNil([set member:@"A"]);
+	XCTAssertThrows([set member:nil]);
+	XCTAssertTrue([set containsObject:@3]);
+	XCTAssertFalse([set containsObject:@"A"]);
+}
+
+- (void)testNearestObjects {
+	XCTAssertThrows([set floorObject:nil]);
+	XCTAssertThrows([set objectAfter:@"A"]);
+	XCTAssertNil([set ceilingObject:@5]);
+	
+	// Enough keys for many leaves, so some answers are in an adjacent leaf.
+	NSArray *numbers = [self numbersFrom:0 to:990 by:10];
+	[set addObjectsFromArray:numbers];
+	for (NSInteger key = -5; key <= 1000; key += 5) {
+		NSNumber *probe = @(key);
+		id expectedFloor = nil, expectedCeiling = nil, expectedBefore = nil, expectedAfter = nil;
+		for (NSNumber *number in numbers) {
+			NSInteger value = [number integerValue];
+			if (value <= key) {
+				expectedFloor = number;
+			}
+			if (value < key) {
+				expectedBefore = number;
+			}
+			if (value >= key && expectedCeiling == nil) {
+				expectedCeiling = number;
+			}
+			if (value > key && expectedAfter == nil) {
+				expectedAfter = number;
+			}
+		}
+		XCTAssertEqualObjects([set floorObject:probe], expectedFloor);
+		XCTAssertEqualObjects([set ceilingObject:probe], expectedCeiling);
+		XCTAssertEqualObjects([set objectBefore:probe], expectedBefore);
+		XCTAssertEqualObjects([set objectAfter:probe], expectedAfter);
+	}
+	
+	[set addInt64:INT64_MIN];
+	[set addInt64:INT64_MAX];
+	XCTAssertNil([set objectBefore:@(INT64_MIN)]);
+	XCTAssertNil([set objectAfter:@(INT64_MAX)]);
+	XCTAssertEqualObjects([set ceilingObject:@991], @(INT64_MAX));
+	XCTAssertEqualObjects([set floorObject:@(-1)], @(INT64_MIN));
+}
+
+- (void)testRemoveFirstAndLastObject {
+	[set addObjectsFromArray:[self numbersFrom:1 to:100 by:1]];
+	for (NSInteger i = 1; i <= 50; i++) {
+		XCTAssertEqualObjects([set firstObject], @(i));
+		XCTAssertEqualObjects([set lastObject], @(101 - i));
+		[set removeFirstObject];
+		[set removeLastObject];
+	}
+	XCTAssertEqual([set count], 0);
+	XCTAssertNoThrow([set removeFirstObject]);
+	XCTAssertNoThrow([set removeLastObject]);
+	XCTAssertThrows([set removeObject:nil]);
+	XCTAssertNoThrow([set removeObject:@"A"]);
+}
+
+- (void)testSubsetFromObjectToObject {
+	[set addObjectsFromArray:[self numbersFrom:0 to:100 by:10]];
+	id<CHSortedSet> subset;
+	
+	subset = [set subsetFromObject:@20 toObject:@50 options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@20,@30,@40,@50]));
+	XCTAssertTrue([subset isKindOfClass:[CHInt64SortedSet class]]);
+	subset = [set subsetFromObject:@15 toObject:@55 options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@20,@30,@40,@50]));
+	subset = [set subsetFromObject:@20 toObject:@50
+	                       options:CHSubsetConstructionExcludeLowEndpoint|CHSubsetConstructionExcludeHighEndpoint];
+	XCTAssertEqualObjects([subset allObjects], (@[@30,@40]));
+	subset = [set subsetFromObject:@80 toObject:nil options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@80,@90,@100]));
+	subset = [set subsetFromObject:nil toObject:@10 options:CHSubsetConstructionExcludeHighEndpoint];
+	XCTAssertEqualObjects([subset allObjects], (@[@0]));
+	// Parameters in reverse order exclude the objects between them.
+	subset = [set subsetFromObject:@90 toObject:@10 options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@0,@10,@90,@100]));
+	subset = [set subsetFromObject:nil toObject:nil options:0];
+	XCTAssertEqualObjects([subset allObjects], [set allObjects]);
+}
+
+- (void)testIsEqual {
+	NSArray *numbers = [self numbersFrom:-50 to:50 by:5];
+	[set addObjectsFromArray:numbers];
+	CHRedBlackTree *tree = [[[CHRedBlackTree alloc] initWithArray:numbers] autorelease];
+	XCTAssertTrue([set isEqual:tree]);
+	XCTAssertTrue([set isEqualToSortedSet:tree]);
+	XCTAssertFalse([set isEqual:numbers]);
+	[set removeInt64:0];
+	XCTAssertFalse([set isEqual:tree]);
+}
+
+- (void)testNSCoding {
+	[set addObjectsFromArray:[self numbersFrom:1 to:100 by:3]];
+	id copy = [[set copyUsingNSCoding] autorelease];
+	XCTAssertTrue([copy isKindOfClass:[CHInt64SortedSet class]]);
+	XCTAssertEqualObjects([copy allObjects], [set allObjects]);
+}
+
+- (void)testNSCopying {
+	id copy = [[set copy] autorelease];
+	XCTAssertEqual([copy count], 0);
+	XCTAssertEqual([set hash], [copy hash]);
+	
+	[set addObjectsFromArray:[self numbersFrom:1 to:1000 by:7]];
+	copy = [[set copy] autorelease];
+	XCTAssertEqualObjects([copy allObjects], [set allObjects]);
+	XCTAssertEqual([set hash], [copy hash]);
+	[copy removeFirstObject];
+	XCTAssertEqual([copy count], [set count] - 1);
+}
+
+- (void)testNSFastEnumeration {
+	NSUInteger limit = 100; // Spans several leaves and batches of objects
+	for (NSUInteger number = 1; number <= limit; number++) {
+		[set addInt64:number];
+	}
+	NSUInteger expected = 1, count = 0;
+	for (NSNumber *object in set) {
+		XCTAssertEqual([object unsignedIntegerValue], expected++);
+		count++;
+	}
+	XCTAssertEqual(count, limit);
+	
+	@try {
+		for (__unused id object in set) {
+			[set addObject:@(-1)];
+		}
+		XCTFail(@"Expected an exception for mutating during enumeration.");
+	}
+	@catch (NSException *exception) {
+	}
+}
+
+- (void)testObjectEnumerator {
+	XCTAssertNil([[set objectEnumerator] nextObject]);
+	XCTAssertNil([[set reverseObjectEnumerator] nextObject]);
+	[set addObjectsFromArray:[self numbersFrom:1 to:40 by:1]];
+	NSEnumerator *e = [set objectEnumerator];
+	XCTAssertEqualObjects([e nextObject], @1);
+	XCTAssertEqualObjects([e nextObject], @2);
+	XCTAssertEqualObjects([e allObjects], [self numbersFrom:3 to:40 by:1]);
+	XCTAssertNil([e nextObject]);
+	e = [set reverseObjectEnumerator];
+	XCTAssertEqualObjects([e nextObject], @40);
+	[set removeObject:@1];
+	XCTAssertThrows([e nextObject]);
+}
+
+@end
+
+#pragma mark -
+
+// CHFrozenSortedSet can't be modified, so it can't reuse the tests in
+// CHSortedSetTest. These compare it against a sorted array of the same objects.
+@interface CHFrozenSortedSetTest : XCTestCase {
+	NSArray *numbers;
+	CHFrozenSortedSet *set;
+}
+@end
+
+@implementation CHFrozenSortedSetTest
+
+- (void)setUp {
+	// Enough objects that the bottom level of the implicit tree is partly full.
+	NSMutableArray *array = [NSMutableArray array];
+	for (NSInteger number = 0; number <= 990; number += 10) {
+		[array addObject:@(number)];
+	}
+	numbers = array;
+	set = [[[CHFrozenSortedSet alloc] initWithArray:numbers] autorelease];
+}
+
+- (void)testInitWithArray {
+	XCTAssertEqual([set count], [numbers count]);
+	XCTAssertEqualObjects([set allObjects], numbers);
+	XCTAssertEqualObjects([set firstObject], @0);
+	XCTAssertEqualObjects([set lastObject], @990);
+	
+	// Unsorted objects are sorted, and the last of several equal objects is kept.
+	NSMutableArray *shuffled = [NSMutableArray arrayWithArray:numbers];
+	[shuffled addObjectsFromArray:numbers];
+	for (NSUInteger i = [shuffled count] - 1; i > 0; i--) {
+		[shuffled exchangeObjectAtIndex:i withObjectAtIndex:arc4random_uniform((uint32_t)i + 1)];
+	}
+	set = [[[CHFrozenSortedSet alloc] initWithArray:shuffled] autorelease];
+	XCTAssertEqualObjects([set allObjects], numbers);
+	NSString *a1 = [NSMutableString stringWithString:@"A"];
+	NSString *a2 = [NSMutableString stringWithString:@"A"];
+	set = [[[CHFrozenSortedSet alloc] initWithArray:@[a1, @"B", a2]] autorelease];
+	XCTAssertEqual([set count], 2);
+	XCTAssertEqual([set firstObject], a2);
+	
+	set = [[[CHFrozenSortedSet alloc] init] autorelease];
+	XCTAssertEqual([set count], 0);
+	XCTAssertNil([set firstObject]);
+	XCTAssertNil([set lastObject]);
+	XCTAssertNil([set anyObject]);
+	XCTAssertNil([set member:@1]);
+	XCTAssertEqualObjects([set allObjects], @[]);
+}
+
+- (void)testInitWithSortedSet {
+	XCTAssertThrows([[CHFrozenSortedSet alloc] initWithSortedSet:nil]);
+	CHRedBlackTree *tree = [[[CHRedBlackTree alloc] initWithArray:numbers] autorelease];
+	set = [[[CHFrozenSortedSet alloc] initWithSortedSet:tree] autorelease];
+	XCTAssertEqualObjects([set allObjects], numbers);
+	XCTAssertTrue([set isEqual:tree]);
+	XCTAssertTrue([set isEqualToSortedSet:tree]);
+	XCTAssertEqual([set hash], [tree hash]);
+	[tree removeLastObject];
+	XCTAssertFalse([set isEqual:tree]);
+}
+
+- (void)testMember {
+	XCTAssertThrows([set member:nil]);
+	for (NSInteger key = -5; key <= 1000; key += 5) {
+		NSNumber *probe = @(key);
+		BOOL isMember = (key >= 0 && key % 10 == 0);
+		XCTAssertEqualObjects([set member:probe], isMember ? probe : nil);
+		XCTAssertEqual([set containsObject:probe], isMember);
+	}
+}
+
+- (void)testNearestObjects {
+	XCTAssertThrows([set floorObject:nil]);
+	XCTAssertThrows([set objectAfter:nil]);
+	
+	for (NSInteger key = -5; key <= 1000; key += 5) {
+		NSNumber *probe = @(key);
+		id expectedFloor = nil, expectedCeiling = nil, expectedBefore = nil, expectedAfter = nil;
+		for (NSNumber *number in numbers) {
+			NSInteger value = [number integerValue];
+			if (value <= key) {
+				expectedFloor = number;
+			}
+			if (value < key) {
+				expectedBefore = number;
+			}
+			if (value >= key && expectedCeiling == nil) {
+				expectedCeiling = number;
+			}
+			if (value > key && expectedAfter == nil) {
+				expectedAfter = number;
+			}
+		}
+		XCTAssertEqualObjects([set floorObject:probe], expectedFloor);
+		XCTAssertEqualObjects([set ceilingObject:probe], expectedCeiling);
+		XCTAssertEqualObjects([set objectBefore:probe], expectedBefore);
+		XCTAssertEqualObjects([set objectAfter:probe], expectedAfter);
+	}
+}
+
+- (void)testModifyingRaisesException {
+	XCTAssertThrows([set addObject:@5]);
+	XCTAssertThrows([set addObjectsFromArray:@[@5]]);
+	XCTAssertThrows([set removeObject:@10]);
+	XCTAssertThrows([set removeFirstObject]);
+	XCTAssertThrows([set removeLastObject]);
+	XCTAssertThrows([set removeAllObjects]);
+	XCTAssertEqualObjects([set allObjects], numbers);
+}
+
+- (void)testSubsetFromObjectToObject {
+	set = [[[CHFrozenSortedSet alloc] initWithArray:@[@0,@10,@20,@30,@40,@50,@60,@70,@80,@90,@100]] autorelease];
+	id<CHSortedSet> subset;
+	
+	subset = [set subsetFromObject:@20 toObject:@50 options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@20,@30,@40,@50]));
+	XCTAssertTrue([subset isKindOfClass:[CHFrozenSortedSet class]]);
+	XCTAssertEqualObjects([subset member:@30], @30);
+	subset = [set subsetFromObject:@15 toObject:@55 options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@20,@30,@40,@50]));
+	subset = [set subsetFromObject:@20 toObject:@50
+	                       options:CHSubsetConstructionExcludeLowEndpoint|CHSubsetConstructionExcludeHighEndpoint];
+	XCTAssertEqualObjects([subset allObjects], (@[@30,@40]));
+	subset = [set subsetFromObject:@80 toObject:nil options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@80,@90,@100]));
+	subset = [set subsetFromObject:nil toObject:@10 options:CHSubsetConstructionExcludeHighEndpoint];
+	XCTAssertEqualObjects([subset allObjects], (@[@0]));
+	subset = [set subsetFromObject:@200 toObject:nil options:0];
+	XCTAssertEqualObjects([subset allObjects], @[]);
+	// Parameters in reverse order exclude the objects between them.
+	subset = [set subsetFromObject:@90 toObject:@10 options:0];
+	XCTAssertEqualObjects([subset allObjects], (@[@0,@10,@90,@100]));
+	// Equal endpoints include everything, or everything but the endpoint.
+	subset = [set subsetFromObject:@50 toObject:@50 options:0];
+	XCTAssertEqualObjects([subset allObjects], [set allObjects]);
+	subset = [set subsetFromObject:@50 toObject:@50 options:CHSubsetConstructionExcludeLowEndpoint];
+	XCTAssertEqualObjects([subset allObjects], (@[@0,@10,@20,@30,@40,@60,@70,@80,@90,@100]));
+	subset = [set subsetFromObject:nil toObject:nil options:0];
+	XCTAssertEqualObjects([subset allObjects], [set allObjects]);
+}
+
+- (void)testNSCoding {
+	id copy = [[set copyUsingNSCoding] autorelease];
+	XCTAssertTrue([copy isKindOfClass:[CHFrozenSortedSet class]]);
+	XCTAssertEqualObjects([copy allObjects], numbers);
+	XCTAssertEqualObjects(copy, set);
+}
+
+- (void)testNSCopying {
+	id copy = [[set copy] autorelease];
+	XCTAssertEqual(copy, set);
+	XCTAssertEqual([set hash], [copy hash]);
+}
+
+- (void)testNSFastEnumeration {
+	NSUInteger index = 0;
+	for (NSNumber *object in set) {
+		XCTAssertEqualObjects(object, numbers[index++]);
+	}
+	XCTAssertEqual(index, [numbers count]);
+}
+
+- (void)testObjectEnumerator {
+	NSEnumerator *e = [set objectEnumerator];
+	XCTAssertEqualObjects([e nextObject], @0);
+	XCTAssertEqualObjects([e nextObject], @10);
+	XCTAssertEqualObjects([e allObjects], [numbers subarrayWithRange:NSMakeRange(2, [numbers count] - 2)]);
+	XCTAssertNil([e nextObject]);
+	e = [set reverseObjectEnumerator];
+	XCTAssertEqualObjects([e allObjects], [[numbers reverseObjectEnumerator] allObjects]);
+	XCTAssertEqualObjects([set set], [NSSet setWithArray:numbers]);
+}
+
+@end